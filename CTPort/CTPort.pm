@@ -51,18 +51,30 @@ our $VERSION = '0.3';
 
 # constructor - opens TCP/IP connection to server and makes sure we are
 # on hook to start with
-sub new($) {
+sub new($;$) {
     my $proto = shift;
     my $port = shift;
+    my $channel = shift;
     my $class = ref($proto) || $proto;
     my $self = {};
+    my $server;
 
-    $self->{SERVER} = IO::Socket::INET->new(
+    $server = IO::Socket::INET->new(
 				Proto => "tcp",
 				PeerAddr => "localhost",
 				PeerPort => $port,
 				)
 	or croak "cannot connect to server tcp port $port";
+    $self->{SERVER} = $server;
+
+    # a port shared by several channels, pick one
+    if (defined $channel) {
+	print $server "ctchannel\n$channel\n";
+	my $reply = <$server>;
+	$reply =~ /OK (\d+:\d+)/
+	    or croak "channel $channel not available on tcp port $port";
+	$self->{CHANNEL} = $1;
+    }
 
     $self->{EVENT}  = undef;
     $self->{DEF_EXT} = ".au";     # default audio file extension
@@ -134,23 +146,48 @@ sub wait_for_dial_tone() {
 sub play($) {
    my $self = shift;
    my $files_str = shift;
+   my $server = $self->{SERVER};
    my $file;
+   my $path;
+   my @paths;
+   my $event;
 
    unless ($files_str) {return;}
+   if ($self->{EVENT}) {return;}
    my @files_array = split(/ /,$files_str);
 
    foreach $file (@files_array) {
-       if (!$self->{EVENT}) {
-	   $self->_ctplayonefile($file);
+       $path = $self->_findfile($file);
+       if (defined($path)) {
+	   push(@paths, $path);
        }
    }
+   unless (@paths) {return;}
+
+   # the server plays the whole list without gaps, and tells us which
+   # file was playing if a key was pressed
+
+   undef $self->{INDEX};
+   print $server "ctplaylist\n" . scalar(@paths) . "\n" . 
+       join("\n", @paths) . "\n";
+   $event = <$server>;
+   if ($event =~ /([0-9ABCD#*]) (\d+)/) {
+       $self->{EVENT} = $1;
+       $self->{INDEX} = $2;
+   }
+}
+
+sub play_index() {
+    my $self = shift;
+
+    return $self->{INDEX};
 }
 
-sub _ctplayonefile() {
+# returns the full path of an audio file, or undef if it can't be found
+
+sub _findfile() {
    my $self = shift;
    my($file) = shift;
-   my $server = $self->{SERVER};
-   my $event;
    my $path;
 
    # append default extension if no extension on file name
@@ -168,11 +205,7 @@ sub _ctplayonefile() {
 	   # find first path that contains the file
 
 	   if (-e "$path/$file") {
-	       print $server "ctplay\n$path/$file\n";
-	       $event = <$server>;
-	       $event =~ s/[^1-9ADCD#*]//g;
-	       $self->{EVENT} = $event;
-               return;			      
+	       return "$path/$file";
 	   }
        }
    }
@@ -181,32 +214,21 @@ sub _ctplayonefile() {
 
    if (-e "$ENV{PWD}/$file") {
        # full path supplied by caller
-       print $server "ctplay\n$ENV{PWD}/$file\n";
-       $event = <$server>;
-       $event =~ s/[^1-9ADCD#*]//g;
-       $self->{EVENT} = $event;
-       return;			      
+       return "$ENV{PWD}/$file";
    }
 
    if (-e "$ENV{PWD}/prompts/$file") {
        # prompts sub-dir of current dir
-       print $server "ctplay\n$ENV{PWD}/prompts/$file\n";
-       $event = <$server>;
-       $event =~ s/[^1-9ADCD#*]//g;
-       $self->{EVENT} = $event;
-       return;			      
+       return "$ENV{PWD}/prompts/$file";
    }
 
    if (-e "/var/ctserver/USEngM/$file") {
        # USEngM prompts dir
-       print $server "ctplay\n/var/ctserver/USEngM/$file\n";
-       $event = <$server>;
-       $event =~ s/[^1-9ADCD#*]//g;
-       $self->{EVENT} = $event;
-       return;			      
+       return "/var/ctserver/USEngM/$file";
    }
 
    carp "play: File $file not found!\n";
+   return undef;
 } 
 
 sub record($$$) {
@@ -224,10 +246,108 @@ sub record($$$) {
    }
    print $server "ctrecord\n$file\n$timeout\n$term_digits\n";
    $event = <$server>;
+   # "OK <ms>" when record_vad() is on
+   undef $self->{SPEECH};
+   if ($event =~ s/OK (\d+)/OK/) {
+       $self->{SPEECH} = $1;
+   }
    $event =~ s/[^1-9ADCD#*]//g;
    $self->{EVENT} = $event;
 } 
 
+sub speech() {
+    my $self = shift;
+
+    return $self->{SPEECH};
+}
+
+sub record_vad($) {
+   my $self = shift;
+   my $silence = shift;
+   my $server = $self->{SERVER};
+   my $ret;
+
+   print $server "ctrecordvad\n$silence\n";
+   $ret = <$server>;
+   return $ret =~ /OK/;
+}
+
+sub record_format($) {
+   my $self = shift;
+   my $format = shift;
+   my $server = $self->{SERVER};
+   my $ret;
+
+   print $server "ctrecordformat\n$format\n";
+   $ret = <$server>;
+   return $ret =~ /OK/;
+}
+
+sub record_stream($$$;$) {
+   my $self = shift;
+   my $callback = shift;
+   my $timeout = shift;
+   my $term_digits = shift;
+   my $mode = shift || "linear";
+   my $server = $self->{SERVER};
+   my ($line, $audio);
+
+   print $server "ctrecordstream\n$mode\n$timeout\n$term_digits\n";
+   while ($line = <$server>) {
+       last unless $line =~ /^\0?audio (\d+)$/;
+       read($server, $audio, $1);
+       &$callback($audio);
+   }
+   $line =~ s/[^1-9ADCD#*]//g;
+   $self->{EVENT} = $line;
+}
+
+sub _conference($$$$) {
+   my $self = shift;
+   my $cmd = shift;
+   my $name = shift;
+   my $term_digits = shift;
+   my $server = $self->{SERVER};
+   my $event;
+
+   print $server "$cmd\n$name\n$term_digits\n";
+   $event = <$server>;
+   $event =~ s/[^1-9ADCD#*]//g;
+   $self->{EVENT} = $event;
+}
+
+sub conference($$) {
+   my $self = shift;
+   $self->_conference("ctconference", @_);
+}
+
+sub bridge($$) {
+   my $self = shift;
+   $self->_conference("ctbridge", @_);
+}
+
+sub run_script($;$) {
+    my $self = shift;
+    my $script = shift;
+    my $callout = shift;
+    my $server = $self->{SERVER};
+    my @lines = split(/\n/, $script);
+    my $reply;
+
+    undef $self->{EVENT};
+    print $server "ctrunscript\n" . scalar(@lines) . "\n" .
+	join("\n", @lines) . "\n";
+
+    # the script may stop to ask us something before it ends
+    while (1) {
+	$reply = <$server>;
+	$reply =~ s/[\0\n]//g;
+	last unless $reply =~ /^CALLOUT ?(.*)/;
+	print $server ($callout ? &$callout($1) : "") . "\n";
+    }
+    return $reply;
+}
+
 sub ctsleep($) {
     my $self = shift;
     my $secs = shift;
@@ -265,7 +385,7 @@ sub collect($$) {
 
     print $server "ctcollect\n$maxdigits\n$maxseconds\n$maxinter\n";
     $digits = <$server>; 
-    $digits =~ s/[^1-9ADCD#*]//g;
+    $digits =~ s/[^0-9A-D#*]//g;
     return $digits;		  
 }
 
@@ -309,6 +429,44 @@ sub number($) {
     return $all;
 }
 
+# the say_xxx methods have the server build and play the readout from its
+# UsEngM vocabulary, in one round trip
+
+sub _say($$) {
+    my $self = shift;
+    my $cmd = shift;
+    my $arg = shift;
+    my $server = $self->{SERVER};
+    my $event;
+
+    if ($self->{EVENT}) {return;}
+    print $server "$cmd\n$arg\n";
+    $event = <$server>;
+    if ($event =~ /^\0?([0-9ABCD#*])$/) {
+	$self->{EVENT} = $1;
+    }
+}
+
+sub say_number($) {
+    my $self = shift;
+    $self->_say("ctsaynumber", shift);
+}
+
+sub say_digits($) {
+    my $self = shift;
+    $self->_say("ctsaydigits", shift);
+}
+
+sub spell($) {
+    my $self = shift;
+    $self->_say("ctspell", shift);
+}
+
+sub say_date($) {
+    my $self = shift;
+    $self->_say("ctsaydate", shift);
+}
+
 sub get_inter_digit_time_out() {
     my $self = shift;
 
@@ -361,6 +519,12 @@ Connects Perl client to the "ctserver" server via TCP/IP port SERVER_PORT,
 where SERVER_PORT=1200, 1201,..... etc for the first, second,..... etc
 CT ports.
 
+new Telephony::CTPort(SERVER_PORT, CHANNEL);
+
+Connects to a TCP/IP port the server shares between several CT ports (a
+"select" line in ctserver.conf), and asks for CHANNEL, either
+"<board>:<channel>" or "any".  Dies if that channel is in use.
+
 =head1 METHODS
 
 event() - returns the most recent event, or undef if no events pending.
@@ -370,7 +534,8 @@ off_hook() - takes port off hook, just like picking up the phone.
 on_hook() - places the port on hook, just like hanging up.
 
 wait_for_ring() - blocks until port detects a ring, then returns.  The caller
-ID (if present) will be returned.
+ID (if present) will be returned, as soon as it is decoded, which is usually
+before the second ring.
 
 wait_for_dial_tone() - blocks until dial tone detected on port, then returns.
 
@@ -391,6 +556,11 @@ default is .au, can be redefined by calling set_def_ext()
 
 override default by providing extension, e.g. $ctport->play("hello.wav");
 
+=item *
+
+files may be at any sample rate up to 48 kHz, mono or stereo, the server
+converts them once when it first loads them
+
 =back
 
 Searches for file in:
@@ -432,11 +602,76 @@ $ctport->play("1 2 3");
 (see /var/ctserver/UsMEng directory for the list of included files that define
 the vocab)
 
+All the files are sent to the server in one "ctplaylist" command, and are
+played back to back without gaps.
+
+play_index() - after play() was stopped by a DTMF key, returns the index
+(from 0) of the file that was playing, otherwise undef.
+
 record($file_name, $time_out, $term_keys) - records $file_name for 
 $time_out seconds or until any of the digits in $term_keys are pressed.
 The path of $file_name is considered absolute if there is a leading /, 
 otherwise it is relative to the current directory.
 
+record_format($format) - sets what record() writes from now on, one of
+"linear" (16 bit), "alaw" or "mulaw" (the default), optionally with a
+sample rate, e.g. "linear/16000".  The port always records at 8 kHz and
+the file is converted when the recording ends.  Returns true if the server
+accepted the format.
+
+record_vad($silence) - from now on record() listens for the caller
+talking, and ends once they have been quiet for $silence ms after
+speaking.  The silence before and after what they said is trimmed from
+the file.  A $silence of 0 only trims, "off" turns it off again.
+Returns true if the server accepted it.
+
+speech() - after record() with record_vad() on, the ms of talking in the
+recording, 0 if there was none, otherwise undef.
+
+record_stream($callback, $time_out, $term_keys, [$mode]) - records like
+record(), but instead of a file the audio is passed to &$callback in
+blocks as it arrives.  $mode is the sample format, "linear" (16 bit, the
+default), "alaw" or "mulaw", all at 8 kHz.  As with record(), the last
+quarter second is dropped so the terminating DTMF key is not heard.
+
+conference($name, $term_keys) - joins the conference $name, which is
+created when its first party joins, and returns when one of the digits in
+$term_keys is pressed or the far end hangs up.  Each party hears everyone
+else mixed, and each joins with its own port and client script.
+
+bridge($name, $term_keys) - like conference(), but for two parties only,
+so two ports joining the same $name are bridged together.  A third party
+is refused.
+
+run_script($script, [$callout]) - the server runs the whole of a menu
+script, so playing, collecting and branching cost no round trips, and
+returns what the script's end statement gives, "OK" if nothing, or "ERROR".
+A script has one statement a line:
+
+ answer
+ menu:
+ play /var/ctserver/menu.wav
+ collect key 1|2|9# 10 5
+ if $key == 1 goto balance
+ if $key == 9# goto done
+ goto menu
+ balance:
+ callout amount balance
+ say number $amount
+ goto menu
+ done:
+ end bye
+
+Steps are play, say number|digits|spell|date, collect var digits secs
+inter, record, sleep, dial, clear, answer and hangup, which do what the
+method of the same name does.  File names are as the server sees them.
+There are also set var value, goto, if with ==, !=, < or >, and end.
+$name is a variable, and $result holds what the last step returned.
+callout var text calls &$callout with the text, and the value it returns
+goes in var.  Scripts are compiled once by the server and cached, so
+sending the same script for every call costs little.  See ivr.h in the
+ctserver source for the details.
+
 ctsleep($seconds) - blocks for $seconds, unless a DTMF key is pressed in which
 case it returns immediately.  If $ctport->event() is already defined it 
 returns immediately without sleeping.
@@ -448,6 +683,15 @@ to $max_seconds.  Will return as soon as either $max_digits have been collected
 or $max_seconds have elapsed.  On return, the event() method will return
 undefined.  
 
+$max_digits may instead be a digit grammar, a regular expression over the
+keys, for example '1|2|9#' or '[0-9]{4}#'.  collect() then returns as soon as
+the digits match and no further key could extend the match, or as soon as they
+can no longer match, rather than waiting for the inter digit time out.  The
+digits are returned either way, so check them against the menu.  * is the
+star key, alternatives are |, [1-4] is any one of, . is any key, ( ) groups,
+? is optional, + is one or more and {n,m} repeats.  A grammar that is just a
+number of digits must be written with brackets, (12) rather than 12.
+
 DTMF digits pressed at any time are collected in the digit buffer.  The digit
 buffer is cleared by the clear() method.  Thus it is possible for this function
 to return immediately if there are already $max_digits in the digit buffer.
@@ -477,6 +721,16 @@ e.g. ctplay("youhave " . $ctnumber($num_mails) . " mails");
 
 (assumes files youhave.au, mails.au, and variable $num_mails exist)
 
+say_number($num) - the server speaks $num (0 to 999999999999) from its
+UsEngM vocabulary, as one gapless prompt.  Like play(), a DTMF key stops
+it and can be read with event().
+
+say_digits($digits) - speaks each digit, e.g. a phone number.
+
+spell($word) - speaks each letter and digit of $word.
+
+say_date($date) - speaks a date given as YYYYMMDD or YYYY-MM-DD.
+
 set_path() - used to set the search path for audio files supplied to play()
 
 get_inter_digit_time_out() - returns the optional inter-digit time out used
@@ -0,0 +1,35 @@
+#!/usr/bin/perl -w
+# campaign.pl
+# agent 17/10/26
+#
+# Demonstrates an outbound campaign.  ctserver must be started with
+# -campaign 1300.  The server calls every number on the command line on
+# whichever lines are free, two at a time, trying busy numbers twice
+# more a minute apart, and plays the prompt to everyone who answers.
+#
+# usage: campaign.pl prompt.wav number...
+ 
+# ctserver - client/server library for Computer Telephony programming in Perl
+# Copyright (C) 2026 agent agent@local
+# see COPYING.TXT
+
+use IO::Socket;
+
+my $prompt = shift or die "usage: campaign.pl prompt.wav number...\n";
+my $server = IO::Socket::INET->new(PeerAddr => "localhost",
+				   PeerPort => 1300,
+				   Proto => "tcp") or die "no ctserver\n";
+
+# name, lines, ms between calls, retries, seconds between retries,
+# digits to collect, then the prompts
+print $server "ctcampaign\tdemo\t2\t1000\t2\t60\t0\t$prompt\n";
+<$server> =~ /^OK/ or die "campaign refused\n";
+print $server "ctcall\tdemo\t" . join("\t", @ARGV) . "\n";
+<$server> =~ /^OK/ or die "numbers refused\n";
+
+while (<$server>) {
+    chomp;
+    my @f = split(/\t/);
+    print "$f[2]: $f[3] after $f[4] attempts on $f[5]\n" if $f[0] eq "CALL";
+    last if $f[0] eq "DONE";
+}
@@ -0,0 +1,52 @@
+#!/usr/bin/perl -w
+# menu.pl
+# agent 17/10/26
+#
+# The playrec menu run as a script in the server, so playing, collecting
+# and branching on the keys cost no round trips.  The script only calls
+# out to us to turn the three digit number into a file name.  Run it from
+# the samples directory, the server needs full paths to the prompts.
+
+# ctserver - client/server library for Computer Telephony programming in Perl
+# Copyright (C) 2026 agent agent@local
+# see COPYING.TXT
+
+use Telephony::CTPort;
+use Cwd;
+
+my $prompts = getcwd() . "/prompts";
+my $script = <<END;
+menu:
+clear
+play $prompts/playrec.ul
+collect key 1|2|# 10 5
+if \$key == 1 goto play
+if \$key == 2 goto record
+# no key, or #
+if \$key < 1 goto done
+play $prompts/playrec0.ul
+goto menu
+play:
+play $prompts/playrec1.ul
+collect number [0-9]{3} 10 5
+callout file \$number
+play \$file
+goto menu
+record:
+play $prompts/playrec2.ul
+collect number [0-9]{3} 10 5
+callout file \$number
+record \$file 6 *#
+goto menu
+done:
+end
+END
+
+$ctport = new Telephony::CTPort(1200); # first port of CT card
+
+while(1) {
+    $ctport->wait_for_ring();
+    $ctport->off_hook;
+    $ctport->run_script($script, sub { "/tmp/" . shift() . ".wav" });
+    $ctport->on_hook;
+}
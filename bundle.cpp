@@ -0,0 +1,128 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: BUNDLE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Reading prompt bundles, see bundle.h.  They are written by ctbundle.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ctbackend.h"
+#include "bundle.h"
+
+// FNV-1a, as the prompt cache uses
+
+unsigned int bundle_hash(const char *name) {
+  unsigned int h = 2166136261u;
+
+  while(*name)
+    h = (h ^ (unsigned char)*name++) * 16777619u;
+  return h;
+}
+
+// offsets all inside the file, and an empty slot for lookups to stop on
+
+static int check(BUNDLE *b) {
+  BUNDLE_HDR  *h = b->hdr;
+  BUNDLE_SLOT *s;
+  unsigned int i, used = 0, names_size;
+
+  if (memcmp(h->magic, BUNDLE_MAGIC, 8) || (h->size != b->size) ||
+      !h->nslots || (h->nslots & (h->nslots-1)) ||
+      (h->nprompts >= h->nslots) || (h->index < sizeof(BUNDLE_HDR)) ||
+      (h->names < h->index + (unsigned long)h->nslots*sizeof(BUNDLE_SLOT)) ||
+      (h->data <= h->names) || (h->data > h->size) ||
+      (memchr(h->dir, 0, BUNDLE_DIR) == NULL))
+    return CT_ERROR;
+
+  names_size = h->data - h->names;
+  for(i=0; i<h->nslots; i++) {
+    s = &b->slots[i];
+    if (s->name == 0)
+      continue;
+    used++;
+    if ((s->name >= names_size) ||
+	(memchr(b->names + s->name, 0, names_size - s->name) == NULL) ||
+	(s->off > h->size - h->data) || (s->bytes > h->size - h->data - s->off))
+      return CT_ERROR;
+  }
+
+  return (used == h->nprompts) ? CT_OK : CT_ERROR;
+}
+
+int bundle_map(const char *file_name, BUNDLE *b) {
+  struct stat st;
+  void        *p;
+  int         fd;
+
+  memset(b, 0, sizeof(BUNDLE));
+  fd = open(file_name, O_RDONLY);
+  if (fd == -1)
+    return CT_ERROR;
+  if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(BUNDLE_HDR))) {
+    close(fd);
+    return CT_ERROR;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return CT_ERROR;
+
+  b->hdr = (BUNDLE_HDR*)p;
+  b->size = st.st_size;
+  b->slots = (BUNDLE_SLOT*)((char*)p + b->hdr->index);
+  b->names = (const char*)p + b->hdr->names;
+  b->data = (const char*)p + b->hdr->data;
+  if (check(b) != CT_OK) {
+    bundle_unmap(b);
+    return CT_ERROR;
+  }
+
+  return CT_OK;
+}
+
+int bundle_find(BUNDLE *b, const char *name) {
+  unsigned int h = bundle_hash(name), mask = b->hdr->nslots - 1, i;
+
+  for(i=h & mask; b->slots[i].name; i=(i+1) & mask)
+    if ((b->slots[i].hash == h) && !strcmp(b->names + b->slots[i].name, name))
+      return i;
+  return -1;
+}
+
+void bundle_unmap(BUNDLE *b) {
+  if (b->hdr)
+    munmap(b->hdr, b->size);
+  memset(b, 0, sizeof(BUNDLE));
+}
@@ -0,0 +1,86 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: BUNDLE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Prompt bundles, a directory of prompts packed into one file by
+    ctbundle and mapped read only by the server.  The layout is a header,
+    a hash index of the prompt names, the names, then the samples of
+    every prompt in the card's mode at 8 kHz, starting on a page boundary.
+    Numbers are in host byte order.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __BUNDLE__
+#define __BUNDLE__
+
+#define BUNDLE_MAGIC       "CTBNDL01"
+#define BUNDLE_PAGE        4096         // data starts on a page
+#define BUNDLE_ALIGN       64           // and each prompt on a cache line
+#define BUNDLE_DIR         256
+
+typedef struct {
+  char         magic[8];
+  unsigned int mode;                    // CT_xxx of every prompt
+  unsigned int rate;                    // Hz
+  unsigned int nprompts;
+  unsigned int nslots;                  // index slots, a power of 2
+  unsigned int index;                   // file offsets of each part
+  unsigned int names;
+  unsigned int data;
+  unsigned int size;                    // of the whole file
+  char         dir[BUNDLE_DIR];         // directory the prompts stand in for
+} BUNDLE_HDR;
+
+// open addressed, linear probing from hash & (nslots-1)
+typedef struct {
+  unsigned int hash;
+  unsigned int name;                    // into names, 0 for an empty slot
+  unsigned int off;                     // into data
+  unsigned int bytes;
+} BUNDLE_SLOT;
+
+typedef struct {
+  BUNDLE_HDR   *hdr;
+  BUNDLE_SLOT  *slots;
+  const char   *names;
+  const char   *data;
+  unsigned long size;
+} BUNDLE;
+
+unsigned int bundle_hash(const char *name);
+
+// maps a bundle and checks it hangs together, CT_OK or CT_ERROR
+int  bundle_map(const char *file_name, BUNDLE *b);
+
+// slot holding a prompt, or -1
+int  bundle_find(BUNDLE *b, const char *name);
+
+void bundle_unmap(BUNDLE *b);
+
+#endif
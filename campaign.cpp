@@ -0,0 +1,278 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CAMPAIGN.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Outbound dialling campaign scheduler, see campaign.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "ctbackend.h"
+#include "campaign.h"
+
+static CAMPAIGN      *camps;            // served from the head
+static unsigned long serial;            // makes phrase keys unique
+
+static void camp_free(CAMPAIGN *c);
+
+CAMPAIGN *camp_find(const char *name, int owner, int *taken) {
+  CAMPAIGN *c;
+
+  *taken = 0;
+  for(c=camps; c; c=c->next)
+    if ((c->owner != -1) && (strcmp(c->name, name) == 0)) {
+      if (c->owner == owner)
+	return c;
+      *taken = 1;
+    }
+
+  return NULL;
+}
+
+int camp_set(const char *name, int owner, int lines, int gap_ms,
+	     int retries, int retry_ms, int digits, const char **prompts,
+	     int nprompts) {
+  CAMPAIGN *c;
+  int      i, taken;
+
+  if ((strlen(name) >= CAMP_NAME) || (lines < 1) || (gap_ms < 0) ||
+      (retries < 0) || (retry_ms < 0) || (digits < 0) ||
+      (digits >= CT_MAX_STR) || (nprompts < 1) ||
+      (nprompts > CAMP_PROMPTS))
+    return CT_ERROR;
+  for(i=0; i<nprompts; i++)
+    if (strlen(prompts[i]) >= CAMP_FILE)
+      return CT_ERROR;
+
+  c = camp_find(name, owner, &taken);
+  if (taken)
+    return CT_ERROR;
+  if (c == NULL) {
+    c = (CAMPAIGN*)calloc(1, sizeof(CAMPAIGN));
+    strcpy(c->name, name);
+    c->owner = owner;
+    c->next = camps;
+    camps = c;
+  }
+
+  c->lines = lines;
+  c->gap_ms = gap_ms;
+  c->retries = retries;
+  c->retry_ms = retry_ms;
+  c->digits = digits;
+  c->nprompts = nprompts;
+  for(i=0; i<nprompts; i++)
+    strcpy(c->prompt[i], prompts[i]);
+  sprintf(c->key, "campaign %lu", ++serial);
+
+  return CT_OK;
+}
+
+int camp_add(CAMPAIGN *c, const char *number) {
+  CAMP_CALL *call;
+
+  if ((*number == 0) || (strlen(number) >= CAMP_NUMBER))
+    return CT_ERROR;
+
+  call = (CAMP_CALL*)calloc(1, sizeof(CAMP_CALL));
+  call->c = c;
+  strcpy(call->number, number);
+  if (c->tail)
+    c->tail->next = call;
+  else
+    c->head = call;
+  c->tail = call;
+  c->waiting++;
+
+  return CT_OK;
+}
+
+static int drop(CAMP_CALL **head, CAMP_CALL **tail) {
+  CAMP_CALL *call;
+  int       n = 0;
+
+  while((call = *head) != NULL) {
+    *head = call->next;
+    free(call);
+    n++;
+  }
+  *tail = NULL;
+
+  return n;
+}
+
+int camp_cancel(CAMPAIGN *c) {
+  int n;
+
+  n = drop(&c->head, &c->tail) + drop(&c->rhead, &c->rtail);
+  c->waiting = 0;
+
+  return n;
+}
+
+void camp_owner_gone(int owner) {
+  CAMPAIGN *c, *next;
+
+  for(c=camps; c; c=next) {
+    next = c->next;
+    if (c->owner != owner)
+      continue;
+    camp_cancel(c);
+    c->owner = -1;
+    if (c->active == 0)
+      camp_free(c);
+  }
+}
+
+// the call c would start now, NULL if it has to wait.  *wait_ms is
+// lowered to when it could if that is the only reason.
+
+static CAMP_CALL *ready(CAMPAIGN *c, unsigned long long now, long *wait_ms) {
+  CAMP_CALL          *call;
+  unsigned long long at;
+
+  if ((c->waiting == 0) || (c->active >= c->lines))
+    return NULL;
+
+  at = c->next_start;
+  if (c->head == NULL) {
+    if (c->rhead->due > at)
+      at = c->rhead->due;
+  }
+  if (at > now) {
+    if ((*wait_ms == -1) || ((long)(at - now) < *wait_ms))
+      *wait_ms = at - now;
+    return NULL;
+  }
+
+  // retries go first once they are due, they have waited longest
+  if (c->rhead && (c->rhead->due <= now)) {
+    call = c->rhead;
+    if ((c->rhead = call->next) == NULL)
+      c->rtail = NULL;
+  }
+  else {
+    call = c->head;
+    if ((c->head = call->next) == NULL)
+      c->tail = NULL;
+  }
+  call->next = NULL;
+
+  return call;
+}
+
+CAMP_CALL *camp_next(unsigned long long now, long *wait_ms) {
+  CAMPAIGN  *c, *prev, *last;
+  CAMP_CALL *call;
+
+  *wait_ms = -1;
+  for(prev=NULL, c=camps; c; prev=c, c=c->next) {
+    if ((call = ready(c, now, wait_ms)) == NULL)
+      continue;
+
+    c->waiting--;
+    c->active++;
+    c->next_start = now + c->gap_ms;
+    call->attempts++;
+
+    // to the back of the list, so campaigns take turns
+    if (c->next) {
+      if (prev)
+	prev->next = c->next;
+      else
+	camps = c->next;
+      for(last=c->next; last->next; last=last->next);
+      last->next = c;
+      c->next = NULL;
+    }
+
+    return call;
+  }
+
+  return NULL;
+}
+
+int camp_done(CAMP_CALL *call, int result, unsigned long long now) {
+  CAMPAIGN *c = call->c;
+
+  c->active--;
+  if ((result != CAMP_ANSWERED) && (result != CAMP_ERROR) &&
+      (call->attempts <= c->retries) && (c->owner != -1)) {
+    call->due = now + c->retry_ms;
+    if (c->rtail)
+      c->rtail->next = call;
+    else
+      c->rhead = call;
+    c->rtail = call;
+    c->waiting++;
+    return 1;
+  }
+
+  if (result == CAMP_ANSWERED)
+    c->answered++;
+  else
+    c->failed++;
+
+  return 0;
+}
+
+void camp_release(CAMP_CALL *call) {
+  CAMPAIGN *c = call->c;
+
+  free(call);
+  if ((c->owner == -1) && (c->active == 0))
+    camp_free(c);
+}
+
+int camp_idle(CAMPAIGN *c) {
+  return (c->waiting == 0) && (c->active == 0);
+}
+
+const char *camp_result_name(int result) {
+  static const char *names[] = {"ANSWERED", "BUSY", "NOANSWER",
+				"NODIALTONE", "ERROR"};
+
+  if ((result < CAMP_ANSWERED) || (result > CAMP_ERROR))
+    return "ERROR";
+  return names[result];
+}
+
+static void camp_free(CAMPAIGN *c) {
+  CAMPAIGN **p;
+
+  for(p=&camps; *p; p=&(*p)->next)
+    if (*p == c) {
+      *p = c->next;
+      break;
+    }
+  camp_cancel(c);
+  free(c);
+}
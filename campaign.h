@@ -0,0 +1,134 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CAMPAIGN.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Outbound dialling campaigns.  A campaign is a queue of numbers to
+    call, with the prompts to play when a call is answered and limits on
+    how it may use the lines: how many calls at once, how far apart calls
+    may start, and how often a busy or unanswered number is tried again.
+    This module only decides which number is due next, ctserver runs the
+    calls on whatever channels are idle and reports how they went.
+
+    Everything here runs in the reactor thread, so nothing is locked.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __CAMPAIGN__
+#define __CAMPAIGN__
+
+#define CAMP_NAME          32
+#define CAMP_NUMBER        32
+#define CAMP_PROMPTS       8
+#define CAMP_FILE          100
+#define CAMP_KEY           (CAMP_NAME+16)
+
+// how a call ended
+#define CAMP_ANSWERED      0
+#define CAMP_BUSY          1
+#define CAMP_NOANSWER      2
+#define CAMP_NODIALTONE    3
+#define CAMP_ERROR         4
+
+typedef struct CAMPAIGN CAMPAIGN;
+
+typedef struct CAMP_CALL {
+  struct CAMP_CALL   *next;
+  CAMPAIGN           *c;
+  int                attempts;
+  unsigned long long due;               // ms, a retry waits until then
+  char               number[CAMP_NUMBER];
+} CAMP_CALL;
+
+struct CAMPAIGN {
+  CAMPAIGN           *next;
+  char               name[CAMP_NAME];
+  int                owner;             // told the results, -1 once gone
+
+  // set by the owner
+  int                lines;             // most calls at once
+  int                gap_ms;            // least time between call starts
+  int                retries;           // further attempts when not answered
+  int                retry_ms;
+  int                digits;            // collected after the prompts
+  int                nprompts;
+  char               prompt[CAMP_PROMPTS][CAMP_FILE];
+  char               key[CAMP_KEY];     // phrase cache key for the prompts
+
+  // new numbers in the order given, then retries in the order they are
+  // due, as retry_ms is the same for all of them
+  CAMP_CALL          *head, *tail;
+  CAMP_CALL          *rhead, *rtail;
+  int                waiting;
+  int                active;
+  unsigned long long next_start;        // ms
+
+  unsigned long      answered, failed;
+};
+
+// the owner's campaign called name, NULL if there isn't one.  Another
+// owner's campaign of that name is returned through *taken.
+CAMPAIGN *camp_find(const char *name, int owner, int *taken);
+
+// creates the campaign, or changes it if the owner already has one.
+// CT_ERROR if the name belongs to someone else.
+int camp_set(const char *name, int owner, int lines, int gap_ms,
+	     int retries, int retry_ms, int digits, const char **prompts,
+	     int nprompts);
+
+// queues a number to call, CT_ERROR if it is too long
+int camp_add(CAMPAIGN *c, const char *number);
+
+// drops the numbers still waiting, returns how many
+int camp_cancel(CAMPAIGN *c);
+
+// the owner has gone, its campaigns stop and are freed once the calls
+// in progress have ended
+void camp_owner_gone(int owner);
+
+// the next call that may start at now, NULL if none.  Campaigns take
+// turns.  *wait_ms is set to how long until a paced or retried call
+// could start, or -1 if only a channel or a call ending can help.
+CAMP_CALL *camp_next(unsigned long long now, long *wait_ms);
+
+// a call returned by camp_next has ended.  Returns 1 if it has been
+// queued to try again, otherwise the caller reports it and calls
+// camp_release.
+int camp_done(CAMP_CALL *call, int result, unsigned long long now);
+
+// frees a call that has ended, and its campaign if the owner is gone and
+// nothing is left
+void camp_release(CAMP_CALL *call);
+
+// no numbers waiting or being called
+int camp_idle(CAMPAIGN *c);
+
+// result names for reports, e.g. "BUSY"
+const char *camp_result_name(int result);
+
+#endif
@@ -0,0 +1,242 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CID.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Bell 202 caller ID demodulator that works on audio as it arrives, so
+    the number is known as soon as the message ends rather than at the
+    second ring.
+
+    Each sample is mixed with quadrature mark (1200 Hz) and space
+    (2200 Hz) oscillators, the four products are summed over about a bit
+    and the larger of the mark and space energies is the bit.  The four
+    products fit one SSE register, which is used where there is SSE2.
+    A UART then finds bytes after the mark signal that precedes every
+    message, and SDMF (type 0x04) and MDMF (type 0x80) messages are
+    accepted once the checksum is good.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "cid.h"
+
+#define FS                 8000
+#define PERIOD             40           // samples, both tones repeat
+#define MIN_LEVEL          150          // peak amplitude of a carrier
+#define MIN_MARKS          67           // 10 bits of mark before a message
+
+// about CID_TAPS/2 times the level, squared
+#define MIN_ENERGY         ((CID_TAPS*MIN_LEVEL/2.0)*(CID_TAPS*MIN_LEVEL/2.0))
+
+#define HUNT               0            // waiting for carrier and mark
+#define IDLE               1            // mark, waiting for a start bit
+#define BITS               2            // in a byte
+#define DONE               3
+
+static float osc[PERIOD][4] __attribute__ ((aligned (16)));
+static int   osc_ready;
+
+void cid_init(CID_DEMOD *d) {
+  int i;
+
+  if (!osc_ready) {
+    for(i=0; i<PERIOD; i++) {
+      osc[i][0] = cos(2*M_PI*1200*i/FS);
+      osc[i][1] = sin(2*M_PI*1200*i/FS);
+      osc[i][2] = cos(2*M_PI*2200*i/FS);
+      osc[i][3] = sin(2*M_PI*2200*i/FS);
+    }
+    osc_ready = 1;
+  }
+
+  memset(d, 0, sizeof(CID_DEMOD));
+  d->state = HUNT;
+}
+
+// checks a whole message and pulls out the number, 1 if it is good
+
+static int message(CID_DEMOD *d) {
+  unsigned char sum = 0;
+  int           i, len, n;
+
+  for(i=0; i<d->nmsg; i++)
+    sum += d->msg[i];
+  if (sum != 0)
+    return 0;
+
+  len = d->msg[1];
+  d->number[0] = 0;
+  if (d->msg[0] == 0x04) {
+    // SDMF: MMDDHHMM then the number
+    n = len - 8;
+    if (n < 0)
+      return 0;
+    if (n >= CID_MAX_NUMBER)
+      n = CID_MAX_NUMBER-1;
+    memcpy(d->number, d->msg+10, n);
+    d->number[n] = 0;
+    return 1;
+  }
+  if (d->msg[0] == 0x80) {
+    // MDMF: parameters of type, length, data.  0x02 is the number.
+    for(i=2; i+1 < 2+len; i += 2+d->msg[i+1]) {
+      if ((d->msg[i] == 0x02) && (i+2+d->msg[i+1] <= 2+len)) {
+	n = d->msg[i+1];
+	if (n >= CID_MAX_NUMBER)
+	  n = CID_MAX_NUMBER-1;
+	memcpy(d->number, d->msg+i+2, n);
+	d->number[n] = 0;
+      }
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+// one demodulated sample, e is the total energy and m is > 0 for mark
+
+static int uart(CID_DEMOD *d, float e, float m) {
+  int mark = m > 0;
+
+  if (e < MIN_ENERGY) {
+    d->state = HUNT;
+    d->marks = 0;
+    return 0;
+  }
+
+  switch(d->state) {
+  case HUNT:
+    d->marks = mark ? d->marks+1 : 0;
+    if (d->marks >= MIN_MARKS) {
+      d->state = IDLE;
+      d->nmsg = 0;
+    }
+    break;
+
+  case IDLE:
+    if (!mark) {
+      d->state = BITS;
+      d->t = 0;
+      d->bit = 0;
+      d->byte = 0;
+    }
+    break;
+
+  case BITS:
+    // bits are 20/3 samples, sample each in the middle
+    d->t++;
+    if (3*d->t < 20*d->bit+10)
+      break;
+    if (d->bit == 0) {
+      if (mark)
+	d->state = IDLE;                // a glitch, not a start bit
+    }
+    else if (d->bit <= 8)
+      d->byte |= mark << (d->bit-1);
+    else {
+      if (!mark) {
+	d->state = HUNT;                // framing error
+	d->marks = 0;
+	break;
+      }
+      d->msg[d->nmsg++] = d->byte;
+      d->state = IDLE;
+      if ((d->nmsg >= 2) && (d->nmsg == d->msg[1]+3)) {
+	if (message(d)) {
+	  d->state = DONE;
+	  return 1;
+	}
+	d->state = HUNT;
+	d->marks = 0;
+      }
+      break;
+    }
+    d->bit++;
+    break;
+  }
+
+  return 0;
+}
+
+int cid_feed(CID_DEMOD *d, const short *s, int n) {
+  int i;
+
+  if (d->state == DONE)
+    return 0;
+
+#ifdef __SSE2__
+  __m128 acc = _mm_load_ps(d->acc);
+  __m128 v, sq;
+  float  r[4] __attribute__ ((aligned (16)));
+
+  for(i=0; i<n; i++) {
+    v = _mm_mul_ps(_mm_set1_ps(s[i]), _mm_load_ps(osc[d->phase]));
+    acc = _mm_add_ps(acc, _mm_sub_ps(v, _mm_load_ps(d->hist[d->k])));
+    _mm_store_ps(d->hist[d->k], v);
+    if (++d->k == CID_TAPS)
+      d->k = 0;
+    if (++d->phase == PERIOD)
+      d->phase = 0;
+
+    sq = _mm_mul_ps(acc, acc);
+    _mm_store_ps(r, sq);
+    if (uart(d, r[0]+r[1]+r[2]+r[3], r[0]+r[1]-r[2]-r[3])) {
+      _mm_store_ps(d->acc, acc);
+      return 1;
+    }
+  }
+  _mm_store_ps(d->acc, acc);
+#else
+  float v[4];
+  int   j;
+
+  for(i=0; i<n; i++) {
+    for(j=0; j<4; j++) {
+      v[j] = s[i]*osc[d->phase][j];
+      d->acc[j] += v[j] - d->hist[d->k][j];
+      d->hist[d->k][j] = v[j];
+    }
+    if (++d->k == CID_TAPS)
+      d->k = 0;
+    if (++d->phase == PERIOD)
+      d->phase = 0;
+
+    for(j=0; j<4; j++)
+      v[j] = d->acc[j]*d->acc[j];
+    if (uart(d, v[0]+v[1]+v[2]+v[3], v[0]+v[1]-v[2]-v[3]))
+      return 1;
+  }
+#endif
+
+  return 0;
+}
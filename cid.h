@@ -0,0 +1,69 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CID.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Bell 202 caller ID demodulator that takes audio as it arrives.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __CID__
+#define __CID__
+
+#define CID_TAPS           7            // about one bit at 8 kHz
+#define CID_MAX_MSG        258          // type, length, 255 bytes, checksum
+#define CID_MAX_NUMBER     64
+
+typedef struct {
+  // mixer outputs for the last CID_TAPS samples and their running sum:
+  // mark I, mark Q, space I, space Q
+  float         hist[CID_TAPS][4] __attribute__ ((aligned (16)));
+  float         acc[4] __attribute__ ((aligned (16)));
+  int           k;                      // oldest in hist
+  int           phase;                  // oscillator table index
+
+  // UART and message framing
+  int           state;
+  int           marks;                  // samples of mark in a row
+  int           t;                      // samples since the start bit
+  int           bit;
+  int           byte;
+  unsigned char msg[CID_MAX_MSG];
+  int           nmsg;
+
+  char          number[CID_MAX_NUMBER];
+} CID_DEMOD;
+
+void cid_init(CID_DEMOD *d);
+
+// n samples of 8 kHz linear audio, returns 1 once a message with a good
+// checksum has arrived.  d->number then has the number, which is empty
+// if the message didn't carry one.
+int  cid_feed(CID_DEMOD *d, const short *s, int n);
+
+#endif
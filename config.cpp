@@ -0,0 +1,187 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CONFIG.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Reads the file that maps CT channels to the TCP ports clients connect
+    to.  Each line is
+
+      listen <tcp port> <channels>
+      select <tcp port> <channels>
+
+    where <channels> is a comma separated list of <board>:<channel>,
+    <board>:<first>-<last>, <board>:* or all.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+
+#define MAX_CFG_LINE       1024
+
+static void add(LISTEN_CFG *c, int board, int channel) {
+  if ((c->n & (c->n-1)) == 0) {
+    c->board = (int*)realloc(c->board, (c->n ? 2*c->n : 1)*sizeof(int));
+    c->channel = (int*)realloc(c->channel, (c->n ? 2*c->n : 1)*sizeof(int));
+  }
+  c->board[c->n] = board;
+  c->channel[c->n++] = channel;
+}
+
+// adds one item of a channel list, returns CT_ERROR if it is not valid
+
+static int add_item(LISTEN_CFG *c, CTBackend *ct, char *item) {
+  int  b, first, last, nb, nc;
+  char *p;
+
+  nb = ct->num_boards();
+  if (strcmp(item, "all") == 0) {
+    for(b=1; b<=nb; b++) {
+      nc = ct->num_channels(b);
+      for(first=1; first<=nc; first++)
+	add(c, b, first);
+    }
+    return CT_OK;
+  }
+
+  b = strtol(item, &p, 10);
+  if ((*p != ':') || (b < 1) || (b > nb))
+    return CT_ERROR;
+  nc = ct->num_channels(b);
+  p++;
+  if (strcmp(p, "*") == 0) {
+    first = 1;
+    last = nc;
+  }
+  else {
+    first = last = strtol(p, &p, 10);
+    if (*p == '-')
+      last = strtol(p+1, &p, 10);
+    if (*p || (first < 1) || (last < first) || (last > nc))
+      return CT_ERROR;
+  }
+
+  for(; first<=last; first++)
+    add(c, b, first);
+
+  return CT_OK;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: config_read
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Reads the config file into an array of LISTEN_CFG, one per listen or
+	select line.  # starts a comment.
+
+\*--------------------------------------------------------------------------*/
+
+int config_read(const char *file_name, CTBackend *ct, LISTEN_CFG **cfg,
+		int *ncfg) {
+  FILE       *f;
+  char       line[MAX_CFG_LINE];
+  char       *p, *cmd, *port, *list, *item;
+  int        n, lineno;
+  LISTEN_CFG *c;
+
+  *cfg = NULL;
+  *ncfg = 0;
+  f = fopen(file_name, "rt");
+  if (f == NULL) {
+    fprintf(stderr, "config: cannot open %s\n", file_name);
+    return CT_ERROR;
+  }
+
+  n = 0;
+  lineno = 0;
+  while(fgets(line, sizeof(line), f)) {
+    lineno++;
+    if ((p = strchr(line, '#')) != NULL)
+      *p = 0;
+    cmd = strtok(line, " \t\r\n");
+    if (cmd == NULL)
+      continue;
+    port = strtok(NULL, " \t\r\n");
+    list = strtok(NULL, " \t\r\n");
+    if ((port == NULL) || (list == NULL) || (atoi(port) <= 0) ||
+	(strcmp(cmd, "listen") && strcmp(cmd, "select")))
+      goto error;
+
+    *cfg = (LISTEN_CFG*)realloc(*cfg, (n+1)*sizeof(LISTEN_CFG));
+    c = &(*cfg)[n++];
+    memset(c, 0, sizeof(LISTEN_CFG));
+    c->port = atoi(port);
+    c->select = (strcmp(cmd, "select") == 0);
+    for(item=strtok(list, ","); item; item=strtok(NULL, ","))
+      if (add_item(c, ct, item) != CT_OK)
+	goto error;
+    if (c->n == 0)
+      goto error;
+  }
+
+  fclose(f);
+  *ncfg = n;
+  return CT_OK;
+
+ error:
+  fprintf(stderr, "config: %s error line %d\n", file_name, lineno);
+  fclose(f);
+  config_free(*cfg, n);
+  *cfg = NULL;
+  return CT_ERROR;
+}
+
+int config_default(CTBackend *ct, int port, int max, LISTEN_CFG **cfg,
+		   int *ncfg) {
+  LISTEN_CFG *c;
+  char       all[] = "all";
+
+  c = (LISTEN_CFG*)calloc(1, sizeof(LISTEN_CFG));
+  c->port = port;
+  add_item(c, ct, all);
+  if (max && (c->n > max))
+    c->n = max;
+
+  *cfg = c;
+  *ncfg = 1;
+  return c->n ? CT_OK : CT_ERROR;
+}
+
+void config_free(LISTEN_CFG *cfg, int ncfg) {
+  int i;
+
+  for(i=0; i<ncfg; i++) {
+    free(cfg[i].board);
+    free(cfg[i].channel);
+  }
+  free(cfg);
+}
@@ -0,0 +1,62 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CONFIG.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Reads the file that maps CT channels to the TCP ports clients connect
+    to, see ctserver.conf for the format.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __CONFIG__
+#define __CONFIG__
+
+#include "ctbackend.h"
+
+// one listen or select line of the config file
+typedef struct {
+  int  port;             // TCP port, the first of a range for listen
+  int  select;           // 1 for one listener where the client picks
+  int  n;                // channels
+  int  *board;           // numbered from 1
+  int  *channel;         // numbered from 1
+} LISTEN_CFG;
+
+// channel lists are checked against the boards the backend has, returns
+// CT_ERROR if the file can't be read or has errors
+int  config_read(const char *file_name, CTBackend *ct, LISTEN_CFG **cfg,
+		 int *ncfg);
+
+// the config used when no file is given: a listener per channel on TCP
+// ports from port up, for at most max channels (0 for all)
+int  config_default(CTBackend *ct, int port, int max, LISTEN_CFG **cfg,
+		    int *ncfg);
+
+void config_free(LISTEN_CFG *cfg, int ncfg);
+
+#endif
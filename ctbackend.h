@@ -0,0 +1,129 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CTBACKEND.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Channel backend interface.  ctserver talks to CT hardware only through
+    this interface, so the same server can drive Voicetronix cards
+    (vpbbackend.cpp) or simulated channels (simbackend.cpp).
+
+    The calls and events deliberately mirror the vpb_* API that ctserver
+    was written against.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __CTBACKEND__
+#define __CTBACKEND__
+
+#define CT_MAX_STR         256
+
+// return codes
+#define CT_OK              0
+#define CT_TIME_OUT        1
+#define CT_ERROR           -1
+
+// hook states
+#define CT_ONHOOK          0
+#define CT_OFFHOOK         1
+
+// audio compression modes
+#define CT_LINEAR          0
+#define CT_ALAW            1
+#define CT_MULAW           2
+
+// event types
+#define CT_RING            0
+#define CT_TONEDETECT      2      // data is one of CT_TONE_xxx
+#define CT_TIMEREXP        3      // a wheel timer, data is its id
+#define CT_PLAYEND         4      // data is bytes of a buffer played
+#define CT_RECORDEND       5
+#define CT_DTMF            6      // data is the digit
+#define CT_DIALEND         7
+
+// call progress tones
+#define CT_TONE_DIAL       0
+#define CT_TONE_RINGBACK   1
+#define CT_TONE_BUSY       2
+#define CT_TONE_GRUNT      3
+
+// receives recorded audio from record_stream_async, called on a backend
+// thread
+typedef void (*CT_AUDIO_CB)(void *arg, const char *buf, long n);
+
+// fills buf with the next n bytes for play_stream_async to play, called
+// on a backend thread
+typedef void (*CT_FILL_CB)(void *arg, char *buf, long n);
+
+typedef struct {
+  int           type;             // CT_xxx event type
+  int           handle;           // channel handle from CTBackend::open
+  int           data;
+} CT_EVENT;
+
+class CTBackend {
+public:
+  virtual ~CTBackend() {}
+
+  // what is fitted, boards and their channels are numbered from 1
+  virtual int  num_boards() = 0;
+  virtual int  num_channels(int board) = 0;
+
+  // channels, open may be called from several threads at once
+  virtual int  open(int board, int channel) = 0;
+  virtual void close(int h) = 0;
+  virtual int  sethook(int h, int hookstate) = 0;
+
+  // blocks up to time_out ms for the next event on any channel
+  virtual int  get_event(CT_EVENT *e, unsigned int time_out) = 0;
+
+  // play & record, end is signalled with CT_PLAYEND/CT_RECORDEND.  The
+  // buffer given to play_buf_async must stay valid until CT_PLAYEND.
+  virtual int  play_buf_async(int h, const char *buf, long n, int mode) = 0;
+  virtual int  play_terminate(int h) = 0;
+  virtual int  record_file_async(int h, const char *file_name, int mode,
+				 unsigned int time_out) = 0;
+  virtual int  record_terminate(int h) = 0;
+
+  // record without a file, audio is handed to cb as it arrives and
+  // CT_RECORDEND follows the last of it
+  virtual int  record_stream_async(int h, int mode, unsigned int time_out,
+				   CT_AUDIO_CB cb, void *arg) = 0;
+
+  // play without a buffer, cb is asked for each block as the card needs
+  // it until play_terminate, then CT_PLAYEND
+  virtual int  play_stream_async(int h, int mode, CT_FILL_CB cb,
+				 void *arg) = 0;
+
+  virtual int  dial_async(int h, const char *dial_str) = 0;
+};
+
+CTBackend *vpb_backend_create();
+CTBackend *sim_backend_create(const char *script_file);
+CTBackend *replay_backend_create();
+
+#endif
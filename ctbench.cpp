@@ -0,0 +1,398 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CTBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Load generator for ctserver.  Starts ctserver-sim with a script that
+    plays the caller (bench.sim), then runs one client per channel
+    through a typical call over and over:
+
+      ctwaitforring, ctanswer, ctplay, ctclear, ctcollect, ctrecord,
+      cthangup
+
+    Each reply is checked against what bench.sim should make the server
+    say (its caller ID, the digits it presses), and a reply that differs,
+    or a command that takes as long as its own timeout, is an error.
+
+    At the end it prints JSON to stdout: calls and commands a second,
+    latency percentiles and errors for each command as the client sees
+    them, the CPU ctserver used per channel, and ctserver's own stats.  A summary
+    goes to stderr.  "make bench" runs it and keeps the JSON in
+    bench.json so releases can be compared.
+
+    Latencies of commands that play or record include the audio time,
+    divided by the speed set in the script.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "stats.h"
+
+#define MAX_REPLY          256
+#define MAX_STATS          (1024*1024)
+#define GRACE_S            15           // for calls in progress at the end
+
+// the call each client makes, "%d" in an argument is the client number.
+// reply is what bench.sim should get back, timeout_ms the command's own
+// timeout, 0 for none.  The server times ctcollect, the simulated card
+// times recordings, at the speed set in the script.
+typedef struct {
+  const char    *cmd;
+  const char    *arg[3];
+  const char    *reply;
+  unsigned long timeout_ms;
+  int           sim_timed;
+} STEP;
+
+static const STEP steps[] = {
+  {"ctwaitforring", {NULL},                            "0412345678\n", 0, 0},
+  {"ctanswer",      {NULL},                            "OK\n",         0, 0},
+  {"ctplay",        {"UsEngM/1.au", NULL},             "OK\n",         0, 0},
+  {"ctclear",       {NULL},                            "OK\n",         0, 0},
+  {"ctcollect",     {"4", "10", "5"},                  "1234\n",   10000, 0},
+  {"ctrecord",      {"/tmp/ctbench%d.wav", "30", "9"}, "OK\n",     30000, 1},
+  {"cthangup",      {NULL},                            "OK\n",         0, 0},
+};
+#define NUM_STEPS          (int)(sizeof(steps)/sizeof(STEP))
+
+typedef struct {
+  int                n;
+  int                port;
+  int                sd;
+  unsigned long long calls;
+  unsigned long long commands;
+  unsigned long long errors;
+  HIST               hist[NUM_STEPS];
+  unsigned long long step_errors[NUM_STEPS];
+} CLIENT;
+
+static int stop;
+static int done;                        // clients that have finished
+static int reported[NUM_STEPS];         // first error of each step logged
+static double speed = 1;                // set speed in the script
+
+static int connect_port(int port) {
+  struct sockaddr_in addr;
+  int                sd;
+
+  if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (connect(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(sd);
+    return -1;
+  }
+
+  return sd;
+}
+
+// sends a command and its arguments, returns the NUL terminated reply
+// or -1 if the server went away
+
+static int command(CLIENT *c, const STEP *st, char *reply) {
+  char s[MAX_REPLY*4], arg[MAX_REPLY];
+  int  i, n;
+
+  n = sprintf(s, "%s\n", st->cmd);
+  for(i=0; (i<3) && st->arg[i]; i++) {
+    snprintf(arg, sizeof(arg), st->arg[i], c->n);
+    n += sprintf(s+n, "%s\n", arg);
+  }
+  if (write(c->sd, s, n) != n)
+    return -1;
+
+  for(i=0; i<MAX_REPLY-1; i++) {
+    if (read(c->sd, &reply[i], 1) != 1)
+      return -1;
+    if (reply[i] == 0)
+      return 0;
+  }
+  reply[i] = 0;
+
+  return 0;
+}
+
+// a reply other than the one expected, or one that came no sooner than
+// the command's timeout, the first of each step is reported
+
+static void check(CLIENT *c, int i, const char *reply,
+		  unsigned long long us) {
+  const STEP *st = &steps[i];
+  double     timeout = st->timeout_ms*1000.0/(st->sim_timed ? speed : 1);
+  int        late = st->timeout_ms && (us >= timeout);
+
+  if (!late && (strcmp(reply, st->reply) == 0))
+    return;
+  c->errors++;
+  c->step_errors[i]++;
+  if (__atomic_exchange_n(&reported[i], 1, __ATOMIC_RELAXED) == 0)
+    fprintf(stderr, "ctbench: client %d %s replied \"%.*s\" after %llu us, "
+	    "expected \"%.*s\"%s\n", c->n, st->cmd,
+	    (int)strcspn(reply, "\n"), reply, us,
+	    (int)strcspn(st->reply, "\n"), st->reply,
+	    late ? " (timed out)" : "");
+}
+
+static void *client_thread(void *pv) {
+  CLIENT             *c = (CLIENT*)pv;
+  char               reply[MAX_REPLY];
+  unsigned long long t;
+  int                i;
+
+  while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    for(i=0; i<NUM_STEPS; i++) {
+      t = stats_now_us();
+      if (command(c, &steps[i], reply) != 0) {
+	__atomic_fetch_add(&done, 1, __ATOMIC_RELEASE);
+	return NULL;
+      }
+      t = stats_now_us() - t;
+      hist_add(&c->hist[i], t);
+      c->commands++;
+      check(c, i, reply, t);
+    }
+    c->calls++;
+  }
+  __atomic_fetch_add(&done, 1, __ATOMIC_RELEASE);
+
+  return NULL;
+}
+
+// the speed the script runs the simulation at, 1 if it doesn't say
+
+static double script_speed(const char *script) {
+  char   s[256];
+  double v = 1;
+  FILE   *f;
+
+  if ((f = fopen(script, "rt")) == NULL)
+    return 1;
+  while(fgets(s, sizeof(s), f))
+    sscanf(s, " set speed %lf", &v);
+  fclose(f);
+
+  return (v > 0) ? v : 1;
+}
+
+// user + system CPU seconds a process has used
+
+static double cpu_seconds(pid_t pid) {
+  char               name[64], s[1024], *p;
+  FILE               *f;
+  unsigned long long utime, stime;
+
+  sprintf(name, "/proc/%d/stat", (int)pid);
+  if ((f = fopen(name, "rt")) == NULL)
+    return 0;
+  p = fgets(s, sizeof(s), f);
+  fclose(f);
+  if ((p == NULL) || ((p = strrchr(s, ')')) == NULL))
+    return 0;
+  if (sscanf(p+2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+	     &utime, &stime) != 2)
+    return 0;
+
+  return (double)(utime + stime)/sysconf(_SC_CLK_TCK);
+}
+
+// ctserver's /json, or NULL
+
+static char *server_stats(int port) {
+  char *s, *body;
+  int  sd, n, got = 0;
+
+  if ((sd = connect_port(port)) < 0)
+    return NULL;
+  write(sd, "GET /json HTTP/1.0\r\n\r\n", 22);
+  s = (char*)malloc(MAX_STATS);
+  while((got < MAX_STATS-1) && ((n = read(sd, s+got, MAX_STATS-1-got)) > 0))
+    got += n;
+  s[got] = 0;
+  close(sd);
+  if ((body = strstr(s, "\r\n\r\n")) == NULL) {
+    free(s);
+    return NULL;
+  }
+  memmove(s, body+4, strlen(body+4)+1);
+
+  return s;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char         *server = "./ctserver-sim", *script = "bench.sim";
+  int                clients = 8, seconds = 20, port = 1200;
+  int                stats_port = 1299;
+  CLIENT             *c;
+  pthread_t          *threads;
+  pid_t              pid;
+  HIST               h;
+  char               sclients[16], sstats[16], *sstat;
+  unsigned long long t0, calls = 0, commands = 0, errors = 0, serrors;
+  double             elapsed, cpu0, cpu;
+  int                i, j, sd;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-server path] [-script file] [-clients n] "
+	   "[-time s]\n        [-port n] [-stats n]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-server")) && (i+1 < argc))
+    server = argv[i+1];
+  if ((i = arg_exists(argc,argv,"-script")) && (i+1 < argc))
+    script = argv[i+1];
+  if ((i = arg_exists(argc,argv,"-clients")) && (i+1 < argc))
+    clients = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-time")) && (i+1 < argc))
+    seconds = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-port")) && (i+1 < argc))
+    port = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-stats")) && (i+1 < argc))
+    stats_port = atoi(argv[i+1]);
+
+  speed = script_speed(script);
+
+  // server with its log thrown away, ready once the stats port answers
+  sprintf(sclients, "%d", clients);
+  sprintf(sstats, "%d", stats_port);
+  if ((pid = fork()) == 0) {
+    int fd = open("/dev/null", O_WRONLY);
+    dup2(fd, STDOUT_FILENO);
+    execl(server, server, "-sim", script, "-ports", sclients, "-stats",
+	  sstats, (char*)NULL);
+    perror(server);
+    exit(1);
+  }
+  for(i=0; i<100; i++) {
+    if ((sd = connect_port(stats_port)) >= 0)
+      break;
+    if (waitpid(pid, NULL, WNOHANG) == pid)
+      break;
+    usleep(100000);
+  }
+  if (sd < 0) {
+    fprintf(stderr, "ctbench: %s did not start\n", server);
+    kill(pid, SIGTERM);
+    exit(1);
+  }
+  close(sd);
+
+  c = (CLIENT*)calloc(clients, sizeof(CLIENT));
+  threads = (pthread_t*)malloc(clients*sizeof(pthread_t));
+  for(i=0; i<clients; i++) {
+    c[i].n = i;
+    c[i].port = port+i;
+    if ((c[i].sd = connect_port(c[i].port)) < 0) {
+      fprintf(stderr, "ctbench: cannot connect to port %d\n", c[i].port);
+      kill(pid, SIGTERM);
+      exit(1);
+    }
+  }
+
+  t0 = stats_now_us();
+  cpu0 = cpu_seconds(pid);
+  for(i=0; i<clients; i++)
+    pthread_create(&threads[i], NULL, client_thread, &c[i]);
+  sleep(seconds);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+  // let calls in progress finish, then cut off any still waiting
+  for(i=0; (i<GRACE_S*10) && (__atomic_load_n(&done, __ATOMIC_ACQUIRE) <
+			     clients); i++)
+    usleep(100000);
+  for(j=0; j<clients; j++)
+    shutdown(c[j].sd, SHUT_RDWR);
+  for(j=0; j<clients; j++)
+    pthread_join(threads[j], NULL);
+  elapsed = (stats_now_us() - t0)/1E6;
+  cpu = cpu_seconds(pid) - cpu0;
+  sstat = server_stats(stats_port);
+
+  for(j=0; j<clients; j++) {
+    calls += c[j].calls;
+    commands += c[j].commands;
+    errors += c[j].errors;
+    close(c[j].sd);
+  }
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+
+  printf("{\n  \"clients\": %d,\n  \"seconds\": %.3f,\n  \"calls\": %llu,\n"
+	 "  \"calls_per_sec\": %.3f,\n  \"commands\": %llu,\n"
+	 "  \"commands_per_sec\": %.3f,\n  \"errors\": %llu,\n"
+	 "  \"cpu_seconds\": %.3f,\n  \"cpu_percent_per_channel\": %.4f,\n"
+	 "  \"latency_us\": {\n", clients, elapsed, calls, calls/elapsed,
+	 commands, commands/elapsed, errors, cpu,
+	 100.0*cpu/elapsed/clients);
+  fprintf(stderr, "%d clients %.1fs: %llu calls (%.2f/s), %llu commands "
+	  "(%.1f/s), %llu errors, CPU %.3f%% per channel\n", clients,
+	  elapsed, calls, calls/elapsed, commands, commands/elapsed, errors,
+	  100.0*cpu/elapsed/clients);
+  for(i=0; i<NUM_STEPS; i++) {
+    memset(&h, 0, sizeof(h));
+    serrors = 0;
+    for(j=0; j<clients; j++) {
+      hist_merge(&h, &c[j].hist[i]);
+      serrors += c[j].step_errors[i];
+    }
+    printf("    \"%s\": {\"count\": %llu, \"p50\": %llu, \"p99\": %llu, "
+	   "\"p999\": %llu, \"max\": %llu, \"errors\": %llu}%s\n",
+	   steps[i].cmd, h.count, hist_percentile(&h, 0.5),
+	   hist_percentile(&h, 0.99), hist_percentile(&h, 0.999), h.max,
+	   serrors, (i == NUM_STEPS-1) ? "" : ",");
+    fprintf(stderr, "  %-14s p50 %8llu us  p99 %8llu us  p999 %8llu us  "
+	    "%llu errors\n", steps[i].cmd, hist_percentile(&h, 0.5),
+	    hist_percentile(&h, 0.99), hist_percentile(&h, 0.999), serrors);
+  }
+  printf("  },\n  \"server\": %s}\n", sstat ? sstat : "null\n");
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: CTBUNDLE.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Packs prompts into a bundle (see bundle.h) for ctserver -bundle.
+    Each file is converted to the card's mode at 8 kHz as it is packed,
+    so the server can play straight from the mapping.  The bundle is
+    written alongside and renamed into place, so a server that has the
+    old one mapped keeps a consistent copy.
+
+      ctbundle [-mode mulaw|alaw|linear] [-dir path] -o bundle dir|file ...
+
+    Prompts are named by their file name.  -dir is the directory the
+    bundle stands in for, by default the directory given, so the server
+    finds a prompt whether it is asked for "path/name" or just "name".
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ctbackend.h"
+#include "transcode.h"
+#include "bundle.h"
+
+typedef struct {
+  char *path;
+  char *name;
+  char *buf;
+  long bytes;
+  unsigned int off;
+} ITEM;
+
+static ITEM *items;
+static int  nitems, maxitems;
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+static void add(const char *path) {
+  const char *slash = strrchr(path, '/');
+
+  if (nitems == maxitems) {
+    maxitems = maxitems ? 2*maxitems : 64;
+    items = (ITEM*)realloc(items, maxitems*sizeof(ITEM));
+  }
+  memset(&items[nitems], 0, sizeof(ITEM));
+  items[nitems].path = strdup(path);
+  items[nitems].name = strdup(slash ? slash+1 : path);
+  nitems++;
+}
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(((ITEM*)a)->name, ((ITEM*)b)->name);
+}
+
+// every regular file in a directory, it's up to load() which are audio
+
+static int add_dir(const char *dir) {
+  DIR           *d;
+  struct dirent *e;
+  struct stat   st;
+  char          path[PATH_MAX];
+
+  if ((d = opendir(dir)) == NULL)
+    return -1;
+  while((e = readdir(d)) != NULL) {
+    if (e->d_name[0] == '.')
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+    if ((stat(path, &st) == 0) && S_ISREG(st.st_mode))
+      add(path);
+  }
+  closedir(d);
+  return 0;
+}
+
+static unsigned int align(unsigned long x, unsigned int a) {
+  return (x + a-1) & ~(unsigned long)(a-1);
+}
+
+int main(int argc, char *argv[]) {
+  BUNDLE_HDR   hdr;
+  BUNDLE_SLOT  *slots;
+  struct stat  st;
+  const char   *out = NULL;
+  char         *names, tmp[PATH_MAX], dir[PATH_MAX];
+  unsigned long size;
+  unsigned int h, names_size, off;
+  int          i, k, mode = CT_MULAW, ndirs = 0, loaded;
+  FILE         *f;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help") ||
+      !(i = arg_exists(argc,argv,"-o")) || (i+1 >= argc)) {
+    printf("usage: %s [-mode mulaw|alaw|linear] [-dir path] -o bundle "
+	   "dir|file ...\n", argv[0]);
+    exit(0);
+  }
+  out = argv[i+1];
+  if ((i = arg_exists(argc,argv,"-mode")) && (i+1 < argc)) {
+    if (!strcmp(argv[i+1], "linear"))
+      mode = CT_LINEAR;
+    else if (!strcmp(argv[i+1], "alaw"))
+      mode = CT_ALAW;
+    else if (strcmp(argv[i+1], "mulaw")) {
+      fprintf(stderr, "unknown mode %s\n", argv[i+1]);
+      exit(1);
+    }
+  }
+  dir[0] = 0;
+  if ((i = arg_exists(argc,argv,"-dir")) && (i+1 < argc))
+    snprintf(dir, sizeof(dir), "%s", argv[i+1]);
+
+  for(i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "-mode") ||
+	!strcmp(argv[i], "-dir")) {
+      i++;
+      continue;
+    }
+    if ((stat(argv[i], &st) == 0) && S_ISDIR(st.st_mode)) {
+      add_dir(argv[i]);
+      if (!arg_exists(argc,argv,"-dir") && (ndirs++ == 0) &&
+	  (realpath(argv[i], dir) == NULL))
+	dir[0] = 0;
+    }
+    else
+      add(argv[i]);
+  }
+  if (ndirs > 1)
+    dir[0] = 0;
+  if (strlen(dir) >= BUNDLE_DIR) {
+    fprintf(stderr, "directory name too long: %s\n", dir);
+    exit(1);
+  }
+
+  // sorted so the same prompts always make the same bundle
+  qsort(items, nitems, sizeof(ITEM), by_name);
+  for(i=1; i<nitems; i++)
+    if (!strcmp(items[i].name, items[i-1].name)) {
+      fprintf(stderr, "%s and %s have the same name\n", items[i-1].path,
+	      items[i].path);
+      exit(1);
+    }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, BUNDLE_MAGIC, 8);
+  hdr.mode = mode;
+  hdr.rate = 8000;
+  strcpy(hdr.dir, dir);
+  for(hdr.nslots=16; hdr.nslots < 2*(unsigned)nitems; hdr.nslots*=2);
+  slots = (BUNDLE_SLOT*)calloc(hdr.nslots, sizeof(BUNDLE_SLOT));
+
+  // names start at 1, 0 marks an empty slot
+  for(names_size=1, i=0; i<nitems; i++)
+    names_size += strlen(items[i].name) + 1;
+  names = (char*)calloc(1, names_size);
+
+  size = 0;
+  off = 1;
+  loaded = 0;
+  for(i=0; i<nitems; i++) {
+    items[i].buf = tc_load(items[i].path, mode, &items[i].bytes);
+    if (items[i].buf == NULL) {
+      fprintf(stderr, "skipping %s, not audio we can read\n", items[i].path);
+      continue;
+    }
+    items[i].off = size;
+    size = align(size + items[i].bytes, BUNDLE_ALIGN);
+
+    strcpy(names + off, items[i].name);
+    h = bundle_hash(items[i].name);
+    for(k=h & (hdr.nslots-1); slots[k].name; k=(k+1) & (hdr.nslots-1));
+    slots[k].hash = h;
+    slots[k].name = off;
+    slots[k].off = items[i].off;
+    slots[k].bytes = items[i].bytes;
+    off += strlen(items[i].name) + 1;
+    loaded++;
+  }
+  hdr.nprompts = loaded;
+  hdr.index = align(sizeof(hdr), BUNDLE_ALIGN);
+  hdr.names = hdr.index + hdr.nslots*sizeof(BUNDLE_SLOT);
+  hdr.data = align(hdr.names + names_size, BUNDLE_PAGE);
+  if (hdr.data + size > 0xffffffffUL) {
+    fprintf(stderr, "bundle would be over 4 GB\n");
+    exit(1);
+  }
+  hdr.size = hdr.data + size;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", out);
+  if ((f = fopen(tmp, "wb")) == NULL) {
+    perror(tmp);
+    exit(1);
+  }
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  fseek(f, hdr.index, SEEK_SET);
+  fwrite(slots, sizeof(BUNDLE_SLOT), hdr.nslots, f);
+  fwrite(names, 1, names_size, f);
+  for(i=0; i<nitems; i++)
+    if (items[i].buf) {
+      fseek(f, hdr.data + items[i].off, SEEK_SET);
+      fwrite(items[i].buf, 1, items[i].bytes, f);
+    }
+  // zero pads the last prompt out to its alignment
+  fflush(f);
+  if (ftruncate(fileno(f), hdr.size) != 0) {
+    perror(tmp);
+    exit(1);
+  }
+  if ((fclose(f) != 0) || (rename(tmp, out) != 0)) {
+    perror(out);
+    unlink(tmp);
+    exit(1);
+  }
+
+  printf("%s: %d prompts, %lu bytes of audio, for %s\n", out, loaded, size,
+	 dir[0] ? dir : "names only");
+
+  for(i=0; i<nitems; i++) {
+    free(items[i].path);
+    free(items[i].name);
+    free(items[i].buf);
+  }
+  free(items);
+  free(slots);
+  free(names);
+
+  return 0;
+}
@@ -7,7 +7,7 @@
 
     Computer Telephony (CT) server.  Executes cc-script like commands on CT
     hardware on behalf of client programs.
- 	 
+	 
 \*---------------------------------------------------------------------------*/
 
 /*--------------------------------------------------------------------------*\
@@ -49,7 +49,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <vpbapi.h>
 #include <string.h>
 #include <pthread.h>
 #include <signal.h>
@@ -58,17 +57,43 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include "ctbackend.h"
+#include "wave.h"
+#include "g711.h"
+#include "prompt.h"
+#include "phrase.h"
+#include "say.h"
+#include "config.h"
+#include "log.h"
+#include "stats.h"
+#include "cid.h"
+#include "tone.h"
+#include "trace.h"
+#include "transcode.h"
+#include "mix.h"
+#include "campaign.h"
+#include "wheel.h"
+#include "grammar.h"
+#include "ivr.h"
+#include "vad.h"
 
 #define SUCCESS            0
-#define ERROR              1  
+#define ERROR              1
 
 #define END_LINE           0x0A
-#define SERVER_PORT        1200          
+#define SERVER_PORT        1200
 #define MAX_MSG            100
+#define MAX_LINE           65536         // longest line a client may send
+#define RCV_INIT           256           // first size of a client's buffer
+#define MAX_UNBOUND        1024          // input before a channel is picked
 
-#define NUM_PORTS          4
+#define VOCAB_DIR          "/var/ctserver/USEngM"
 #define SEC2MS             1000
-#define N                  160
 
 // state machine states
 #define PLAYING            0
@@ -76,38 +101,472 @@
 #define FINISHED           2
 #define RECORDING          3
 #define WAIT_FOR_RECORDEND 1
+#define FIRST_RING         4
+#define SECOND_RING        5
+#define WAITING            6
+#define STREAM_ABORTED     7
+#define CID_END            8
+#define CID_END_RESTART    9
+#define CONFERENCING       10
+#define WAIT_FOR_CONFEND   11
+#define CALL_DIALTONE      12
+#define CALL_DIALING       13
+#define CALL_RINGING       14
+#define CALL_PLAYING       15
+#define CALL_COLLECT       16
+#define SCRIPT_RUNNING     17
+#define SCRIPT_CALLOUT     18
+#define RECORD_POST        19
+
+// commands, CMD_NONE means the channel is idle
+#define CMD_NONE           0
+#define CMD_WAITFORRING    1
+#define CMD_WAITFORDIAL    2
+#define CMD_HANGUP         3
+#define CMD_ANSWER         4
+#define CMD_PLAY           5
+#define CMD_RECORD         6
+#define CMD_SLEEP          7
+#define CMD_CLEAR          8
+#define CMD_COLLECT        9
+#define CMD_DIAL           10
+#define CMD_PLAYLIST       11
+#define CMD_SAYNUMBER      12
+#define CMD_SAYDIGITS      13
+#define CMD_SPELL          14
+#define CMD_SAYDATE        15
+#define CMD_RECORDSTREAM   16
+#define CMD_PROTOCOL       17
+#define CMD_RECORDFORMAT   18
+#define CMD_CONFERENCE     19
+#define CMD_BRIDGE         20
+#define CMD_CAMPCALL       21            // server's own, not a client's
+#define CMD_RUNSCRIPT      22
+#define CMD_RECORDVAD      23
+#define NUM_CMDS           24
+
+// protocol version 2, see README
+#define MAX_ID             16            // request id, including the NUL
+#define MAX_PENDING        32            // commands queued behind the running one
+#define MAX_FIELDS         (MAX_PLAYLIST+2)
+
+// command lookup table, COMMAND_MUL is chosen so no names collide
+#define COMMAND_HASH       128
+#define COMMAND_MUL        53
+
+// maximum number of argument lines that follow a command line
+#define MAX_ARGS           3
+
+// maximum number of files in a ctplaylist
+#define MAX_PLAYLIST       32
+
+// ctrunscript, lines a version 1 client may send, and ops a script may
+// run without waiting for a command, so a loop can't hang the reactor
+#define MAX_SCRIPT         1000
+#define SCRIPT_OPS         10000
+
+// reactor event sources, packed into the top half of epoll_event.data.u64
+#define SRC_LISTEN         1
+#define SRC_CLIENT         2
+#define SRC_EVENTS         3
+#define SRC_SELECT         4
+#define SRC_UNBOUND        5
+#define SRC_CAMPAIGN       6
+#define SRC_CAMPCLIENT     7
+#define MAX_EPOLL_EVENTS   64
+
+// hardware events queued per channel between the event pump and the
+// reactor, a power of 2
+#define EVRING             64
+
+// events no command wanted are kept this long for the next command
+#define MAX_RETAINED       16
+#define RETAIN_MS          8000
+
+// samples dropped from the end of recordings, the DTMF that stopped them,
+// when it can't be found in the last TRIM_SCAN samples
+#define TRIM_SAMPLES       2000
+#define TRIM_SCAN          8000
+
+// threads that trim and convert finished recordings, so a long one
+// doesn't hold up the reactor
+#define POST_THREADS       2
+
+// silence kept either side of the speech when ctrecordvad trims a
+// recording, so the soft start and end of words aren't clipped
+#define VAD_PAD            1600          // samples, 200 ms
+
+// frames of the live detector's counts kept, more than TRIM_SCAN
+#define VAD_MARKS          64
+
+// how the card plays and records, prompts are converted to this when
+// loaded and recordings from it when they finish
+#define CARD_MODE          CT_MULAW
+#define CARD_RATE          8000
+
+// parties in a ctconference, a ctbridge is two
+#define MAX_CONFERENCE     64
+#define MIN_RATE           4000
+#define MAX_RATE           48000
+
+// campaign calls, see campaign_call
+#define DIALTONE_MS        5000          // off hook to dial tone
+#define ANSWER_GAP_MS      8000          // no ringback this long is answered
+#define NOANSWER_MS        40000         // still ringing is no answer
+#define CALL_COLLECT_MS    5000          // for digits after the prompts
+#define CALL_INTER_MS      3000
+#define CALL_REST_MS       1000          // on hook between calls
+#define CAMP_FIELDS        (CAMP_PROMPTS+8)
+
+// default length of the -trace ring, 64 MB
+#define TRACE_RECS         (1<<20)
+
+// replies one trace record may cause in -replay
+#define MAX_REPLIES        64
+
+// output queued for a client beyond this is audio the client isn't
+// reading, it is dropped
+#define OUT_MAX            (1<<20)
+#define OUT_IOV            16
+
+// CID is sent between the first and second ring, which are at most this
+// far apart
+#define CID_MS             6000
+
+// a block of output for a client, or of streamed audio
+
+typedef struct OUTBUF {
+  struct OUTBUF      *next;
+  long               n;
+  long               off;                // bytes already sent
+  char               data[1];
+} OUTBUF;
+
+// the live detector's counts after a frame, so they can be had back
+// once the DTMF it also heard is trimmed off
 
-// size of buffer to store CID signal in (may need to be adjusted)
-#define CIDN (8000*4)
+typedef struct {
+  long               frames;             // -1 if unused
+  long               speech, first, last;
+} VAD_MARK;
+
+// a version 2 command line waiting to run
+
+typedef struct PENDING {
+  struct PENDING     *next;
+  char               line[1];
+} PENDING;
+
+// Everything the reactor knows about one CT port.  Handlers never block,
+// instead they record where they are up to in cmd/state and are resumed
+// by the reactor when the next hardware event for the port arrives, or
+// their timer expires.
+
+typedef struct {
+  int                h;                  // backend channel handle
+  int                board, channel;     // numbered from 1
+  int                port;               // TCP port clients connect to
+  int                sd;                 // listening socket, -1 if none
+  int                newSd;              // client socket, -1 if none
+  struct sockaddr_in cliAddr;
+  unsigned int       interest;           // epoll events wanted on newSd
+  WHEEL_TIMER        timer;              // the command's, ends in CT_TIMEREXP
+  WHEEL_TIMER        idle;               // client sending nothing, -idle
+
+  // client input not yet processed, grows up to MAX_LINE
+  char               *rcv_msg;
+  int                rcv_n, rcv_size;
+
+  // version 2 clients tag each command with an id, and may send more
+  // while one is running
+  int                proto;              // 1 or 2
+  char               id[MAX_ID];         // id of the running command
+  int                cancelled;          // running command was cancelled
+  PENDING            *pend_head, *pend_tail;
+  int                npend;
+
+  // output the client hasn't taken yet
+  OUTBUF             *out_head, *out_tail;
+  long               out_bytes;
+
+  // command in progress
+  int                cmd;                // CMD_xxx
+  int                nargs;              // argument lines still to read
+  int                argc;
+  char               arg[MAX_ARGS][MAX_MSG];
+  int                state;              // handler state machine state
+  char               smess[CT_MAX_STR]; // reply held until command ends
+  int                run_cmd;            // for stats, until the reply
+  unsigned long long run_start;          // us
+  char               digbuf[CT_MAX_STR];// digits collect_event took
+
+  // DTMF heard since the last ctclear, and what ctcollect is waiting for
+  char               dtmf[CT_MAX_STR];
+  int                ndtmf;
+  int                collect_max;
+  int                collect_n;          // digits the grammar has taken
+  GRAMMAR            grammar;            // nstates 0 to just count
+  int                gram_state;
+  unsigned long long collect_end;        // ms
+  unsigned long      collect_inter;      // ms
+
+  // files to play, ctplay is a list of one
+  int                nlist;
+  char               list[MAX_PLAYLIST][MAX_MSG];
+  PHRASE             *phrase;            // being played, held until PLAYEND
+
+  // ctrecordformat, what ctrecord files end up as, for this connection
+  int                rec_mode;           // CT_xxx
+  int                rec_rate;           // Hz
+
+  // ctrecordvad, ctrecord trims silence and, if vad_ms, ends after that
+  // much of it.  The server then writes the file from a record stream.
+  int                vad_on;
+  unsigned long      vad_ms;
+  WAVE               *rec_wave;
+  VAD                vad;
+  VAD_MARK           vad_mark[VAD_MARKS];// by frames % VAD_MARKS
+  int                vad_end;            // ended by silence
+
+  // a finished ctrecord with a post thread, see post_thread
+  long               post_speech;        // ms, -1 if not asked for
+  int                post_ready;         // done, reactor not yet told
+
+  // ctrunscript, the script as it arrives, then where the run is up to
+  char               *src;               // allocated on first use
+  int                src_n, src_size;
+  IVR_PROG           *prog;
+  int                pc;
+  int                ivr_step;           // a step's command is running
+  int                ivr_running;        // in ivr_run
+  int                ivr_var;            // gets the step's reply as well
+  char               vars[IVR_VARS][IVR_VALUE];
+
+  // ctbridge and ctconference, the record and play streams feed the mixer
+  MIX_PARTY          party;
+  int                conf_ends;          // stream ends still to come
+
+  // a campaign call the server is making while no client is connected
+  CAMP_CALL          *call;
+  unsigned long long call_deadline;      // ms, ringing after this is NOANSWER
+  unsigned long long rest_until;         // ms, on hook until then
+
+  // ctrecordstream, audio arrives from a backend thread under mutex.
+  // The last TRIM_SAMPLES are held back and never sent.
+  OUTBUF             *audio_head, *audio_tail;
+  char               *hold;              // allocated on first use
+  long               hold_n, hold_max;
+
+  // CID demodulated as audio arrives between first and second ring
+  CID_DEMOD          cid;
+  int                cid_streaming;      // until its CT_RECORDEND
+  int                cid_done;           // cid.number is valid
+  int                cid_ready;          // decoded, reactor not yet told
+
+  // hardware events, a ring with one writer (event_thread) and one reader
+  // (the reactor) so no lock is needed
+  CT_EVENT           evring[EVRING];
+  unsigned long long evtime[EVRING];     // us, when event_thread got it
+  unsigned int       ev_head, ev_tail;
+
+  // set while the channel is on the ready list
+  int                ready;
+  int                ready_next;
+  int                audio_ready;        // ctrecordstream audio waiting
+
+  // RING, DTMF and tones the running command didn't want
+  CT_EVENT           retained[MAX_RETAINED];
+  unsigned long long retained_at[MAX_RETAINED];
+  int                nretained;
+} CHANNEL;
+
+// a finished recording for a post thread, with what the channel asked
+// for when it ended, as the client may go and reset it meanwhile
+
+typedef struct REC_JOB {
+  struct REC_JOB     *next;
+  CHANNEL            *ch;
+  char               file[MAX_MSG];
+  int                lose;               // samples if no DTMF is found
+  int                vad;                // trim the silence
+  int                live;               // the reactor heard it, in
+  VAD                heard;              // heard and mark
+  VAD_MARK           mark[VAD_MARKS];
+  int                mode, rate;         // to convert to
+} REC_JOB;
+
+// a select listener, clients connect then pick one of its channels
+
+typedef struct {
+  int                sd;
+  int                port;
+  int                n;
+  int                *chan;              // indexes into chans
+} SELECTOR;
+
+// a client of a select listener that hasn't picked a channel yet
+
+typedef struct {
+  int                sd;                 // -1 if the slot is free
+  int                sel;                // index into selectors
+  int                want_arg;           // ctchannel received
+  struct sockaddr_in cliAddr;
+  char               rcv_msg[MAX_UNBOUND];
+  int                rcv_n;
+} UNBOUND;
+
+// a client of the campaign port, not tied to any channel
 
 typedef struct {
-	int   h;
-	short buf[CIDN];
-} THREAD_INFO;
-	
+  int                sd;                 // -1 if the slot is free
+  unsigned int       interest;
+  struct sockaddr_in cliAddr;
+  char               *rcv_msg;           // MAX_LINE
+  int                rcv_n;
+  OUTBUF             *out_head, *out_tail;
+  long               out_bytes;
+} CAMP_CLIENT;
+
+// a command the client can send
+typedef struct {
+  const char         *name;
+  int                cmd;                // CMD_xxx
+  int                nargs;              // argument lines that follow
+} COMMAND;
+
+// channels of one board, opened by one thread
+typedef struct {
+  int                first;
+  int                n;
+} OPEN_INFO;
+
 /*--------------------------------------------------------------------------*\
 
 			  FUNCTION PROTOTYPES
 
 \*--------------------------------------------------------------------------*/
 
-void *port_thread(void *pv);
-int read_line(int newSd, char *line_to_return);
+void ports_open(LISTEN_CFG *cfg, int ncfg);
+void stats_setup();
+void command_done(CHANNEL *ch, int error);
+void *open_thread(void *pv);
+int channel_init(CHANNEL *ch, int board, int channel);
+int channel_listen(CHANNEL *ch, int port);
+int listen_socket(int port, unsigned long long data);
+int find_channel(int board, int channel);
+void selector_accept(int sel);
+void unbound_read(UNBOUND *u);
+void unbound_close(UNBOUND *u);
+int unbound_bind(UNBOUND *u, const char *which);
+void client_attach(CHANNEL *ch, int sd, struct sockaddr_in *addr);
+void *reactor_thread(void *pv);
+void *event_thread(void *pv);
+void client_accept(CHANNEL *ch);
+void client_read(CHANNEL *ch);
+void client_close(CHANNEL *ch);
+void service_input(CHANNEL *ch);
+void process_line(CHANNEL *ch, char *line);
+void command_init();
+int lookup_command(const char *name, int *nargs);
+int rcv_reserve(CHANNEL *ch, int n);
+void v2_line(CHANNEL *ch, char *line);
+void v2_cancel(CHANNEL *ch, const char *id, const char *target);
+void v2_next(CHANNEL *ch);
+void v2_start(CHANNEL *ch, char *line);
+void v2_event(CHANNEL *ch, CT_EVENT *e);
+void pending_free(CHANNEL *ch);
+int split_fields(char *line, char **f, int max);
+void run_command(CHANNEL *ch);
+void start_command(CHANNEL *ch);
+void dispatch_event(CHANNEL *ch, CT_EVENT *e);
+void deliver_event(CHANNEL *ch, CT_EVENT *e);
+int event_wanted(CHANNEL *ch, CT_EVENT *e);
+void retain_event(CHANNEL *ch, CT_EVENT *e);
+void replay_retained(CHANNEL *ch);
+void channel_events(CHANNEL *ch);
+void ev_push(CHANNEL *ch, CT_EVENT *e);
+void ready_push(CHANNEL *ch);
+void abort_command(CHANNEL *ch);
+void reply(CHANNEL *ch, const char *s);
+void reply_id(CHANNEL *ch, const char *id, const char *s);
+void out_queue(CHANNEL *ch, const char *hdr, long hn, const char *buf1,
+	       long n1, const char *buf2, long n2);
+void out_flush(CHANNEL *ch);
+void out_free(CHANNEL *ch);
+void set_interest(CHANNEL *ch);
 static int digit_match(char digit, char *term_digits);
 void sig_handler(int sig);
-int ctwaitforevent(int h, void *timer,int event_type,int data,int timeout_ms);
-void ctwaitforring(int h, void *timer, int newSd);
-void ctwaitfordial(int h, void *timer, int newSd);
-void ctplay(int h, int newSd);
-void ctrecord(int h, int newSd);
-void ctsleep(int h, int newSd, void *timer);
-void ctcollect(int h, int newSd);
-void ctdial(int h, int newSd);
-void mylog(int messtype, char *fmt, ...);
+void ctwaitforring(CHANNEL *ch);
+void ctwaitforring_event(CHANNEL *ch, CT_EVENT *e);
+void ctwaitfordial(CHANNEL *ch);
+void ctwaitfordial_event(CHANNEL *ch, CT_EVENT *e);
+void ctplay(CHANNEL *ch);
+void ctplay_event(CHANNEL *ch, CT_EVENT *e);
+void ctsay(CHANNEL *ch, int what);
+int play_phrase(CHANNEL *ch, const char *key, const char **files, int n);
+void ctrecord(CHANNEL *ch);
+void ctrecord_event(CHANNEL *ch, CT_EVENT *e);
+void ctrecordformat(CHANNEL *ch);
+void ctrecordvad(CHANNEL *ch);
+void record_vad(CHANNEL *ch, const char *buf, long n);
+void vad_marks(CHANNEL *ch);
+void ctconference(CHANNEL *ch, int max);
+void ctconference_event(CHANNEL *ch, CT_EVENT *e);
+void conf_leave(CHANNEL *ch);
+void conf_in_cb(void *arg, const char *buf, long n);
+void conf_out_cb(void *arg, char *buf, long n);
+int parse_mode(const char *s);
+void ctrecordstream(CHANNEL *ch);
+void ctrecordstream_audio(CHANNEL *ch);
+void ctrecord_post(CHANNEL *ch, int live);
+void ctrecord_done(CHANNEL *ch);
+void audio_cb(void *arg, const char *buf, long n);
+void ctsleep(CHANNEL *ch);
+void ctsleep_event(CHANNEL *ch, CT_EVENT *e);
+void ctcollect(CHANNEL *ch);
+void ctcollect_event(CHANNEL *ch, CT_EVENT *e);
+void collect_start(CHANNEL *ch, int max, unsigned long time_out,
+		   unsigned long inter);
+int collect_event(CHANNEL *ch, CT_EVENT *e);
+void dtmf_push(CHANNEL *ch, char digit);
+void chan_timeout(void *arg);
+void ctrunscript(CHANNEL *ch);
+void script_add(CHANNEL *ch, const char *line);
+void ivr_run(CHANNEL *ch);
+void ivr_reply(CHANNEL *ch, const char *s);
+void ivr_resume(CHANNEL *ch, const char *value);
+void ivr_stop(CHANNEL *ch);
+void client_idle(void *arg);
+static unsigned long long now_ms();
+void ctdial(CHANNEL *ch);
+void ctdial_event(CHANNEL *ch, CT_EVENT *e);
 void trim(char *audio_file, int lose);
-void wave_get_size(void *wv, unsigned long *bytes);
-int arg_exists(int argc, char *argv[], char *arg);
-void *rec_thread(void *pv);
+long trim_silence(char *audio_file, const VAD *heard,
+		  const VAD_MARK *mark);
+void post_start();
+void post_submit(REC_JOB *j);
+long post_run(REC_JOB *j);
+int arg_exists(int argc, char *argv[], const char *arg);
+void cid_cb(void *arg, const char *buf, long n);
+void cid_end(CHANNEL *ch, int state);
+void ctwaitforring_cid(CHANNEL *ch);
+void ctwaitforring_reply(CHANNEL *ch);
+void reply_sent(CHANNEL *ch, const char *s, int n);
+int replay(const char *file_name, int fast);
+int campaign_listen(int port);
+void campaign_accept();
+void campaign_read(int k);
+void campaign_line(int k, char *line);
+void campaign_send(int k, const char *s);
+void campaign_flush(int k);
+void campaign_close(int k);
+void campaign_kick();
+void campaign_run();
+void campaign_timeout(void *arg);
+void campaign_call(CHANNEL *ch, CAMP_CALL *call);
+void campaign_event(CHANNEL *ch, CT_EVENT *e);
+void campaign_answered(CHANNEL *ch);
+void campaign_end(CHANNEL *ch, int result);
 
 /*--------------------------------------------------------------------------*\
 
@@ -120,7 +579,65 @@ int             finito;         // flag to signal the program is finished.
 int             threads_active; // the number of active threads.
 sigjmp_buf      jmpbuf;
 int             syslog_enabled; //  to log messags to console, 1 to syslog
-  
+
+CTBackend       *ct;            // CT hardware or simulation
+CHANNEL         *chans;
+int             num_ports;
+SELECTOR        *selectors;
+int             nselectors;
+UNBOUND         *unbound;
+int             nunbound;
+
+COMMAND commands[] = {
+  {"ctwaitforring",  CMD_WAITFORRING,  0},
+  {"ctwaitfordial",  CMD_WAITFORDIAL,  0},
+  {"cthangup",       CMD_HANGUP,       0},
+  {"ctanswer",       CMD_ANSWER,       0},
+  {"ctplay",         CMD_PLAY,         1},
+  {"ctplaylist",     CMD_PLAYLIST,     1},
+  {"ctsaynumber",    CMD_SAYNUMBER,    1},
+  {"ctsaydigits",    CMD_SAYDIGITS,    1},
+  {"ctspell",        CMD_SPELL,        1},
+  {"ctsaydate",      CMD_SAYDATE,      1},
+  {"ctrecord",       CMD_RECORD,       3},
+  {"ctrecordstream", CMD_RECORDSTREAM, 3},
+  {"ctsleep",        CMD_SLEEP,        1},
+  {"ctclear",        CMD_CLEAR,        0},
+  {"ctcollect",      CMD_COLLECT,      3},
+  {"ctdial",         CMD_DIAL,         1},
+  {"ctprotocol",     CMD_PROTOCOL,     1},
+  {"ctrecordformat", CMD_RECORDFORMAT, 1},
+  {"ctconference",   CMD_CONFERENCE,   2},
+  {"ctbridge",       CMD_BRIDGE,       2},
+  {"ctrunscript",    CMD_RUNSCRIPT,    1},
+  {"ctrecordvad",    CMD_RECORDVAD,    1},
+  {NULL,             CMD_NONE,         0}
+};
+COMMAND         *command_hash[COMMAND_HASH];
+CHANNEL         **hmap;         // channel for each backend handle
+int             nhmap;
+int             epfd;           // reactor epoll instance
+int             evfd;           // eventfd, signals channels are ready
+int             ready_head;     // channels with events, a lock free stack
+char            vocab_dir[CT_MAX_STR]; // UsEngM prompts for ctsayxxx
+int             camp_sd = -1;   // campaign port listener
+WHEEL_TIMER     camp_timer;     // when campaigns next need a look
+unsigned long   idle_ms;        // -idle, 0 for never
+CAMP_CLIENT     *campclients;
+int             ncampclients;
+
+// -replay, the time of the record being replayed, and the replies it
+// caused
+int                replaying;
+unsigned long long replay_ms;
+TRACE_REC          replies[MAX_REPLIES];
+int                nreplies;
+
+// recordings waiting for a post thread
+pthread_mutex_t    post_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t     post_cond = PTHREAD_COND_INITIALIZER;
+REC_JOB            *post_head, *post_tail;
+
 /*--------------------------------------------------------------------------*\
 
 				MAIN
@@ -128,24 +645,91 @@ int             syslog_enabled; //  to log messags to console, 1 to syslog
 \*--------------------------------------------------------------------------*/
 
 int main (int argc, char *argv[]) {
-  int       i;
-  int       h[NUM_PORTS];
-  pthread_t aport_thread[NUM_PORTS];
+  int        i, max_ports, ret, ncfg;
+  pthread_t  areactor_thread, aevent_thread;
+  LISTEN_CFG *cfg;
 
   openlog(argv[0], LOG_PID, LOG_DAEMON);
   pthread_mutex_init(&mutex,NULL);
-  vpb_seterrormode(VPB_ERROR_CODE);
   threads_active = 0;
   finito = 0;
 
   if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
-	  printf("usage: %s [-h --help -d -nv]\n", argv[0]);
+	  printf("usage: %s [-h --help -d -nv -ports n -config file\n"
+		 "       -sim [script] -mlock -vocab dir -bundle file "
+		 "-loglevel n -stats port\n"
+		 "       -trace file -tracesize n -replay file -fast "
+		 "-campaign port -idle s]\n",
+		 argv[0]);
 	  printf("-d             run as a daemon\n");
 	  printf("-h or --help   print this message\n");
 	  printf("-nv            non-verbose mode (daemon only)\n");
+	  printf("-ports n       use at most n CT ports (default all)\n");
+	  printf("-config file   TCP ports for each CT port, see "
+		 "ctserver.conf\n");
+	  printf("-sim [script]  simulated CT ports, see simbackend.cpp\n");
+	  printf("-mlock         lock cached prompts in memory\n");
+	  printf("-vocab dir     prompts for ctsaynumber etc (default %s)\n",
+		 VOCAB_DIR);
+	  printf("-bundle file   map prompts packed by ctbundle, may be "
+		 "given more than once\n");
+	  printf("-loglevel n    syslog level to log up to (default %d), "
+		 "SIGUSR1/SIGUSR2\n"
+		 "               raise/lower it while running\n", LOG_DEBUG);
+	  printf("-stats port    serve counters and latencies on "
+		 "127.0.0.1:port\n");
+	  printf("-trace file    keep a binary trace of events and client "
+		 "I/O, see trace.h\n");
+	  printf("-tracesize n   records the trace holds (default %d), the "
+		 "oldest go first\n", TRACE_RECS);
+	  printf("-replay file   run a trace through the server and check "
+		 "its replies\n");
+	  printf("-fast          replay as fast as possible rather than "
+		 "at the traced speed\n");
+	  printf("-campaign port take outbound campaigns on TCP port, see "
+		 "campaign_line\n");
+	  printf("-idle s        disconnect clients that send nothing for s "
+		 "seconds while idle\n");
 	  exit(0);
   }
 
+  max_ports = 0;
+  if ((i = arg_exists(argc,argv,"-ports")) && (i+1 < argc))
+	  max_ports = atoi(argv[i+1]);
+
+  if ((i = arg_exists(argc,argv,"-replay")) && (i+1 < argc))
+	  ct = replay_backend_create();
+  else if ((i = arg_exists(argc,argv,"-sim"))) {
+	  if ((i+1 < argc) && (argv[i+1][0] != '-'))
+		  ct = sim_backend_create(argv[i+1]);
+	  else
+		  ct = sim_backend_create(NULL);
+  }
+  else {
+#ifdef NO_VPB
+	  ct = sim_backend_create(NULL);
+#else
+	  ct = vpb_backend_create();
+#endif
+  }
+  if (ct == NULL)
+	  exit(-1);
+  command_init();
+  mix_init();
+  prompt_init(arg_exists(argc,argv,"-mlock"), CARD_MODE);
+  for(i=1; i+1<argc; i++)
+	  if (strcmp(argv[i], "-bundle") == 0) {
+		  if (prompt_bundle(argv[i+1]) == CT_OK)
+			  mylog(LOG_INFO,"mapped prompt bundle %s", argv[i+1]);
+		  else
+			  mylog(LOG_ERR,"cannot map prompt bundle %s",
+				argv[i+1]);
+	  }
+  strcpy(vocab_dir, VOCAB_DIR);
+  if ((i = arg_exists(argc,argv,"-vocab")) && (i+1 < argc))
+	  snprintf(vocab_dir, sizeof(vocab_dir), "%s", argv[i+1]);
+  say_init(vocab_dir);
+
   if (arg_exists(argc,argv,"-d")) {
 	  // OK - lets turn into a daemon
 
@@ -185,14 +769,74 @@ int main (int argc, char *argv[]) {
   else
       syslog_enabled = 0;
 
-  // open VPB & TCP/IP ports and start a thread for each port 
-  for(i=0; i<NUM_PORTS; i++) {
-    h[i] = vpb_open(1,i+1);
-    pthread_create(&aport_thread[i], NULL, port_thread, (void*)&h[i]);
+  // threads don't survive fork() so logging only goes async here
+  if ((i = arg_exists(argc,argv,"-loglevel")) && (i+1 < argc))
+    log_set_level(atoi(argv[i+1]));
+  log_init(syslog_enabled);
+
+  if ((i = arg_exists(argc,argv,"-replay")) && (i+1 < argc)) {
+    ret = replay(argv[i+1], arg_exists(argc,argv,"-fast"));
+    log_stop();
+    return (ret == 0) ? 0 : 1;
+  }
+
+  // a client or scraper that resets mid reply is an error from the
+  // write, not a signal that takes every channel down with it
+  signal(SIGPIPE, SIG_IGN);
+
+  // one epoll instance owns every socket, plus an eventfd that the event
+  // pump uses to hand over hardware events
+
+  epfd = epoll_create(64);
+  evfd = eventfd(0, EFD_NONBLOCK);
+  if ((epfd < 0) || (evfd < 0)) {
+    mylog(LOG_ERR,"cannot create reactor: %s", strerror(errno));
+    exit(-1);
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = (unsigned long long)SRC_EVENTS << 32;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev);
+  ready_head = -1;
+  wheel_init(now_ms());
+  if ((i = arg_exists(argc,argv,"-idle")) && (i+1 < argc))
+    idle_ms = atol(argv[i+1])*SEC2MS;
+
+  // open CT & TCP/IP ports, then start the reactor and event pump
+  if ((i = arg_exists(argc,argv,"-config")) && (i+1 < argc))
+    ret = config_read(argv[i+1], ct, &cfg, &ncfg);
+  else
+    ret = config_default(ct, SERVER_PORT, max_ports, &cfg, &ncfg);
+  if (ret != CT_OK) {
+    mylog(LOG_ERR,"no CT ports to open");
+    exit(-1);
+  }
+  ports_open(cfg, ncfg);
+  config_free(cfg, ncfg);
+  stats_setup();
+  if ((i = arg_exists(argc,argv,"-trace")) && (i+1 < argc)) {
+    unsigned long nrecs = TRACE_RECS;
+    int           j;
+
+    if ((j = arg_exists(argc,argv,"-tracesize")) && (j+1 < argc))
+      nrecs = atol(argv[j+1]);
+    if (trace_open(argv[i+1], nrecs, num_ports) != 0)
+      mylog(LOG_ERR,"cannot open trace file %s", argv[i+1]);
   }
+  if ((i = arg_exists(argc,argv,"-stats")) && (i+1 < argc) &&
+      (stats_listen(atoi(argv[i+1])) != 0))
+    mylog(LOG_ERR,"cannot open stats port TCP %s", argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-campaign")) && (i+1 < argc) &&
+      (campaign_listen(atoi(argv[i+1])) != SUCCESS))
+    mylog(LOG_ERR,"cannot open campaign port TCP %s", argv[i+1]);
+  post_start();
+  pthread_create(&areactor_thread, NULL, reactor_thread, NULL);
+  pthread_create(&aevent_thread, NULL, event_thread, NULL);
 
   // set up SIGTERM handler to allow for an orderly exit
   signal(SIGTERM, sig_handler);
+  signal(SIGUSR1, sig_handler);
+  signal(SIGUSR2, sig_handler);
   int term_sig = sigsetjmp(jmpbuf, 0);
 
   // program will jump here with term_sig == 1 when SIGTERM occurs
@@ -203,763 +847,3697 @@ int main (int argc, char *argv[]) {
     // Note: we ignore any running threads, which could lead to problems
 
     // shut down and clean up
-    for(i=0; i<NUM_PORTS; i++) {
-      vpb_close(h[i]);
+    for(i=0; i<num_ports; i++) {
+      ct->close(chans[i].h);
     }
 
+    trace_close();
     unlink("/var/run/ctsrver.pid");
     mylog(LOG_INFO, "shut down OK!");
-    return 0; 
+    log_stop();
+    return 0;
   }
 
   mylog(LOG_INFO, "Started!");
 
   // do nothing in main thread.......until SIGTERM occurs
   while(1)
-    vpb_sleep(1000);
+    sleep(1);
 }
 
-// - server thread, one of these threads is started for each CT port
-// - each CT port has a different IP port.
+/*--------------------------------------------------------------------------*\
 
-void *port_thread(void *pv) {
-  int                sd, newSd;
-  socklen_t          cliLen;
-  struct sockaddr_in cliAddr, servAddr;
-  char               line[MAX_MSG];
+	FUNCTION....: replay
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
 
-  int                h;
-  void               *timer;
-  char               s[VPB_MAX_STR];
-  int                rc;
+	Feeds a trace (see trace.h) back through the handlers the reactor
+	uses, at the speed it was recorded or as fast as possible.  Channels
+	start idle with a backend that does nothing, clients write to
+	/dev/null, and the replies each record causes are checked against
+	the ones that follow it in the trace.  Returns the number that
+	differed, or -1 if the trace can't be read.
 
-  pthread_mutex_lock(&mutex);
-  threads_active++;
-  pthread_mutex_unlock(&mutex);
+	The timing wheel is not run.  A channel timer that expired is in
+	the trace as a CT_TIMEREXP event and is fed back like any other,
+	so a command's time out is replayed, but not checked.  Timers that
+	don't end in an event, the client idle time out and campaign
+	pacing, are not replayed at all.
 
-  h = *(int*)pv;
-  vpb_sethook_sync(h,VPB_ONHOOK);
-  vpb_timer_open(&timer, h, 0, 1000);
+\*--------------------------------------------------------------------------*/
 
-  /* create socket */
-  sd = socket(AF_INET, SOCK_STREAM, 0);
-  if(sd<0) {
-    mylog(LOG_ERR,"[%02d] cannot create socket %s", h, strerror(errno));
-    return NULL;
-  }
-  
-  /* bind server port */
-  servAddr.sin_family = AF_INET;
-  servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-  servAddr.sin_port = htons(SERVER_PORT+h);
-  
-  if(bind(sd, (struct sockaddr *) &servAddr, sizeof(servAddr))<0) {
-    mylog(LOG_ERR,"[%02d] cannot bind port %d: %s", h, SERVER_PORT+h,
-	  strerror(errno));
-    return NULL;
+int replay(const char *file_name, int fast) {
+  TRACE_MAP          m;
+  TRACE_REC          *r, *x;
+  CHANNEL            *ch;
+  CT_EVENT           e;
+  struct sockaddr_in addr;
+  unsigned long long i, j, t0, t, now, checked = 0;
+  int                k, bad = 0;
+
+  if (trace_map(file_name, &m) != 0) {
+    mylog(LOG_ERR,"cannot read trace %s", file_name);
+    return -1;
   }
 
-  listen(sd,5);
-  
-  while(!finito) {
+  num_ports = m.hdr->nports;
+  chans = (CHANNEL*)calloc(num_ports, sizeof(CHANNEL));
+  for(k=0; k<num_ports; k++)
+    channel_init(&chans[k], 0, k);
+  stats_setup();
+  epfd = -1;
+  memset(&addr, 0, sizeof(addr));
+  replaying = 1;
+  mylog(LOG_INFO,"replaying %llu records of %s on %d ports", m.n, file_name,
+	num_ports);
+
+  t0 = stats_now_us();
+  for(i=0; i<m.n; i=j) {
+    r = trace_rec(&m, i);
+    j = i+1;
+    if (r->chan >= num_ports)
+      continue;
+    ch = &chans[r->chan];
+
+    if (!fast) {
+      t = t0 + r->t - trace_rec(&m, 0)->t;
+      now = stats_now_us();
+      if (t > now)
+	usleep(t - now);
+    }
+    replay_ms = r->t/1000;
+    nreplies = 0;
+
+    switch(r->kind) {
+    case TRACE_EVENT:
+      e.type = r->type;
+      e.handle = ch->h;
+      e.data = r->data;
+      dispatch_event(ch, &e);
+      break;
+
+    case TRACE_OPEN:
+      if (ch->newSd == -1)
+	client_attach(ch, open("/dev/null", O_WRONLY), &addr);
+      break;
+
+    case TRACE_INPUT:
+      if ((ch->newSd == -1) || (rcv_reserve(ch, ch->rcv_n+r->n) != SUCCESS))
+	break;
+      memcpy(ch->rcv_msg+ch->rcv_n, r->text, r->n);
+      ch->rcv_n += r->n;
+
+      // one recv() may have been split over several records
+      x = (j < m.n) ? trace_rec(&m, j) : NULL;
+      if ((x == NULL) || (x->kind != TRACE_INPUT) || (x->chan != r->chan) ||
+	  (r->n < TRACE_TEXT))
+	service_input(ch);
+      break;
+
+    case TRACE_CLOSE:
+      if (ch->newSd != -1)
+	client_close(ch);
+      break;
+
+    case TRACE_CID:
+      memcpy(ch->cid.number, r->text, r->n);
+      ch->cid.number[r->n] = 0;
+      ch->cid_done = 1;
+      ctwaitforring_cid(ch);
+      break;
+
+    case TRACE_REPLY:
+      // caused by something before the oldest record kept
+      continue;
+    }
 
-    mylog(LOG_INFO,"[%02d] waiting for data on port TCP %u",h,SERVER_PORT+h);
-
-    cliLen = sizeof(cliAddr);
-    newSd = accept(sd, (struct sockaddr *) &cliAddr, &cliLen);
-    if(newSd<0) {
-      mylog(LOG_ERR,"[%02d] cannot accept connection %s", h, strerror(errno));
-      return NULL;
-    }
-        
-    // wait for command
-
-    memset(line,0x0,MAX_MSG);
-    while(read_line(newSd,line)!=ERROR) {
-      
-      strncpy(s, line, strlen(line)-1);
-      s[strlen(line)-1] = 0;
-      mylog(LOG_INFO,"[%02d] received from %s:TCP%d : %s", h,
-	     inet_ntoa(cliAddr.sin_addr),
-	     ntohs(cliAddr.sin_port), s);
-      
-      if (strcmp(line,"ctwaitforring\n")==0) {
-	ctwaitforring(h, timer, newSd);
-      }
-      if (strcmp(line,"ctwaitfordial\n")==0) {
-	ctwaitfordial(h, timer, newSd);
-      }
-      if (strcmp(line,"cthangup\n")==0) {
-	      vpb_sethook_sync(h,VPB_ONHOOK);
-	      sprintf(s, "OK\n");
-	      rc = send(newSd, s, strlen(s)+1, 0);
-      }
-      if (strcmp(line,"ctanswer\n")==0) {
-	      vpb_sethook_sync(h,VPB_OFFHOOK);
-	      sprintf(s, "OK\n");
-	      rc = send(newSd, s, strlen(s)+1, 0);
-      }
-      if (strcmp(line,"ctplay\n")==0) {
-	ctplay(h, newSd);
+    for(k=0; (j < m.n) && ((x = trace_rec(&m, j))->kind == TRACE_REPLY);
+	j++, k++) {
+      checked++;
+      if ((k >= nreplies) || (replies[k].chan != x->chan) ||
+	  (replies[k].n != x->n) || memcmp(replies[k].text, x->text, x->n)) {
+	mylog(LOG_ERR,"[%02d] replay record %llu: expected reply %.*s",
+	      x->chan, j, x->n, x->text);
+	bad++;
       }
-      if (strcmp(line,"ctrecord\n")==0) {
-	ctrecord(h, newSd);
-      }
-      if (strcmp(line,"ctsleep\n")==0) {
-	ctsleep(h, newSd, timer);
-      }
-      if (strcmp(line,"ctclear\n")==0) {
-	vpb_flush_digits(h);
-	sprintf(s, "OK\n");
-	rc = send(newSd, s, strlen(s)+1, 0);
-      }
-      if (strcmp(line,"ctcollect\n")==0) {
-	ctcollect(h, newSd);
-      }
-      if (strcmp(line,"ctdial\n")==0) {
-	ctdial(h, newSd);
-      }
-    
-      memset(line,0x0,MAX_MSG);
-    } /* while(read_line) */
+    }
+    for(; k<nreplies; k++) {
+      mylog(LOG_ERR,"[%02d] replay record %llu: unexpected reply %.*s",
+	    replies[k].chan, i, replies[k].n, replies[k].text);
+      bad++;
+    }
+  }
 
-    mylog(LOG_INFO,"[%02d] connection closed!\n",h);
+  t = stats_now_us() - t0;
+  mylog(LOG_INFO,"replayed %llu records in %.3f s, %llu replies checked, "
+	"%d differed", m.n, t/1E6, checked, bad);
+  trace_unmap(&m);
 
-  } /* while (!finito) */
+  return bad;
+}
 
-  pthread_mutex_lock(&mutex);
-  threads_active--;
-  pthread_mutex_unlock(&mutex);
+/*--------------------------------------------------------------------------*\
 
-  return NULL;
-}
+	FUNCTION....: ports_open
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Opens every CT port named in the config, with a thread per board so
+	the boards are set up in parallel, then creates the listeners.
 
-/* rcv_line is my function readline(). Data is read from the socket when */
-/* needed, but not byte after bytes. All the received data is read.      */
-/* This means only one call to recv(), instead of one call for           */
-/* each received byte.                                                   */
-/* You can set END_CHAR to whatever means endofline for you. (0x0A is \n)*/
-/* read_lin returns the number of bytes returned in line_to_return       */
+\*--------------------------------------------------------------------------*/
 
-int read_line(int newSd, char *line_to_return) {
-  
-  static int rcv_ptr=0;
-  static char rcv_msg[MAX_MSG];
-  static int n;
-  int offset;
+static int chan_cmp(const void *a, const void *b) {
+  const CHANNEL *ca = (const CHANNEL*)a;
+  const CHANNEL *cb = (const CHANNEL*)b;
 
-  offset=0;
+  if (ca->board != cb->board)
+    return ca->board - cb->board;
+  return ca->channel - cb->channel;
+}
 
-  while(1) {
-    if(rcv_ptr==0) {
-      /* read data from socket */
-      memset(rcv_msg,0x0,MAX_MSG); /* init buffer */
-      n = recv(newSd, rcv_msg, MAX_MSG, 0); /* wait for data */
-      if (n<0) {
-	perror(" cannot receive data ");
-	return ERROR;
-      } else if (n==0) {
-	close(newSd);
-	return ERROR;
+void ports_open(LISTEN_CFG *cfg, int ncfg) {
+  OPEN_INFO *oi;
+  pthread_t *threads;
+  SELECTOR  *sel;
+  int       i, j, k, n, nthreads;
+
+  // every channel mentioned, sorted by board then channel, once each
+  for(i=0, n=0; i<ncfg; i++)
+    n += cfg[i].n;
+  chans = (CHANNEL*)calloc(n, sizeof(CHANNEL));
+  for(i=0, k=0; i<ncfg; i++)
+    for(j=0; j<cfg[i].n; j++, k++) {
+      chans[k].board = cfg[i].board[j];
+      chans[k].channel = cfg[i].channel[j];
+    }
+  qsort(chans, n, sizeof(CHANNEL), chan_cmp);
+  for(i=0, num_ports=0; i<n; i++)
+    if ((num_ports == 0) || chan_cmp(&chans[i], &chans[num_ports-1]))
+      chans[num_ports++] = chans[i];
+
+  oi = (OPEN_INFO*)malloc(num_ports*sizeof(OPEN_INFO));
+  threads = (pthread_t*)malloc(num_ports*sizeof(pthread_t));
+  for(i=0, nthreads=0; i<num_ports; i=j) {
+    for(j=i; (j<num_ports) && (chans[j].board == chans[i].board); j++);
+    oi[nthreads].first = i;
+    oi[nthreads].n = j-i;
+    pthread_create(&threads[nthreads], NULL, open_thread, &oi[nthreads]);
+    nthreads++;
+  }
+  for(i=0; i<nthreads; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  free(oi);
+
+  // handles are small integers, keep a table to find channels by handle
+  hmap = NULL;
+  nhmap = 0;
+  for(i=0; i<num_ports; i++) {
+    k = chans[i].h;
+    if (k < 0)
+      continue;
+    if (k >= nhmap) {
+      hmap = (CHANNEL**)realloc(hmap, (k+1)*sizeof(CHANNEL*));
+      memset(hmap+nhmap, 0, (k+1-nhmap)*sizeof(CHANNEL*));
+      nhmap = k+1;
+    }
+    hmap[k] = &chans[i];
+  }
+
+  selectors = NULL;
+  nselectors = 0;
+  for(i=0; i<ncfg; i++) {
+    if (!cfg[i].select) {
+      for(j=0; j<cfg[i].n; j++) {
+	k = find_channel(cfg[i].board[j], cfg[i].channel[j]);
+	channel_listen(&chans[k], cfg[i].port+j);
       }
+      continue;
     }
-  
-    /* if new data read on socket */
-    /* OR */
-    /* if another line is still in buffer */
-
-    /* copy line into 'line_to_return' */
-    while(*(rcv_msg+rcv_ptr)!=END_LINE && rcv_ptr<n) {
-      memcpy(line_to_return+offset,rcv_msg+rcv_ptr,1);
-      offset++;
-      rcv_ptr++;
-    }
-    
-    /* end of line + end of buffer => return line */
-    if(rcv_ptr==n-1) { 
-      /* set last byte to END_LINE */
-      *(line_to_return+offset)=END_LINE;
-      rcv_ptr=0;
-      return ++offset;
-    } 
-    
-    /* end of line but still some data in buffer => return line */
-    if(rcv_ptr <n-1) {
-      /* set last byte to END_LINE */
-      *(line_to_return+offset)=END_LINE;
-      rcv_ptr++;
-      return ++offset;
-    }
-
-    /* end of buffer but line is not ended => */
-    /*  wait for more data to arrive on socket */
-    if(rcv_ptr == n) {
-      rcv_ptr = 0;
-    } 
-    
-  } /* while */
-}
-  
-/*---------------------------------------------------------------------------*\
 
-	FUNCTION: digit_match
-	AUTHOR..: David Rowe
-	DATE....: 29/7/98
+    selectors = (SELECTOR*)realloc(selectors,
+				   (nselectors+1)*sizeof(SELECTOR));
+    sel = &selectors[nselectors];
+    sel->port = cfg[i].port;
+    sel->n = cfg[i].n;
+    sel->chan = (int*)malloc(sel->n*sizeof(int));
+    for(j=0; j<sel->n; j++) {
+      sel->chan[j] = find_channel(cfg[i].board[j], cfg[i].channel[j]);
+      if (chans[sel->chan[j]].port == 0)
+	chans[sel->chan[j]].port = sel->port;
+    }
+    sel->sd = listen_socket(sel->port, ((unsigned long long)SRC_SELECT << 32)
+			    | nselectors);
+    if (sel->sd != -1)
+      mylog(LOG_INFO,"waiting for data on port TCP %u for %d channels",
+	    sel->port, sel->n);
+    nselectors++;
+  }
 
-	Determines if the digit is a member of the term_digit string.
+  unbound = NULL;
+  nunbound = 0;
+}
 
-\*--------------------------------------------------------------------------*/
+// names the channels and commands for the stats port
+
+void stats_setup() {
+  const char *names[NUM_CMDS];
+  char       **labels;
+  int        *ports;
+  COMMAND    *c;
+  int        i;
+
+  memset(names, 0, sizeof(names));
+  for(c=commands; c->name; c++)
+    names[c->cmd] = c->name;
+  names[CMD_CAMPCALL] = "campaign";
+
+  labels = (char**)malloc(num_ports*sizeof(char*));
+  ports = (int*)malloc(num_ports*sizeof(int));
+  for(i=0; i<num_ports; i++) {
+    labels[i] = (char*)malloc(16);
+    sprintf(labels[i], "%d:%d", chans[i].board, chans[i].channel);
+    ports[i] = chans[i].port;
+  }
+  stats_init(num_ports, (const char**)labels, ports, names, NUM_CMDS);
+  for(i=0; i<num_ports; i++)
+    free(labels[i]);
+  free(labels);
+  free(ports);
+}
 
-static int digit_match(char digit, char *term_digits)
-{
-	char *p = term_digits;
+void *open_thread(void *pv) {
+  OPEN_INFO *oi = (OPEN_INFO*)pv;
+  int       i;
 
-	while(*p != 0) {
-		if (*p == digit)
-			return(1);
-		p++;
-	}
+  for(i=oi->first; i<oi->first+oi->n; i++)
+    channel_init(&chans[i], chans[i].board, chans[i].channel);
 
-	return(0);
+  return NULL;
 }
 
-/*--------------------------------------------------------------------------*\
+// opens a CT port, may be called from several threads at once
+
+int channel_init(CHANNEL *ch, int board, int channel) {
+  memset(ch, 0, sizeof(CHANNEL));
+  ch->board = board;
+  ch->channel = channel;
+  ch->h = ct->open(board, channel);
+  ch->sd = -1;
+  ch->newSd = -1;
+  ch->cmd = CMD_NONE;
+  ch->proto = 1;
+  ch->rec_mode = CARD_MODE;
+  ch->rec_rate = CARD_RATE;
+  if (ch->h < 0) {
+    mylog(LOG_ERR,"cannot open CT port %d:%d", board, channel);
+    return ERROR;
+  }
 
-	FUNCTION....: sig_handler
-	AUTHOR......: David Rowe
-	DATE CREATED: 13/09/01
+  ct->sethook(ch->h,CT_ONHOOK);
+  wheel_timer_init(&ch->timer, chan_timeout, ch);
+  wheel_timer_init(&ch->idle, client_idle, ch);
 
-	SIGTERM handler.
+  return SUCCESS;
+}
 
-\*--------------------------------------------------------------------------*/
+// the channel's own listener, TCP port clients connect to directly
 
-void sig_handler(int sig) {
-  if (sig == SIGTERM) {
-    signal(SIGTERM,SIG_DFL);
-    siglongjmp(jmpbuf, 0);
-  }
-}
+int channel_listen(CHANNEL *ch, int port) {
+  if (ch->h < 0)
+    return ERROR;
 
-/*--------------------------------------------------------------------------*\
+  ch->port = port;
+  ch->sd = listen_socket(port, ((unsigned long long)SRC_LISTEN << 32) |
+			 (ch - chans));
+  if (ch->sd == -1)
+    return ERROR;
 
-	FUNCTION....: ctwaitforring
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+  mylog(LOG_INFO,"[%02d] waiting for data on port TCP %u",ch->h,ch->port);
+  return SUCCESS;
+}
 
-	Waits for two rings, decodes CID if present.
+// creates a listening socket and registers it with the reactor
 
-\*--------------------------------------------------------------------------*/
+int listen_socket(int port, unsigned long long data) {
+  struct sockaddr_in servAddr;
+  struct epoll_event ev;
+  int                sd, on = 1;
 
-void ctwaitforring(int h, void *timer, int newSd) {
-  char        s[VPB_MAX_STR], cid_str[VPB_MAX_STR];
-  int         state, ret, rc, ev;
-  THREAD_INFO ti;
-  pthread_t   thread;
+  /* create socket */
+  sd = socket(AF_INET, SOCK_STREAM, 0);
+  if(sd<0) {
+    mylog(LOG_ERR,"cannot create socket %s", strerror(errno));
+    return -1;
+  }
+  setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 
-  state = 0;
-  do {
-    // wait forever for first ring
-    ctwaitforevent(h, timer, VPB_RING, 0, 0);
-    ti.h = h;
-    pthread_create(&thread, NULL, rec_thread, (void*)&ti);
-    mylog(LOG_INFO,"[%02d] First Ring-CID recording-waiting for second ring",
-	  h);
-	
-    // wait for 6 seconds for second ring, otherwise time out
-    ev = ctwaitforevent(h, timer, VPB_RING, 0, 6000);
-    vpb_record_terminate(h);
-    if (ev == VPB_RING) {
-      mylog(LOG_INFO,"[%02d] Second Ring, CID decoding", h);
-      ret = vpb_cid_decode(cid_str, ti.buf, N);
-      mylog(LOG_INFO,"[%02d] CID decoding ret = %d, number = %s",
-	    h, ret, cid_str);
-      sprintf(s, "%s\n", cid_str);
-      state = 1;
-    }
-  } while(!finito && !state);
+  /* bind server port */
+  servAddr.sin_family = AF_INET;
+  servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  servAddr.sin_port = htons(port);
 
-  if (finito) {
-    sprintf(s, "finito\n");
+  if(bind(sd, (struct sockaddr *) &servAddr, sizeof(servAddr))<0) {
+    mylog(LOG_ERR,"cannot bind port %d: %s", port, strerror(errno));
+    close(sd);
+    return -1;
   }
 
-  rc = send(newSd, s, strlen(s)+1, 0);
-}
+  listen(sd,5);
+  fcntl(sd, F_SETFL, O_NONBLOCK);
 
-/*--------------------------------------------------------------------------*\
+  ev.events = EPOLLIN;
+  ev.data.u64 = data;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, sd, &ev);
 
-	FUNCTION....: ctwaitfordial
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+  return sd;
+}
 
-	Waits for dial tone.
+// index in chans of a CT port, chans is sorted so we can bisect
 
-\*--------------------------------------------------------------------------*/
+int find_channel(int board, int channel) {
+  CHANNEL key;
+  CHANNEL *ch;
 
-void ctwaitfordial(int h, void *timer, int newSd) {
-  int         rc, ev;
+  key.board = board;
+  key.channel = channel;
+  ch = (CHANNEL*)bsearch(&key, chans, num_ports, sizeof(CHANNEL), chan_cmp);
 
-  ev = ctwaitforevent(h, timer, VPB_TONEDETECT, VPB_DIAL, 0);
-  rc = send(newSd,"\n", strlen("\n")+1, 0);
+  return ch ? ch - chans : -1;
 }
 
 /*--------------------------------------------------------------------------*\
 
-	FUNCTION....: ctplay
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+	FUNCTION....: reactor_thread
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
 
-	Play handler.
+	Single thread that services every port.  Waits on epoll for client
+	connections, client data and hardware events, or until the next
+	timer on the wheel, and resumes the state machine of the port
+	concerned.  Nothing in here may block.
 
 \*--------------------------------------------------------------------------*/
 
-void ctplay(int h, int newSd) {
-  char      s[VPB_MAX_STR];
-  char      smess[VPB_MAX_STR];
-  int       state, next_state, ret, rc;
-  VPB_EVENT e;
-  char      line[MAX_MSG];
-  char      *ext;
+void *reactor_thread(void *pv) {
+  struct epoll_event ev[MAX_EPOLL_EVENTS];
+  unsigned long long count;
+  int                i, k, n, src, next;
+  CHANNEL            *ch;
 
-  // read file name
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  line[strlen(line)-1] = 0;
-  sprintf(s, "%s",line);
+  pthread_mutex_lock(&mutex);
+  threads_active++;
+  pthread_mutex_unlock(&mutex);
 
-  ext = strrchr(s, '.');
-  if (!strcmp(ext,".ul"))
-      ret = vpb_play_voxfile_async(h, s, VPB_MULAW, 0);
-  else
-      ret = vpb_play_file_async(h, s, 0);
-      
-  if (ret != VPB_OK) {
-	  rc = send(newSd, "ERROR\n", strlen("ERROR\n")+1, 0);
-	  mylog(LOG_ERR,"Error playing: %s", s);
-	  return;
-  }  
+  while(!finito) {
+    n = epoll_wait(epfd, ev, MAX_EPOLL_EVENTS, wheel_timeout(now_ms()));
+    wheel_run(now_ms());
+    if (n < 0) {
+      if (errno != EINTR)
+	mylog(LOG_ERR,"epoll_wait: %s", strerror(errno));
+      continue;
+    }
 
-  state = PLAYING;
+    for(i=0; i<n; i++) {
+      src = ev[i].data.u64 >> 32;
+      ch = &chans[ev[i].data.u64 & 0xffffffff];
 
-  do {
-    ret = vpb_get_event_ch_async(h, &e);
-
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s);
-
-      next_state = state;
-      switch(state) {
-      case PLAYING:
-	      
-	if (e.type == VPB_PLAYEND) {
-	  next_state = FINISHED;
-	  rc = send(newSd, "OK\n", strlen("OK\n")+1, 0);
-	}
-	    
-	if (e.type == VPB_DTMF) {
-	  next_state = WAIT_FOR_PLAYEND;
-	  vpb_play_terminate(h);
-	  sprintf(smess, "%c\n", e.data);
-	}
+      switch(src) {
+      case SRC_LISTEN:
+	client_accept(ch);
 	break;
 
-      case WAIT_FOR_PLAYEND:
-	if (e.type == VPB_PLAYEND) {
-	  next_state = FINISHED;
-	  rc = send(newSd, smess, strlen(smess)+1, 0);
-	}
+      case SRC_SELECT:
+	selector_accept(ev[i].data.u64 & 0xffffffff);
 	break;
-      }
-      state = next_state;
-    }
-    else
-      vpb_sleep(100);
-  } while(state != FINISHED);
-	
-}
-
-/*--------------------------------------------------------------------------*\
-
-	FUNCTION....: ctrecord
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
-
-	Record handler.
 
-\*--------------------------------------------------------------------------*/
-
-void ctrecord(int h, int newSd) {
-  char      file_name[VPB_MAX_STR], s[VPB_MAX_STR];
-  char      smess[VPB_MAX_STR];
-  int       state, next_state, ret, rc;
-  char      line[MAX_MSG];
-  VPB_EVENT e;
-
-  // filename
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  line[strlen(line)-1] = 0;
-  sprintf(file_name, "%s",line);
+      case SRC_UNBOUND:
+	unbound_read(&unbound[ev[i].data.u64 & 0xffffffff]);
+	break;
 
-  // timeout
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  unsigned int timeout = atoi(line)*SEC2MS;
-  VPB_RECORD r = {"", timeout};
-  vpb_record_set(h, &r);
-	
-  // term digits
-  char term_digits[VPB_MAX_STR];
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,term_digits);
-
-  ret = vpb_record_file_async(h, file_name, VPB_MULAW);
-  if (ret != VPB_OK) {
-	  rc = send(newSd, "ERROR\n", strlen("ERROR\n")+1, 0);
-	  mylog(LOG_ERR,"Error recording: %s", file_name);
-	  return;
-  }  
+      case SRC_CAMPAIGN:
+	campaign_accept();
+	break;
 
-  state = RECORDING;
+      case SRC_CAMPCLIENT:
+	k = ev[i].data.u64 & 0xffffffff;
+	if ((campclients[k].sd != -1) && (ev[i].events & EPOLLOUT))
+	  campaign_flush(k);
+	if (campclients[k].sd == -1)
+	  break;
+	if (ev[i].events & EPOLLIN)
+	  campaign_read(k);
+	else if (ev[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+	  campaign_close(k);
+	break;
 
-  do {
-    ret = vpb_get_event_ch_async(h, &e);
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s);
-
-      next_state = state;
-      switch(state) {
-      case RECORDING:
-	      
-	if (e.type == VPB_RECORDEND) {
-	  next_state = FINISHED;
-	  sprintf(smess, "OK\n");
-	}
-	    
-	if (e.type == VPB_DTMF) {
-	  if (digit_match(e.data, term_digits)) {
-	    next_state = WAIT_FOR_RECORDEND;
-	    vpb_record_terminate(h);
-	    sprintf(smess, "OK\n");
-	  }
-	}
+      case SRC_CLIENT:
+	if ((ch->newSd != -1) && (ev[i].events & EPOLLOUT))
+	  out_flush(ch);
+	if (ch->newSd == -1)
+	  break;
+	if (ev[i].events & EPOLLIN)
+	  client_read(ch);
+	else if (ev[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+	  client_close(ch);
 	break;
 
-      case WAIT_FOR_RECORDEND:
-	if (e.type == VPB_RECORDEND) {
-	  next_state = FINISHED;
+      case SRC_EVENTS:
+	read(evfd, &count, sizeof(count));
+
+	// take every ready channel at once.  ready is cleared before the
+	// channel's ring is drained, so an event that slips in meanwhile
+	// puts the channel back on the list rather than being missed.
+	next = __atomic_exchange_n(&ready_head, -1, __ATOMIC_ACQUIRE);
+	while(next != -1) {
+	  ch = &chans[next];
+	  next = ch->ready_next;
+	  __atomic_store_n(&ch->ready, 0, __ATOMIC_SEQ_CST);
+	  channel_events(ch);
 	}
 	break;
       }
-      state = next_state;
     }
-    else
-      vpb_sleep(100);
-  } while(state != FINISHED);	
+  }
+
+  pthread_mutex_lock(&mutex);
+  threads_active--;
+  pthread_mutex_unlock(&mutex);
 
-  trim(file_name, 2000);
-  rc = send(newSd, smess, strlen(smess)+1, 0);
+  return NULL;
 }
 
 /*--------------------------------------------------------------------------*\
 
-	FUNCTION....: ctsleep
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+	FUNCTION....: event_thread
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
 
-	Sleep handler.
+	Event pump.  Blocks on the hardware event queue for all ports and
+	passes each event to its channel's ring, so no port ever polls.
 
 \*--------------------------------------------------------------------------*/
 
-void ctsleep(int h, int newSd, void *timer) {
-  char      s[VPB_MAX_STR];
-  int       state, ret, rc;
-  char      line[MAX_MSG];
-  VPB_EVENT e;
+void *event_thread(void *pv) {
+  CT_EVENT          e;
 
-  // read duration of sleep
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  unsigned long newperiod;
-  newperiod = atol(line)*SEC2MS;
-
-  vpb_timer_change_period(timer, newperiod);	
-  vpb_timer_start(timer);
+  pthread_mutex_lock(&mutex);
+  threads_active++;
+  pthread_mutex_unlock(&mutex);
 
-  state = 0;
-  do {
-    ret = vpb_get_event_ch_async(h, &e);
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s); 
-      if (e.type == VPB_TIMEREXP) {
-	state = 1;
-	rc = send(newSd, "OK\n", strlen("OK\n")+1, 0);
-      }
-      if (e.type == VPB_DTMF) {
-	state = 1;
-	vpb_timer_stop(timer);
-	sprintf(s, "%c\n", e.data);
-	rc = send(newSd, s, strlen(s)+1, 0);
-      }
-    }
+  while(!finito) {
+    if (ct->get_event(&e, 1000) != CT_OK)
+      continue;
+    if ((e.handle >= 0) && (e.handle < nhmap) && hmap[e.handle])
+      ev_push(hmap[e.handle], &e);
     else
-      vpb_sleep(100);
-  } while(!state);
-}
+      mylog(LOG_ERR,"[%02d] event %d for unknown port", e.handle, e.type);
+  }
 
-/*--------------------------------------------------------------------------*\
+  pthread_mutex_lock(&mutex);
+  threads_active--;
+  pthread_mutex_unlock(&mutex);
 
-	FUNCTION....: ctcollect
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+  return NULL;
+}
 
-	Collect digits handler.
+// event_thread only, adds an event to the channel's ring
 
-\*--------------------------------------------------------------------------*/
+void ev_push(CHANNEL *ch, CT_EVENT *e) {
+  unsigned int head = ch->ev_head;
+  unsigned int tail = __atomic_load_n(&ch->ev_tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail == EVRING) {
+    mylog(LOG_ERR,"[%02d] event queue full, event lost", ch->h);
+    stats_lost(ch - chans);
+    return;
+  }
+  ch->evring[head % EVRING] = *e;
+  ch->evtime[head % EVRING] = stats_now_us();
+  __atomic_store_n(&ch->ev_head, head+1, __ATOMIC_RELEASE);
 
-void ctcollect(int h, int newSd) {
-  char      s[VPB_MAX_STR];
-  int       state, ret, rc;
-  char      line[MAX_MSG];
-  VPB_EVENT e;
-  int       digits;
-  char      buf[VPB_MAX_STR];
+  ready_push(ch);
+}
 
-  // read digits
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  digits = atoi(line);
+// any thread, puts the channel on the ready list and wakes the reactor.
+// The reactor takes the whole list at once, so there is no ABA problem.
 
-  // read time out in seconds
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  int unsigned long seconds = atol(line);
+void ready_push(CHANNEL *ch) {
+  unsigned long long one = 1;
+  int                old;
 
-  // read inter digit time out in seconds
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  int unsigned long inter_seconds = atol(line);
+  if (__atomic_exchange_n(&ch->ready, 1, __ATOMIC_ACQ_REL))
+    return;
 
-  VPB_DIGITS d = {"", digits, seconds*SEC2MS, inter_seconds*SEC2MS};
-  vpb_get_digits_async(h, &d, buf);
-	
-  state = 0;
+  old = __atomic_load_n(&ready_head, __ATOMIC_RELAXED);
   do {
-    ret = vpb_get_event_ch_async(h, &e);
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s);
-
-      if (e.type == VPB_DIGIT) {
-	state = 1;
-	sprintf(s, "%s\n", buf);
-	rc = send(newSd, s, strlen(s)+1, 0);
-      }
-    }
-    else
-      vpb_sleep(100);
-  } while(!state);
-	
+    ch->ready_next = old;
+  } while(!__atomic_compare_exchange_n(&ready_head, &old, (int)(ch - chans),
+				       1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  write(evfd, &one, sizeof(one));
 }
 
-/*--------------------------------------------------------------------------*\
+// reactor, handles everything waiting for a ready channel
 
-	FUNCTION....: ctdial
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+void channel_events(CHANNEL *ch) {
+  unsigned int       tail = ch->ev_tail;
+  CT_EVENT           e;
+  unsigned long long t;
 
-	Dial handler.
+  if (__atomic_exchange_n(&ch->audio_ready, 0, __ATOMIC_ACQ_REL))
+    ctrecordstream_audio(ch);
+  if (__atomic_exchange_n(&ch->post_ready, 0, __ATOMIC_ACQ_REL)) {
+    ctrecord_done(ch);
+    service_input(ch);
+  }
+  if (__atomic_exchange_n(&ch->cid_ready, 0, __ATOMIC_ACQ_REL)) {
+    trace_add(ch - chans, TRACE_CID, 0, 0, ch->cid.number,
+	      strlen(ch->cid.number));
+    ctwaitforring_cid(ch);
+  }
 
-\*--------------------------------------------------------------------------*/
+  while(tail != __atomic_load_n(&ch->ev_head, __ATOMIC_ACQUIRE)) {
+    e = ch->evring[tail % EVRING];
+    t = ch->evtime[tail % EVRING];
+    __atomic_store_n(&ch->ev_tail, ++tail, __ATOMIC_RELEASE);
+    dispatch_event(ch, &e);
+    stats_event(ch - chans, e.type, stats_now_us() - t);
+  }
+}
 
-void ctdial(int h, int newSd) {
-  char      s[VPB_MAX_STR];
-  int       state, ret, rc;
-  char      line[MAX_MSG];
-  VPB_EVENT e;
+// accepts a client, only one client per port at a time
 
-  // read dial string
-  memset(line,0x0,MAX_MSG);
-  read_line(newSd,line);
-  line[strlen(line)-1]=0;
-  printf("dial: %s %d\n",line,strlen(line));
-  
-  ret = vpb_dial_async(h, line);
-  if (ret != VPB_OK) {
-	  rc = send(newSd, "ERROR\n", strlen("ERROR\n")+1, 0);
-	  mylog(LOG_ERR,"Error recording");
-	  return;
-  }  
-	
-  state = 0;
-  do {
-    ret = vpb_get_event_ch_async(h, &e);
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s);
-
-      if (e.type == VPB_DIALEND) {
-	state = 1;
-	sprintf(s, "OK\n");
-	rc = send(newSd, s, strlen(s)+1, 0);
-      }
-    }
-    else
-      vpb_sleep(100);
-  } while(!state);
-	
-}
+void client_accept(CHANNEL *ch) {
+  struct sockaddr_in cliAddr;
+  socklen_t          cliLen;
+  int                sd;
 
-/*--------------------------------------------------------------------------*\
+  cliLen = sizeof(cliAddr);
+  sd = accept(ch->sd, (struct sockaddr *) &cliAddr, &cliLen);
+  if(sd<0) {
+    if (errno != EAGAIN)
+      mylog(LOG_ERR,"[%02d] cannot accept connection %s", ch->h,
+	    strerror(errno));
+    return;
+  }
+  fcntl(sd, F_SETFL, O_NONBLOCK);
 
-	FUNCTION....: mylog
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+  client_attach(ch, sd, &cliAddr);
+
+  // a command left running by the previous client may still be finishing
+  service_input(ch);
+}
 
-	Allows switching between syslog and console output of messages.
+// makes sd the channel's client, from its own listener or a selector
 
-\*--------------------------------------------------------------------------*/
+void client_attach(CHANNEL *ch, int sd, struct sockaddr_in *addr) {
+  struct epoll_event ev;
 
-void mylog(int messtype, char *fmt, ...) {
-  char    s[VPB_MAX_STR];
-  va_list argptr;
+  ch->newSd = sd;
+  ch->cliAddr = *addr;
+  trace_add(ch - chans, TRACE_OPEN, 0, 0, NULL, 0);
 
-  va_start(argptr, fmt);
-  vsprintf(s, fmt, argptr);
-  va_end(argptr);
-  
-  if(syslog_enabled) {
-    syslog(messtype, s);
-  }
-  else {
-    printf("%s\n",s);
+  // stop listening until this client goes away
+  if (ch->sd != -1) {
+    ev.events = 0;
+    ev.data.u64 = ((unsigned long long)SRC_LISTEN << 32) | (ch - chans);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, ch->sd, &ev);
   }
 
+  ch->rcv_n = 0;
+  rcv_reserve(ch, RCV_INIT);
+  if (idle_ms)
+    wheel_add(&ch->idle, idle_ms);
+  ch->interest = EPOLLIN | EPOLLRDHUP;
+  ev.events = ch->interest;
+  ev.data.u64 = ((unsigned long long)SRC_CLIENT << 32) | (ch - chans);
+  epoll_ctl(epfd, EPOLL_CTL_ADD, ch->newSd, &ev);
 }
 
 /*--------------------------------------------------------------------------*\
 
-	FUNCTION....: trim
-	AUTHOR......: David Rowe
-	DATE CREATED: 10/10/01
+	FUNCTION....: selector_accept
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
 
-	Removes the last 'lose' samples from an audio file.
+	Accepts a client on a select listener.  It is held in an UNBOUND slot
+	until it picks a channel with "ctchannel", followed by a line with
+	<board>:<channel> or "any".  The reply is "OK <board>:<channel>", or
+	ERROR if that channel is taken or not on this listener, and from
+	then on the client talks to the channel as if it had connected to
+	the channel's own port.
 
 \*--------------------------------------------------------------------------*/
 
-void trim(char *audio_file, int lose) {
-	void               *wr,*rd;
-	char               buf[N];
-	short unsigned int mode;
-	long unsigned int  size,i;
-	char               tmp_file[VPB_MAX_STR], tmp_ext[VPB_MAX_STR], *p;
-	int                ret;
-
-	// generate tmp file name
-	strcpy(tmp_file, audio_file);
-	sprintf(tmp_ext, ".%d", rand());
-	p = strchr(tmp_file, '.');
-	if (p == NULL) {
-		// no ext on audio_file, add new one
-		strcat(tmp_file, tmp_ext);
-	}
-	else {
-		// replace existing ext
-		*p = 0;
-		strcat(tmp_file, tmp_ext);
-	}
+void selector_accept(int sel) {
+  struct epoll_event ev;
+  struct sockaddr_in cliAddr;
+  socklen_t          cliLen;
+  int                sd, i;
+  UNBOUND            *u;
 
-	ret = vpb_wave_open_read(&rd, audio_file);
-	if (ret < 0) {
-		mylog(LOG_INFO,"trim: error opening %s",audio_file);
-		return;
-	}
-		
-	vpb_wave_get_mode(rd, &mode);
-	wave_get_size(rd, &size);
-
-	ret = vpb_wave_open_write(&wr, tmp_file, mode);
-	if (ret < 0) {
-		mylog(LOG_INFO,"trim: error opening temp file %s",tmp_file);
-		return;
+  cliLen = sizeof(cliAddr);
+  sd = accept(selectors[sel].sd, (struct sockaddr *) &cliAddr, &cliLen);
+  if(sd<0) {
+    if (errno != EAGAIN)
+      mylog(LOG_ERR,"cannot accept connection %s", strerror(errno));
+    return;
+  }
+  fcntl(sd, F_SETFL, O_NONBLOCK);
+
+  for(i=0; (i<nunbound) && (unbound[i].sd != -1); i++);
+  if (i == nunbound) {
+    unbound = (UNBOUND*)realloc(unbound, (nunbound+1)*sizeof(UNBOUND));
+    nunbound++;
+  }
+  u = &unbound[i];
+  u->sd = sd;
+  u->sel = sel;
+  u->want_arg = 0;
+  u->cliAddr = cliAddr;
+  u->rcv_n = 0;
+
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.u64 = ((unsigned long long)SRC_UNBOUND << 32) | i;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, sd, &ev);
+}
+
+void unbound_read(UNBOUND *u) {
+  char *line, *end;
+  int  n, len;
+
+  if (u->sd == -1)
+    return;
+  if (u->rcv_n == MAX_UNBOUND) {
+    unbound_close(u);
+    return;
+  }
+
+  n = recv(u->sd, u->rcv_msg+u->rcv_n, MAX_UNBOUND-u->rcv_n, 0);
+  if (n<0) {
+    if ((errno == EAGAIN) || (errno == EINTR))
+      return;
+    unbound_close(u);
+    return;
+  } else if (n==0) {
+    unbound_close(u);
+    return;
+  }
+  u->rcv_n += n;
+
+  while((end = (char*)memchr(u->rcv_msg, END_LINE, u->rcv_n)) != NULL) {
+    *end = 0;
+    line = u->rcv_msg;
+    len = end - line + 1;
+
+    if (u->want_arg) {
+      u->want_arg = 0;
+      if (unbound_bind(u, line) == SUCCESS)
+	return;
+      send(u->sd, "ERROR\n", 7, MSG_NOSIGNAL);
+    }
+    else if (strcmp(line, "ctchannel") == 0)
+      u->want_arg = 1;
+    else
+      send(u->sd, "ERROR\n", 7, MSG_NOSIGNAL);
+
+    u->rcv_n -= len;
+    memmove(u->rcv_msg, u->rcv_msg+len, u->rcv_n);
+  }
+}
+
+// hands the client over to the channel it asked for
+
+int unbound_bind(UNBOUND *u, const char *which) {
+  struct epoll_event ev;
+  SELECTOR           *sel = &selectors[u->sel];
+  CHANNEL            *ch;
+  char               s[CT_MAX_STR];
+  int                i, k, board, channel, len;
+
+  k = -1;
+  if (strcmp(which, "any") == 0) {
+    for(i=0; i<sel->n; i++) {
+      ch = &chans[sel->chan[i]];
+      if ((ch->h >= 0) && (ch->newSd == -1) && (ch->cmd != CMD_CAMPCALL)) {
+	k = sel->chan[i];
+	break;
+      }
+    }
+  }
+  else if (sscanf(which, "%d:%d", &board, &channel) == 2) {
+    for(i=0; i<sel->n; i++) {
+      ch = &chans[sel->chan[i]];
+      if ((ch->board == board) && (ch->channel == channel) &&
+	  (ch->h >= 0) && (ch->newSd == -1))
+	k = sel->chan[i];
+    }
+  }
+  if (k == -1)
+    return ERROR;
+
+  ch = &chans[k];
+  sprintf(s, "OK %d:%d\n", ch->board, ch->channel);
+  send(u->sd, s, strlen(s)+1, MSG_NOSIGNAL);
+  mylog(LOG_INFO,"[%02d] client on port TCP %u is %d:%d", ch->h, sel->port,
+	ch->board, ch->channel);
+
+  epoll_ctl(epfd, EPOLL_CTL_DEL, u->sd, &ev);
+  client_attach(ch, u->sd, &u->cliAddr);
+
+  // anything sent after the channel line is for the channel
+  len = strlen(u->rcv_msg) + 1;
+  rcv_reserve(ch, u->rcv_n - len + 1);
+  ch->rcv_n = u->rcv_n - len;
+  memcpy(ch->rcv_msg, u->rcv_msg+len, ch->rcv_n);
+  u->sd = -1;
+
+  service_input(ch);
+  return SUCCESS;
+}
+
+void unbound_close(UNBOUND *u) {
+  struct epoll_event ev;
+
+  epoll_ctl(epfd, EPOLL_CTL_DEL, u->sd, &ev);
+  close(u->sd);
+  u->sd = -1;
+}
+
+// ctserver -campaign port, and the timer the scheduler wakes up with
+
+int campaign_listen(int port) {
+  wheel_timer_init(&camp_timer, campaign_timeout, NULL);
+  camp_sd = listen_socket(port, (unsigned long long)SRC_CAMPAIGN << 32);
+  if (camp_sd == -1)
+    return ERROR;
+
+  mylog(LOG_INFO,"waiting for campaigns on port TCP %u", port);
+  return SUCCESS;
+}
+
+void campaign_accept() {
+  struct epoll_event ev;
+  struct sockaddr_in cliAddr;
+  socklen_t          cliLen;
+  CAMP_CLIENT        *cc;
+  int                sd, k;
+
+  cliLen = sizeof(cliAddr);
+  sd = accept(camp_sd, (struct sockaddr *) &cliAddr, &cliLen);
+  if(sd<0) {
+    if (errno != EAGAIN)
+      mylog(LOG_ERR,"cannot accept connection %s", strerror(errno));
+    return;
+  }
+  fcntl(sd, F_SETFL, O_NONBLOCK);
+
+  for(k=0; (k<ncampclients) && (campclients[k].sd != -1); k++);
+  if (k == ncampclients) {
+    campclients = (CAMP_CLIENT*)realloc(campclients,
+				       (ncampclients+1)*sizeof(CAMP_CLIENT));
+    ncampclients++;
+  }
+  cc = &campclients[k];
+  memset(cc, 0, sizeof(CAMP_CLIENT));
+  cc->sd = sd;
+  cc->cliAddr = cliAddr;
+  cc->rcv_msg = (char*)malloc(MAX_LINE);
+  cc->interest = EPOLLIN | EPOLLRDHUP;
+
+  ev.events = cc->interest;
+  ev.data.u64 = ((unsigned long long)SRC_CAMPCLIENT << 32) | k;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, sd, &ev);
+  mylog(LOG_INFO,"campaign client %d from %s:TCP%d", k,
+	inet_ntoa(cliAddr.sin_addr), ntohs(cliAddr.sin_port));
+}
+
+void campaign_read(int k) {
+  CAMP_CLIENT *cc = &campclients[k];
+  char        *line, *end;
+  int         n, start;
+
+  if (cc->rcv_n == MAX_LINE) {
+    mylog(LOG_ERR,"campaign client %d: line too long", k);
+    campaign_close(k);
+    return;
+  }
+
+  n = recv(cc->sd, cc->rcv_msg+cc->rcv_n, MAX_LINE-cc->rcv_n, 0);
+  if (n<0) {
+    if ((errno == EAGAIN) || (errno == EINTR))
+      return;
+    campaign_close(k);
+    return;
+  } else if (n==0) {
+    campaign_close(k);
+    return;
+  }
+  cc->rcv_n += n;
+
+  start = 0;
+  while((cc->sd != -1) &&
+	(end = (char*)memchr(cc->rcv_msg+start, END_LINE,
+			     cc->rcv_n-start)) != NULL) {
+    *end = 0;
+    line = cc->rcv_msg + start;
+    start = end - cc->rcv_msg + 1;
+    campaign_line(k, line);
+  }
+
+  if ((cc->sd != -1) && start) {
+    cc->rcv_n -= start;
+    memmove(cc->rcv_msg, cc->rcv_msg+start, cc->rcv_n);
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: campaign_line
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Takes a line from a campaign client, fields are separated by tabs:
+
+	  ctcampaign <name> <lines> <gap ms> <retries> <retry s> <digits>
+		     <prompt>...
+	    creates the client's campaign, or changes it.  At most <lines>
+	    calls at once, starting at least <gap ms> apart.  A busy,
+	    unanswered or dead line is tried <retries> more times, <retry s>
+	    apart.  Answered calls hear the prompts, then <digits> are
+	    collected if it isn't 0.
+
+	  ctcall <name> <number>...
+	    queues numbers to call, the reply has how many were queued
+
+	  ctcancel <name>
+	    drops the numbers not yet called, the reply has how many
+
+	Replies are "OK[\t<n>]" or "ERROR".  Results come whenever a call
+	ends, as "CALL <name> <number> <result> <attempts> <board:channel>
+	<digits>", result being ANSWERED, BUSY, NOANSWER, NODIALTONE or
+	ERROR, then "DONE <name> <answered> <failed>" once nothing is left
+	to call.  A client's campaigns end when it disconnects.
+
+\*--------------------------------------------------------------------------*/
+
+void campaign_line(int k, char *line) {
+  char     *f[CAMP_FIELDS], *p, *next, s[CT_MAX_STR];
+  CAMPAIGN *c;
+  int      n, queued, taken;
+
+  mylog(LOG_INFO,"campaign client %d: %.*s", k, MAX_MSG, line);
+
+  if (strncmp(line, "ctcall\t", 7) == 0) {
+    p = line + 7;
+    next = strchr(p, '\t');
+    if (next)
+      *next++ = 0;
+    c = camp_find(p, k, &taken);
+    if (c == NULL) {
+      campaign_send(k, "ERROR\n");
+      return;
+    }
+    for(queued=0, p=next; p; p=next) {
+      if ((next = strchr(p, '\t')) != NULL)
+	*next++ = 0;
+      if (camp_add(c, p) == CT_OK)
+	queued++;
+    }
+    sprintf(s, "OK\t%d\n", queued);
+    campaign_send(k, s);
+    campaign_kick();
+    return;
+  }
+
+  n = split_fields(line, f, CAMP_FIELDS);
+  if ((strcmp(f[0], "ctcampaign") == 0) && (n >= 8) &&
+      (camp_set(f[1], k, atoi(f[2]), atoi(f[3]), atoi(f[4]),
+		atoi(f[5])*SEC2MS, atoi(f[6]), (const char**)f+7,
+		n-7) == CT_OK)) {
+    campaign_send(k, "OK\n");
+    campaign_kick();
+  }
+  else if ((strcmp(f[0], "ctcancel") == 0) && (n == 2) &&
+	   (c = camp_find(f[1], k, &taken)) != NULL) {
+    sprintf(s, "OK\t%d\n", camp_cancel(c));
+    n = strlen(s);
+    if (camp_idle(c))
+      sprintf(s+n, "DONE\t%s\t%lu\t%lu\n", c->name, c->answered,
+	      c->failed);
+    campaign_send(k, s);
+  }
+  else
+    campaign_send(k, "ERROR\n");
+}
+
+// queues output for a campaign client, one that falls OUT_MAX behind is
+// dropped
+
+void campaign_send(int k, const char *s) {
+  CAMP_CLIENT *cc = &campclients[k];
+  OUTBUF      *b;
+  long        n = strlen(s);
+
+  if (cc->sd == -1)
+    return;
+  if (cc->out_bytes + n > OUT_MAX) {
+    mylog(LOG_ERR,"campaign client %d isn't reading", k);
+    campaign_close(k);
+    return;
+  }
+
+  b = (OUTBUF*)malloc(sizeof(OUTBUF) + n);
+  memcpy(b->data, s, n);
+  b->n = n;
+  b->off = 0;
+  b->next = NULL;
+  if (cc->out_tail)
+    cc->out_tail->next = b;
+  else
+    cc->out_head = b;
+  cc->out_tail = b;
+  cc->out_bytes += n;
+
+  campaign_flush(k);
+}
+
+void campaign_flush(int k) {
+  CAMP_CLIENT        *cc = &campclients[k];
+  struct epoll_event ev;
+  OUTBUF             *b;
+  long               n;
+
+  while((b = cc->out_head) != NULL) {
+    n = send(cc->sd, b->data+b->off, b->n-b->off, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      if (errno != EAGAIN) {
+	campaign_close(k);
+	return;
+      }
+      break;
+    }
+    cc->out_bytes -= n;
+    b->off += n;
+    if (b->off < b->n)
+      break;
+    if ((cc->out_head = b->next) == NULL)
+      cc->out_tail = NULL;
+    free(b);
+  }
+
+  ev.events = EPOLLIN | EPOLLRDHUP | (cc->out_head ? EPOLLOUT : 0);
+  if (ev.events != cc->interest) {
+    cc->interest = ev.events;
+    ev.data.u64 = ((unsigned long long)SRC_CAMPCLIENT << 32) | k;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, cc->sd, &ev);
+  }
+}
+
+void campaign_close(int k) {
+  CAMP_CLIENT        *cc = &campclients[k];
+  struct epoll_event ev;
+  OUTBUF             *b;
+
+  epoll_ctl(epfd, EPOLL_CTL_DEL, cc->sd, &ev);
+  close(cc->sd);
+  cc->sd = -1;
+  while((b = cc->out_head) != NULL) {
+    cc->out_head = b->next;
+    free(b);
+  }
+  free(cc->rcv_msg);
+  cc->rcv_msg = NULL;
+
+  camp_owner_gone(k);
+  mylog(LOG_INFO,"campaign client %d closed", k);
+}
+
+void client_read(CHANNEL *ch) {
+  int n, i;
+
+  if (rcv_reserve(ch, ch->rcv_n+1) != SUCCESS) {
+    mylog(LOG_ERR,"[%02d] line too long", ch->h);
+    client_close(ch);
+    return;
+  }
+
+  n = recv(ch->newSd, ch->rcv_msg+ch->rcv_n, ch->rcv_size-ch->rcv_n, 0);
+  if (n<0) {
+    if ((errno == EAGAIN) || (errno == EINTR))
+      return;
+    mylog(LOG_ERR,"[%02d] cannot receive data %s", ch->h, strerror(errno));
+    client_close(ch);
+    return;
+  } else if (n==0) {
+    client_close(ch);
+    return;
+  }
+
+  for(i=0; i<n; i+=TRACE_TEXT)
+    trace_add(ch - chans, TRACE_INPUT, 0, 0, ch->rcv_msg+ch->rcv_n+i, n-i);
+  ch->rcv_n += n;
+  if (idle_ms)
+    wheel_add(&ch->idle, idle_ms);
+  service_input(ch);
+}
+
+// makes room for n bytes of input, the buffer doubles as needed
+
+int rcv_reserve(CHANNEL *ch, int n) {
+  int size;
+
+  if (n <= ch->rcv_size)
+    return SUCCESS;
+  if (n > MAX_LINE)
+    return ERROR;
+
+  size = ch->rcv_size ? ch->rcv_size : RCV_INIT;
+  while(size < n)
+    size *= 2;
+  if (size > MAX_LINE)
+    size = MAX_LINE;
+  ch->rcv_msg = (char*)realloc(ch->rcv_msg, size);
+  ch->rcv_size = size;
+
+  return SUCCESS;
+}
+
+void client_close(CHANNEL *ch) {
+  struct epoll_event ev;
+
+  trace_add(ch - chans, TRACE_CLOSE, 0, 0, NULL, 0);
+  wheel_cancel(&ch->idle);
+  epoll_ctl(epfd, EPOLL_CTL_DEL, ch->newSd, &ev);
+  close(ch->newSd);
+  ch->newSd = -1;
+  ch->rcv_n = 0;
+  out_free(ch);
+  pending_free(ch);
+  abort_command(ch);
+  ch->proto = 1;
+  ch->cancelled = 0;
+  ch->rec_mode = CARD_MODE;
+  ch->rec_rate = CARD_RATE;
+  ch->vad_on = 0;
+
+  if (ch->sd != -1) {
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((unsigned long long)SRC_LISTEN << 32) | (ch - chans);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, ch->sd, &ev);
+  }
+
+  mylog(LOG_INFO,"[%02d] connection closed!",ch->h);
+
+  // the channel may be free for campaign calls again
+  campaign_kick();
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: service_input
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Processes complete lines in the client's input buffer.  For version
+	1 clients, lines that arrive while a command is running are left in
+	the buffer until the command finishes, which preserves the
+	one-command-at-a-time protocol.  Version 2 lines are always read, and
+	queued until the port is free.
+
+\*--------------------------------------------------------------------------*/
+
+void service_input(CHANNEL *ch) {
+  char               *line, *end;
+  int                start, busy;
+
+  // lines are handled where they lie, and the buffer is shuffled down
+  // once at the end
+  start = 0;
+  while(ch->newSd != -1) {
+    busy = (ch->proto == 1) && (ch->cmd != CMD_NONE) && (ch->nargs == 0);
+    if (busy)
+      break;
+
+    line = ch->rcv_msg + start;
+    end = (char*)memchr(line, END_LINE, ch->rcv_n - start);
+    if (end == NULL)
+      break;
+    *end = 0;
+    start = end - ch->rcv_msg + 1;
+
+    if (ch->proto == 2)
+      v2_line(ch, line);
+    else
+      process_line(ch, line);
+  }
+
+  if ((ch->newSd != -1) && start) {
+    ch->rcv_n -= start;
+    memmove(ch->rcv_msg, ch->rcv_msg+start, ch->rcv_n);
+  }
+
+  if (ch->proto == 2)
+    v2_next(ch);
+  set_interest(ch);
+}
+
+// stop reading if the buffer fills up while a command is running,
+// otherwise epoll would keep reporting the socket as readable.  Ask to
+// hear when the socket is writable only while output is queued.
+
+void set_interest(CHANNEL *ch) {
+  struct epoll_event ev;
+  unsigned int       interest;
+  int                busy;
+
+  if (ch->newSd == -1)
+    return;
+
+  busy = (ch->proto == 1) && (ch->cmd != CMD_NONE) && (ch->nargs == 0);
+  interest = EPOLLRDHUP;
+  if (!busy || (ch->rcv_n < ch->rcv_size))
+    interest |= EPOLLIN;
+  if (ch->out_head)
+    interest |= EPOLLOUT;
+  if (interest != ch->interest) {
+    ch->interest = interest;
+    ev.events = interest;
+    ev.data.u64 = ((unsigned long long)SRC_CLIENT << 32) | (ch - chans);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, ch->newSd, &ev);
+  }
+}
+
+// either starts a new command, or stores an argument for the current one
+
+void process_line(CHANNEL *ch, char *line) {
+
+  // arguments are at most MAX_MSG-1 characters
+  if (strlen(line) >= MAX_MSG)
+    line[MAX_MSG-1] = 0;
+
+  if (ch->cmd != CMD_NONE) {
+    if ((ch->cmd == CMD_PLAYLIST) && (ch->argc > 0)) {
+      if (ch->nlist < MAX_PLAYLIST)
+	strcpy(ch->list[ch->nlist], line);
+      ch->nlist++;
+    }
+    else if ((ch->cmd == CMD_RUNSCRIPT) && (ch->argc > 0))
+      script_add(ch, line);
+    else
+      strcpy(ch->arg[ch->argc], line);
+    ch->argc++;
+    ch->nargs--;
+
+    // first argument of ctplaylist is the number of files that follow
+    if ((ch->cmd == CMD_PLAYLIST) && (ch->argc == 1)) {
+      ch->nargs = atoi(line);
+      if (ch->nargs < 0)
+	ch->nargs = 0;
+      ch->nlist = 0;
+    }
+
+    // and of ctrunscript the number of lines, unless this is the answer
+    // to a callout
+    if ((ch->cmd == CMD_RUNSCRIPT) && (ch->argc == 1) && !ch->prog) {
+      ch->nargs = atoi(line);
+      if (ch->nargs < 0)
+	ch->nargs = 0;
+      if (ch->nargs > MAX_SCRIPT)
+	ch->nargs = MAX_SCRIPT;
+      ch->src_n = 0;
+    }
+
+    if (ch->nargs == 0)
+      run_command(ch);
+    return;
+  }
+
+  mylog(LOG_INFO,"[%02d] received from %s:TCP%d : %s", ch->h,
+	inet_ntoa(ch->cliAddr.sin_addr),
+	ntohs(ch->cliAddr.sin_port), line);
+
+  ch->argc = 0;
+  ch->cmd = lookup_command(line, &ch->nargs);
+  if ((ch->cmd != CMD_NONE) && (ch->nargs == 0))
+    run_command(ch);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: command_init
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Fills in the hash table lookup_command uses, so finding a command
+	costs one hash and one strcmp however many commands there are.  If a
+	new command collides we stop here, change COMMAND_MUL until it
+	doesn't.
+
+\*--------------------------------------------------------------------------*/
+
+static unsigned int command_hash_of(const char *name) {
+  unsigned int h = 0;
+
+  while(*name)
+    h = h*COMMAND_MUL + (unsigned char)*name++;
+
+  return h % COMMAND_HASH;
+}
+
+void command_init() {
+  COMMAND      *c;
+  unsigned int h;
+
+  for(c=commands; c->name; c++) {
+    h = command_hash_of(c->name);
+    if (command_hash[h]) {
+      mylog(LOG_ERR,"commands %s and %s collide", c->name,
+	    command_hash[h]->name);
+      exit(-1);
+    }
+    command_hash[h] = c;
+  }
+}
+
+// returns CMD_xxx for a command name, and how many arguments it takes
+
+int lookup_command(const char *name, int *nargs) {
+  COMMAND *c = command_hash[command_hash_of(name)];
+
+  if (c && (strcmp(c->name, name) == 0)) {
+    *nargs = c->nargs;
+    return c->cmd;
+  }
+
+  *nargs = 0;
+  return CMD_NONE;
+}
+
+// starts a command once all of its arguments have arrived
+
+void run_command(CHANNEL *ch) {
+
+  // the answer to a script's callout, the script carries on
+  if ((ch->cmd == CMD_RUNSCRIPT) && ch->prog) {
+    ivr_resume(ch, ch->arg[0]);
+    return;
+  }
+
+  ch->run_cmd = ch->cmd;
+  ch->run_start = stats_now_us();
+  stats_command_start(ch - chans);
+  start_command(ch);
+}
+
+// runs the handler for ch->cmd, then gives it any events it has missed.
+// Scripts start their steps here too.
+
+void start_command(CHANNEL *ch) {
+
+  switch(ch->cmd) {
+  case CMD_WAITFORRING:
+    ctwaitforring(ch);
+    break;
+  case CMD_WAITFORDIAL:
+    ctwaitfordial(ch);
+    break;
+  case CMD_HANGUP:
+    ct->sethook(ch->h,CT_ONHOOK);
+    ch->nretained = 0;
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+    break;
+  case CMD_ANSWER:
+    ct->sethook(ch->h,CT_OFFHOOK);
+    ch->nretained = 0;
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+    break;
+  case CMD_PLAY:
+    strcpy(ch->list[0], ch->arg[0]);
+    ch->nlist = 1;
+    ctplay(ch);
+    break;
+  case CMD_PLAYLIST:
+    ctplay(ch);
+    break;
+  case CMD_SAYNUMBER:
+    ctsay(ch, SAY_NUMBER);
+    break;
+  case CMD_SAYDIGITS:
+    ctsay(ch, SAY_DIGITS);
+    break;
+  case CMD_SPELL:
+    ctsay(ch, SAY_SPELL);
+    break;
+  case CMD_SAYDATE:
+    ctsay(ch, SAY_DATE);
+    break;
+  case CMD_RECORD:
+    ctrecord(ch);
+    break;
+  case CMD_RECORDSTREAM:
+    ctrecordstream(ch);
+    break;
+  case CMD_RECORDFORMAT:
+    ctrecordformat(ch);
+    break;
+  case CMD_RECORDVAD:
+    ctrecordvad(ch);
+    break;
+  case CMD_CONFERENCE:
+    ctconference(ch, MAX_CONFERENCE);
+    break;
+  case CMD_BRIDGE:
+    ctconference(ch, 2);
+    break;
+  case CMD_SLEEP:
+    ctsleep(ch);
+    break;
+  case CMD_CLEAR:
+    ch->ndtmf = 0;
+    ch->nretained = 0;
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+    break;
+  case CMD_COLLECT:
+    ctcollect(ch);
+    break;
+  case CMD_DIAL:
+    ctdial(ch);
+    break;
+  case CMD_PROTOCOL:
+    ch->cmd = CMD_NONE;
+    if ((strcmp(ch->arg[0], "2") == 0) && (ch->proto == 1)) {
+      // no NUL, version 2 replies never have one
+      ch->proto = 2;
+      command_done(ch, 0);
+      if (ch->newSd != -1)
+	out_queue(ch, "OK 2\n", 5, NULL, 0, NULL, 0);
+    }
+    else if ((strcmp(ch->arg[0], "1") == 0) ||
+	     (strcmp(ch->arg[0], "2") == 0)) {
+      sprintf(ch->smess, "OK %s\n", ch->arg[0]);
+      reply(ch, ch->smess);
+      ch->proto = atoi(ch->arg[0]);
+    }
+    else
+      reply(ch, "ERROR\n");
+    break;
+  case CMD_RUNSCRIPT:
+    ctrunscript(ch);
+    break;
+  }
+
+  if ((ch->cmd != CMD_NONE) && ch->nretained)
+    replay_retained(ch);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: v2_line
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Takes a version 2 line, "<id>\t<command>[\t<arg>...]".  cancel is
+	acted on straight away, anything else joins the queue of commands
+	waiting for the port.
+
+\*--------------------------------------------------------------------------*/
+
+void v2_line(CHANNEL *ch, char *line) {
+  char    *f[3];
+  int     n;
+  PENDING *p;
+
+  // keep a copy for the queue, the line itself is split up in place
+  p = (PENDING*)malloc(sizeof(PENDING) + strlen(line));
+  strcpy(p->line, line);
+  p->next = NULL;
+
+  n = split_fields(line, f, 3);
+  if ((n < 2) || (strlen(f[0]) >= MAX_ID)) {
+    mylog(LOG_ERR,"[%02d] bad request: %s", ch->h, p->line);
+    reply_id(ch, "?", "ERROR\n");
+    free(p);
+    return;
+  }
+
+  if (strcmp(f[1], "cancel") == 0) {
+    v2_cancel(ch, f[0], (n > 2) ? f[2] : "");
+    free(p);
+    return;
+  }
+
+  // the answer to a callout from the running script
+  if (strcmp(f[1], "resume") == 0) {
+    if ((ch->cmd == CMD_RUNSCRIPT) && (ch->state == SCRIPT_CALLOUT) &&
+	(strcmp(ch->id, f[0]) == 0))
+      ivr_resume(ch, (n > 2) ? f[2] : "");
+    else
+      reply_id(ch, f[0], "ERROR\n");
+    free(p);
+    return;
+  }
+
+  if (ch->npend == MAX_PENDING) {
+    reply_id(ch, f[0], "ERROR\n");
+    free(p);
+    return;
+  }
+
+  if (ch->pend_tail)
+    ch->pend_tail->next = p;
+  else
+    ch->pend_head = p;
+  ch->pend_tail = p;
+  ch->npend++;
+}
+
+// cancels the running or a queued command.  A running command is stopped
+// the same way as when its client goes away, and replies CANCELLED when
+// it has finished.
+
+void v2_cancel(CHANNEL *ch, const char *id, const char *target) {
+  PENDING *p, *prev;
+  char    tid[MAX_ID];
+
+  if ((ch->cmd != CMD_NONE) && (ch->cmd != CMD_CAMPCALL) &&
+      (strcmp(ch->id, target) == 0)) {
+    ch->cancelled = 1;
+    abort_command(ch);
+    if (ch->cmd == CMD_NONE)
+      reply(ch, "");
+    reply_id(ch, id, "OK\n");
+    return;
+  }
+
+  for(prev=NULL, p=ch->pend_head; p; prev=p, p=p->next) {
+    sscanf(p->line, "%15[^\t]", tid);
+    if (strcmp(tid, target) == 0) {
+      if (prev)
+	prev->next = p->next;
+      else
+	ch->pend_head = p->next;
+      if (ch->pend_tail == p)
+	ch->pend_tail = prev;
+      ch->npend--;
+      free(p);
+      reply_id(ch, target, "CANCELLED\n");
+      reply_id(ch, id, "OK\n");
+      return;
+    }
+  }
+
+  reply_id(ch, id, "ERROR\n");
+}
+
+// starts queued commands while the port is free
+
+void v2_next(CHANNEL *ch) {
+  PENDING *p;
+
+  while((ch->cmd == CMD_NONE) && (ch->proto == 2) && ch->pend_head) {
+    p = ch->pend_head;
+    ch->pend_head = p->next;
+    if (ch->pend_head == NULL)
+      ch->pend_tail = NULL;
+    ch->npend--;
+    v2_start(ch, p->line);
+    free(p);
+  }
+}
+
+// sets up the command, its id and arguments from a version 2 line and
+// runs it.  ctplaylist takes the files directly, without a count, and
+// ctrunscript a field for each line of the script.
+
+void v2_start(CHANNEL *ch, char *line) {
+  char *f[MAX_FIELDS+1], *s;
+  int  i, n, bad;
+
+  mylog(LOG_INFO,"[%02d] received from %s:TCP%d : %s", ch->h,
+	inet_ntoa(ch->cliAddr.sin_addr),
+	ntohs(ch->cliAddr.sin_port), line);
+
+  n = split_fields(line, f, MAX_FIELDS+1);
+  strcpy(ch->id, f[0]);
+  ch->cancelled = 0;
+  ch->cmd = lookup_command(f[1], &ch->nargs);
+  n -= 2;
+
+  bad = (ch->cmd == CMD_NONE);
+  for(i=0; i<n; i++)
+    if ((strlen(f[i+2]) >= MAX_MSG) && (ch->cmd != CMD_RUNSCRIPT))
+      bad = 1;
+  if (ch->cmd == CMD_PLAYLIST) {
+    if (n > MAX_PLAYLIST)
+      bad = 1;
+  }
+  else if ((n != ch->nargs) && (ch->cmd != CMD_RUNSCRIPT))
+    bad = 1;
+  if (bad) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "ERROR\n");
+    return;
+  }
+
+  if (ch->cmd == CMD_PLAYLIST) {
+    for(i=0; i<n; i++)
+      strcpy(ch->list[i], f[i+2]);
+    ch->nlist = n;
+    sprintf(ch->arg[0], "%d", n);
+    ch->argc = 1;
+  }
+  else if (ch->cmd == CMD_RUNSCRIPT) {
+    // lines past MAX_FIELDS are still in the last field, tab separated
+    ch->src_n = 0;
+    for(i=0; i<n; i++) {
+      for(s=f[i+2]; (s = strchr(s, '\t')) != NULL; )
+	*s = '\n';
+      script_add(ch, f[i+2]);
+    }
+    ch->argc = 0;
+  }
+  else {
+    for(i=0; i<n; i++)
+      strcpy(ch->arg[i], f[i+2]);
+    ch->argc = n;
+  }
+  ch->nargs = 0;
+
+  run_command(ch);
+}
+
+// unsolicited events for version 2 clients, sent whatever is running
+
+void v2_event(CHANNEL *ch, CT_EVENT *e) {
+  static const char *tones[] = {"dial", "ringback", "busy", "grunt"};
+  char s[CT_MAX_STR];
+
+  switch(e->type) {
+  case CT_RING:
+    reply_id(ch, "*", "RING\n");
+    break;
+  case CT_DTMF:
+    sprintf(s, "DTMF\t%c\n", e->data);
+    reply_id(ch, "*", s);
+    break;
+  case CT_TONEDETECT:
+    if ((e->data >= CT_TONE_DIAL) && (e->data <= CT_TONE_GRUNT)) {
+      sprintf(s, "TONE\t%s\n", tones[e->data - CT_TONE_DIAL]);
+      reply_id(ch, "*", s);
+    }
+    break;
+  }
+}
+
+void pending_free(CHANNEL *ch) {
+  PENDING *p;
+
+  while((p = ch->pend_head) != NULL) {
+    ch->pend_head = p->next;
+    free(p);
+  }
+  ch->pend_tail = NULL;
+  ch->npend = 0;
+}
+
+// splits a line at tabs in place, returns the number of fields
+
+int split_fields(char *line, char **f, int max) {
+  int  n = 0;
+  char *p = line;
+
+  while(n < max) {
+    f[n++] = p;
+    p = strchr(p, '\t');
+    if (p == NULL)
+      break;
+    *p++ = 0;
+  }
+
+  return n;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: dispatch_event
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Hands a hardware event to the state machine of the command running on
+	that port.  RING, DTMF and tones the command doesn't want, or that
+	arrive while the port is idle, are kept for the next command, e.g.
+	a key pressed between two prompts stops the second.  Other events
+	that arrive while a port is idle are logged and discarded.
+
+\*--------------------------------------------------------------------------*/
+
+void dispatch_event(CHANNEL *ch, CT_EVENT *e) {
+
+  log_event(LOG_INFO, e);
+  trace_add(ch - chans, TRACE_EVENT, e->type, e->data, NULL, 0);
+
+  // the end of a CID stream only matters to ctwaitforring, it mustn't end
+  // a later command
+  if ((e->type == CT_RECORDEND) && ch->cid_streaming) {
+    ch->cid_streaming = 0;
+    if (ch->cmd == CMD_WAITFORRING)
+      ctwaitforring_event(ch, e);
+    service_input(ch);
+    return;
+  }
+
+  if ((ch->proto == 2) && (ch->newSd != -1))
+    v2_event(ch, e);
+  if (e->type == CT_DTMF)
+    dtmf_push(ch, e->data);
+
+  if (event_wanted(ch, e))
+    deliver_event(ch, e);
+  else
+    retain_event(ch, e);
+
+  // command may have finished, move on to anything the client has queued
+  service_input(ch);
+}
+
+void deliver_event(CHANNEL *ch, CT_EVENT *e) {
+
+  switch(ch->cmd) {
+  case CMD_WAITFORRING:
+    ctwaitforring_event(ch, e);
+    break;
+  case CMD_WAITFORDIAL:
+    ctwaitfordial_event(ch, e);
+    break;
+  case CMD_PLAY:
+  case CMD_PLAYLIST:
+  case CMD_SAYNUMBER:
+  case CMD_SAYDIGITS:
+  case CMD_SPELL:
+  case CMD_SAYDATE:
+    ctplay_event(ch, e);
+    break;
+  case CMD_RECORD:
+  case CMD_RECORDSTREAM:
+    ctrecord_event(ch, e);
+    break;
+  case CMD_CONFERENCE:
+  case CMD_BRIDGE:
+    ctconference_event(ch, e);
+    break;
+  case CMD_SLEEP:
+    ctsleep_event(ch, e);
+    break;
+  case CMD_COLLECT:
+    ctcollect_event(ch, e);
+    break;
+  case CMD_DIAL:
+    ctdial_event(ch, e);
+    break;
+  case CMD_CAMPCALL:
+    campaign_event(ch, e);
+    break;
+  }
+}
+
+// RING, DTMF and tones are only wanted by some commands, anything else
+// belongs to whatever is running
+
+int event_wanted(CHANNEL *ch, CT_EVENT *e) {
+
+  switch(e->type) {
+  case CT_RING:
+    return ch->cmd == CMD_WAITFORRING;
+  case CT_TONEDETECT:
+    return (ch->cmd == CMD_WAITFORDIAL) || (ch->cmd == CMD_CAMPCALL);
+  case CT_DTMF:
+    switch(ch->cmd) {
+    case CMD_PLAY:
+    case CMD_PLAYLIST:
+    case CMD_SAYNUMBER:
+    case CMD_SAYDIGITS:
+    case CMD_SPELL:
+    case CMD_SAYDATE:
+    case CMD_RECORD:
+    case CMD_RECORDSTREAM:
+    case CMD_CONFERENCE:
+    case CMD_BRIDGE:
+    case CMD_SLEEP:
+    case CMD_COLLECT:
+    case CMD_CAMPCALL:
+      return 1;
+    }
+    return 0;
+  }
+
+  return 1;
+}
+
+static unsigned long long now_ms() {
+  struct timespec ts;
+
+  if (replaying)
+    return replay_ms;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+void retain_event(CHANNEL *ch, CT_EVENT *e) {
+
+  if ((e->type != CT_RING) && (e->type != CT_DTMF) &&
+      (e->type != CT_TONEDETECT))
+    return;
+
+  // oldest goes if we are full
+  if (ch->nretained == MAX_RETAINED) {
+    ch->nretained--;
+    memmove(ch->retained, ch->retained+1, ch->nretained*sizeof(CT_EVENT));
+    memmove(ch->retained_at, ch->retained_at+1,
+	    ch->nretained*sizeof(unsigned long long));
+  }
+  ch->retained[ch->nretained] = *e;
+  ch->retained_at[ch->nretained++] = now_ms();
+}
+
+// offers kept events to a command that has just started, in the order
+// they arrived.  Ones it doesn't want stay for the next command.
+
+void replay_retained(CHANNEL *ch) {
+  unsigned long long now = now_ms();
+  CT_EVENT           e;
+  int                i, n;
+
+  for(i=0, n=0; i<ch->nretained; i++) {
+    e = ch->retained[i];
+    if (now - ch->retained_at[i] > RETAIN_MS)
+      continue;
+    if ((ch->cmd != CMD_NONE) && event_wanted(ch, &e)) {
+      deliver_event(ch, &e);
+      continue;
+    }
+    ch->retained[n] = e;
+    ch->retained_at[n++] = ch->retained_at[i];
+  }
+  ch->nretained = n;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: abort_command
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Called when the client goes away mid-command.  Play and record are
+	terminated and left to finish through their normal end events, so
+	the recorded file is still trimmed and streamed audio still in
+	flight is thrown away.  Commands that may wait forever
+	are ended immediately.  A campaign call isn't the client's, it
+	carries on to the end.  A script stops, and the step it was
+	running is aborted like a command.
+
+\*--------------------------------------------------------------------------*/
+
+void abort_command(CHANNEL *ch) {
+
+  if (ch->prog)
+    ivr_stop(ch);
+
+  if (ch->nargs != 0) {
+    ch->cmd = CMD_NONE;
+    return;
+  }
+
+  switch(ch->cmd) {
+  case CMD_PLAY:
+  case CMD_PLAYLIST:
+  case CMD_SAYNUMBER:
+  case CMD_SAYDIGITS:
+  case CMD_SPELL:
+  case CMD_SAYDATE:
+    if (ch->state == PLAYING)
+      ct->play_terminate(ch->h);
+    ch->state = WAIT_FOR_PLAYEND;
+    break;
+  case CMD_RECORD:
+    if (ch->state == RECORDING)
+      ct->record_terminate(ch->h);
+    if (ch->state != RECORD_POST)
+      ch->state = WAIT_FOR_RECORDEND;
+    break;
+  case CMD_RECORDSTREAM:
+    if (ch->state == RECORDING)
+      ct->record_terminate(ch->h);
+    ch->state = STREAM_ABORTED;
+    break;
+  case CMD_CONFERENCE:
+  case CMD_BRIDGE:
+    if (ch->state == CONFERENCING)
+      conf_leave(ch);
+    break;
+  case CMD_WAITFORRING:
+    wheel_cancel(&ch->timer);
+    if (ch->cid_streaming)
+      ct->record_terminate(ch->h);
+    ch->cmd = CMD_NONE;
+    break;
+  case CMD_SLEEP:
+  case CMD_COLLECT:
+    wheel_cancel(&ch->timer);
+    ch->cmd = CMD_NONE;
+    break;
+  case CMD_WAITFORDIAL:
+  case CMD_DIAL:
+  case CMD_RUNSCRIPT:
+    ch->cmd = CMD_NONE;
+    break;
+  }
+}
+
+// sends a reply to the client, if it is still connected.  The reply to a
+// script's step goes to the script instead.
+
+void reply(CHANNEL *ch, const char *s) {
+  if (ch->ivr_step) {
+    ivr_reply(ch, s);
+    return;
+  }
+
+  command_done(ch, strncmp(s, "ERROR", 5) == 0);
+  if (ch->newSd == -1) {
+    // the client has gone, so the channel may be free for campaigns
+    campaign_kick();
+    return;
+  }
+
+  if (ch->proto == 2)
+    reply_id(ch, ch->id, ch->cancelled ? "CANCELLED\n" : s);
+  else {
+    reply_sent(ch, s, strlen(s));
+    out_queue(ch, s, strlen(s)+1, NULL, 0, NULL, 0);
+  }
+}
+
+// every command ends with a reply, which is when it is timed
+
+void command_done(CHANNEL *ch, int error) {
+  if (ch->run_cmd == CMD_NONE)
+    return;
+  stats_command_done(ch - chans, ch->run_cmd, stats_now_us() - ch->run_start,
+		     error);
+  ch->run_cmd = CMD_NONE;
+}
+
+// version 2 reply or event, tagged with an id rather than NUL terminated
+
+void reply_id(CHANNEL *ch, const char *id, const char *s) {
+  char hdr[MAX_ID+1], sent[TRACE_TEXT+1];
+  int  hn;
+
+  hn = sprintf(hdr, "%s\t", id);
+  out_queue(ch, hdr, hn, s, strlen(s), NULL, 0);
+  reply_sent(ch, sent, snprintf(sent, sizeof(sent), "%s%s", hdr, s));
+}
+
+// every reply goes in the trace, and when replaying is kept to check
+// against the trace
+
+void reply_sent(CHANNEL *ch, const char *s, int n) {
+  TRACE_REC *r;
+
+  if (n > TRACE_TEXT)
+    n = TRACE_TEXT;
+  trace_add(ch - chans, TRACE_REPLY, 0, 0, s, n);
+  if (replaying && (nreplies < MAX_REPLIES)) {
+    r = &replies[nreplies++];
+    r->chan = ch - chans;
+    r->n = n;
+    memcpy(r->text, s, n);
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: out_queue
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Queues a header and up to two blocks of data for the client as one
+	OUTBUF, then sends what the socket will take.  Anything left over
+	is sent by out_flush when epoll says the socket is writable, so a
+	slow client never blocks the reactor.
+
+\*--------------------------------------------------------------------------*/
+
+void out_queue(CHANNEL *ch, const char *hdr, long hn, const char *buf1,
+	       long n1, const char *buf2, long n2) {
+  OUTBUF *b = (OUTBUF*)malloc(sizeof(OUTBUF) + hn + n1 + n2);
+
+  memcpy(b->data, hdr, hn);
+  if (n1)
+    memcpy(b->data+hn, buf1, n1);
+  if (n2)
+    memcpy(b->data+hn+n1, buf2, n2);
+  b->n = hn + n1 + n2;
+  b->off = 0;
+  b->next = NULL;
+
+  if (ch->out_tail)
+    ch->out_tail->next = b;
+  else
+    ch->out_head = b;
+  ch->out_tail = b;
+  ch->out_bytes += b->n;
+
+  out_flush(ch);
+}
+
+// sends as much queued output as the socket will take, OUT_IOV buffers
+// per writev.  SIGPIPE is ignored, so a client that has reset gives EPIPE.
+
+void out_flush(CHANNEL *ch) {
+  struct iovec iov[OUT_IOV];
+  OUTBUF       *b;
+  int          i;
+  long         n;
+
+  while(ch->out_head) {
+    for(i=0, b=ch->out_head; b && (i<OUT_IOV); i++, b=b->next) {
+      iov[i].iov_base = b->data + b->off;
+      iov[i].iov_len = b->n - b->off;
+    }
+
+    n = writev(ch->newSd, iov, i);
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      // if the client has gone the read side will notice
+      if (errno != EAGAIN)
+	out_free(ch);
+      break;
+    }
+
+    ch->out_bytes -= n;
+    while(ch->out_head && (n >= ch->out_head->n - ch->out_head->off)) {
+      b = ch->out_head;
+      n -= b->n - b->off;
+      ch->out_head = b->next;
+      free(b);
+    }
+    if (ch->out_head == NULL)
+      ch->out_tail = NULL;
+    else if (n) {
+      // socket is full
+      ch->out_head->off += n;
+      break;
+    }
+  }
+
+  set_interest(ch);
+}
+
+void out_free(CHANNEL *ch) {
+  OUTBUF *b;
+
+  while((b = ch->out_head) != NULL) {
+    ch->out_head = b->next;
+    free(b);
+  }
+  ch->out_tail = NULL;
+  ch->out_bytes = 0;
+}
+
+/*---------------------------------------------------------------------------*\
+
+	FUNCTION: digit_match
+	AUTHOR..: David Rowe
+	DATE....: 29/7/98
+
+	Determines if the digit is a member of the term_digit string.
+
+\*--------------------------------------------------------------------------*/
+
+static int digit_match(char digit, char *term_digits)
+{
+	char *p = term_digits;
+
+	while(*p != 0) {
+		if (*p == digit)
+			return(1);
+		p++;
 	}
-  	size -= lose;
 
-	for(i=0; i<size; i+=N) {
-		vpb_wave_read(rd, buf, N);
-		vpb_wave_write(wr, buf, N);
-	}
+	return(0);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: sig_handler
+	AUTHOR......: David Rowe
+	DATE CREATED: 13/09/01
+
+	SIGTERM handler.
+
+\*--------------------------------------------------------------------------*/
+
+void sig_handler(int sig) {
+  if (sig == SIGTERM) {
+    signal(SIGTERM,SIG_DFL);
+    siglongjmp(jmpbuf, 0);
+  }
+
+  // log more or less
+  if (sig == SIGUSR1)
+    log_set_level(log_get_level()+1);
+  if (sig == SIGUSR2)
+    log_set_level(log_get_level()-1);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctwaitforring
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Waits for two rings, decoding CID as it arrives after the first.  If
+	a CID message is complete before the second ring we reply straight
+	away rather than waiting for the ring.
+
+\*--------------------------------------------------------------------------*/
+
+void ctwaitforring(CHANNEL *ch) {
+  ch->state = FIRST_RING;
+  if (finito) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "finito\n");
+  }
+}
+
+void ctwaitforring_event(CHANNEL *ch, CT_EVENT *e) {
+
+  switch(ch->state) {
+  case FIRST_RING:
+    if ((e->type == CT_RING) && (e->data == 0)) {
+      if (!ch->cid_streaming) {
+	cid_init(&ch->cid);
+	ch->cid_done = 0;
+	if (ct->record_stream_async(ch->h, CT_LINEAR, CID_MS, cid_cb, ch)
+	    == CT_OK)
+	  ch->cid_streaming = 1;
+      }
+      mylog(LOG_INFO,"[%02d] First Ring-CID decoding-waiting for second "
+	    "ring", ch->h);
+
+      // wait for 6 seconds for second ring, otherwise time out
+      wheel_add(&ch->timer, CID_MS);
+      ch->state = SECOND_RING;
+    }
+    break;
+
+  case SECOND_RING:
+    if ((e->type == CT_RING) && (e->data == 0)) {
+      wheel_cancel(&ch->timer);
+      mylog(LOG_INFO,"[%02d] Second Ring", ch->h);
+      cid_end(ch, CID_END);
+    }
+    if (e->type == CT_TIMEREXP)
+      cid_end(ch, CID_END_RESTART);
+    break;
+
+  // the stream thread may still be feeding ch->cid until CT_RECORDEND
+
+  case CID_END:
+    if (e->type == CT_RECORDEND)
+      ctwaitforring_reply(ch);
+    break;
+
+  case CID_END_RESTART:
+    if (e->type == CT_RECORDEND)
+      ch->state = FIRST_RING;
+    break;
+  }
+}
+
+// stops CID streaming, then moves to state, which ends in a reply
+// (CID_END) or waiting for the next first ring (CID_END_RESTART)
+
+void cid_end(CHANNEL *ch, int state) {
+  if (ch->cid_streaming) {
+    ct->record_terminate(ch->h);
+    ch->state = state;
+  }
+  else if (state == CID_END)
+    ctwaitforring_reply(ch);
+  else
+    ch->state = FIRST_RING;
+}
+
+// backend thread, feeds the demodulator and tells the reactor when a
+// message is complete
+
+void cid_cb(void *arg, const char *buf, long n) {
+  CHANNEL *ch = (CHANNEL*)arg;
+
+  if (cid_feed(&ch->cid, (const short*)buf, n/2)) {
+    __atomic_store_n(&ch->cid_done, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ch->cid_ready, 1, __ATOMIC_RELEASE);
+    ready_push(ch);
+  }
+}
+
+// reactor, CID decoded, no need to wait for the second ring
+
+void ctwaitforring_cid(CHANNEL *ch) {
+  if ((ch->cmd != CMD_WAITFORRING) || (ch->state != SECOND_RING))
+    return;
+  wheel_cancel(&ch->timer);
+  mylog(LOG_INFO,"[%02d] CID decoded before second ring", ch->h);
+  cid_end(ch, CID_END);
+}
+
+void ctwaitforring_reply(CHANNEL *ch) {
+  char        s[CT_MAX_STR+1];
+  const char  *number = "";
+
+  if (__atomic_load_n(&ch->cid_done, __ATOMIC_ACQUIRE))
+    number = ch->cid.number;
+  mylog(LOG_INFO,"[%02d] CID number = %s", ch->h, number);
+  snprintf(s, sizeof(s), "%s\n", number);
+  ch->cmd = CMD_NONE;
+  reply(ch, finito ? "finito\n" : s);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctwaitfordial
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Waits for dial tone.
+
+\*--------------------------------------------------------------------------*/
+
+void ctwaitfordial(CHANNEL *ch) {
+  ch->state = WAITING;
+}
+
+void ctwaitfordial_event(CHANNEL *ch, CT_EVENT *e) {
+  if ((e->type == CT_TONEDETECT) && (e->data == CT_TONE_DIAL)) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "\n");
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctplay
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Play handler, for both ctplay and ctplaylist.  Prompts come from the
+	prompt cache, so after the first play of a file there is no file
+	I/O.  A playlist is joined into one buffer and played in one go, so
+	there are no gaps between files.  If a DTMF digit stops a playlist
+	the reply also has the index of the file that was playing.
+
+\*--------------------------------------------------------------------------*/
+
+void ctplay(CHANNEL *ch) {
+  const char *files[MAX_PLAYLIST];
+  int        i, ret = CT_ERROR;
+
+  if (ch->nlist <= MAX_PLAYLIST) {
+    for(i=0; i<ch->nlist; i++)
+      files[i] = ch->list[i];
+    ret = play_phrase(ch, NULL, files, ch->nlist);
+  }
+
+  if (ret != CT_OK) {
+	  ch->cmd = CMD_NONE;
+	  reply(ch, "ERROR\n");
+	  mylog(LOG_ERR,"Error playing: %s", ch->nlist ? ch->list[0] : "");
+	  return;
+  }
+}
+
+void ctplay_event(CHANNEL *ch, CT_EVENT *e) {
+  char      digit;
+
+  switch(ch->state) {
+  case PLAYING:
+
+    if (e->type == CT_PLAYEND) {
+      phrase_release(ch->phrase);
+      ch->phrase = NULL;
+      ch->cmd = CMD_NONE;
+      reply(ch, "OK\n");
+    }
+
+    if (e->type == CT_DTMF) {
+      ch->state = WAIT_FOR_PLAYEND;
+      ct->play_terminate(ch->h);
+      sprintf(ch->smess, "%c\n", e->data);
+    }
+    break;
+
+  case WAIT_FOR_PLAYEND:
+    if (e->type == CT_PLAYEND) {
+      if ((ch->cmd == CMD_PLAYLIST) && (ch->smess[0] != 0)) {
+	digit = ch->smess[0];
+	sprintf(ch->smess, "%c %d\n", digit,
+		phrase_index(ch->phrase, e->data));
+      }
+      phrase_release(ch->phrase);
+      ch->phrase = NULL;
+      ch->cmd = CMD_NONE;
+      reply(ch, ch->smess);
+    }
+    break;
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctsay
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Handler for ctsaynumber, ctsaydigits, ctspell and ctsaydate.  The
+	readout is built from the UsEngM vocabulary and played as one
+	phrase.  Phrases are cached by value, so a readout that has been
+	said before is played without being assembled again.
+
+\*--------------------------------------------------------------------------*/
+
+void ctsay(CHANNEL *ch, int what) {
+  char       words[SAY_MAX_WORDS][SAY_WORD];
+  char       paths[SAY_MAX_WORDS][CT_MAX_STR+SAY_WORD+4];
+  const char *files[SAY_MAX_WORDS];
+  char       key[MAX_MSG+2];
+  int        i, n;
+
+  n = say_words(what, ch->arg[0], words);
+  for(i=0; i<n; i++) {
+    sprintf(paths[i], "%s/%s.au", vocab_dir, words[i]);
+    files[i] = paths[i];
+  }
+  snprintf(key, sizeof(key), "%d%s", what, ch->arg[0]);
+
+  if ((n <= 0) || (play_phrase(ch, key, files, n) != CT_OK)) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "ERROR\n");
+    mylog(LOG_ERR,"[%02d] cannot say: %s", ch->h, ch->arg[0]);
+  }
+}
+
+// starts a phrase playing, leaving the handler in the PLAYING state
+
+int play_phrase(CHANNEL *ch, const char *key, const char **files, int n) {
+  int ret;
+
+  ch->phrase = phrase_get(key, files, n);
+  if (ch->phrase == NULL)
+    return CT_ERROR;
+
+  ret = ct->play_buf_async(ch->h, phrase_buf(ch->phrase),
+			   phrase_size(ch->phrase), phrase_mode(ch->phrase));
+  if (ret != CT_OK) {
+    phrase_release(ch->phrase);
+    ch->phrase = NULL;
+    return ret;
+  }
+
+  ch->smess[0] = 0;
+  ch->state = PLAYING;
+  return CT_OK;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctrecord
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Record handler.  Arguments are file name, timeout and term digits.
+	When ctrecordvad has asked for recordings to end on silence the
+	card streams the audio and the server writes the file, so it can
+	listen to it as it arrives.  The finished file is trimmed and
+	converted by a post thread, and the reply waits for that.
+
+\*--------------------------------------------------------------------------*/
+
+void ctrecord(CHANNEL *ch) {
+  char      *file_name = ch->arg[0];
+  int       ret;
+
+  // timeout
+  unsigned int timeout = atoi(ch->arg[1])*SEC2MS;
+  ch->vad_end = 0;
+  if (ch->vad_on && ch->vad_ms) {
+    ret = wave_open_write(&ch->rec_wave, file_name, CARD_MODE);
+    if (ret == CT_OK) {
+      vad_init(&ch->vad);
+      vad_marks(ch);
+      ret = ct->record_stream_async(ch->h, CARD_MODE, timeout, audio_cb, ch);
+      if (ret != CT_OK) {
+	wave_close(ch->rec_wave);
+	ch->rec_wave = NULL;
+      }
+    }
+  }
+  else
+    ret = ct->record_file_async(ch->h, file_name, CARD_MODE, timeout);
+  if (ret != CT_OK) {
+	  ch->cmd = CMD_NONE;
+	  reply(ch, "ERROR\n");
+	  mylog(LOG_ERR,"Error recording: %s", file_name);
+	  return;
+  }
+
+  ch->state = RECORDING;
+}
+
+void ctrecord_event(CHANNEL *ch, CT_EVENT *e) {
+  char      *term_digits = ch->arg[2];
+  int       finished = 0, live;
+
+  switch(ch->state) {
+  case RECORDING:
+
+    if (e->type == CT_RECORDEND) {
+      finished = 1;
+    }
+
+    if (e->type == CT_DTMF) {
+      if (digit_match(e->data, term_digits)) {
+	ch->state = WAIT_FOR_RECORDEND;
+	ct->record_terminate(ch->h);
+      }
+    }
+    break;
+
+  case WAIT_FOR_RECORDEND:
+  case STREAM_ABORTED:
+    if (e->type == CT_RECORDEND) {
+      finished = 1;
+    }
+    break;
+  }
+
+  if (finished) {
+    ch->hold_n = 0;
+    if (ch->cmd == CMD_RECORD) {
+      live = (ch->rec_wave != NULL);
+      if (live) {
+	ctrecordstream_audio(ch);
+	wave_close(ch->rec_wave);
+	ch->rec_wave = NULL;
+      }
+      ctrecord_post(ch, live);
+      return;
+    }
+    ctrecordstream_audio(ch);
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+  }
+}
+
+// the file is complete, a post thread trims and converts it and ctrecord
+// replies once that is done.  If the server wrote the file (live) the
+// detector has already heard all of it, so the post thread needn't.
+
+void ctrecord_post(CHANNEL *ch, int live) {
+  REC_JOB *j = (REC_JOB*)malloc(sizeof(REC_JOB));
+
+  j->ch = ch;
+  strcpy(j->file, ch->arg[0]);
+  j->lose = ((ch->state == RECORDING) || ch->vad_end) ? 0 : TRIM_SAMPLES;
+  j->vad = ch->vad_on;
+  j->live = live;
+  if (live) {
+    j->heard = ch->vad;
+    memcpy(j->mark, ch->vad_mark, sizeof(j->mark));
+  }
+  j->mode = ch->rec_mode;
+  j->rate = ch->rec_rate;
+  ch->state = RECORD_POST;
+
+  // replies must come from the records that caused them
+  if (replaying) {
+    ch->post_speech = post_run(j);
+    free(j);
+    ctrecord_done(ch);
+    return;
+  }
+  post_submit(j);
+}
+
+void ctrecord_done(CHANNEL *ch) {
+  char ok[32];
+
+  ch->cmd = CMD_NONE;
+  if (ch->post_speech != -1) {
+    sprintf(ok, "OK %ld\n", ch->post_speech);
+    reply(ch, ok);
+  }
+  else
+    reply(ch, "OK\n");
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctrecordvad
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Sets how ctrecord uses the voice activity detector (vad.h) from now
+	on, until the connection closes.  The argument is the ms of silence
+	after speech that ends a recording, 0 to only trim, or off.  With
+	the detector on the silence before and after the speech is trimmed
+	from each recording and ctrecord replies "OK <ms of speech>".
+
+\*--------------------------------------------------------------------------*/
+
+void ctrecordvad(CHANNEL *ch) {
+  char *end;
+  long ms;
+
+  ch->cmd = CMD_NONE;
+  if (strcmp(ch->arg[0], "off") == 0) {
+    ch->vad_on = 0;
+    reply(ch, "OK\n");
+    return;
+  }
+
+  ms = strtol(ch->arg[0], &end, 10);
+  if ((end == ch->arg[0]) || *end || (ms < 0)) {
+    reply(ch, "ERROR\n");
+    return;
+  }
+
+  ch->vad_on = 1;
+  ch->vad_ms = ms;
+  reply(ch, "OK\n");
+}
+
+// keeps the detector's counts once a frame ends, at most one does each
+// time record_vad gives it VAD_FRAME samples or less
+
+void vad_marks(CHANNEL *ch) {
+  VAD      *v = &ch->vad;
+  VAD_MARK *m = &ch->vad_mark[v->frames % VAD_MARKS];
+  int      i;
+
+  if (v->frames == 0)
+    for(i=0; i<VAD_MARKS; i++)
+      ch->vad_mark[i].frames = -1;
+  m->frames = v->frames;
+  m->speech = v->speech;
+  m->first = v->first;
+  m->last = v->last;
+}
+
+// ctrecordvad, writes what the card records for ctrecord and stops it
+// once the caller has been quiet for vad_ms after speaking
+
+void record_vad(CHANNEL *ch, const char *buf, long n) {
+  short x[VAD_FRAME];
+  long  i, m, quiet;
+  int   bps = wave_bytes_per_sample(CARD_MODE);
+
+  wave_write(ch->rec_wave, buf, n);
+  n /= bps;
+  for(i=0; i<n; i+=m) {
+    m = (n-i < VAD_FRAME) ? n-i : VAD_FRAME;
+    g711_to_linear(x, buf+i*bps, m, CARD_MODE);
+    vad_audio(&ch->vad, x, m);
+    vad_marks(ch);
+  }
+
+  quiet = vad_silence(&ch->vad);
+  if ((ch->state == RECORDING) && (quiet != -1) &&
+      ((unsigned long)quiet*VAD_FRAME_MS >= ch->vad_ms)) {
+    mylog(LOG_DEBUG,"[%02d] %ld ms of silence, ending recording", ch->h,
+	  quiet*VAD_FRAME_MS);
+    ch->vad_end = 1;
+    ch->state = WAIT_FOR_RECORDEND;
+    ct->record_terminate(ch->h);
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctrecordformat
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Sets what ctrecord files are written as from now on, until the
+	connection closes.  The argument is linear, alaw or mulaw, with an
+	optional sample rate, e.g. linear/16000.  The card always records
+	at 8 kHz, the file is converted when the recording ends.
+
+\*--------------------------------------------------------------------------*/
+
+void ctrecordformat(CHANNEL *ch) {
+  char *rate;
+  int  mode, r = CARD_RATE;
+
+  ch->cmd = CMD_NONE;
+  if ((rate = strchr(ch->arg[0], '/')) != NULL) {
+    *rate++ = 0;
+    r = atoi(rate);
+  }
+  mode = parse_mode(ch->arg[0]);
+  if ((mode == -1) || (r < MIN_RATE) || (r > MAX_RATE) ||
+      !tc_resample_ok(CARD_RATE, r)) {
+    reply(ch, "ERROR\n");
+    return;
+  }
+
+  ch->rec_mode = mode;
+  ch->rec_rate = r;
+  reply(ch, "OK\n");
+}
+
+// CT_xxx from its name in ctrecordformat and ctrecordstream, -1 if unknown
+
+int parse_mode(const char *s) {
+  if (strcmp(s, "linear") == 0)
+    return CT_LINEAR;
+  if (strcmp(s, "alaw") == 0)
+    return CT_ALAW;
+  if (strcmp(s, "mulaw") == 0)
+    return CT_MULAW;
+  return -1;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctrecordstream
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Records without a file.  Arguments are the format (linear, alaw or
+	mulaw), timeout and term digits.  Audio is sent to the client as it
+	arrives, each block as a line "audio <bytes>" followed by the bytes,
+	and the usual reply ends the stream.
+
+	Rather than trimming the DTMF off the end afterwards, the last
+	TRIM_SAMPLES are held back while recording and dropped at the end.
+
+	The backend runs a channel's streamed recordings one after another
+	on a single record thread, so a cancelled stream has delivered all
+	its audio and its RECORDEND (awaited in STREAM_ABORTED) before the
+	next ctrecordstream starts on the card.
+
+\*--------------------------------------------------------------------------*/
+
+void ctrecordstream(CHANNEL *ch) {
+  int          mode, ret;
+  unsigned int timeout = atoi(ch->arg[1])*SEC2MS;
+
+  mode = parse_mode(ch->arg[0]);
+  ret = CT_ERROR;
+  if (mode != -1) {
+    if (ch->hold == NULL)
+      ch->hold = (char*)malloc(TRIM_SAMPLES*2);
+    ch->hold_n = 0;
+    ch->hold_max = TRIM_SAMPLES*(mode == CT_LINEAR ? 2 : 1);
+    ret = ct->record_stream_async(ch->h, mode, timeout, audio_cb, ch);
+  }
+  if (ret != CT_OK) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "ERROR\n");
+    mylog(LOG_ERR,"[%02d] Error recording stream: %s", ch->h, ch->arg[0]);
+    return;
+  }
+
+  ch->state = RECORDING;
+}
+
+// called by the backend as audio arrives, queues it for the reactor
+
+void audio_cb(void *arg, const char *buf, long n) {
+  CHANNEL  *ch = (CHANNEL*)arg;
+  OUTBUF   *b = (OUTBUF*)malloc(sizeof(OUTBUF) + n);
+
+  memcpy(b->data, buf, n);
+  b->n = n;
+  b->off = 0;
+  b->next = NULL;
+
+  pthread_mutex_lock(&mutex);
+  if (ch->audio_tail)
+    ch->audio_tail->next = b;
+  else
+    ch->audio_head = b;
+  ch->audio_tail = b;
+  pthread_mutex_unlock(&mutex);
+
+  __atomic_store_n(&ch->audio_ready, 1, __ATOMIC_RELEASE);
+  ready_push(ch);
+}
+
+// sends the audio queued by audio_cb, less the held back tail.  Audio is
+// dropped rather than queued without limit if the client falls behind.
+
+void ctrecordstream_audio(CHANNEL *ch) {
+  OUTBUF *b, *next;
+  char   hdr[MAX_ID+32];
+  long   send, from_hold, from_b;
+  int    hn;
+
+  pthread_mutex_lock(&mutex);
+  b = ch->audio_head;
+  ch->audio_head = ch->audio_tail = NULL;
+  pthread_mutex_unlock(&mutex);
+
+  for(; b; b=next) {
+    next = b->next;
+
+    if ((ch->cmd == CMD_RECORD) && ch->rec_wave)
+      record_vad(ch, b->data, b->n);
+    else if ((ch->cmd == CMD_RECORDSTREAM) &&
+	     (ch->state != STREAM_ABORTED) && (ch->newSd != -1)) {
+      send = ch->hold_n + b->n - ch->hold_max;
+      if (send < 0)
+	send = 0;
+      from_hold = (send < ch->hold_n) ? send : ch->hold_n;
+      from_b = send - from_hold;
+      if (send && (ch->out_bytes < OUT_MAX)) {
+	if (ch->proto == 2)
+	  hn = sprintf(hdr, "%s\taudio\t%ld\n", ch->id, send);
+	else
+	  hn = sprintf(hdr, "audio %ld\n", send);
+	out_queue(ch, hdr, hn, ch->hold, from_hold, b->data, from_b);
+      }
+      ch->hold_n -= from_hold;
+      memmove(ch->hold, ch->hold+from_hold, ch->hold_n);
+      memcpy(ch->hold+ch->hold_n, b->data+from_b, b->n-from_b);
+      ch->hold_n += b->n-from_b;
+    }
+
+    free(b);
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctconference
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	ctconference and ctbridge handler.  Arguments are the conference
+	name and term digits.  Each channel's client joins by name, a bridge
+	is a conference with room for two.  The channel records and plays
+	linear streams that the mixer (mix.cpp) connects to the other
+	parties, until a term digit is pressed or the command is cancelled,
+	then replies with the digit, or OK, once both streams have ended.
+
+\*--------------------------------------------------------------------------*/
+
+void ctconference(CHANNEL *ch, int max) {
+  if (mix_join(&ch->party, ch->arg[0], max) != CT_OK) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "ERROR\n");
+    mylog(LOG_INFO,"[%02d] conference %s is full", ch->h, ch->arg[0]);
+    return;
+  }
+
+  ch->smess[0] = 0;
+  ch->conf_ends = 0;
+  if (ct->record_stream_async(ch->h, CT_LINEAR, 0, conf_in_cb, ch) == CT_OK)
+    ch->conf_ends++;
+  if (ct->play_stream_async(ch->h, CT_LINEAR, conf_out_cb, ch) == CT_OK)
+    ch->conf_ends++;
+  ch->state = CONFERENCING;
+  if (ch->conf_ends < 2) {
+    mylog(LOG_ERR,"[%02d] Error starting conference audio", ch->h);
+    strcpy(ch->smess, "ERROR\n");
+    conf_leave(ch);
+    if (ch->conf_ends == 0) {
+      ch->cmd = CMD_NONE;
+      reply(ch, ch->smess);
+    }
+  }
+  else
+    mylog(LOG_DEBUG,"[%02d] joined conference %s", ch->h, ch->arg[0]);
+}
+
+void ctconference_event(CHANNEL *ch, CT_EVENT *e) {
+  if ((e->type == CT_RECORDEND) || (e->type == CT_PLAYEND)) {
+    // either stream stopping on its own ends the conference
+    if (ch->state == CONFERENCING)
+      conf_leave(ch);
+    ch->conf_ends--;
+  }
 
-	vpb_wave_close_read(rd);
-	vpb_wave_close_write(wr);
+  if ((ch->state == CONFERENCING) && (e->type == CT_DTMF) &&
+      digit_match(e->data, ch->arg[1])) {
+    conf_leave(ch);
+    sprintf(ch->smess, "%c\n", e->data);
+  }
 
-	ret = rename(tmp_file, audio_file);
-	if (ret < 0) {
-		mylog(LOG_INFO,"trim: error renaming %s: %s",audio_file,
-		      strerror(errno));
-		return;
-	}
-	unlink(tmp_file);
+  if ((ch->state == WAIT_FOR_CONFEND) && (ch->conf_ends <= 0)) {
+    mylog(LOG_DEBUG,"[%02d] left conference %s, %lu frames %lu slips "
+	  "%lu underruns", ch->h, ch->arg[0], ch->party.frames,
+	  ch->party.slips, ch->party.underruns);
+    ch->cmd = CMD_NONE;
+    reply(ch, ch->smess[0] ? ch->smess : "OK\n");
+  }
 }
 
-int arg_exists(int argc, char *argv[], char *arg) {
-  int i;
+// stops mixing and both streams, the command ends with their end events
 
-  for(i=0; i<argc; i++)
-    if (strcmp(argv[i],arg) == 0)
-      return i;
+void conf_leave(CHANNEL *ch) {
+  mix_leave(&ch->party);
+  ct->record_terminate(ch->h);
+  ct->play_terminate(ch->h);
+  ch->state = WAIT_FOR_CONFEND;
+}
+
+// the backend's stream callbacks, on its threads
+
+void conf_in_cb(void *arg, const char *buf, long n) {
+  mix_in(&((CHANNEL*)arg)->party, buf, n);
+}
+
+void conf_out_cb(void *arg, char *buf, long n) {
+  mix_out(&((CHANNEL*)arg)->party, buf, n);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctsleep
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Sleep handler.
+
+\*--------------------------------------------------------------------------*/
+
+void ctsleep(CHANNEL *ch) {
+  unsigned long newperiod;
+
+  // duration of sleep
+  newperiod = atol(ch->arg[0])*SEC2MS;
+
+  wheel_add(&ch->timer, newperiod);
+  ch->state = WAITING;
+}
+
+void ctsleep_event(CHANNEL *ch, CT_EVENT *e) {
+  char      s[CT_MAX_STR];
+
+  if (e->type == CT_TIMEREXP) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+  }
+  if (e->type == CT_DTMF) {
+    wheel_cancel(&ch->timer);
+    sprintf(s, "%c\n", e->data);
+    ch->cmd = CMD_NONE;
+    reply(ch, s);
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctcollect
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Collect digits handler.  Arguments are the number of digits, time out
+	and inter digit time out in seconds.  Digits are collected by the
+	server from DTMF events, including any pressed since the last
+	ctclear, rather than by the card.
+
+	The first argument may instead be a digit grammar, see grammar.h,
+	anything but a plain number is taken as one.  Collecting then ends
+	as soon as the digits match and no further digit could extend the
+	match, or the digits can't match whatever comes next, so "1|2|9#"
+	returns on the 1 without waiting for the inter digit time out.  The
+	digits are returned either way, the client decides what they mean.
+
+\*--------------------------------------------------------------------------*/
+
+void ctcollect(CHANNEL *ch) {
+  char      s[CT_MAX_STR+1];
+  char      *g = ch->arg[0];
+
+  int unsigned long seconds = atol(ch->arg[1]);
+  int unsigned long inter_seconds = atol(ch->arg[2]);
+
+  collect_start(ch, atoi(g), seconds*SEC2MS, inter_seconds*SEC2MS);
+  if (g[strspn(g, "0123456789")]) {
+    if (gram_compile(&ch->grammar, g) != CT_OK) {
+      ch->cmd = CMD_NONE;
+      reply(ch, "ERROR\n");
+      mylog(LOG_ERR,"[%02d] bad digit grammar: %s", ch->h, g);
+      return;
+    }
+    ch->collect_max = CT_MAX_STR-1;
+  }
+  ch->state = WAITING;
+  if (collect_event(ch, NULL)) {
+    snprintf(s, sizeof(s), "%s\n", ch->digbuf);
+    ch->cmd = CMD_NONE;
+    reply(ch, s);
+  }
+}
+
+void ctcollect_event(CHANNEL *ch, CT_EVENT *e) {
+  char      s[CT_MAX_STR+1];
+
+  if (collect_event(ch, e)) {
+    snprintf(s, sizeof(s), "%s\n", ch->digbuf);
+    ch->cmd = CMD_NONE;
+    reply(ch, s);
+  }
+}
+
+// waits for up to max digits, for time_out ms in all and inter ms between
+// digits once the first has come, inter of 0 is no limit between digits
+
+void collect_start(CHANNEL *ch, int max, unsigned long time_out,
+		   unsigned long inter) {
+  if (max < 1)
+    max = 1;
+  if (max > CT_MAX_STR-1)
+    max = CT_MAX_STR-1;
+  ch->collect_max = max;
+  ch->collect_end = now_ms() + time_out;
+  ch->collect_inter = inter;
+  ch->collect_n = 0;
+  ch->grammar.nstates = 0;
+  ch->gram_state = 0;
+}
+
+// whether the digits buffered so far end collecting, walking the grammar
+// over any it hasn't seen yet
+
+static int collect_done(CHANNEL *ch) {
+  GRAMMAR *g = &ch->grammar;
+
+  if (g->nstates == 0)
+    return ch->ndtmf >= ch->collect_max;
+
+  if (g->final[ch->gram_state])
+    return 1;
+  while(ch->collect_n < ch->ndtmf) {
+    ch->gram_state = gram_step(g, ch->gram_state, ch->dtmf[ch->collect_n++]);
+    if ((ch->gram_state == GRAM_DEAD) || g->final[ch->gram_state] ||
+	(ch->collect_n == ch->collect_max))
+      return 1;
+  }
 
   return 0;
 }
 
-int ctwaitforevent(int h,void *timer,int event_type,int data,int timeout_ms) {
-  char      s[VPB_MAX_STR];
-  int       ret, state;
-  VPB_EVENT e;   
+// call with NULL to start, then with each event.  Returns 1 when
+// collecting is over, with the digits taken from the buffer to digbuf.
+
+int collect_event(CHANNEL *ch, CT_EVENT *e) {
+  unsigned long long now;
+  unsigned long      wait;
+  int                n;
+
+  if (e && (e->type != CT_DTMF) && (e->type != CT_TIMEREXP))
+    return 0;
+
+  if ((e == NULL) || (e->type == CT_DTMF)) {
+    if (!collect_done(ch)) {
+      now = now_ms();
+      wait = (ch->collect_end > now) ? ch->collect_end - now : 0;
+      if (ch->ndtmf && ch->collect_inter && (ch->collect_inter < wait))
+	wait = ch->collect_inter;
+      wheel_add(&ch->timer, wait);
+      return 0;
+    }
+    wheel_cancel(&ch->timer);
+  }
+
+  if (ch->grammar.nstates)
+    n = ch->collect_n;
+  else
+    n = (ch->ndtmf < ch->collect_max) ? ch->ndtmf : ch->collect_max;
+  memcpy(ch->digbuf, ch->dtmf, n);
+  ch->digbuf[n] = 0;
+  ch->ndtmf -= n;
+  memmove(ch->dtmf, ch->dtmf+n, ch->ndtmf);
 
-  vpb_timer_change_period(timer, timeout_ms);
-  if (timeout_ms != 0)
-    vpb_timer_start(timer);
+  return 1;
+}
 
-  state = 1;
-  while(state && !finito) {
-    ret = vpb_get_event_ch_async(h, &e);
+// the digit buffer, once it is full further digits are lost
 
-    if (ret == VPB_OK) {
-      vpb_translate_event(&e, s); s[strlen(s)-1]=0;
-      mylog(LOG_INFO,"%s",s);
+void dtmf_push(CHANNEL *ch, char digit) {
+  if (ch->ndtmf < CT_MAX_STR-1)
+    ch->dtmf[ch->ndtmf++] = digit;
+}
 
-      if ((e.type == event_type) && (e.data == data)) {
-	state = 0;
-      }
-      if (e.type == VPB_TIMEREXP) {
-	state = 0;
+// wheel, a command's timer is delivered like any other event so it is
+// traced and can be replayed
+
+void chan_timeout(void *arg) {
+  CHANNEL  *ch = (CHANNEL*)arg;
+  CT_EVENT e;
+
+  e.type = CT_TIMEREXP;
+  e.handle = ch->h;
+  e.data = 0;
+  dispatch_event(ch, &e);
+}
+
+// wheel, -idle.  A client that is waiting for a command, or has output
+// queued, isn't idle.
+
+void client_idle(void *arg) {
+  CHANNEL *ch = (CHANNEL*)arg;
+
+  if (ch->newSd == -1)
+    return;
+  if ((ch->cmd != CMD_NONE) || ch->npend || ch->out_head) {
+    wheel_add(&ch->idle, idle_ms);
+    return;
+  }
+  mylog(LOG_INFO,"[%02d] client idle for %lu s", ch->h, idle_ms/SEC2MS);
+  client_close(ch);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctrunscript
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Runs a menu script, see ivr.h.  Each step is started as the command
+	it stands for, and its reply goes back to the script rather than to
+	the client, so the client only hears when the script ends, with the
+	text given to end, or makes a callout:
+
+	  version 1: CALLOUT <text>, the client sends a line in answer
+	  version 2: <id>\tCALLOUT\t<text>, answered by <id>\tresume\t<line>
+
+	Version 1 clients send the number of lines in the script then the
+	lines, version 2 clients a field per line.
+
+\*--------------------------------------------------------------------------*/
+
+void ctrunscript(CHANNEL *ch) {
+  char err[CT_MAX_STR];
+
+  ch->prog = ivr_load(ch->src ? ch->src : "", ch->src_n, err, sizeof(err));
+  ch->src_n = 0;
+  if (ch->prog == NULL) {
+    mylog(LOG_ERR,"[%02d] script %s", ch->h, err);
+    ch->cmd = CMD_NONE;
+    reply(ch, "ERROR\n");
+    return;
+  }
+
+  ch->pc = 0;
+  ch->ivr_step = 0;
+  memset(ch->vars, 0, sizeof(ch->vars));
+  ch->state = SCRIPT_RUNNING;
+  ivr_run(ch);
+}
+
+void script_add(CHANNEL *ch, const char *line) {
+  int n = strlen(line);
+
+  if (ch->src_n + n + 1 > ch->src_size) {
+    ch->src_size = 2*(ch->src_n + n + 1);
+    ch->src = (char*)realloc(ch->src, ch->src_size);
+  }
+  memcpy(ch->src + ch->src_n, line, n);
+  ch->src_n += n;
+  ch->src[ch->src_n++] = '\n';
+}
+
+// the arguments of an end or callout, as one line
+
+static void ivr_join(CHANNEL *ch, IVR_OP *op, char *s, int size) {
+  int i, n;
+
+  for(i=0, n=0, *s=0; (i < op->narg) && (n < size); i++)
+    n += snprintf(s+n, size-n, "%s%s", i ? " " : "",
+		  ivr_arg(ch->prog, op->arg[i], ch->vars));
+}
+
+// starts the command a step stands for
+
+static void ivr_command(CHANNEL *ch, IVR_OP *op) {
+  static const int says[] = {CMD_SAYNUMBER, CMD_SAYDIGITS, CMD_SPELL,
+			     CMD_SAYDATE};
+  const char       *a;
+  int              i;
+
+  for(i=0; i<op->narg; i++) {
+    a = ivr_arg(ch->prog, op->arg[i], ch->vars);
+    snprintf(ch->list[i], MAX_MSG, "%s", a);
+    if (i < MAX_ARGS)
+      snprintf(ch->arg[i], MAX_MSG, "%s", a);
+  }
+  ch->nlist = op->narg;
+  ch->argc = op->narg;
+  ch->nargs = 0;
+
+  switch(op->op) {
+  case IVR_PLAY:
+    ch->cmd = (op->narg == 1) ? CMD_PLAY : CMD_PLAYLIST;
+    break;
+  case IVR_SAY:
+    ch->cmd = says[op->cmp];
+    break;
+  case IVR_COLLECT:
+    ch->cmd = CMD_COLLECT;
+    break;
+  case IVR_RECORD:
+    ch->cmd = CMD_RECORD;
+    break;
+  case IVR_SLEEP:
+    ch->cmd = CMD_SLEEP;
+    break;
+  case IVR_DIAL:
+    ch->cmd = CMD_DIAL;
+    break;
+  case IVR_CLEAR:
+    ch->cmd = CMD_CLEAR;
+    break;
+  case IVR_ANSWER:
+    ch->cmd = CMD_ANSWER;
+    break;
+  case IVR_HANGUP:
+    ch->cmd = CMD_HANGUP;
+    break;
+  }
+
+  ch->ivr_var = (op->op == IVR_COLLECT) ? op->var : IVR_RESULT;
+  ch->ivr_step = 1;
+  start_command(ch);
+}
+
+static void ivr_finish(CHANNEL *ch, const char *text) {
+  char s[CT_MAX_STR];
+
+  snprintf(s, sizeof(s), "%s\n", *text ? text : "OK");
+  ivr_release(ch->prog);
+  ch->prog = NULL;
+  ch->cmd = CMD_NONE;
+  reply(ch, s);
+}
+
+static void ivr_callout(CHANNEL *ch, const char *text) {
+  char s[CT_MAX_STR];
+
+  ch->state = SCRIPT_CALLOUT;
+  if (ch->proto == 2) {
+    snprintf(s, sizeof(s), "CALLOUT\t%s\n", text);
+    reply_id(ch, ch->id, s);
+  }
+  else {
+    snprintf(s, sizeof(s), "CALLOUT %s\n", text);
+    reply_sent(ch, s, strlen(s));
+    out_queue(ch, s, strlen(s)+1, NULL, 0, NULL, 0);
+
+    // the answer comes in like an argument
+    ch->argc = 0;
+    ch->nargs = 1;
+  }
+}
+
+// runs ops until a step has to wait for its command, a callout, or the
+// end.  Steps that finish at once come back through ivr_reply while we
+// are still in here, so the loop carries on rather than recursing.
+
+void ivr_run(CHANNEL *ch) {
+  IVR_OP     *op;
+  const char *a, *b;
+  char       s[CT_MAX_STR];
+  int        ops, yes = 0;
+
+  ch->ivr_running = 1;
+  for(ops=0; ch->prog && !ch->ivr_step; ops++) {
+    if (ops == SCRIPT_OPS) {
+      mylog(LOG_ERR,"[%02d] script ran %d ops without waiting", ch->h, ops);
+      ivr_finish(ch, "ERROR");
+      break;
+    }
+
+    op = &ch->prog->ops[ch->pc++];
+    switch(op->op) {
+    case IVR_SET:
+      snprintf(ch->vars[op->var], IVR_VALUE, "%s",
+	       ivr_arg(ch->prog, op->arg[0], ch->vars));
+      break;
+    case IVR_GOTO:
+      ch->pc = op->target;
+      break;
+    case IVR_IF:
+      a = ivr_arg(ch->prog, op->arg[0], ch->vars);
+      b = ivr_arg(ch->prog, op->arg[1], ch->vars);
+      switch(op->cmp) {
+      case IVR_EQ: yes = strcmp(a, b) == 0; break;
+      case IVR_NE: yes = strcmp(a, b) != 0; break;
+      case IVR_LT: yes = atof(a) < atof(b); break;
+      case IVR_GT: yes = atof(a) > atof(b); break;
       }
+      if (yes)
+	ch->pc = op->target;
+      break;
+    case IVR_CALLOUT:
+      ivr_join(ch, op, s, sizeof(s));
+      ch->ivr_var = op->var;
+      ivr_callout(ch, s);
+      ch->ivr_running = 0;
+      return;
+    case IVR_END:
+      ivr_join(ch, op, s, sizeof(s));
+      ivr_finish(ch, s);
+      break;
+    default:
+      ivr_command(ch, op);
     }
-    else
-      vpb_sleep(100);
   }
-	  
-  vpb_timer_stop(timer);	
-  if (state == 0)
-    return e.type;
+  ch->ivr_running = 0;
+}
+
+// a step's command has ended with reply s
+
+void ivr_reply(CHANNEL *ch, const char *s) {
+  ch->ivr_step = 0;
+  ch->cmd = CMD_RUNSCRIPT;
+  ch->state = SCRIPT_RUNNING;
+  snprintf(ch->vars[IVR_RESULT], IVR_VALUE, "%.*s", (int)strcspn(s, "\n"),
+	   s);
+  if (ch->ivr_var != IVR_RESULT)
+    strcpy(ch->vars[ch->ivr_var], ch->vars[IVR_RESULT]);
+  if (!ch->ivr_running)
+    ivr_run(ch);
+}
+
+void ivr_resume(CHANNEL *ch, const char *value) {
+  snprintf(ch->vars[ch->ivr_var], IVR_VALUE, "%s", value);
+  ch->state = SCRIPT_RUNNING;
+  ch->argc = 0;
+  ch->nargs = 0;
+  ivr_run(ch);
+}
+
+// the client has gone or cancelled, whatever step is running is left to
+// abort_command
+
+void ivr_stop(CHANNEL *ch) {
+  ivr_release(ch->prog);
+  ch->prog = NULL;
+  ch->ivr_step = 0;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ctdial
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Dial handler.
+
+\*--------------------------------------------------------------------------*/
+
+void ctdial(CHANNEL *ch) {
+  int       ret;
+
+  mylog(LOG_INFO,"[%02d] dial: %s", ch->h, ch->arg[0]);
+
+  ret = ct->dial_async(ch->h, ch->arg[0]);
+  if (ret != CT_OK) {
+	  ch->cmd = CMD_NONE;
+	  reply(ch, "ERROR\n");
+	  mylog(LOG_ERR,"Error dialing");
+	  return;
+  }
+
+  ch->state = WAITING;
+}
+
+void ctdial_event(CHANNEL *ch, CT_EVENT *e) {
+  if (e->type == CT_DIALEND) {
+    ch->cmd = CMD_NONE;
+    reply(ch, "OK\n");
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: campaign_run
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Campaign dispatcher.  Starts the calls that are due on channels with
+	no client and nothing running, then sets the timer for when the next
+	paced or retried call, or a channel resting between calls, will be
+	ready.  A channel freeing up calls campaign_kick, which runs this
+	from the reactor once the handler has returned.
+
+\*--------------------------------------------------------------------------*/
+
+static long wait_min(long a, long b) {
+  if (a == -1)
+    return b;
+  if ((b == -1) || (a < b))
+    return a;
+  return b;
+}
+
+void campaign_run() {
+  unsigned long long now;
+  CAMP_CALL          *call;
+  CHANNEL            *ch;
+  long               wait, w;
+  int                i, more;
+
+  if (camp_sd == -1)
+    return;
+
+  now = now_ms();
+  wait = -1;
+  more = 1;
+  for(i=0; i<num_ports; i++) {
+    ch = &chans[i];
+    if ((ch->h < 0) || (ch->newSd != -1) || (ch->cmd != CMD_NONE))
+      continue;
+    if (ch->rest_until > now) {
+      wait = wait_min(wait, ch->rest_until - now);
+      continue;
+    }
+    if (!more)
+      continue;
+    if ((call = camp_next(now, &w)) == NULL) {
+      wait = wait_min(wait, w);
+      more = 0;
+      continue;
+    }
+    campaign_call(ch, call);
+  }
+
+  if (wait == -1)
+    wheel_cancel(&camp_timer);
   else
+    wheel_add(&camp_timer, wait);
+}
+
+// asks for campaign_run to be called as soon as the reactor is free
+
+void campaign_kick() {
+  if (camp_sd != -1)
+    wheel_add(&camp_timer, 0);
+}
+
+void campaign_timeout(void *arg) {
+  campaign_run();
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: campaign_call
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Makes one campaign call, as the server's own command on the channel.
+	Goes off hook, waits for dial tone and dials.  A busy tone is BUSY,
+	ringback for more than NOANSWER_MS is NOANSWER, and the call is
+	answered once ringback has stopped for ANSWER_GAP_MS, or voice or a
+	DTMF key is heard.  Answered calls hear the campaign's prompts, then
+	digits may be collected before hanging up.  A client that connects
+	meanwhile has its commands run once the call is over.
+
+\*--------------------------------------------------------------------------*/
+
+void campaign_call(CHANNEL *ch, CAMP_CALL *call) {
+  ch->call = call;
+  ch->cmd = CMD_CAMPCALL;
+  ch->nargs = 0;
+  ch->id[0] = 0;
+  ch->digbuf[0] = 0;
+  ch->nretained = 0;
+  ch->run_cmd = CMD_CAMPCALL;
+  ch->run_start = stats_now_us();
+  stats_command_start(ch - chans);
+
+  mylog(LOG_INFO,"[%02d] campaign %s: calling %s, attempt %d", ch->h,
+	call->c->name, call->number, call->attempts);
+  ch->ndtmf = 0;
+  ct->sethook(ch->h, CT_OFFHOOK);
+  wheel_add(&ch->timer, DIALTONE_MS);
+  ch->state = CALL_DIALTONE;
+}
+
+void campaign_event(CHANNEL *ch, CT_EVENT *e) {
+  CAMPAIGN *c = ch->call->c;
+
+  switch(ch->state) {
+  case CALL_DIALTONE:
+    if ((e->type == CT_TONEDETECT) && (e->data == CT_TONE_DIAL)) {
+      wheel_cancel(&ch->timer);
+      if (ct->dial_async(ch->h, ch->call->number) != CT_OK)
+	campaign_end(ch, CAMP_ERROR);
+      else
+	ch->state = CALL_DIALING;
+    }
+    if (e->type == CT_TIMEREXP)
+      campaign_end(ch, CAMP_NODIALTONE);
+    break;
+
+  case CALL_DIALING:
+    if (e->type == CT_DIALEND) {
+      ch->call_deadline = now_ms() + NOANSWER_MS;
+      wheel_add(&ch->timer, ANSWER_GAP_MS);
+      ch->state = CALL_RINGING;
+    }
+    break;
+
+  case CALL_RINGING:
+    if (e->type == CT_TONEDETECT) {
+      if (e->data == CT_TONE_BUSY)
+	campaign_end(ch, CAMP_BUSY);
+      else if (e->data == CT_TONE_GRUNT)
+	campaign_answered(ch);
+      else if ((e->data == CT_TONE_RINGBACK) &&
+	       (now_ms() >= ch->call_deadline))
+	campaign_end(ch, CAMP_NOANSWER);
+      else if (e->data == CT_TONE_RINGBACK) {
+	// still ringing, the gap starts again
+	wheel_add(&ch->timer, ANSWER_GAP_MS);
+      }
+    }
+    if ((e->type == CT_TIMEREXP) || (e->type == CT_DTMF))
+      campaign_answered(ch);
+    break;
+
+  case CALL_PLAYING:
+    if (e->type == CT_PLAYEND) {
+      phrase_release(ch->phrase);
+      ch->phrase = NULL;
+      if (c->digits == 0) {
+	campaign_end(ch, CAMP_ANSWERED);
+	break;
+      }
+      collect_start(ch, c->digits, CALL_COLLECT_MS, CALL_INTER_MS);
+      ch->state = CALL_COLLECT;
+      if (collect_event(ch, NULL))
+	campaign_end(ch, CAMP_ANSWERED);
+    }
+    break;
+
+  case CALL_COLLECT:
+    if (collect_event(ch, e))
+      campaign_end(ch, CAMP_ANSWERED);
+    break;
+  }
+}
+
+void campaign_answered(CHANNEL *ch) {
+  CAMPAIGN   *c = ch->call->c;
+  const char *files[CAMP_PROMPTS];
+  int        i;
+
+  // a DTMF key that showed the call was answered isn't an answer to the
+  // prompts
+  ch->ndtmf = 0;
+  wheel_cancel(&ch->timer);
+  mylog(LOG_DEBUG,"[%02d] campaign %s: %s answered", ch->h, c->name,
+	ch->call->number);
+  for(i=0; i<c->nprompts; i++)
+    files[i] = c->prompt[i];
+  if (play_phrase(ch, c->key, files, c->nprompts) != CT_OK) {
+    mylog(LOG_ERR,"[%02d] campaign %s: cannot play %s", ch->h, c->name,
+	  c->prompt[0]);
+    campaign_end(ch, CAMP_ERROR);
+    return;
+  }
+  ch->state = CALL_PLAYING;
+}
+
+// hangs up and tells the campaign's client, unless the number is to be
+// tried again
+
+void campaign_end(CHANNEL *ch, int result) {
+  CAMP_CALL          *call = ch->call;
+  CAMPAIGN           *c = call->c;
+  unsigned long long now = now_ms();
+  char               s[CT_MAX_STR*2];
+  int                owner;
+
+  wheel_cancel(&ch->timer);
+  ct->sethook(ch->h, CT_ONHOOK);
+  ch->call = NULL;
+  ch->cmd = CMD_NONE;
+  ch->ndtmf = 0;                       // nothing for a client's ctcollect
+  ch->rest_until = now + CALL_REST_MS;
+  command_done(ch, result == CAMP_ERROR);
+  mylog(LOG_INFO,"[%02d] campaign %s: %s %s", ch->h, c->name, call->number,
+	camp_result_name(result));
+
+  if (!camp_done(call, result, now)) {
+    owner = c->owner;
+    sprintf(s, "CALL\t%s\t%s\t%s\t%d\t%d:%d\t%s\n", c->name,
+	    call->number, camp_result_name(result), call->attempts,
+	    ch->board, ch->channel,
+	    (result == CAMP_ANSWERED) ? ch->digbuf : "");
+    if (camp_idle(c))
+      sprintf(s+strlen(s), "DONE\t%s\t%lu\t%lu\n", c->name, c->answered,
+	      c->failed);
+
+    // sending may drop the client, which frees its campaigns
+    camp_release(call);
+    if (owner != -1)
+      campaign_send(owner, s);
+  }
+
+  campaign_kick();
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: trim
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Removes the DTMF that stopped a recording from the end of the file.
+	The last TRIM_SCAN samples go through the tone detector and the file
+	is cut where the last digit in them starts.  If there isn't one the
+	last 'lose' samples are removed instead.
+
+\*--------------------------------------------------------------------------*/
+
+void trim(char *audio_file, int lose) {
+  WAVE          *w;
+  TONE_DET      t, *pt = &t;
+  char          buf[TRIM_SCAN*2];
+  short         x[TRIM_SCAN];
+  const short   *frame;
+  unsigned long samples, start;
+  long          n = 0, f, onset = -1;
+  int           mode, bps;
+
+  if (wave_open_read(&w, audio_file) == CT_OK) {
+    mode = wave_get_mode(w);
+    bps = wave_bytes_per_sample(mode);
+    samples = wave_get_size(w)/bps;
+    start = (samples > TRIM_SCAN) ? samples - TRIM_SCAN : 0;
+    if (wave_seek(w, start*bps) == CT_OK)
+      n = wave_read(w, buf, (samples-start)*bps)/bps;
+    wave_close(w);
+    g711_to_linear(x, buf, n, mode);
+
+    // a digit is reported in its second frame, and may have started
+    // part way through the frame before
+    tone_init(&t);
+    for(f=0; (f+1)*TONE_FRAME <= n; f++) {
+      frame = x + f*TONE_FRAME;
+      tone_frames(&pt, &frame, 1);
+      if (t.dtmf)
+	onset = (f > 2) ? (f-2)*TONE_FRAME : 0;
+    }
+    if (onset != -1) {
+      mylog(LOG_DEBUG,"trim: DTMF %ld samples from end of %s", n-onset,
+	    audio_file);
+      lose = n - onset;
+    }
+  }
+
+  if (wave_trim(audio_file, lose) != CT_OK)
+    mylog(LOG_INFO,"trim: error trimming %s",audio_file);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: trim_silence
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Removes the silence before and after the speech in a recording at
+	the card's rate, all but VAD_PAD samples of it.  heard is the voice
+	activity detector that listened while the server wrote the file,
+	with mark its counts over the last frames, or NULL to run the file
+	through one now.  A recording without speech is left empty.
+	Returns the ms of speech, or -1 if the file can't be read.
+
+\*--------------------------------------------------------------------------*/
+
+long trim_silence(char *audio_file, const VAD *heard,
+		  const VAD_MARK *mark) {
+  WAVE           *w;
+  VAD            v;
+  const VAD_MARK *m;
+  char           buf[TRIM_SCAN*2];
+  short          x[TRIM_SCAN];
+  long           n, samples, end, skip = 0, keep = 0;
+  int            mode, bps;
+
+  if (wave_open_read(&w, audio_file) != CT_OK)
     return -1;
+  mode = wave_get_mode(w);
+  bps = wave_bytes_per_sample(mode);
+  samples = wave_get_size(w)/bps;
+
+  // the live detector also heard the DTMF trim() has since cut off, so
+  // go back to its counts at the frame the file now ends in
+  if (heard) {
+    v = *heard;
+    end = samples/VAD_FRAME;
+    if (v.frames > end) {
+      m = &mark[end % VAD_MARKS];
+      if (m->frames == end) {
+	v.speech = m->speech;
+	v.first = m->first;
+	v.last = m->last;
+      }
+      else
+	heard = NULL;
+    }
+  }
+  if (heard == NULL) {
+    vad_init(&v);
+    while((n = wave_read(w, buf, TRIM_SCAN*bps)/bps) > 0) {
+      g711_to_linear(x, buf, n, mode);
+      vad_audio(&v, x, n);
+    }
+  }
+  wave_close(w);
+
+  if (v.first != -1) {
+    skip = v.first*VAD_FRAME - VAD_PAD;
+    if (skip < 0)
+      skip = 0;
+    keep = (v.last+1)*VAD_FRAME + VAD_PAD - skip;
+    if (skip + keep > samples)
+      keep = samples - skip;
+  }
+
+  if (wave_cut(audio_file, skip, samples - skip - keep) != CT_OK)
+    mylog(LOG_INFO,"trim: error trimming %s",audio_file);
+  else
+    mylog(LOG_DEBUG,"trim: kept %ld of %ld samples of %s, %ld ms speech",
+	  keep, samples, audio_file, v.speech*VAD_FRAME_MS);
+  return v.speech*VAD_FRAME_MS;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: post_thread
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Finishes recordings off the reactor.  Trimming the DTMF and
+	silence and converting to the client's format each read the whole
+	file, hundreds of ms for a long message at a high rate, which would
+	hold up every channel.  The reactor hands over the file with
+	post_submit and is told through the channel's post_ready when it
+	is done.
+
+\*--------------------------------------------------------------------------*/
+
+void *post_thread(void *pv) {
+  REC_JOB *j;
+  CHANNEL *ch;
+
+  while(1) {
+    pthread_mutex_lock(&post_mutex);
+    while(post_head == NULL)
+      pthread_cond_wait(&post_cond, &post_mutex);
+    j = post_head;
+    post_head = j->next;
+    if (post_head == NULL)
+      post_tail = NULL;
+    pthread_mutex_unlock(&post_mutex);
+
+    ch = j->ch;
+    ch->post_speech = post_run(j);
+    free(j);
+    __atomic_store_n(&ch->post_ready, 1, __ATOMIC_RELEASE);
+    ready_push(ch);
+  }
+
+  return NULL;
+}
+
+void post_start() {
+  pthread_t thread;
+  TONE_DET  t;
+  int       i;
+
+  // the tone detector's tables are set up on first use
+  tone_init(&t);
+  for(i=0; i<POST_THREADS; i++) {
+    pthread_create(&thread, NULL, post_thread, NULL);
+    pthread_detach(thread);
+  }
+}
+
+// reactor, queues a finished recording
+
+void post_submit(REC_JOB *j) {
+  j->next = NULL;
+  pthread_mutex_lock(&post_mutex);
+  if (post_tail)
+    post_tail->next = j;
+  else
+    post_head = j;
+  post_tail = j;
+  pthread_cond_signal(&post_cond);
+  pthread_mutex_unlock(&post_mutex);
 }
 
-// Records CID samples to a buffer
+// trims and converts the file, returns the ms of speech if the silence
+// was trimmed, else -1
 
-void *rec_thread(void *pv) {
-  THREAD_INFO *ti = (THREAD_INFO*)pv;
+long post_run(REC_JOB *j) {
+  long speech = -1;
 
-  // record buffer of samples between rings
+  trim(j->file, j->lose);
+  if (j->vad)
+    speech = trim_silence(j->file, j->live ? &j->heard : NULL, j->mark);
+  if (((j->mode != CARD_MODE) || (j->rate != CARD_RATE)) &&
+      (tc_file(j->file, j->mode, j->rate) != CT_OK))
+    mylog(LOG_INFO,"[%02d] error converting %s", j->ch->h, j->file);
 
-  vpb_record_buf_start(ti->h, VPB_LINEAR);
-  vpb_record_buf_sync(ti->h, (char*)ti->buf, sizeof(short)*CIDN);
-  vpb_record_buf_finish(ti->h);
+  return speech;
+}
+
+int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
 
-  return(NULL);
+  return 0;
 }
-			    
@@ -0,0 +1,107 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: G711.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    G.711 A-law and mu-law conversion, see g711.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "ctbackend.h"
+#include "g711.h"
+
+unsigned char linear2mulaw(short s) {
+  int sign, exponent, mantissa, x = s;
+
+  sign = (x < 0) ? 0x80 : 0;
+  if (sign)
+    x = -x;
+  if (x > 32635)
+    x = 32635;
+  x += 0x84;
+  for(exponent=7; (exponent>0) && !(x & (0x4000 >> (7-exponent))); exponent--);
+  mantissa = (x >> (exponent+3)) & 0x0f;
+  return ~(sign | (exponent << 4) | mantissa);
+}
+
+unsigned char linear2alaw(short s) {
+  int sign, exponent, mantissa, x = s;
+
+  sign = (x >= 0) ? 0x80 : 0;
+  if (!sign)
+    x = -x - 1;
+  if (x > 32767)
+    x = 32767;
+  for(exponent=7; (exponent>0) && !(x & (0x4000 >> (7-exponent))); exponent--);
+  if (exponent == 0)
+    mantissa = (x >> 4) & 0x0f;
+  else
+    mantissa = (x >> (exponent+3)) & 0x0f;
+  return (sign | (exponent << 4) | mantissa) ^ 0x55;
+}
+
+short mulaw2linear(unsigned char u) {
+  int x;
+
+  u = ~u;
+  x = ((((u & 0x0f) << 3) + 0x84) << ((u & 0x70) >> 4)) - 0x84;
+  return (u & 0x80) ? -x : x;
+}
+
+short alaw2linear(unsigned char a) {
+  int x, exponent;
+
+  a ^= 0x55;
+  exponent = (a & 0x70) >> 4;
+  x = (a & 0x0f) << 4;
+  if (exponent == 0)
+    x += 8;
+  else
+    x = (x + 0x108) << (exponent-1);
+  return (a & 0x80) ? x : -x;
+}
+
+void g711_to_linear(short *out, const char *in, long n, int mode) {
+  const unsigned char *p = (const unsigned char*)in;
+  long                i;
+
+  switch(mode) {
+  case CT_MULAW:
+    for(i=0; i<n; i++)
+      out[i] = mulaw2linear(p[i]);
+    break;
+  case CT_ALAW:
+    for(i=0; i<n; i++)
+      out[i] = alaw2linear(p[i]);
+    break;
+  default:
+    memcpy(out, in, n*sizeof(short));
+    break;
+  }
+}
@@ -0,0 +1,46 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: G711.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    G.711 A-law and mu-law conversion.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __G711__
+#define __G711__
+
+unsigned char linear2mulaw(short s);
+unsigned char linear2alaw(short s);
+short mulaw2linear(unsigned char u);
+short alaw2linear(unsigned char a);
+
+// converts n samples in CT_xxx mode to linear
+void g711_to_linear(short *out, const char *in, long n, int mode);
+
+#endif
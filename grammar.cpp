@@ -0,0 +1,405 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: GRAMMAR.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Digit grammar compiler, see grammar.h.  The expression is parsed to a
+    tree, and the DFA built straight from the tree with the followpos
+    construction (Aho, Sethi and Ullman 3.9), each DFA state being a set
+    of positions, the leaves of the tree.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ctbackend.h"
+#include "grammar.h"
+
+#define MAX_NODES          512
+#define MAX_POS            128    // leaves, including the end marker
+#define MAX_REPEAT         32
+
+#define NODE_LEAF          0
+#define NODE_EMPTY         1
+#define NODE_CAT           2
+#define NODE_ALT           3
+#define NODE_OPT           4
+#define NODE_PLUS          5
+
+typedef struct {
+  unsigned long long w[MAX_POS/64];
+} POSSET;
+
+typedef struct {
+  int            type;
+  int            left, right;
+  unsigned short mask;             // leaf, the keys it matches
+  int            nullable;
+  POSSET         first, last;
+} NODE;
+
+typedef struct {
+  const char     *s;
+  int            err;
+  NODE           node[MAX_NODES];
+  int            nnodes;
+  unsigned short mask[MAX_POS];
+  POSSET         follow[MAX_POS];
+  int            npos;
+} PARSE;
+
+static const char symbols[] = "0123456789*#ABCD";
+
+static int parse_alt(PARSE *p);
+
+static int symbol(char digit) {
+  const char *s;
+
+  if (digit == 0)
+    return -1;
+  s = strchr(symbols, toupper(digit));
+  return s ? s - symbols : -1;
+}
+
+static void set_or(POSSET *a, const POSSET *b) {
+  for(int i=0; i<MAX_POS/64; i++)
+    a->w[i] |= b->w[i];
+}
+
+static int set_has(const POSSET *a, int pos) {
+  return (a->w[pos/64] >> (pos%64)) & 1;
+}
+
+static int new_node(PARSE *p, int type, int left, int right) {
+  NODE *n;
+
+  if (p->err || (p->nnodes == MAX_NODES)) {
+    p->err = 1;
+    return 0;
+  }
+  n = &p->node[p->nnodes];
+  memset(n, 0, sizeof(NODE));
+  n->type = type;
+  n->left = left;
+  n->right = right;
+  return p->nnodes++;
+}
+
+static int leaf(PARSE *p, unsigned short mask) {
+  int n = new_node(p, NODE_LEAF, 0, 0);
+
+  p->node[n].mask = mask;
+  return n;
+}
+
+static int copy(PARSE *p, int i) {
+  NODE *n = &p->node[i];
+  int  l = 0, r = 0;
+
+  if ((n->type != NODE_LEAF) && (n->type != NODE_EMPTY)) {
+    l = copy(p, n->left);
+    if ((n->type == NODE_CAT) || (n->type == NODE_ALT))
+      r = copy(p, n->right);
+  }
+  l = new_node(p, n->type, l, r);
+  p->node[l].mask = p->node[i].mask;
+  return l;
+}
+
+// a{n,m}, m of -1 for no upper limit
+
+static int repeat(PARSE *p, int a, int n, int m) {
+  int r, i;
+
+  if ((n > MAX_REPEAT) || (m > MAX_REPEAT) || ((m != -1) && (m < n))) {
+    p->err = 1;
+    return 0;
+  }
+
+  r = new_node(p, NODE_EMPTY, 0, 0);
+  for(i=0; i<n; i++)
+    r = new_node(p, NODE_CAT, r, copy(p, a));
+  if (m == -1)
+    r = new_node(p, NODE_CAT, r,
+		 new_node(p, NODE_OPT, new_node(p, NODE_PLUS, copy(p, a), 0),
+			  0));
+  else
+    for(; i<m; i++)
+      r = new_node(p, NODE_CAT, r, new_node(p, NODE_OPT, copy(p, a), 0));
+
+  return r;
+}
+
+static int number(PARSE *p) {
+  int n = 0;
+
+  if (!isdigit(*p->s))
+    p->err = 1;
+  while(isdigit(*p->s) && (n <= MAX_REPEAT))
+    n = n*10 + *p->s++ - '0';
+  return n;
+}
+
+static unsigned short klass(PARSE *p) {
+  unsigned short mask = 0;
+  int            not_ = 0, lo, hi;
+
+  if (*p->s == '^') {
+    not_ = 1;
+    p->s++;
+  }
+  while(*p->s && (*p->s != ']')) {
+    if ((lo = symbol(*p->s++)) < 0)
+      p->err = 1;
+    hi = lo;
+    if ((*p->s == '-') && p->s[1] && (p->s[1] != ']')) {
+      hi = symbol(p->s[1]);
+      p->s += 2;
+    }
+    if ((lo < 0) || (hi < lo)) {
+      p->err = 1;
+      return 0;
+    }
+    for(; lo<=hi; lo++)
+      mask |= 1 << lo;
+  }
+  if (*p->s++ != ']')
+    p->err = 1;
+  if (not_)
+    mask = ~mask;
+  if (mask == 0)
+    p->err = 1;
+
+  return mask;
+}
+
+static int parse_atom(PARSE *p) {
+  int  a, n, m, sym;
+  char c = *p->s++;
+
+  if (c == '(') {
+    a = parse_alt(p);
+    if (*p->s++ != ')')
+      p->err = 1;
+  }
+  else if (c == '[')
+    a = leaf(p, klass(p));
+  else if (c == '.')
+    a = leaf(p, 0xffff);
+  else if ((sym = symbol(c)) >= 0)
+    a = leaf(p, 1 << sym);
+  else {
+    p->err = 1;
+    return 0;
+  }
+
+  while(!p->err) {
+    if (*p->s == '?')
+      a = new_node(p, NODE_OPT, a, 0);
+    else if (*p->s == '+')
+      a = new_node(p, NODE_PLUS, a, 0);
+    else if (*p->s == '{') {
+      p->s++;
+      n = m = number(p);
+      if (*p->s == ',') {
+	p->s++;
+	m = (*p->s == '}') ? -1 : number(p);
+      }
+      if (*p->s != '}')
+	p->err = 1;
+      a = repeat(p, a, n, m);
+    }
+    else
+      break;
+    p->s++;
+  }
+
+  return a;
+}
+
+static int parse_seq(PARSE *p) {
+  int r = -1;
+
+  while(!p->err && *p->s && (*p->s != '|') && (*p->s != ')'))
+    r = (r == -1) ? parse_atom(p) : new_node(p, NODE_CAT, r, parse_atom(p));
+
+  return (r == -1) ? new_node(p, NODE_EMPTY, 0, 0) : r;
+}
+
+static int parse_alt(PARSE *p) {
+  int r = parse_seq(p);
+
+  while(!p->err && (*p->s == '|')) {
+    p->s++;
+    r = new_node(p, NODE_ALT, r, parse_seq(p));
+  }
+
+  return r;
+}
+
+// nullable, firstpos and lastpos of the tree under i, numbering the
+// leaves as it goes and filling in followpos
+
+static void positions(PARSE *p, int i) {
+  NODE *n = &p->node[i], *l, *r;
+  int  pos;
+
+  if (n->type == NODE_LEAF) {
+    if (p->npos == MAX_POS) {
+      p->err = 1;
+      return;
+    }
+    pos = p->npos++;
+    p->mask[pos] = n->mask;
+    n->first.w[pos/64] |= 1ULL << (pos%64);
+    n->last = n->first;
+    return;
+  }
+  if (n->type == NODE_EMPTY) {
+    n->nullable = 1;
+    return;
+  }
+
+  positions(p, n->left);
+  l = &p->node[n->left];
+  n->first = l->first;
+  n->last = l->last;
+  n->nullable = l->nullable;
+
+  switch(n->type) {
+  case NODE_CAT:
+    positions(p, n->right);
+    r = &p->node[n->right];
+    for(pos=0; pos<p->npos; pos++)
+      if (set_has(&l->last, pos))
+	set_or(&p->follow[pos], &r->first);
+    if (l->nullable)
+      set_or(&n->first, &r->first);
+    n->last = r->last;
+    if (r->nullable)
+      set_or(&n->last, &l->last);
+    n->nullable = l->nullable && r->nullable;
+    break;
+  case NODE_ALT:
+    positions(p, n->right);
+    r = &p->node[n->right];
+    set_or(&n->first, &r->first);
+    set_or(&n->last, &r->last);
+    n->nullable |= r->nullable;
+    break;
+  case NODE_OPT:
+    n->nullable = 1;
+    break;
+  case NODE_PLUS:
+    for(pos=0; pos<p->npos; pos++)
+      if (set_has(&l->last, pos))
+	set_or(&p->follow[pos], &l->first);
+    break;
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: gram_compile
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Compiles src to a DFA in g.  Returns CT_ERROR if src isn't a grammar,
+	or needs more than GRAM_STATES states or MAX_POS keys.
+
+\*--------------------------------------------------------------------------*/
+
+int gram_compile(GRAMMAR *g, const char *src) {
+  PARSE  *p;
+  POSSET sets[GRAM_STATES], u;
+  int    root, end, s, c, pos, t;
+
+  g->nstates = 0;
+  p = (PARSE*)calloc(1, sizeof(PARSE));
+  p->s = src;
+  root = parse_alt(p);
+  if (*p->s)
+    p->err = 1;
+  end = leaf(p, 0);
+  root = new_node(p, NODE_CAT, root, end);
+  if (!p->err)
+    positions(p, root);
+  if (p->err) {
+    free(p);
+    return CT_ERROR;
+  }
+  end = p->npos - 1;
+
+  sets[0] = p->node[root].first;
+  g->nstates = 1;
+  for(s=0; s<g->nstates; s++) {
+    g->accept[s] = set_has(&sets[s], end);
+    g->final[s] = g->accept[s];
+    for(c=0; c<GRAM_SYMBOLS; c++) {
+      memset(&u, 0, sizeof(u));
+      for(pos=0; pos<end; pos++)
+	if (set_has(&sets[s], pos) && (p->mask[pos] & (1 << c)))
+	  set_or(&u, &p->follow[pos]);
+
+      g->next[s][c] = GRAM_DEAD;
+      for(t=0; t<MAX_POS/64; t++)
+	if (u.w[t])
+	  break;
+      if (t == MAX_POS/64)
+	continue;
+
+      for(t=0; t<g->nstates; t++)
+	if (memcmp(&sets[t], &u, sizeof(u)) == 0)
+	  break;
+      if (t == g->nstates) {
+	if (t == GRAM_STATES) {
+	  g->nstates = 0;
+	  free(p);
+	  return CT_ERROR;
+	}
+	sets[g->nstates++] = u;
+      }
+      g->next[s][c] = t;
+      g->final[s] = 0;
+    }
+  }
+
+  free(p);
+  return CT_OK;
+}
+
+// the state after digit, GRAM_DEAD once the digits can't match
+
+int gram_step(GRAMMAR *g, int state, char digit) {
+  int c = symbol(digit);
+
+  if ((state == GRAM_DEAD) || (c < 0))
+    return GRAM_DEAD;
+  return g->next[state][c];
+}
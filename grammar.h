@@ -0,0 +1,65 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: GRAMMAR.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Digit grammars for ctcollect.  A grammar is a regular expression over
+    the DTMF keys that is compiled to a DFA, so collecting can stop the
+    moment the digits are a match that no further digit could extend, or
+    can no longer match at all, rather than at a time out.
+
+      1|2|9#          alternatives
+      [1-4]           any one of, [^0] any but
+      .               any key
+      ( )             grouping
+      ? +             optional, one or more
+      {n} {n,} {n,m}  repeats
+
+    * is the star key, not repetition, use (x+)? for "any number of".
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __GRAMMAR__
+#define __GRAMMAR__
+
+#define GRAM_SYMBOLS       16     // 0-9 * # A-D
+#define GRAM_STATES        64
+#define GRAM_DEAD          255    // no match possible
+
+typedef struct {
+  int           nstates;          // 0 for no grammar
+  unsigned char next[GRAM_STATES][GRAM_SYMBOLS];
+  unsigned char accept[GRAM_STATES];
+  unsigned char final[GRAM_STATES]; // accepts, and nothing longer would
+} GRAMMAR;
+
+// state 0 is the start state
+int gram_compile(GRAMMAR *g, const char *src);
+int gram_step(GRAMMAR *g, int state, char digit);
+
+#endif
@@ -0,0 +1,182 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: GRAMMARTEST.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Tests for the digit grammar compiler (grammar.cpp).  Each example in
+    grammar.h is compiled and fed digits, and after every digit the
+    state is checked to be accepting, final or dead as it should be.
+    Grammars past the compiler's limits, or that don't parse, must be
+    refused.  Exits 1 if any case fails, run by make test.
+
+\*---------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ctbackend.h"
+#include "grammar.h"
+
+// after each digit: a accepts, f accepts and is final, d dead, - neither
+
+typedef struct {
+  const char *src;
+  const char *digits;
+  const char *expect;
+} CASE;
+
+static const CASE cases[] = {
+  // alternatives
+  {"1|2|9#",         "1",       "f"},
+  {"1|2|9#",         "2",       "f"},
+  {"1|2|9#",         "9#",      "-f"},
+  {"1|2|9#",         "3",       "d"},
+  {"1|2|9#",         "99",      "-d"},
+  {"1|2|9#",         "12",      "fd"},
+
+  // classes
+  {"[1-4]",          "4",       "f"},
+  {"[1-4]",          "5",       "d"},
+  {"[^0]",           "7",       "f"},
+  {"[^0]",           "#",       "f"},
+  {"[^0]",           "0",       "d"},
+  {"..",             "*D",      "-f"},
+
+  // * is a key
+  {"*9",             "*9",      "-f"},
+  {"*9",             "9",       "d"},
+
+  // repeats
+  {"1{2}",           "111",     "-fd"},
+  {"1{2,}",          "1111",    "-aaa"},
+  {"1{2,3}",         "1111",    "-afd"},
+  {"[0-9]{4}#",      "1234#",   "----f"},
+  {"[0-9]{1,4}#",    "12#",     "--f"},
+  {"[0-9]{1,4}#",    "12345",   "----d"},
+
+  // optional, one or more, and any number of
+  {"12?",            "12",      "af"},
+  {"12?",            "13",      "ad"},
+  {"5+",             "555",     "aaa"},
+  {"(5+)?",          "55",      "aa"},
+  {"(5+)?",          "56",      "ad"},
+  {"(12+)?3",        "12223",   "----f"},
+  {"(12+)?3",        "3",       "f"},
+  {"(12+)?3",        "13",      "-d"},
+  {"0(1|23)*",       "023*",    "---f"},
+};
+
+#define NUM_CASES (int)(sizeof(cases)/sizeof(cases[0]))
+
+// refused, too big for the compiler or not a grammar
+
+static const char *bad[] = {
+  "1{33}",                      // more than MAX_REPEAT
+  "1{2,33}",
+  "1{3,2}",
+  "(12345){26}",                // more than MAX_POS keys
+  ".{32}.{32}.",                // more than GRAM_STATES states
+  "(12",
+  "12)",
+  "[5-1]",
+  "[]",
+  "1{2",
+  "{2}",
+  "1|x",
+};
+
+#define NUM_BAD (int)(sizeof(bad)/sizeof(bad[0]))
+
+// just inside the limits
+
+static const char *good[] = {
+  "1{32}",
+  ".{31}.{31}",
+  "(1|2|3|4){31}",
+  "",
+};
+
+#define NUM_GOOD (int)(sizeof(good)/sizeof(good[0]))
+
+static GRAMMAR g;
+
+static char state_class(int state) {
+  if (state == GRAM_DEAD)
+    return 'd';
+  if (g.final[state])
+    return 'f';
+  if (g.accept[state])
+    return 'a';
+  return '-';
+}
+
+static int run_case(const CASE *c) {
+  char got[CT_MAX_STR];
+  int  state = 0, i;
+
+  if (gram_compile(&g, c->src) != CT_OK) {
+    printf("grammartest: %s doesn't compile\n", c->src);
+    return 1;
+  }
+  for(i=0; c->digits[i]; i++) {
+    state = gram_step(&g, state, c->digits[i]);
+    got[i] = state_class(state);
+  }
+  got[i] = 0;
+
+  if (strcmp(got, c->expect)) {
+    printf("grammartest: %s on %s gave %s, expected %s\n", c->src,
+	   c->digits, got, c->expect);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int failed = 0, i;
+
+  for(i=0; i<NUM_CASES; i++)
+    failed += run_case(&cases[i]);
+
+  for(i=0; i<NUM_BAD; i++)
+    if (gram_compile(&g, bad[i]) != CT_ERROR) {
+      printf("grammartest: %s compiled, expected an error\n", bad[i]);
+      failed++;
+    }
+
+  for(i=0; i<NUM_GOOD; i++)
+    if (gram_compile(&g, good[i]) != CT_OK) {
+      printf("grammartest: %s doesn't compile\n", good[i]);
+      failed++;
+    }
+
+  printf("grammartest: %d cases, %d failed\n", NUM_CASES + NUM_BAD + NUM_GOOD,
+	 failed);
+
+  return failed ? 1 : 0;
+}
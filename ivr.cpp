@@ -0,0 +1,383 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: IVR.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Menu script compiler and cache, see ivr.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "ivr.h"
+#include "say.h"
+
+#define IVR_CACHE          32     // programs kept once no run uses them
+#define MAX_LABELS         64
+#define MAX_NAME           32
+#define MAX_STATEMENT      256
+#define MAX_TOKENS         (IVR_ARGS+4)
+
+typedef struct {
+  char name[MAX_NAME];
+  int  pc;
+} LABEL;
+
+typedef struct {
+  IVR_PROG *p;
+  int      ntext;
+  char     vars[IVR_VARS][MAX_NAME];
+  int      nvars;
+  LABEL    labels[MAX_LABELS];
+  int      nlabels;
+  char     *err;
+  int      errlen;
+} COMPILE;
+
+typedef struct {
+  const char *name;
+  int        op;
+  int        var;                // first token names a variable
+  int        min, max;           // arguments after the variable
+} KEYWORD;
+
+static const KEYWORD keywords[] = {
+  {"play",    IVR_PLAY,    0, 1, IVR_ARGS},
+  {"say",     IVR_SAY,     0, 2, 2},
+  {"collect", IVR_COLLECT, 1, 3, 3},
+  {"record",  IVR_RECORD,  0, 3, 3},
+  {"sleep",   IVR_SLEEP,   0, 1, 1},
+  {"dial",    IVR_DIAL,    0, 1, 1},
+  {"clear",   IVR_CLEAR,   0, 0, 0},
+  {"answer",  IVR_ANSWER,  0, 0, 0},
+  {"hangup",  IVR_HANGUP,  0, 0, 0},
+  {"set",     IVR_SET,     1, 1, 1},
+  {"if",      IVR_IF,      0, 5, 5},
+  {"goto",    IVR_GOTO,    0, 1, 1},
+  {"callout", IVR_CALLOUT, 1, 0, IVR_ARGS},
+  {"end",     IVR_END,     0, 0, IVR_ARGS},
+  {NULL,      0,           0, 0, 0}
+};
+
+static const char *says[] = {"number", "digits", "spell", "date", NULL};
+static const char *cmps[] = {"==", "!=", "<", ">", NULL};
+
+static IVR_PROG *cache;
+
+static int find(const char **names, const char *s) {
+  for(int i=0; names[i]; i++)
+    if (strcmp(names[i], s) == 0)
+      return i;
+  return -1;
+}
+
+static int var(COMPILE *c, const char *name) {
+  int i;
+
+  if (*name == '$')
+    name++;
+  if ((*name == 0) || (strlen(name) >= MAX_NAME))
+    return -1;
+  for(i=0; i<c->nvars; i++)
+    if (strcmp(c->vars[i], name) == 0)
+      return i;
+  if (c->nvars == IVR_VARS)
+    return -1;
+  strcpy(c->vars[c->nvars], name);
+  return c->nvars++;
+}
+
+static int literal(COMPILE *c, const char *s) {
+  int at = c->ntext;
+
+  strcpy(c->p->text + at, s);
+  c->ntext += strlen(s) + 1;
+  return at;
+}
+
+static int operand(COMPILE *c, IVR_OP *op, const char *s) {
+  int v;
+
+  if (*s != '$')
+    op->arg[op->narg++] = literal(c, s);
+  else if ((v = var(c, s)) != -1)
+    op->arg[op->narg++] = -1 - v;
+  else {
+    snprintf(c->err, c->errlen, "bad variable %s", s);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int statement(COMPILE *c, char *s) {
+  char          *tok[MAX_TOKENS+1];
+  int           n, i, first;
+  const KEYWORD *k;
+  IVR_OP        *op;
+
+  for(n=0, s=strtok(s, " \t\r"); s && (n <= MAX_TOKENS);
+      s=strtok(NULL, " \t\r"))
+    tok[n++] = s;
+  if ((n == 0) || (*tok[0] == '#'))
+    return 0;
+  if (n > MAX_TOKENS) {
+    snprintf(c->err, c->errlen, "too many words");
+    return -1;
+  }
+
+  i = strlen(tok[0]);
+  if ((n == 1) && (i > 1) && (tok[0][i-1] == ':')) {
+    tok[0][i-1] = 0;
+    for(i=0; i<c->nlabels; i++)
+      if (strcmp(c->labels[i].name, tok[0]) == 0)
+	break;
+    if ((i < c->nlabels) || (c->nlabels == MAX_LABELS) ||
+	(strlen(tok[0]) >= MAX_NAME)) {
+      snprintf(c->err, c->errlen, "bad label %s", tok[0]);
+      return -1;
+    }
+    strcpy(c->labels[i].name, tok[0]);
+    c->labels[c->nlabels++].pc = c->p->nops;
+    return 0;
+  }
+
+  for(k=keywords; k->name; k++)
+    if (strcmp(k->name, tok[0]) == 0)
+      break;
+  if (k->name == NULL) {
+    snprintf(c->err, c->errlen, "unknown statement %s", tok[0]);
+    return -1;
+  }
+  first = 1 + k->var;
+  if ((n < first) || (n - first < k->min) || (n - first > k->max)) {
+    snprintf(c->err, c->errlen, "wrong number of words for %s", k->name);
+    return -1;
+  }
+
+  op = &c->p->ops[c->p->nops++];
+  memset(op, 0, sizeof(IVR_OP));
+  op->op = k->op;
+  if (k->var) {
+    if ((i = var(c, tok[1])) == -1) {
+      snprintf(c->err, c->errlen, "bad variable %s", tok[1]);
+      return -1;
+    }
+    op->var = i;
+  }
+
+  switch(k->op) {
+  case IVR_SAY:
+    if ((i = find(says, tok[1])) == -1) {
+      snprintf(c->err, c->errlen, "can't say %s", tok[1]);
+      return -1;
+    }
+    op->cmp = i;
+    first = 2;
+    break;
+  case IVR_IF:
+    if (((i = find(cmps, tok[2])) == -1) || strcmp(tok[4], "goto")) {
+      snprintf(c->err, c->errlen, "if needs a ==|!=|<|> b goto label");
+      return -1;
+    }
+    op->cmp = i;
+    op->target = literal(c, tok[5]);
+    if (operand(c, op, tok[1]) || operand(c, op, tok[3]))
+      return -1;
+    first = n;
+    break;
+  case IVR_GOTO:
+    op->target = literal(c, tok[1]);
+    first = n;
+    break;
+  }
+
+  for(i=first; i<n; i++)
+    if (operand(c, op, tok[i]))
+      return -1;
+
+  return 0;
+}
+
+// goto and if name their label as a literal until every label is known
+
+static int resolve(COMPILE *c) {
+  IVR_OP *op;
+  int    i, j;
+
+  for(i=0; i<c->p->nops; i++) {
+    op = &c->p->ops[i];
+    if ((op->op != IVR_IF) && (op->op != IVR_GOTO))
+      continue;
+    for(j=0; j<c->nlabels; j++)
+      if (strcmp(c->labels[j].name, c->p->text + op->target) == 0)
+	break;
+    if (j == c->nlabels) {
+      snprintf(c->err, c->errlen, "no label %s", c->p->text + op->target);
+      return -1;
+    }
+    op->target = c->labels[j].pc;
+  }
+
+  return 0;
+}
+
+static IVR_PROG *compile(const char *src, int n, char *err, int errlen) {
+  COMPILE  c;
+  IVR_PROG *p;
+  char     s[MAX_STATEMENT];
+  int      i, start, line, nstat;
+
+  for(i=0, nstat=1; i<n; i++)
+    if ((src[i] == '\n') || (src[i] == ';'))
+      nstat++;
+
+  p = (IVR_PROG*)calloc(1, sizeof(IVR_PROG));
+  p->ops = (IVR_OP*)malloc((nstat+1)*sizeof(IVR_OP));
+  p->text = (char*)malloc(n + nstat*2 + 1);
+  memset(&c, 0, sizeof(c));
+  c.p = p;
+  c.err = err;
+  c.errlen = errlen;
+  var(&c, "result");
+
+  for(i=0, start=0, line=1; i<=n; i++) {
+    if ((i < n) && (src[i] != '\n') && (src[i] != ';'))
+      continue;
+    if (i - start >= MAX_STATEMENT) {
+      snprintf(err, errlen, "line %d: too long", line);
+      break;
+    }
+    memcpy(s, src+start, i-start);
+    s[i-start] = 0;
+    if (statement(&c, s)) {
+      snprintf(s, sizeof(s), "line %d: %s", line, err);
+      snprintf(err, errlen, "%s", s);
+      break;
+    }
+    if ((i < n) && (src[i] == '\n'))
+      line++;
+    start = i+1;
+  }
+
+  if ((i <= n) || resolve(&c)) {
+    free(p->ops);
+    free(p->text);
+    free(p);
+    return NULL;
+  }
+
+  // running off the end is an end with no text
+  memset(&p->ops[p->nops], 0, sizeof(IVR_OP));
+  p->ops[p->nops++].op = IVR_END;
+  return p;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: ivr_load
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Returns the compiled program for the n characters of script in src,
+	compiling it only if it isn't cached.  NULL with the reason in err
+	if it doesn't compile.  The caller holds a reference until
+	ivr_release.
+
+\*--------------------------------------------------------------------------*/
+
+IVR_PROG *ivr_load(const char *src, int n, char *err, int errlen) {
+  IVR_PROG           *p, *prev, *last, *last_prev;
+  unsigned long long hash = 14695981039346656037ULL;
+  int                i, cached;
+
+  // FNV-1a
+  for(i=0; i<n; i++)
+    hash = (hash ^ (unsigned char)src[i]) * 1099511628211ULL;
+
+  for(prev=NULL, p=cache; p; prev=p, p=p->next)
+    if ((p->hash == hash) && (p->src_n == n) && !memcmp(p->src, src, n))
+      break;
+
+  if (p) {
+    if (prev) {
+      prev->next = p->next;
+      p->next = cache;
+      cache = p;
+    }
+    p->refs++;
+    return p;
+  }
+
+  if ((p = compile(src, n, err, errlen)) == NULL)
+    return NULL;
+  p->hash = hash;
+  p->src = (char*)malloc(n);
+  memcpy(p->src, src, n);
+  p->src_n = n;
+  p->refs = 1;
+  p->next = cache;
+  cache = p;
+
+  // the least recently used program nothing is running goes
+  for(cached=0, p=cache; p; p=p->next)
+    cached++;
+  if (cached > IVR_CACHE) {
+    last = last_prev = NULL;
+    for(prev=NULL, p=cache; p; prev=p, p=p->next)
+      if (p->refs == 0) {
+	last = p;
+	last_prev = prev;
+      }
+    if (last) {
+      if (last_prev)
+	last_prev->next = last->next;
+      else
+	cache = last->next;
+      free(last->src);
+      free(last->ops);
+      free(last->text);
+      free(last);
+    }
+  }
+
+  return cache;
+}
+
+void ivr_release(IVR_PROG *p) {
+  p->refs--;
+}
+
+// the text of an op's argument
+
+const char *ivr_arg(IVR_PROG *p, int arg, char vars[][IVR_VALUE]) {
+  if (arg < 0)
+    return vars[-1-arg];
+  return p->text + arg;
+}
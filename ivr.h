@@ -0,0 +1,114 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: IVR.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Menu scripts for ctrunscript.  A client sends a whole menu once and the
+    server runs it, so the steps of a menu cost no round trips.  Scripts
+    are compiled to a list of ops and kept in a cache keyed by a hash of
+    their text, so a script sent for every call is compiled once.  One
+    statement per line, or separated by ';':
+
+      # comment
+      menu:                            a label
+      play file...                     ctplaylist
+      say number|digits|spell|date v   ctsaynumber etc.
+      collect var digits secs inter    ctcollect, digits may be a grammar
+      record file secs term            ctrecord
+      sleep secs                       ctsleep
+      dial number                      ctdial
+      clear | answer | hangup          ctclear etc.
+      set var value
+      if value ==|!=|<|> value goto label, < and > compare numbers
+      goto label
+      callout var text...              asks the client, answer in var
+      end [text...]                    the reply, OK if none is given
+
+    $name is a variable, $result the reply to the last step.  Variables
+    start empty for each run.
+
+    This module only compiles, ctserver runs the ops on a channel.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __IVR__
+#define __IVR__
+
+#define IVR_VARS           16     // including result
+#define IVR_VALUE          100    // a variable, NUL included
+#define IVR_ARGS           8
+#define IVR_RESULT         0      // var the last step's reply goes in
+
+// ops
+#define IVR_END            0
+#define IVR_PLAY           1
+#define IVR_SAY            2      // cmp is SAY_xxx
+#define IVR_COLLECT        3
+#define IVR_RECORD         4
+#define IVR_SLEEP          5
+#define IVR_DIAL           6
+#define IVR_CLEAR          7
+#define IVR_ANSWER         8
+#define IVR_HANGUP         9
+#define IVR_SET            10
+#define IVR_IF             11
+#define IVR_GOTO           12
+#define IVR_CALLOUT        13
+
+// IVR_IF comparisons
+#define IVR_EQ             0
+#define IVR_NE             1
+#define IVR_LT             2
+#define IVR_GT             3
+
+// an argument is an offset into the program's text, or -1-n for var n
+typedef struct {
+  unsigned char  op;
+  unsigned char  cmp;
+  unsigned char  var;            // set, collect and callout
+  unsigned char  narg;
+  int            target;         // if and goto
+  int            arg[IVR_ARGS];
+} IVR_OP;
+
+typedef struct IVR_PROG {
+  struct IVR_PROG    *next;      // cache, most recently used first
+  unsigned long long hash;
+  int                refs;       // runs using it
+  char               *src;
+  int                src_n;
+  IVR_OP             *ops;
+  int                nops;
+  char               *text;      // literal arguments
+} IVR_PROG;
+
+IVR_PROG *ivr_load(const char *src, int n, char *err, int errlen);
+void ivr_release(IVR_PROG *p);
+const char *ivr_arg(IVR_PROG *p, int arg, char vars[][IVR_VALUE]);
+
+#endif
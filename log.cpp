@@ -0,0 +1,308 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: LOG.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Logging off the call path.  mylog() formats into a slot of a fixed
+    ring that any thread can add to without a lock, events are stored as
+    they are.  A writer thread empties the ring to the console or syslog,
+    so a slow syslog daemon or terminal never holds up a port.
+
+    Messages below the log level are dropped before they are formatted,
+    and LOG_INFO and less important messages are limited to LOG_RATE a
+    second.  Anything dropped is counted and reported by the writer.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2001 David Rowe david@voicetronix.com.au
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "log.h"
+
+#define LOG_SLOTS          1024         // a power of 2
+#define LOG_RATE           500          // LOG_INFO and below, per second
+
+#define LOG_TEXT           0
+#define LOG_EVENT          1
+
+typedef struct {
+  unsigned int seq;                     // slot is ready when seq == pos+1
+  int          level;
+  int          kind;                    // LOG_TEXT or LOG_EVENT
+  CT_EVENT     e;
+  char         text[CT_MAX_STR];
+} LOG_SLOT;
+
+static LOG_SLOT      ring[LOG_SLOTS];
+static unsigned int  enq_pos;           // next slot to fill, any thread
+static unsigned int  deq_pos;           // next slot to write, writer only
+static sem_t         sem;               // posted once per filled slot
+static pthread_t     writer;
+static int           running;
+static int           stopping;
+static int           use_syslog;
+static int           log_level = LOG_DEBUG;
+static unsigned int  dropped;
+static long          rate_sec;
+static int           rate_count;
+
+static void output(int level, const char *s) {
+  if (use_syslog)
+    syslog(level, "%s", s);
+  else
+    printf("%s\n", s);
+}
+
+static void write_slot(LOG_SLOT *l) {
+  char s[CT_MAX_STR];
+
+  if (l->kind == LOG_EVENT) {
+    translate_event(&l->e, s);
+    s[strlen(s)-1] = 0;
+    output(l->level, s);
+  }
+  else
+    output(l->level, l->text);
+}
+
+static void *writer_thread(void *pv) {
+  LOG_SLOT     *l;
+  unsigned int n;
+  char         s[CT_MAX_STR];
+
+  while(1) {
+    sem_wait(&sem);
+
+    // slots can be filled out of order, stop at the first one not ready
+    // yet, its own sem_post will wake us again
+    while(1) {
+      l = &ring[deq_pos & (LOG_SLOTS-1)];
+      if (__atomic_load_n(&l->seq, __ATOMIC_ACQUIRE) != deq_pos+1)
+	break;
+      write_slot(l);
+      __atomic_store_n(&l->seq, deq_pos+LOG_SLOTS, __ATOMIC_RELEASE);
+      deq_pos++;
+    }
+
+    if ((n = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED))) {
+      sprintf(s, "%u log messages dropped", n);
+      output(LOG_WARNING, s);
+    }
+    if (!use_syslog)
+      fflush(stdout);
+
+    if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE) &&
+	(deq_pos == __atomic_load_n(&enq_pos, __ATOMIC_ACQUIRE)))
+      break;
+  }
+
+  return NULL;
+}
+
+// claims the next free slot, NULL if the writer has fallen a whole ring
+// behind
+
+static LOG_SLOT *claim(unsigned int *pos) {
+  LOG_SLOT     *l;
+  unsigned int p, seq;
+
+  p = __atomic_load_n(&enq_pos, __ATOMIC_RELAXED);
+  while(1) {
+    l = &ring[p & (LOG_SLOTS-1)];
+    seq = __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE);
+    if (seq == p) {
+      if (__atomic_compare_exchange_n(&enq_pos, &p, p+1, 1,
+				      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	*pos = p;
+	return l;
+      }
+    }
+    else if ((int)(seq - p) < 0)
+      return NULL;
+    else
+      p = __atomic_load_n(&enq_pos, __ATOMIC_RELAXED);
+  }
+}
+
+static void publish(LOG_SLOT *l, unsigned int pos) {
+  __atomic_store_n(&l->seq, pos+1, __ATOMIC_RELEASE);
+  sem_post(&sem);
+}
+
+// 1 if the message should be dropped
+
+static int limited(int level) {
+  struct timespec ts;
+  long            sec;
+
+  if (level > __atomic_load_n(&log_level, __ATOMIC_RELAXED))
+    return 1;
+  if (level < LOG_INFO)
+    return 0;
+
+  // a new second resets the count, racing threads may let a few extra
+  // messages through, which is fine
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  sec = ts.tv_sec;
+  if (sec != __atomic_load_n(&rate_sec, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&rate_sec, sec, __ATOMIC_RELAXED);
+    __atomic_store_n(&rate_count, 0, __ATOMIC_RELAXED);
+  }
+  if (__atomic_fetch_add(&rate_count, 1, __ATOMIC_RELAXED) >= LOG_RATE) {
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    return 1;
+  }
+
+  return 0;
+}
+
+void log_init(int syslog_enabled) {
+  unsigned int i;
+
+  use_syslog = syslog_enabled;
+  for(i=0; i<LOG_SLOTS; i++)
+    ring[i].seq = i;
+  enq_pos = deq_pos = 0;
+  stopping = 0;
+  sem_init(&sem, 0, 0);
+  if (pthread_create(&writer, NULL, writer_thread, NULL) == 0)
+    running = 1;
+}
+
+void log_stop() {
+  if (!running)
+    return;
+  __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+  sem_post(&sem);
+  pthread_join(writer, NULL);
+}
+
+void log_set_level(int level) {
+  if (level < LOG_EMERG)
+    level = LOG_EMERG;
+  if (level > LOG_DEBUG)
+    level = LOG_DEBUG;
+  __atomic_store_n(&log_level, level, __ATOMIC_RELAXED);
+}
+
+int log_get_level() {
+  return __atomic_load_n(&log_level, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: mylog
+	AUTHOR......: David Rowe
+	DATE CREATED: 10/10/01
+
+	Allows switching between syslog and console output of messages.
+
+\*--------------------------------------------------------------------------*/
+
+void mylog(int level, const char *fmt, ...) {
+  char         s[CT_MAX_STR];
+  LOG_SLOT     *l;
+  unsigned int pos;
+  va_list      argptr;
+
+  if (limited(level))
+    return;
+
+  if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+    va_start(argptr, fmt);
+    vsnprintf(s, sizeof(s), fmt, argptr);
+    va_end(argptr);
+    output(level, s);
+    return;
+  }
+
+  if ((l = claim(&pos)) == NULL) {
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  l->level = level;
+  l->kind = LOG_TEXT;
+  va_start(argptr, fmt);
+  vsnprintf(l->text, sizeof(l->text), fmt, argptr);
+  va_end(argptr);
+  publish(l, pos);
+}
+
+void log_event(int level, CT_EVENT *e) {
+  char         s[CT_MAX_STR];
+  LOG_SLOT     *l;
+  unsigned int pos;
+
+  if (limited(level))
+    return;
+
+  if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+    translate_event(e, s);
+    s[strlen(s)-1] = 0;
+    output(level, s);
+    return;
+  }
+
+  if ((l = claim(&pos)) == NULL) {
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  l->level = level;
+  l->kind = LOG_EVENT;
+  l->e = *e;
+  publish(l, pos);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: translate_event
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Converts an event to a string for logging, with a trailing newline
+	like vpb_translate_event().
+
+\*--------------------------------------------------------------------------*/
+
+void translate_event(CT_EVENT *e, char *s) {
+  sprintf(s, "[%02d] %s %d\n", e->handle, event_name(e->type), e->data);
+}
+
+const char *event_name(int type) {
+  static const char *names[] = {"RING", "event", "TONEDETECT", "TIMEREXP",
+				"PLAYEND", "RECORDEND", "DTMF", "DIALEND"};
+
+  if ((type >= 0) && (type <= CT_DIALEND))
+    return names[type];
+  return "event";
+}
@@ -0,0 +1,67 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: LOG.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Logging to the console or syslog.  Callers only fill a slot in a
+    ring, a writer thread does the slow part.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __LOG__
+#define __LOG__
+
+#include <syslog.h>
+#include "ctbackend.h"
+
+// starts the writer thread, after any fork().  Messages logged before
+// this, or after log_stop(), are written straight away.
+void log_init(int use_syslog);
+
+// writes anything still queued and stops the writer thread
+void log_stop();
+
+// messages less important than level (a syslog LOG_xxx) are dropped
+// before they are formatted, may be called from a signal handler
+void log_set_level(int level);
+int  log_get_level();
+
+void mylog(int level, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+// an event is queued as it is and only translated by the writer thread
+void log_event(int level, CT_EVENT *e);
+
+// "RING", "DTMF" etc, "event" for types ctserver doesn't know
+const char *event_name(int type);
+
+// converts an event to a string, with a trailing newline like
+// vpb_translate_event()
+void translate_event(CT_EVENT *e, char *s);
+
+#endif
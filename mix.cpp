@@ -0,0 +1,311 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: MIX.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Conference mixer, see mix.h.
+
+    The rings have one writer and one reader each, so they need no lock.
+    The list of conferences is changed by the reactor and walked by the
+    mixer thread under cmutex.
+
+    Mixing forms the sum of every party once, in 32 bits, and gives each
+    party the sum less its own audio, saturated back to 16 bits.  With
+    SSE2 that is eight samples at a time, so the cost per party is two
+    loads, a subtract and a pack per eight samples.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "ctbackend.h"
+#include "mix.h"
+
+#define TICK_NS            20000000     // MIX_FRAME at 8 kHz
+#define MAX_BEHIND_NS      100000000    // then we stop trying to catch up
+
+struct MIX_CONF {
+  char             name[MIX_NAME];
+  int              n, max;
+  MIX_PARTY        *parties;
+  const short      **in;                // max of each, for mix_frame
+  short            **out;
+  MIX_CONF         *next;
+};
+
+static pthread_mutex_t cmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  ccond = PTHREAD_COND_INITIALIZER;
+static MIX_CONF        *confs;
+
+/*--------------------------------------------------------------------------*\
+
+				  Rings
+
+\*--------------------------------------------------------------------------*/
+
+// producer side, returns the samples that fit
+
+static long ring_put(short *ring, unsigned int *head, unsigned int *tail,
+		     const short *x, long n) {
+  unsigned int h = *head, t = __atomic_load_n(tail, __ATOMIC_ACQUIRE);
+  long         i, room = MIX_RING - (h - t);
+
+  if (n > room)
+    n = room;
+  for(i=0; i<n; i++)
+    ring[(h+i) & (MIX_RING-1)] = x[i];
+  __atomic_store_n(head, h+n, __ATOMIC_RELEASE);
+  return n;
+}
+
+// consumer side, returns the samples read
+
+static long ring_get(short *ring, unsigned int *head, unsigned int *tail,
+		     short *x, long n) {
+  unsigned int t = *tail, h = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+  long         i;
+
+  if (n > (long)(h - t))
+    n = h - t;
+  for(i=0; i<n; i++)
+    x[i] = ring[(t+i) & (MIX_RING-1)];
+  __atomic_store_n(tail, t+n, __ATOMIC_RELEASE);
+  return n;
+}
+
+static long ring_count(unsigned int *head, unsigned int *tail) {
+  return __atomic_load_n(head, __ATOMIC_ACQUIRE) -
+    __atomic_load_n(tail, __ATOMIC_ACQUIRE);
+}
+
+void mix_in(MIX_PARTY *p, const char *buf, long n) {
+  ring_put(p->in, &p->in_head, &p->in_tail, (const short*)buf, n/2);
+}
+
+// short of audio the rest is silence
+
+void mix_out(MIX_PARTY *p, char *buf, long n) {
+  long got = ring_get(p->out, &p->out_head, &p->out_tail, (short*)buf, n/2);
+
+  memset(buf + 2*got, 0, n - 2*got);
+}
+
+/*--------------------------------------------------------------------------*\
+
+				  Mixing
+
+\*--------------------------------------------------------------------------*/
+
+void mix_frame(short *out[], const short *in[], int n) {
+  int i, k;
+
+#ifdef __SSE2__
+  __m128i x, lo, hi, ylo, yhi;
+
+  for(i=0; i<MIX_FRAME; i+=8) {
+    lo = hi = _mm_setzero_si128();
+    for(k=0; k<n; k++) {
+      x = _mm_loadu_si128((const __m128i*)(in[k]+i));
+      lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+      hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+    }
+    for(k=0; k<n; k++) {
+      x = _mm_loadu_si128((const __m128i*)(in[k]+i));
+      ylo = _mm_sub_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+      yhi = _mm_sub_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+      _mm_storeu_si128((__m128i*)(out[k]+i), _mm_packs_epi32(ylo, yhi));
+    }
+  }
+#else
+  int total[MIX_FRAME], y;
+
+  memset(total, 0, sizeof(total));
+  for(k=0; k<n; k++)
+    for(i=0; i<MIX_FRAME; i++)
+      total[i] += in[k][i];
+  for(k=0; k<n; k++)
+    for(i=0; i<MIX_FRAME; i++) {
+      y = total[i] - in[k][i];
+      out[k][i] = (y > 32767) ? 32767 : (y < -32768) ? -32768 : y;
+    }
+#endif
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: mix_tick
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Takes a frame from every party, padding with silence if its record
+	stream is late, and drops a frame when more than MIX_DEPTH have
+	built up so the delay can't grow.  The mix is only queued to play
+	if the play stream is keeping up, for the same reason.
+
+\*--------------------------------------------------------------------------*/
+
+void mix_tick() {
+  MIX_CONF  *c;
+  MIX_PARTY *p;
+  long      got;
+  int       k;
+
+  pthread_mutex_lock(&cmutex);
+  for(c=confs; c; c=c->next) {
+    for(p=c->parties, k=0; p; p=p->next, k++) {
+      if (ring_count(&p->in_head, &p->in_tail) > MIX_DEPTH*MIX_FRAME) {
+	ring_get(p->in, &p->in_head, &p->in_tail, p->fin, MIX_FRAME);
+	p->slips++;
+      }
+      got = ring_get(p->in, &p->in_head, &p->in_tail, p->fin, MIX_FRAME);
+      if (got < MIX_FRAME) {
+	memset(p->fin + got, 0, (MIX_FRAME - got)*sizeof(short));
+	p->underruns++;
+      }
+      c->in[k] = p->fin;
+      c->out[k] = p->fout;
+    }
+
+    mix_frame(c->out, c->in, c->n);
+
+    for(p=c->parties; p; p=p->next) {
+      p->frames++;
+      if (ring_count(&p->out_head, &p->out_tail) < MIX_DEPTH*MIX_FRAME)
+	ring_put(p->out, &p->out_head, &p->out_tail, p->fout, MIX_FRAME);
+      else
+	p->slips++;
+    }
+  }
+  pthread_mutex_unlock(&cmutex);
+}
+
+static void *mix_thread(void *arg) {
+  struct timespec t, now;
+  long long       behind;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  for(;;) {
+    // sleeps while there is nothing to mix
+    pthread_mutex_lock(&cmutex);
+    if (confs == NULL) {
+      while(confs == NULL)
+	pthread_cond_wait(&ccond, &cmutex);
+      clock_gettime(CLOCK_MONOTONIC, &t);
+    }
+    pthread_mutex_unlock(&cmutex);
+
+    t.tv_nsec += TICK_NS;
+    if (t.tv_nsec >= 1000000000) {
+      t.tv_nsec -= 1000000000;
+      t.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    mix_tick();
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    behind = (now.tv_sec - t.tv_sec)*1000000000LL + now.tv_nsec - t.tv_nsec;
+    if (behind > MAX_BEHIND_NS)
+      t = now;
+  }
+
+  return NULL;
+}
+
+void mix_init() {
+  pthread_t thread;
+
+  pthread_create(&thread, NULL, mix_thread, NULL);
+  pthread_detach(thread);
+}
+
+/*--------------------------------------------------------------------------*\
+
+			       Conferences
+
+\*--------------------------------------------------------------------------*/
+
+int mix_join(MIX_PARTY *p, const char *name, int max) {
+  MIX_CONF *c;
+
+  pthread_mutex_lock(&cmutex);
+  for(c=confs; c; c=c->next)
+    if (strcmp(c->name, name) == 0)
+      break;
+
+  if (c == NULL) {
+    c = (MIX_CONF*)calloc(1, sizeof(MIX_CONF));
+    strncpy(c->name, name, MIX_NAME-1);
+    c->max = max;
+    c->in = (const short**)calloc(max, sizeof(short*));
+    c->out = (short**)calloc(max, sizeof(short*));
+    c->next = confs;
+    confs = c;
+    pthread_cond_signal(&ccond);
+  }
+  else if (c->n == c->max) {
+    pthread_mutex_unlock(&cmutex);
+    return CT_ERROR;
+  }
+
+  p->in_head = p->in_tail = 0;
+  p->out_head = p->out_tail = 0;
+  p->frames = p->slips = p->underruns = 0;
+  p->conf = c;
+  p->next = c->parties;
+  c->parties = p;
+  c->n++;
+  pthread_mutex_unlock(&cmutex);
+
+  return CT_OK;
+}
+
+void mix_leave(MIX_PARTY *p) {
+  MIX_CONF  *c = p->conf, **cc;
+  MIX_PARTY **pp;
+
+  if (c == NULL)
+    return;
+
+  pthread_mutex_lock(&cmutex);
+  for(pp=&c->parties; *pp != p; pp=&(*pp)->next);
+  *pp = p->next;
+  p->conf = NULL;
+  if (--c->n == 0) {
+    for(cc=&confs; *cc != c; cc=&(*cc)->next);
+    *cc = c->next;
+    free(c->in);
+    free(c->out);
+    free(c);
+  }
+  pthread_mutex_unlock(&cmutex);
+}
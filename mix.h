@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: MIX.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Conference mixer for ctbridge and ctconference.  Each party has a
+    ring of the audio heard on its channel, filled by the record stream,
+    and a ring of what it should hear, drained by the play stream.  A
+    mixer thread takes one frame from every party every 20 ms and gives
+    each party the sum of everyone else.  The rings are kept to a few
+    frames, older audio is dropped, so the delay through the mixer is
+    fixed.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __MIX__
+#define __MIX__
+
+#define MIX_FRAME          160          // samples, 20 ms
+#define MIX_RING           1024         // samples each way, a power of 2
+#define MIX_DEPTH          3            // frames kept before dropping
+#define MIX_NAME           64
+
+typedef struct MIX_CONF MIX_CONF;
+
+typedef struct MIX_PARTY {
+  // heard on the channel, written by the record stream
+  short            in[MIX_RING];
+  unsigned int     in_head, in_tail;
+
+  // to play, written by the mixer
+  short            out[MIX_RING];
+  unsigned int     out_head, out_tail;
+
+  // owned by the mixer
+  MIX_CONF         *conf;
+  struct MIX_PARTY *next;
+  short            fin[MIX_FRAME];
+  short            fout[MIX_FRAME];
+  unsigned long    frames;              // mixed
+  unsigned long    slips;               // frames dropped to hold the delay
+  unsigned long    underruns;           // frames short of audio
+} MIX_PARTY;
+
+// starts the mixer thread
+void mix_init();
+
+// joins the named conference, creating it with room for max parties if
+// need be (2 for a bridge).  CT_ERROR if it is full.
+int  mix_join(MIX_PARTY *p, const char *name, int max);
+
+// the mixer won't touch p after this returns
+void mix_leave(MIX_PARTY *p);
+
+// linear audio in and out, from the backend's stream callbacks
+void mix_in(MIX_PARTY *p, const char *buf, long n);
+void mix_out(MIX_PARTY *p, char *buf, long n);
+
+// one frame for every conference, what the mixer thread does each 20 ms
+void mix_tick();
+
+// out[k] = sum of in[] except in[k], saturated, for one frame of n parties
+void mix_frame(short *out[], const short *in[], int n);
+
+#endif
@@ -0,0 +1,150 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: MIXBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Benchmark for the conference mixer (mix.cpp).  Sets up a number of
+    conferences, pushes a frame of audio into every party, runs
+    mix_tick() and reads every party's mix back, as the record and play
+    streams and the mixer thread would every 20 ms.  The mixes are
+    checked against a plain sum, and the CPU per party is reported.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "ctbackend.h"
+#include "mix.h"
+
+#define FS                 8000
+
+static double cpu_time() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1E9;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+// a tone per party, loud enough that big conferences saturate
+
+static void generate(short *x, int party, long f) {
+  int i;
+
+  for(i=0; i<MIX_FRAME; i++)
+    x[i] = (short)(6000*sin(2*M_PI*(200 + 50*party)*(f*MIX_FRAME + i)/FS));
+}
+
+int main(int argc, char *argv[]) {
+  int       confs = 24, parties = 4, seconds = 60, i, c, k, n;
+  MIX_PARTY *p;
+  short     (*x)[MIX_FRAME], (*y)[MIX_FRAME];
+  long      f, frames, bad = 0, want;
+  char      name[MIX_NAME];
+  double    cpu_mix = 0, cpu_io = 0, t, ns;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-conferences n] [-parties n] [-time s]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-conferences")) && (i+1 < argc))
+    confs = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-parties")) && (i+1 < argc))
+    parties = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-time")) && (i+1 < argc))
+    seconds = atoi(argv[i+1]);
+
+  n = confs*parties;
+  p = (MIX_PARTY*)calloc(n, sizeof(MIX_PARTY));
+  x = (short(*)[MIX_FRAME])malloc(parties*sizeof(*x));
+  y = (short(*)[MIX_FRAME])malloc(n*sizeof(*y));
+  for(c=0; c<confs; c++) {
+    sprintf(name, "conf%d", c);
+    for(k=0; k<parties; k++)
+      mix_join(&p[c*parties + k], name, parties);
+  }
+
+  frames = (long)seconds*FS/MIX_FRAME;
+  for(f=0; f<frames; f++) {
+    for(k=0; k<parties; k++)
+      generate(x[k], k, f);
+
+    t = cpu_time();
+    for(i=0; i<n; i++)
+      mix_in(&p[i], (char*)x[i % parties], sizeof(x[0]));
+    cpu_io += cpu_time() - t;
+
+    t = cpu_time();
+    mix_tick();
+    cpu_mix += cpu_time() - t;
+
+    t = cpu_time();
+    for(i=0; i<n; i++)
+      mix_out(&p[i], (char*)y[i], sizeof(y[0]));
+    cpu_io += cpu_time() - t;
+
+    // the mix is everyone else, saturated
+    for(i=0; i<n; i++)
+      for(k=0; k<MIX_FRAME; k++) {
+	for(want=0, c=0; c<parties; c++)
+	  if (c != i % parties)
+	    want += x[c][k];
+	want = (want > 32767) ? 32767 : (want < -32768) ? -32768 : want;
+	if (y[i][k] != want)
+	  bad++;
+      }
+  }
+
+  for(i=0; i<n; i++)
+    mix_leave(&p[i]);
+
+  ns = cpu_mix*1E9/((double)frames*n);
+  printf("%d conferences of %d, %d s, %ld samples wrong\n", confs, parties,
+	 seconds, bad);
+  printf("mix %.0f ns per party frame, ring copies %.0f ns, %.4f%% of a "
+	 "core per party\n", ns, cpu_io*1E9/((double)frames*n),
+	 100*(ns + cpu_io*1E9/((double)frames*n))/(1E9*MIX_FRAME/FS));
+
+  free(p);
+  free(x);
+  free(y);
+
+  return bad != 0;
+}
@@ -0,0 +1,264 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: PHRASE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Joined prompts and the phrase cache, see phrase.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ctbackend.h"
+#include "wave.h"
+#include "g711.h"
+#include "prompt.h"
+#include "phrase.h"
+
+#define PHRASE_HASH        256    // hash buckets, power of 2
+#define PHRASE_CACHE       512    // max phrases cached
+
+struct PHRASE {
+  PHRASE        *next;            // hash chain
+  PHRASE        *older, *newer;   // LRU list
+  char          *key;             // NULL if not cached
+  int           n;
+  PROMPT        **prompt;
+  long          *offset;          // where each prompt starts in buf
+  char          *buf;             // points into prompt[0] if n == 1
+  long          size;
+  int           mode;
+  int           refs;             // the cache holds one while cached
+};
+
+static pthread_mutex_t phmutex = PTHREAD_MUTEX_INITIALIZER;
+static PHRASE          *hash[PHRASE_HASH];
+static PHRASE          *newest, *oldest;
+static int             ncached;
+
+static unsigned int hash_key(const char *s) {
+  unsigned int h = 2166136261u;
+
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h & (PHRASE_HASH-1);
+}
+
+// the following are called with phmutex held
+
+static void unref(PHRASE *ph) {
+  int i;
+
+  if (--ph->refs)
+    return;
+  if (ph->n > 1)
+    free(ph->buf);
+  for(i=0; i<ph->n; i++)
+    prompt_release(ph->prompt[i]);
+  free(ph->prompt);
+  free(ph->offset);
+  free(ph->key);
+  free(ph);
+}
+
+static void lru_unlink(PHRASE *ph) {
+  if (ph->older)
+    ph->older->newer = ph->newer;
+  else
+    oldest = ph->newer;
+  if (ph->newer)
+    ph->newer->older = ph->older;
+  else
+    newest = ph->older;
+}
+
+static void lru_push(PHRASE *ph) {
+  ph->older = newest;
+  ph->newer = NULL;
+  if (newest)
+    newest->newer = ph;
+  else
+    oldest = ph;
+  newest = ph;
+}
+
+static void uncache(PHRASE *ph) {
+  PHRASE **pp;
+
+  for(pp=&hash[hash_key(ph->key)]; *pp != ph; pp=&(*pp)->next);
+  *pp = ph->next;
+  lru_unlink(ph);
+  ncached--;
+  unref(ph);
+}
+
+// a cached phrase is stale if any of its prompts has been reloaded
+
+static int stale(PHRASE *ph, const char **files, int n) {
+  PROMPT *p;
+  int    i, ret = 0;
+
+  if (ph->n != n)
+    return 1;
+  for(i=0; (i<n) && !ret; i++) {
+    p = prompt_get(files[i]);
+    ret = (p != ph->prompt[i]);
+    if (p)
+      prompt_release(p);
+  }
+  return ret;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: build
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Joins the prompts end to end.  A single prompt is used in place,
+	otherwise they are copied, and converted to linear if they are not
+	all in the same mode.
+
+\*--------------------------------------------------------------------------*/
+
+static PHRASE *build(const char **files, int n) {
+  PHRASE *ph;
+  long   bps, samples;
+  int    i, m;
+
+  ph = (PHRASE*)calloc(1, sizeof(PHRASE));
+  ph->prompt = (PROMPT**)calloc(n, sizeof(PROMPT*));
+  ph->offset = (long*)calloc(n, sizeof(long));
+  ph->refs = 1;
+
+  for(ph->n=0; ph->n<n; ph->n++) {
+    ph->prompt[ph->n] = prompt_get(files[ph->n]);
+    if (ph->prompt[ph->n] == NULL) {
+      unref(ph);
+      return NULL;
+    }
+  }
+
+  if (n == 1) {
+    ph->buf = (char*)prompt_buf(ph->prompt[0]);
+    ph->size = prompt_size(ph->prompt[0]);
+    ph->mode = prompt_mode(ph->prompt[0]);
+    return ph;
+  }
+
+  ph->mode = prompt_mode(ph->prompt[0]);
+  for(i=1; i<n; i++)
+    if (prompt_mode(ph->prompt[i]) != ph->mode)
+      ph->mode = CT_LINEAR;
+  bps = wave_bytes_per_sample(ph->mode);
+
+  for(i=0; i<n; i++) {
+    ph->offset[i] = ph->size;
+    m = prompt_mode(ph->prompt[i]);
+    ph->size += prompt_size(ph->prompt[i]) / wave_bytes_per_sample(m) * bps;
+  }
+  ph->buf = (char*)malloc(ph->size ? ph->size : 1);
+
+  for(i=0; i<n; i++) {
+    m = prompt_mode(ph->prompt[i]);
+    samples = prompt_size(ph->prompt[i]) / wave_bytes_per_sample(m);
+    if (m == ph->mode)
+      memcpy(ph->buf + ph->offset[i], prompt_buf(ph->prompt[i]),
+	     samples*bps);
+    else
+      g711_to_linear((short*)(ph->buf + ph->offset[i]),
+		     prompt_buf(ph->prompt[i]), samples, m);
+  }
+
+  return ph;
+}
+
+PHRASE *phrase_get(const char *key, const char **files, int n) {
+  PHRASE *ph = NULL;
+
+  if (n <= 0)
+    return NULL;
+
+  pthread_mutex_lock(&phmutex);
+
+  if (key) {
+    for(ph=hash[hash_key(key)]; ph && strcmp(ph->key, key); ph=ph->next);
+    if (ph && stale(ph, files, n)) {
+      uncache(ph);
+      ph = NULL;
+    }
+  }
+
+  if (ph) {
+    lru_unlink(ph);
+    lru_push(ph);
+    ph->refs++;
+  }
+  else {
+    ph = build(files, n);
+    if (ph && key) {
+      ph->key = strdup(key);
+      ph->next = hash[hash_key(key)];
+      hash[hash_key(key)] = ph;
+      lru_push(ph);
+      ph->refs++;
+      if (++ncached > PHRASE_CACHE)
+	uncache(oldest);
+    }
+  }
+
+  pthread_mutex_unlock(&phmutex);
+
+  return ph;
+}
+
+void phrase_release(PHRASE *ph) {
+  pthread_mutex_lock(&phmutex);
+  unref(ph);
+  pthread_mutex_unlock(&phmutex);
+}
+
+const char *phrase_buf(PHRASE *ph) {
+  return ph->buf;
+}
+
+long phrase_size(PHRASE *ph) {
+  return ph->size;
+}
+
+int phrase_mode(PHRASE *ph) {
+  return ph->mode;
+}
+
+int phrase_index(PHRASE *ph, long pos) {
+  int i;
+
+  for(i=1; (i<ph->n) && (ph->offset[i] <= pos); i++);
+  return i-1;
+}
@@ -0,0 +1,54 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: PHRASE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    A phrase is a list of prompts joined into one buffer, so it can be
+    played without gaps.  Phrases given a key are kept in an LRU cache,
+    so the readouts an IVR says over and over are only assembled once.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __PHRASE__
+#define __PHRASE__
+
+typedef struct PHRASE PHRASE;
+
+// returns a referenced phrase made of files[0..n-1], or NULL if a file
+// can't be read.  If key is not NULL the phrase is cached under it.
+PHRASE *phrase_get(const char *key, const char **files, int n);
+void    phrase_release(PHRASE *ph);
+
+const char *phrase_buf(PHRASE *ph);
+long    phrase_size(PHRASE *ph);        // bytes
+int     phrase_mode(PHRASE *ph);        // CT_xxx
+
+// index of the file playing at byte offset pos
+int     phrase_index(PHRASE *ph, long pos);
+
+#endif
@@ -0,0 +1,274 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: PROMPT.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Prompt cache, see prompt.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ctbackend.h"
+#include "transcode.h"
+#include "bundle.h"
+#include "prompt.h"
+
+#define PROMPT_HASH        256    // hash buckets, power of 2
+#define MAX_BUNDLES        8
+
+struct PROMPT {
+  PROMPT        *next;            // hash chain
+  char          *file_name;
+  char          *buf;
+  long          n;
+  int           mode;
+  int           refs;             // the cache holds one while cached
+  time_t        mtime;
+  off_t         size;
+  time_t        checked;          // last time the file was stat-ed
+  int           mapped;           // buf is in a bundle
+};
+
+// a mapped bundle, with a prompt for each index slot that is in use
+typedef struct {
+  BUNDLE        map;
+  PROMPT        *prompts;
+  size_t        dir_len;
+} PBUNDLE;
+
+static pthread_mutex_t pmutex = PTHREAD_MUTEX_INITIALIZER;
+static PROMPT          *hash[PROMPT_HASH];
+static int             lock_mem;
+static int             native_mode;
+static PBUNDLE         bundles[MAX_BUNDLES];
+static int             nbundles;
+
+static unsigned int hash_name(const char *s) {
+  unsigned int h = 2166136261u;
+
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h & (PROMPT_HASH-1);
+}
+
+void prompt_init(int lock, int mode) {
+  lock_mem = lock;
+  native_mode = mode;
+}
+
+// called with pmutex held
+
+static void unref(PROMPT *p) {
+  if (--p->refs || p->mapped)
+    return;
+  if (lock_mem)
+    munlock(p->buf, p->n);
+  free(p->buf);
+  free(p->file_name);
+  free(p);
+}
+
+// converted once here, so plays and phrases are straight copies
+
+static PROMPT *load(const char *file_name, struct stat *st) {
+  PROMPT *p;
+  char   *buf;
+  long   n;
+
+  if ((buf = tc_load(file_name, native_mode, &n)) == NULL)
+    return NULL;
+
+  p = (PROMPT*)calloc(1, sizeof(PROMPT));
+  p->buf = buf;
+  p->n = n;
+  p->mode = native_mode;
+
+  p->file_name = strdup(file_name);
+  p->mtime = st->st_mtime;
+  p->size = st->st_size;
+  p->checked = time(NULL);
+  if (lock_mem)
+    mlock(p->buf, p->n);
+
+  return p;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: prompt_bundle
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Maps a bundle built by ctbundle.  Its prompts are never reloaded or
+	dropped, each has a PROMPT that points into the mapping and holds a
+	reference for the life of the server.
+
+\*--------------------------------------------------------------------------*/
+
+int prompt_bundle(const char *file_name) {
+  PBUNDLE      *b = &bundles[nbundles];
+  BUNDLE_SLOT  *s;
+  unsigned int i;
+
+  if (nbundles == MAX_BUNDLES)
+    return CT_ERROR;
+  if (bundle_map(file_name, &b->map) != CT_OK)
+    return CT_ERROR;
+  if ((b->map.hdr->mode != (unsigned)native_mode) ||
+      (b->map.hdr->rate != 8000)) {
+    bundle_unmap(&b->map);
+    return CT_ERROR;
+  }
+
+  b->prompts = (PROMPT*)calloc(b->map.hdr->nslots, sizeof(PROMPT));
+  for(i=0; i<b->map.hdr->nslots; i++) {
+    s = &b->map.slots[i];
+    if (s->name == 0)
+      continue;
+    b->prompts[i].buf = (char*)b->map.data + s->off;
+    b->prompts[i].n = s->bytes;
+    b->prompts[i].mode = native_mode;
+    b->prompts[i].refs = 1;
+    b->prompts[i].mapped = 1;
+  }
+  b->dir_len = strlen(b->map.hdr->dir);
+  if (lock_mem)
+    mlock(b->map.hdr, b->map.size);
+
+  pthread_mutex_lock(&pmutex);
+  nbundles++;
+  pthread_mutex_unlock(&pmutex);
+
+  return CT_OK;
+}
+
+// "name", or "dir/name" where dir is what the bundle stands in for.
+// Called with pmutex held.
+
+static PROMPT *bundle_get(const char *file_name) {
+  PBUNDLE    *b;
+  const char *name;
+  int        i, slot;
+
+  for(i=0; i<nbundles; i++) {
+    b = &bundles[i];
+    name = file_name;
+    if (strchr(name, '/')) {
+      if (!b->dir_len || strncmp(name, b->map.hdr->dir, b->dir_len) ||
+	  (name[b->dir_len] != '/'))
+	continue;
+      name += b->dir_len + 1;
+    }
+    if ((slot = bundle_find(&b->map, name)) != -1)
+      return &b->prompts[slot];
+  }
+
+  return NULL;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: prompt_get
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Looks up a prompt, loading it on a miss.  Cached prompts are checked
+	against the file at most once a second, and reloaded if the file
+	has changed.  Bundled prompts are found first, and never touch the
+	file system.
+
+\*--------------------------------------------------------------------------*/
+
+PROMPT *prompt_get(const char *file_name) {
+  unsigned int h = hash_name(file_name);
+  PROMPT       *p, **pp;
+  struct stat  st;
+  time_t       now = time(NULL);
+
+  pthread_mutex_lock(&pmutex);
+
+  if ((p = bundle_get(file_name)) != NULL) {
+    p->refs++;
+    pthread_mutex_unlock(&pmutex);
+    return p;
+  }
+
+  for(pp=&hash[h]; (p = *pp) != NULL; pp=&p->next)
+    if (!strcmp(p->file_name, file_name))
+      break;
+
+  if (p && (p->checked != now)) {
+    p->checked = now;
+    if ((stat(file_name, &st) != 0) || (st.st_mtime != p->mtime) ||
+	(st.st_size != p->size)) {
+      // changed or gone, drop it from the cache
+      *pp = p->next;
+      unref(p);
+      p = NULL;
+    }
+  }
+
+  if (p == NULL) {
+    if ((stat(file_name, &st) != 0) || ((p = load(file_name, &st)) == NULL)) {
+      pthread_mutex_unlock(&pmutex);
+      return NULL;
+    }
+    p->refs = 1;
+    p->next = hash[h];
+    hash[h] = p;
+  }
+
+  p->refs++;
+  pthread_mutex_unlock(&pmutex);
+
+  return p;
+}
+
+void prompt_release(PROMPT *p) {
+  pthread_mutex_lock(&pmutex);
+  unref(p);
+  pthread_mutex_unlock(&pmutex);
+}
+
+const char *prompt_buf(PROMPT *p) {
+  return p->buf;
+}
+
+long prompt_size(PROMPT *p) {
+  return p->n;
+}
+
+int prompt_mode(PROMPT *p) {
+  return p->mode;
+}
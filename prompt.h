@@ -0,0 +1,60 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: PROMPT.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Server wide cache of prompt audio.  Each file is read and its header
+    parsed once, after that plays on any channel are served from memory.
+    Entries are reference counted so a prompt can be replaced on disk
+    while channels are still playing the old copy.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __PROMPT__
+#define __PROMPT__
+
+typedef struct PROMPT PROMPT;
+
+// lock != 0 mlocks cached audio so plays never page fault.  Prompts are
+// held as 8 kHz mono in mode (CT_xxx), whatever the file holds
+void    prompt_init(int lock, int mode);
+
+// maps a bundle of prompts built by ctbundle, which must be in the mode
+// given to prompt_init.  CT_OK or CT_ERROR.
+int     prompt_bundle(const char *file_name);
+
+// returns a referenced prompt, or NULL if the file can't be read.  The
+// name may be a file, or a prompt in a bundle, see bundle.h
+PROMPT *prompt_get(const char *file_name);
+void    prompt_release(PROMPT *p);
+
+const char *prompt_buf(PROMPT *p);
+long    prompt_size(PROMPT *p);         // bytes
+int     prompt_mode(PROMPT *p);         // CT_xxx
+
+#endif
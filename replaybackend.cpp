@@ -0,0 +1,69 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: REPLAYBACKEND.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Channel backend for ctserver -replay.  Every request succeeds and no
+    events are generated, they all come from the trace being replayed.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <unistd.h>
+#include "ctbackend.h"
+
+class ReplayBackend : public CTBackend {
+public:
+  int  num_boards() { return 1; }
+  int  num_channels(int board) { return 0; }
+  int  open(int board, int channel) { return channel; }
+  void close(int h) {}
+  int  sethook(int h, int hookstate) { return CT_OK; }
+  int  get_event(CT_EVENT *e, unsigned int time_out);
+  int  play_buf_async(int h, const char *buf, long n, int mode) {
+    return CT_OK;
+  }
+  int  play_terminate(int h) { return CT_OK; }
+  int  record_file_async(int h, const char *file_name, int mode,
+			 unsigned int time_out) { return CT_OK; }
+  int  record_terminate(int h) { return CT_OK; }
+  int  record_stream_async(int h, int mode, unsigned int time_out,
+			   CT_AUDIO_CB cb, void *arg) { return CT_OK; }
+  int  play_stream_async(int h, int mode, CT_FILL_CB cb, void *arg) {
+    return CT_OK;
+  }
+  int  dial_async(int h, const char *dial_str) { return CT_OK; }
+};
+
+int ReplayBackend::get_event(CT_EVENT *e, unsigned int time_out) {
+  usleep(time_out*1000);
+  return CT_TIME_OUT;
+}
+
+CTBackend *replay_backend_create() {
+  return new ReplayBackend();
+}
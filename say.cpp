@@ -0,0 +1,197 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: SAY.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Number, digit, spelling and date readouts, see say.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "prompt.h"
+#include "say.h"
+
+static const char *months[] = {"january", "february", "march", "april",
+			       "may", "june", "july", "august", "september",
+			       "october", "november", "december"};
+static int        have_months;
+
+// the months may be in a prompt bundle rather than files
+
+void say_init(const char *vocab_dir) {
+  char   file[FILENAME_MAX];
+  PROMPT *p;
+  int    i;
+
+  have_months = 1;
+  for(i=0; i<12; i++) {
+    snprintf(file, sizeof(file), "%s/%s.au", vocab_dir, months[i]);
+    if ((p = prompt_get(file)) != NULL)
+      prompt_release(p);
+    else
+      have_months = 0;
+  }
+}
+
+static int add(char words[][SAY_WORD], int n, const char *w) {
+  if ((n < 0) || (n == SAY_MAX_WORDS))
+    return -1;
+  strncpy(words[n], w, SAY_WORD-1);
+  words[n][SAY_WORD-1] = 0;
+  return n+1;
+}
+
+static int add_int(char words[][SAY_WORD], int n, int x) {
+  char s[SAY_WORD];
+
+  sprintf(s, "%d", x);
+  return add(words, n, s);
+}
+
+// 1 to 999, UsEngM has 0-20 and the tens
+
+static int say_hundreds(char words[][SAY_WORD], int n, int x) {
+  if (x >= 100) {
+    n = add_int(words, n, x/100);
+    n = add(words, n, "hundred");
+    x %= 100;
+  }
+  if (x > 20) {
+    n = add_int(words, n, x - x%10);
+    x %= 10;
+  }
+  if (x)
+    n = add_int(words, n, x);
+  return n;
+}
+
+static int say_number(char words[][SAY_WORD], int n, long long x) {
+  static const char *scale[] = {"billion", "million", "thousand"};
+  long long         div = 1000000000LL;
+  int               i;
+
+  if (x == 0)
+    return add(words, n, "0");
+  for(i=0; i<3; i++, div /= 1000) {
+    if (x >= div) {
+      n = say_hundreds(words, n, (int)(x/div));
+      n = add(words, n, scale[i]);
+      x %= div;
+    }
+  }
+  if (x)
+    n = say_hundreds(words, n, (int)x);
+  return n;
+}
+
+// years are said in pairs, 1999 is "19 90 9", 1905 is "19 o 5", except
+// for 2000 to 2009, "2 thousand 5"
+
+static int say_year(char words[][SAY_WORD], int n, int y) {
+  if (((y >= 2000) && (y < 2010)) || (y < 1000) || (y % 1000 == 0))
+    return say_number(words, n, y);
+  n = say_hundreds(words, n, y/100);
+  if (y % 100 == 0)
+    return add(words, n, "hundred");
+  if (y % 100 < 10)
+    n = add(words, n, "o");
+  return say_hundreds(words, n, y%100);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: say_words
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Builds the word list for a readout.  Spaces and '-' in digit
+	strings, words and dates are ignored.
+
+\*--------------------------------------------------------------------------*/
+
+int say_words(int what, const char *s, char words[][SAY_WORD]) {
+  char      w[2], d[9];
+  long long x;
+  int       n = 0, i, year, month, day;
+
+  w[1] = 0;
+
+  switch(what) {
+  case SAY_NUMBER:
+    if ((*s == 0) || (strlen(s) > 12))
+      return -1;
+    for(i=0; s[i]; i++)
+      if (!isdigit(s[i]))
+	return -1;
+    x = atoll(s);
+    return say_number(words, 0, x);
+
+  case SAY_DIGITS:
+  case SAY_SPELL:
+    for(; *s; s++) {
+      if ((*s == ' ') || (*s == '-'))
+	continue;
+      if (isdigit(*s) || ((what == SAY_SPELL) && isalpha(*s)))
+	w[0] = tolower(*s);
+      else
+	return -1;
+      n = add(words, n, w);
+    }
+    return n ? n : -1;
+
+  case SAY_DATE:
+    for(i=0; *s && (i<8); s++) {
+      if (*s == '-')
+	continue;
+      if (!isdigit(*s))
+	return -1;
+      d[i++] = *s;
+    }
+    d[i] = 0;
+    if ((i != 8) || *s)
+      return -1;
+    day = atoi(d+6); d[6] = 0;
+    month = atoi(d+4); d[4] = 0;
+    year = atoi(d);
+    if ((month < 1) || (month > 12) || (day < 1) || (day > 31))
+      return -1;
+
+    if (have_months)
+      n = add(words, n, months[month-1]);
+    else
+      n = add_int(words, n, month);
+    n = say_hundreds(words, n, day);
+    return say_year(words, n, year);
+  }
+
+  return -1;
+}
@@ -0,0 +1,55 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: SAY.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Turns numbers, digit strings, words and dates into the list of UsEngM
+    vocabulary words that speak them, e.g. 121 is "1 hundred 20 1".
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __SAY__
+#define __SAY__
+
+#define SAY_MAX_WORDS      128
+#define SAY_WORD           16
+
+// what to say
+#define SAY_NUMBER         0      // 0 to 999999999999
+#define SAY_DIGITS         1      // one word per digit
+#define SAY_SPELL          2      // letters and digits
+#define SAY_DATE           3      // YYYYMMDD or YYYY-MM-DD
+
+// months are said by name if the vocabulary has them (january.au ...),
+// otherwise as a number
+void say_init(const char *vocab_dir);
+
+// fills in words, returns the number of words or -1 if s can't be said
+int  say_words(int what, const char *s, char words[][SAY_WORD]);
+
+#endif
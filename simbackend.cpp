@@ -0,0 +1,1146 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: SIMBACKEND.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Simulated channel backend.  Fakes any number of CT ports in-process so
+    ctserver can be exercised and load tested without a Voicetronix card.
+
+    A single simulation thread keeps a heap of timed items (end of play,
+    end of record, dial complete, timer expiry, script steps) and turns
+    them into events at the right time.  Play and record take as long as
+    the audio would, recordings are written with comfort noise and the
+    DTMF and talking heard during them, and CID is heard as Bell 202 FSK
+    audio in recordings after a ring.
+
+    What the "far end" does is described by a script that every channel
+    runs, for example:
+
+      set speed 10           # run 10x faster than real time
+      label top
+      delay 1000 500         # 1000 +/- 500 ms
+      cid 0412345678
+      ring
+      delay 4000
+      ring
+      wait offhook
+      delay 1500
+      dtmf 1#
+      wait onhook
+      goto top
+
+    Script commands:
+
+      set <param> <value>    speed, dtmf_ms, digit_ms, pause_ms, play_ms,
+			     stagger_ms, boards, channels (per board)
+      label <name>           target for goto
+      goto <name>
+      delay <ms> [+/- ms]
+      ring                   CT_RING event
+      cid <number>           CID sent after the next ring
+      dtmf <digits>          DTMF, dtmf_ms apart, each event comes
+			     DTMF_DETECT_MS after its tone starts
+      tone <dial|ringback|busy|grunt>
+      talk <ms>              the caller talks for ms, heard in recordings
+      wait <offhook|onhook|play|playend|record|recordend|dial|dialend>
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "ctbackend.h"
+#include "wave.h"
+#include "g711.h"
+
+#define MAX_STEPS          256
+#define MAX_LINE           256
+#define MAX_DIGITS         CT_MAX_STR
+#define MAX_REC_DTMF       32
+#define MAX_REC_TALK       8
+#define CID_SAMPLES        8000   // 1 s, enough for seizure, mark, message
+#define MAX_SCRIPT_LOOP    1000   // steps run without delay before giving up
+
+// script step op codes
+#define STEP_RING          0
+#define STEP_CID           1
+#define STEP_DTMF          2
+#define STEP_TONE          3
+#define STEP_DELAY         4
+#define STEP_WAIT          5
+#define STEP_GOTO          6
+#define STEP_TALK          7
+
+// things a script can wait for
+#define WAIT_NONE          0
+#define WAIT_OFFHOOK       1
+#define WAIT_ONHOOK        2
+#define WAIT_PLAY          3
+#define WAIT_PLAYEND       4
+#define WAIT_RECORD        5
+#define WAIT_RECORDEND     6
+#define WAIT_DIAL          7
+#define WAIT_DIALEND       8
+
+// scheduled item kinds
+#define ITEM_SCRIPT        0
+#define ITEM_DTMF          1
+#define ITEM_PLAYEND       2
+#define ITEM_RECORDEND     3
+#define ITEM_DIALEND       4
+#define ITEM_STREAM        5
+#define ITEM_DTMF_TONE     6
+#define ITEM_PLAYSTREAM    7
+
+#define STREAM_MS          20     // audio is streamed in blocks this long
+#define DTMF_DETECT_MS     50     // a card reports DTMF after hearing this
+
+typedef struct {
+  int           op;               // STEP_xxx
+  int           arg;
+  int           arg2;
+  char          str[MAX_DIGITS];
+} SIM_STEP;
+
+typedef struct {
+  unsigned long long when;        // us, CLOCK_MONOTONIC
+  int           h;
+  int           kind;             // ITEM_xxx
+  int           data;
+  unsigned int  gen;              // item is stale if gen has moved on
+} SIM_ITEM;
+
+typedef struct {
+  int           hook;
+
+  // script
+  int           pc;
+  int           waiting;          // WAIT_xxx
+  unsigned int  script_gen;
+  char          cid[MAX_DIGITS];
+
+  // CID heard after the last ring
+  short         *cid_audio;
+  unsigned long long cid_at;
+
+  // play
+  int           playing;
+  unsigned int  play_gen;
+  unsigned long long play_start;
+  unsigned long long play_us;     // real time the play takes
+  unsigned long play_bytes;
+  CT_FILL_CB    play_cb;          // streaming, play_bytes grows as it goes
+  void          *play_arg;
+  int           play_mode;
+
+  // record to file or stream
+  int           recording;
+  unsigned int  rec_gen;
+  WAVE          *rec;             // NULL when streaming
+  CT_AUDIO_CB   rec_cb;
+  void          *rec_arg;
+  int           rec_mode;
+  unsigned long long rec_start;
+  long          rec_pos;          // samples delivered so far
+  int           rec_ndtmf;
+  long          rec_dtmf_at[MAX_REC_DTMF];
+  char          rec_dtmf[MAX_REC_DTMF];
+  int           rec_ntalk;
+  long          rec_talk_at[MAX_REC_TALK];
+  long          rec_talk_len[MAX_REC_TALK];
+
+  // dial
+  unsigned int  dial_gen;
+} SIM_CHAN;
+
+class SimBackend : public CTBackend {
+public:
+  SimBackend();
+  ~SimBackend();
+  int  load_script(const char *file_name);
+  void start();
+
+  int  num_boards();
+  int  num_channels(int board);
+  int  open(int board, int channel);
+  void close(int h);
+  int  sethook(int h, int hookstate);
+  int  get_event(CT_EVENT *e, unsigned int time_out);
+  int  play_buf_async(int h, const char *buf, long n, int mode);
+  int  play_terminate(int h);
+  int  record_file_async(int h, const char *file_name, int mode,
+			 unsigned int time_out);
+  int  record_terminate(int h);
+  int  record_stream_async(int h, int mode, unsigned int time_out,
+			   CT_AUDIO_CB cb, void *arg);
+  int  play_stream_async(int h, int mode, CT_FILL_CB cb, void *arg);
+  int  dial_async(int h, const char *dial_str);
+
+private:
+  static void *sim_thread(void *pv);
+  void  run();
+  int   parse_line(char *line, int lineno);
+  void  run_script(int h);
+  void  process(SIM_ITEM *it);
+  void  schedule(int h, int kind, int data, unsigned int gen,
+		 unsigned long delay_ms);
+  void  post(int h, int type, int data);
+  void  notify(int h, int what);
+  void  dtmf(int h, char digit);
+  void  play_start(int h, unsigned long bytes, int mode);
+  unsigned long play_pos(int h);
+  void  play_audio(int h);
+  void  record_start(int h, int mode, unsigned int time_out);
+  void  record_audio(int h);
+  void  finish_record(int h);
+  unsigned long long now();
+  SIM_CHAN *chan(int h);
+
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;           // new items or buffer record terminated
+  pthread_cond_t  evcond;         // events waiting
+  pthread_t       thread;
+  int             started;
+  int             quit;
+
+  SIM_CHAN        **chans;
+  int             nchans;
+
+  SIM_ITEM        *heap;
+  int             nitems, maxitems;
+
+  CT_EVENT        *evq;
+  int             evq_head, evq_tail, evq_size;
+
+  SIM_STEP        steps[MAX_STEPS];
+  int             nsteps;
+  char            labels[MAX_STEPS][MAX_DIGITS];
+  int             label_pc[MAX_STEPS];
+  int             nlabels;
+  char            gotos[MAX_STEPS][MAX_DIGITS];
+
+  // timing, all in simulated ms
+  double          speed;
+  unsigned long   dtmf_ms;        // between script DTMF digits
+  unsigned long   digit_ms;       // per digit when dialling
+  unsigned long   pause_ms;       // per ',' when dialling
+  unsigned long   play_ms;        // fixed play length, 0 to use file length
+  unsigned long   stagger_ms;     // script start offset between channels
+  unsigned int    seed;
+
+  // simulated hardware
+  int             boards;
+  int             channels;       // per board
+};
+
+// far end when no script is given: dial tone whenever we go off hook
+
+static const char *default_script[] = {
+  "label top",
+  "wait offhook",
+  "delay 300",
+  "tone dial",
+  "wait onhook",
+  "goto top",
+  NULL
+};
+
+static short comfort_noise(unsigned int *seed) {
+  return (rand_r(seed) % 64) - 32;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: dtmf_tone
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Adds sample n of the DTMF tone for digit to x.
+
+\*--------------------------------------------------------------------------*/
+
+static short dtmf_tone(char digit, long n, short x) {
+  static const char  *keys = "123A456B789C*0#D";
+  static const float row[] = {697, 770, 852, 941};
+  static const float col[] = {1209, 1336, 1477, 1633};
+  const char         *p = strchr(keys, digit);
+  int                k;
+
+  if ((p == NULL) || (digit == 0))
+    return x;
+  k = p - keys;
+  return x + (short)(4000*sin(2*M_PI*row[k/4]*n/8000) +
+		     4000*sin(2*M_PI*col[k%4]*n/8000));
+}
+
+// sample n of the caller talking, a 125 Hz buzz rising and falling four
+// times a second like syllables, loud enough for the VAD to hear
+
+static short talk_sample(long n) {
+  float y = 0;
+  int   k;
+
+  for(k=1; k<=8; k++)
+    y += sin(2*M_PI*125*k*n/8000)/k;
+  return (short)(1500*(0.6 + 0.4*sin(2*M_PI*4*n/8000))*y);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: cid_fsk
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Generates n samples of Bell 202 caller ID: channel seizure, mark,
+	then an SDMF message (type 4) carrying the number.  The seizure
+	starts 200 ms in and the message is followed by silence.
+
+\*--------------------------------------------------------------------------*/
+
+static void cid_fsk(const char *number, short *buf, int n) {
+  unsigned char msg[MAX_DIGITS];
+  char          bits[MAX_DIGITS*10 + 480];
+  int           len, nbits, i, j, start, sum;
+  double        phase = 0;
+
+  memset(buf, 0, n*sizeof(short));
+
+  // SDMF message: type, length, MMDDHHMM, number, checksum
+  len = strlen(number);
+  if (len > MAX_DIGITS-12)
+    len = MAX_DIGITS-12;
+  msg[0] = 0x04;
+  msg[1] = 8 + len;
+  memcpy(msg+2, "01010000", 8);
+  memcpy(msg+10, number, len);
+  for(i=0, sum=0; i<10+len; i++)
+    sum += msg[i];
+  msg[10+len] = (-sum) & 0xff;
+
+  nbits = 0;
+  for(i=0; i<300; i++)
+    bits[nbits++] = i & 1;
+  for(i=0; i<180; i++)
+    bits[nbits++] = 1;
+  for(i=0; i<11+len; i++) {
+    bits[nbits++] = 0;
+    for(j=0; j<8; j++)
+      bits[nbits++] = (msg[i] >> j) & 1;
+    bits[nbits++] = 1;
+  }
+
+  // phase continuous FSK, mark 1200 Hz, space 2200 Hz, 1200 bit/s
+  start = 1600;
+  for(i=0; (start+i < n) && (i*1200/8000 < nbits); i++) {
+    phase += 2*M_PI*(bits[i*1200/8000] ? 1200 : 2200)/8000;
+    buf[start+i] = (short)(6000*sin(phase));
+  }
+}
+
+/*--------------------------------------------------------------------------*\
+
+				SimBackend
+
+\*--------------------------------------------------------------------------*/
+
+SimBackend::SimBackend() {
+  pthread_condattr_t attr;
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cond, &attr);
+  pthread_cond_init(&evcond, &attr);
+  pthread_condattr_destroy(&attr);
+  started = 0;
+  quit = 0;
+
+  chans = NULL;
+  nchans = 0;
+  heap = NULL;
+  nitems = maxitems = 0;
+  evq_size = 1024;
+  evq = (CT_EVENT*)malloc(evq_size*sizeof(CT_EVENT));
+  evq_head = evq_tail = 0;
+  nsteps = nlabels = 0;
+
+  speed = 1.0;
+  dtmf_ms = 200;
+  digit_ms = 100;
+  pause_ms = 1000;
+  play_ms = 0;
+  stagger_ms = 0;
+  seed = 1;
+  boards = 1;
+  channels = 4;
+}
+
+SimBackend::~SimBackend() {
+  int i;
+
+  if (started) {
+    pthread_mutex_lock(&mutex);
+    quit = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+  }
+
+  for(i=0; i<nchans; i++) {
+    if (chans[i]->rec)
+      wave_close(chans[i]->rec);
+    free(chans[i]->cid_audio);
+    free(chans[i]);
+  }
+  free(chans);
+  free(heap);
+  free(evq);
+}
+
+// reads the script, the built in default is used if file_name is NULL
+
+int SimBackend::load_script(const char *file_name) {
+  FILE *f = NULL;
+  char line[MAX_LINE];
+  int  i, j, lineno = 0;
+
+  if (file_name) {
+    f = fopen(file_name, "rt");
+    if (f == NULL) {
+      fprintf(stderr, "sim: cannot open script %s\n", file_name);
+      return CT_ERROR;
+    }
+  }
+
+  while(1) {
+    if (f) {
+      if (fgets(line, MAX_LINE, f) == NULL)
+	break;
+    }
+    else {
+      if (default_script[lineno] == NULL)
+	break;
+      strcpy(line, default_script[lineno]);
+    }
+    lineno++;
+    if (parse_line(line, lineno) != CT_OK) {
+      if (f)
+	fclose(f);
+      return CT_ERROR;
+    }
+  }
+  if (f)
+    fclose(f);
+
+  // resolve gotos
+  for(i=0; i<nsteps; i++) {
+    if (steps[i].op != STEP_GOTO)
+      continue;
+    for(j=0; (j<nlabels) && strcmp(labels[j], gotos[i]); j++);
+    if (j == nlabels) {
+      fprintf(stderr, "sim: unknown label %s\n", gotos[i]);
+      return CT_ERROR;
+    }
+    steps[i].arg = label_pc[j];
+  }
+
+  return CT_OK;
+}
+
+int SimBackend::parse_line(char *line, int lineno) {
+  static const char *waits[] = {"", "offhook", "onhook", "play", "playend",
+				"record", "recordend", "dial", "dialend", NULL};
+  static const char *tones[] = {"dial", "ringback", "busy", "grunt", NULL};
+  char     *cmd, *a1, *a2, *p;
+  SIM_STEP *s;
+  int      i;
+
+  if ((p = strchr(line, '#')) != NULL)
+    *p = 0;
+  cmd = strtok(line, " \t\r\n");
+  if (cmd == NULL)
+    return CT_OK;
+  a1 = strtok(NULL, " \t\r\n");
+  a2 = strtok(NULL, " \t\r\n");
+  if (a2 && !strcmp(a2, "+/-"))
+    a2 = strtok(NULL, " \t\r\n");
+
+  if (!strcmp(cmd, "set") && a1 && a2) {
+    if (!strcmp(a1, "speed"))
+      speed = atof(a2);
+    else if (!strcmp(a1, "dtmf_ms"))
+      dtmf_ms = atol(a2);
+    else if (!strcmp(a1, "digit_ms"))
+      digit_ms = atol(a2);
+    else if (!strcmp(a1, "pause_ms"))
+      pause_ms = atol(a2);
+    else if (!strcmp(a1, "play_ms"))
+      play_ms = atol(a2);
+    else if (!strcmp(a1, "stagger_ms"))
+      stagger_ms = atol(a2);
+    else if (!strcmp(a1, "boards"))
+      boards = atoi(a2);
+    else if (!strcmp(a1, "channels"))
+      channels = atoi(a2);
+    else
+      goto error;
+    if ((speed <= 0) || (boards < 1) || (channels < 1))
+      goto error;
+    return CT_OK;
+  }
+
+  if (!strcmp(cmd, "label") && a1) {
+    if (nlabels == MAX_STEPS)
+      goto error;
+    strncpy(labels[nlabels], a1, MAX_DIGITS-1);
+    label_pc[nlabels++] = nsteps;
+    return CT_OK;
+  }
+
+  if (nsteps == MAX_STEPS)
+    goto error;
+  s = &steps[nsteps];
+  memset(s, 0, sizeof(SIM_STEP));
+
+  if (!strcmp(cmd, "ring")) {
+    s->op = STEP_RING;
+  }
+  else if (!strcmp(cmd, "cid") && a1) {
+    s->op = STEP_CID;
+    strncpy(s->str, a1, MAX_DIGITS-1);
+  }
+  else if (!strcmp(cmd, "dtmf") && a1) {
+    s->op = STEP_DTMF;
+    strncpy(s->str, a1, MAX_DIGITS-1);
+  }
+  else if (!strcmp(cmd, "tone") && a1) {
+    s->op = STEP_TONE;
+    for(i=0; tones[i] && strcmp(tones[i], a1); i++);
+    if (tones[i] == NULL)
+      goto error;
+    s->arg = i;
+  }
+  else if (!strcmp(cmd, "talk") && a1) {
+    s->op = STEP_TALK;
+    s->arg = atoi(a1);
+  }
+  else if (!strcmp(cmd, "delay") && a1) {
+    s->op = STEP_DELAY;
+    s->arg = atoi(a1);
+    s->arg2 = a2 ? atoi(a2) : 0;
+  }
+  else if (!strcmp(cmd, "wait") && a1) {
+    s->op = STEP_WAIT;
+    for(i=1; waits[i] && strcmp(waits[i], a1); i++);
+    if (waits[i] == NULL)
+      goto error;
+    s->arg = i;
+  }
+  else if (!strcmp(cmd, "goto") && a1) {
+    s->op = STEP_GOTO;
+    strncpy(gotos[nsteps], a1, MAX_DIGITS-1);
+  }
+  else
+    goto error;
+
+  nsteps++;
+  return CT_OK;
+
+ error:
+  fprintf(stderr, "sim: script error line %d: %s\n", lineno, cmd);
+  return CT_ERROR;
+}
+
+void SimBackend::start() {
+  pthread_create(&thread, NULL, sim_thread, this);
+  started = 1;
+}
+
+unsigned long long SimBackend::now() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+SIM_CHAN *SimBackend::chan(int h) {
+  if ((h < 0) || (h >= nchans))
+    return NULL;
+  return chans[h];
+}
+
+// the following are called with mutex held
+
+void SimBackend::schedule(int h, int kind, int data, unsigned int gen,
+			  unsigned long delay_ms) {
+  SIM_ITEM it;
+  int      i, parent;
+
+  it.when = now() + (unsigned long long)(delay_ms*1000.0/speed);
+  it.h = h;
+  it.kind = kind;
+  it.data = data;
+  it.gen = gen;
+
+  if (nitems == maxitems) {
+    maxitems = maxitems ? maxitems*2 : 256;
+    heap = (SIM_ITEM*)realloc(heap, maxitems*sizeof(SIM_ITEM));
+  }
+
+  // sift up
+  for(i=nitems++; i>0; i=parent) {
+    parent = (i-1)/2;
+    if (heap[parent].when <= it.when)
+      break;
+    heap[i] = heap[parent];
+  }
+  heap[i] = it;
+
+  if (i == 0)
+    pthread_cond_broadcast(&cond);
+}
+
+void SimBackend::post(int h, int type, int data) {
+  int next = (evq_head+1) % evq_size;
+
+  if (next == evq_tail) {
+    // grow, unwrapping the queue
+    CT_EVENT *q = (CT_EVENT*)malloc(2*evq_size*sizeof(CT_EVENT));
+    int      n;
+    for(n=0; evq_tail != evq_head; n++) {
+      q[n] = evq[evq_tail];
+      evq_tail = (evq_tail+1) % evq_size;
+    }
+    free(evq);
+    evq = q;
+    evq_size *= 2;
+    evq_tail = 0;
+    evq_head = n;
+    next = n+1;
+  }
+
+  evq[evq_head].type = type;
+  evq[evq_head].handle = h;
+  evq[evq_head].data = data;
+  evq_head = next;
+  pthread_cond_signal(&evcond);
+}
+
+// wakes a script waiting for what has just happened on the channel
+
+void SimBackend::notify(int h, int what) {
+  SIM_CHAN *c = chans[h];
+
+  if (c->waiting == what) {
+    c->waiting = WAIT_NONE;
+    schedule(h, ITEM_SCRIPT, 0, c->script_gen, 0);
+  }
+}
+
+void SimBackend::run_script(int h) {
+  SIM_CHAN *c = chans[h];
+  SIM_STEP *s;
+  int      i, delay;
+
+  for(i=0; (i<MAX_SCRIPT_LOOP) && (c->pc < nsteps); i++) {
+    s = &steps[c->pc++];
+
+    switch(s->op) {
+    case STEP_RING:
+      post(h, CT_RING, 0);
+      if (c->cid[0]) {
+	if (c->cid_audio == NULL)
+	  c->cid_audio = (short*)malloc(CID_SAMPLES*sizeof(short));
+	cid_fsk(c->cid, c->cid_audio, CID_SAMPLES);
+	c->cid_at = now();
+      }
+      break;
+    case STEP_CID:
+      strcpy(c->cid, s->str);
+      break;
+    case STEP_TONE:
+      post(h, CT_TONEDETECT, s->arg);
+      break;
+    case STEP_DTMF:
+      delay = 0;
+      for(char *p=s->str; *p; p++, delay += dtmf_ms) {
+	schedule(h, ITEM_DTMF_TONE, *p, 0, delay);
+	schedule(h, ITEM_DTMF, *p, 0, delay + DTMF_DETECT_MS);
+      }
+      schedule(h, ITEM_SCRIPT, 0, c->script_gen, delay);
+      return;
+    case STEP_TALK:
+      if (c->recording && (c->rec_ntalk < MAX_REC_TALK)) {
+	c->rec_talk_at[c->rec_ntalk] =
+	  (long)((now() - c->rec_start)*speed*8/1000);
+	c->rec_talk_len[c->rec_ntalk++] = (long)s->arg*8;
+      }
+      schedule(h, ITEM_SCRIPT, 0, c->script_gen, s->arg);
+      return;
+    case STEP_DELAY:
+      delay = s->arg;
+      if (s->arg2)
+	delay += rand_r(&seed) % (2*s->arg2+1) - s->arg2;
+      schedule(h, ITEM_SCRIPT, 0, c->script_gen, delay > 0 ? delay : 0);
+      return;
+    case STEP_WAIT:
+      if ((s->arg == WAIT_OFFHOOK) && (c->hook == CT_OFFHOOK))
+	break;
+      if ((s->arg == WAIT_ONHOOK) && (c->hook == CT_ONHOOK))
+	break;
+      if ((s->arg == WAIT_PLAY) && c->playing)
+	break;
+      if ((s->arg == WAIT_RECORD) && c->recording)
+	break;
+      c->waiting = s->arg;
+      return;
+    case STEP_GOTO:
+      c->pc = s->arg;
+      break;
+    }
+  }
+
+  if (i == MAX_SCRIPT_LOOP)
+    fprintf(stderr, "sim: [%02d] script loops without delay\n", h);
+}
+
+void SimBackend::dtmf(int h, char digit) {
+  post(h, CT_DTMF, digit);
+}
+
+// delivers the audio heard since the last call: noise plus any DTMF
+
+void SimBackend::record_audio(int h) {
+  SIM_CHAN      *c = chans[h];
+  unsigned char buf[2*160];
+  short         x;
+  long          samples, n, i, j, k, bytes, cid;
+
+  samples = (long)((now() - c->rec_start)*speed*8/1000);
+
+  // where the CID after the last ring is, relative to the recording
+  cid = -CID_SAMPLES;
+  if (c->cid_audio)
+    cid = (long)(((long long)c->cid_at - (long long)c->rec_start)*speed*8/1000);
+
+  for(n=c->rec_pos; n<samples; n+=160) {
+    for(i=0; (i<160) && (n+i<samples); i++) {
+      x = comfort_noise(&seed);
+      j = n + i - cid;
+      if ((j >= 0) && (j < CID_SAMPLES))
+	x += c->cid_audio[j];
+      for(k=0; k<c->rec_ndtmf; k++) {
+	j = n + i - c->rec_dtmf_at[k];
+	if ((j >= 0) && (j < 800))
+	  x = dtmf_tone(c->rec_dtmf[k], j, x);
+      }
+      for(k=0; k<c->rec_ntalk; k++) {
+	j = n + i - c->rec_talk_at[k];
+	if ((j >= 0) && (j < c->rec_talk_len[k]))
+	  x += talk_sample(j);
+      }
+      if (c->rec_mode == CT_MULAW)
+	buf[i] = linear2mulaw(x);
+      else if (c->rec_mode == CT_ALAW)
+	buf[i] = linear2alaw(x);
+      else
+	((short*)buf)[i] = x;
+    }
+    bytes = i*wave_bytes_per_sample(c->rec_mode);
+    if (c->rec)
+      wave_write(c->rec, (char*)buf, bytes);
+    else
+      c->rec_cb(c->rec_arg, (char*)buf, bytes);
+  }
+  if (samples > c->rec_pos)
+    c->rec_pos = samples;
+}
+
+void SimBackend::finish_record(int h) {
+  SIM_CHAN      *c = chans[h];
+
+  record_audio(h);
+  if (c->rec)
+    wave_close(c->rec);
+  c->rec = NULL;
+  c->recording = 0;
+  c->rec_gen++;
+  post(h, CT_RECORDEND, 0);
+  notify(h, WAIT_RECORDEND);
+}
+
+void SimBackend::process(SIM_ITEM *it) {
+  SIM_CHAN *c = chans[it->h];
+
+  switch(it->kind) {
+  case ITEM_SCRIPT:
+    if (it->gen == c->script_gen)
+      run_script(it->h);
+    break;
+  case ITEM_DTMF_TONE:
+    // heard in recordings from now, the event comes DTMF_DETECT_MS later
+    if (c->recording && (c->rec_ndtmf < MAX_REC_DTMF)) {
+      c->rec_dtmf[c->rec_ndtmf] = it->data;
+      c->rec_dtmf_at[c->rec_ndtmf++] =
+	(long)((now() - c->rec_start)*speed*8/1000);
+    }
+    break;
+  case ITEM_DTMF:
+    dtmf(it->h, it->data);
+    break;
+  case ITEM_PLAYEND:
+    if (c->playing && (it->gen == c->play_gen)) {
+      c->playing = 0;
+      post(it->h, CT_PLAYEND, c->play_bytes);
+      notify(it->h, WAIT_PLAYEND);
+    }
+    break;
+  case ITEM_RECORDEND:
+    if (c->recording && (it->gen == c->rec_gen))
+      finish_record(it->h);
+    break;
+  case ITEM_DIALEND:
+    if (it->gen == c->dial_gen) {
+      post(it->h, CT_DIALEND, 0);
+      notify(it->h, WAIT_DIALEND);
+    }
+    break;
+  case ITEM_PLAYSTREAM:
+    if (c->playing && (it->gen == c->play_gen)) {
+      play_audio(it->h);
+      schedule(it->h, ITEM_PLAYSTREAM, 0, c->play_gen, STREAM_MS);
+    }
+    break;
+  case ITEM_STREAM:
+    if (c->recording && (it->gen == c->rec_gen)) {
+      record_audio(it->h);
+      schedule(it->h, ITEM_STREAM, 0, c->rec_gen, STREAM_MS);
+    }
+    break;
+  }
+}
+
+void *SimBackend::sim_thread(void *pv) {
+  ((SimBackend*)pv)->run();
+  return NULL;
+}
+
+void SimBackend::run() {
+  struct timespec    ts;
+  unsigned long long t;
+  SIM_ITEM           it, last;
+  int                i, child;
+
+  pthread_mutex_lock(&mutex);
+  while(!quit) {
+    if (nitems == 0) {
+      pthread_cond_wait(&cond, &mutex);
+      continue;
+    }
+
+    t = heap[0].when;
+    if (t > now()) {
+      ts.tv_sec = t / 1000000;
+      ts.tv_nsec = (t % 1000000) * 1000;
+      pthread_cond_timedwait(&cond, &mutex, &ts);
+      continue;
+    }
+
+    // pop earliest item, sift down
+    it = heap[0];
+    last = heap[--nitems];
+    for(i=0; (child = 2*i+1) < nitems; i=child) {
+      if ((child+1 < nitems) && (heap[child+1].when < heap[child].when))
+	child++;
+      if (last.when <= heap[child].when)
+	break;
+      heap[i] = heap[child];
+    }
+    heap[i] = last;
+
+    process(&it);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+/*--------------------------------------------------------------------------*\
+
+			     CTBackend interface
+
+\*--------------------------------------------------------------------------*/
+
+int SimBackend::num_boards() {
+  return boards;
+}
+
+int SimBackend::num_channels(int board) {
+  return channels;
+}
+
+int SimBackend::open(int board, int channel) {
+  SIM_CHAN *c;
+  int      h;
+
+  if ((board < 1) || (board > boards) || (channel < 1) ||
+      (channel > channels))
+    return -1;
+
+  pthread_mutex_lock(&mutex);
+  h = nchans;
+  if ((nchans & (nchans-1)) == 0)
+    chans = (SIM_CHAN**)realloc(chans, (nchans ? 2*nchans : 1)*
+				sizeof(SIM_CHAN*));
+  c = (SIM_CHAN*)calloc(1, sizeof(SIM_CHAN));
+  chans[nchans++] = c;
+  schedule(h, ITEM_SCRIPT, 0, 0, stagger_ms*h);
+  pthread_mutex_unlock(&mutex);
+
+  return h;
+}
+
+void SimBackend::close(int h) {
+  pthread_mutex_lock(&mutex);
+  if (chan(h)) {
+    chans[h]->script_gen++;
+    chans[h]->waiting = WAIT_NONE;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+int SimBackend::sethook(int h, int hookstate) {
+  pthread_mutex_lock(&mutex);
+  if (chan(h) == NULL) {
+    pthread_mutex_unlock(&mutex);
+    return CT_ERROR;
+  }
+  chans[h]->hook = hookstate;
+  notify(h, hookstate == CT_OFFHOOK ? WAIT_OFFHOOK : WAIT_ONHOOK);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::get_event(CT_EVENT *e, unsigned int time_out) {
+  struct timespec    ts;
+  unsigned long long t;
+
+  t = now() + (unsigned long long)time_out*1000;
+  ts.tv_sec = t / 1000000;
+  ts.tv_nsec = (t % 1000000) * 1000;
+
+  pthread_mutex_lock(&mutex);
+  while(evq_tail == evq_head) {
+    if (pthread_cond_timedwait(&evcond, &mutex, &ts) != 0) {
+      pthread_mutex_unlock(&mutex);
+      return CT_TIME_OUT;
+    }
+  }
+  *e = evq[evq_tail];
+  evq_tail = (evq_tail+1) % evq_size;
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+void SimBackend::play_start(int h, unsigned long bytes, int mode) {
+  SIM_CHAN      *c = chans[h];
+  unsigned long ms;
+
+  ms = play_ms ? play_ms : bytes / wave_bytes_per_sample(mode) / 8;
+  c->playing = 1;
+  c->play_start = now();
+  c->play_us = (unsigned long long)(ms*1000.0/speed);
+  c->play_bytes = bytes;
+  schedule(h, ITEM_PLAYEND, 0, ++c->play_gen, ms);
+  notify(h, WAIT_PLAY);
+}
+
+// bytes played so far, reported as the data of CT_PLAYEND
+
+unsigned long SimBackend::play_pos(int h) {
+  SIM_CHAN           *c = chans[h];
+  unsigned long long t = now() - c->play_start;
+
+  if ((c->play_us == 0) || (t >= c->play_us))
+    return c->play_bytes;
+  return (unsigned long)((double)c->play_bytes*t/c->play_us);
+}
+
+// asks a streamed play for the audio due since the last call, which
+// goes nowhere
+
+void SimBackend::play_audio(int h) {
+  SIM_CHAN      *c = chans[h];
+  char          buf[2*160];
+  long          bps = wave_bytes_per_sample(c->play_mode), due, n;
+
+  due = (long)((now() - c->play_start)*speed*8/1000)*bps;
+  for(; (long)c->play_bytes < due; c->play_bytes += n) {
+    n = due - c->play_bytes;
+    if (n > 160*bps)
+      n = 160*bps;
+    c->play_cb(c->play_arg, buf, n);
+  }
+}
+
+int SimBackend::play_buf_async(int h, const char *buf, long n, int mode) {
+  pthread_mutex_lock(&mutex);
+  play_start(h, n, mode);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::play_terminate(int h) {
+  SIM_CHAN *c;
+
+  pthread_mutex_lock(&mutex);
+  c = chan(h);
+  if (c && c->playing) {
+    c->playing = 0;
+    c->play_gen++;
+    post(h, CT_PLAYEND, play_pos(h));
+    notify(h, WAIT_PLAYEND);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::play_stream_async(int h, int mode, CT_FILL_CB cb, void *arg) {
+  SIM_CHAN *c;
+
+  pthread_mutex_lock(&mutex);
+  c = chans[h];
+  c->playing = 1;
+  c->play_start = now();
+  c->play_us = 0;
+  c->play_bytes = 0;
+  c->play_cb = cb;
+  c->play_arg = arg;
+  c->play_mode = mode;
+  schedule(h, ITEM_PLAYSTREAM, 0, ++c->play_gen, STREAM_MS);
+  notify(h, WAIT_PLAY);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::record_file_async(int h, const char *file_name, int mode,
+				  unsigned int time_out) {
+  SIM_CHAN *c;
+  WAVE     *w;
+
+  if (wave_open_write(&w, file_name, mode) != CT_OK)
+    return CT_ERROR;
+
+  pthread_mutex_lock(&mutex);
+  c = chans[h];
+  if (c->rec)
+    wave_close(c->rec);
+  c->rec = w;
+  record_start(h, mode, time_out);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::record_stream_async(int h, int mode, unsigned int time_out,
+				    CT_AUDIO_CB cb, void *arg) {
+  SIM_CHAN *c;
+
+  pthread_mutex_lock(&mutex);
+  c = chans[h];
+  if (c->rec)
+    wave_close(c->rec);
+  c->rec = NULL;
+  c->rec_cb = cb;
+  c->rec_arg = arg;
+  record_start(h, mode, time_out);
+  schedule(h, ITEM_STREAM, 0, c->rec_gen, STREAM_MS);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+void SimBackend::record_start(int h, int mode, unsigned int time_out) {
+  SIM_CHAN *c = chans[h];
+
+  c->rec_mode = mode;
+  c->rec_start = now();
+  c->rec_pos = 0;
+  c->rec_ndtmf = 0;
+  c->rec_ntalk = 0;
+  c->recording = 1;
+  c->rec_gen++;
+  if (time_out)
+    schedule(h, ITEM_RECORDEND, 0, c->rec_gen, time_out);
+  notify(h, WAIT_RECORD);
+}
+
+int SimBackend::record_terminate(int h) {
+  SIM_CHAN *c;
+
+  pthread_mutex_lock(&mutex);
+  c = chan(h);
+  if (c && c->recording)
+    finish_record(h);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+int SimBackend::dial_async(int h, const char *dial_str) {
+  unsigned long ms = 0;
+  const char    *p;
+
+  for(p=dial_str; *p; p++)
+    ms += (*p == ',') ? pause_ms : digit_ms;
+
+  pthread_mutex_lock(&mutex);
+  schedule(h, ITEM_DIALEND, 0, ++chans[h]->dial_gen, ms);
+  notify(h, WAIT_DIAL);
+  pthread_mutex_unlock(&mutex);
+
+  return CT_OK;
+}
+
+CTBackend *sim_backend_create(const char *script_file) {
+  SimBackend *sim = new SimBackend();
+
+  if (sim->load_script(script_file) != CT_OK) {
+    delete sim;
+    return NULL;
+  }
+  sim->start();
+
+  return sim;
+}
@@ -0,0 +1,448 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: STATS.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Counters and latency histograms for each command and event type.
+
+    Histograms are log-linear like HdrHistogram: each power of 2 of
+    microseconds is split into 16 buckets, so any value is known to
+    within 1/16th.  Every counter has a single writer that updates it
+    with plain relaxed atomics, and a thread of its own answers scrapes,
+    so nothing is shared with the call path and nothing is done when
+    nobody is asking.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "ctbackend.h"
+#include "log.h"
+#include "stats.h"
+
+#define SUB_BITS           HIST_SUB_BITS
+#define SUB                (1<<SUB_BITS)
+#define MAX_BITS           HIST_MAX_BITS
+#define BUCKETS            HIST_BUCKETS
+
+#define NUM_EVENTS         (CT_DIALEND+1)
+
+// Prometheus buckets are powers of 2 of microseconds, from 128us to 67s
+#define LE_FIRST           7
+#define LE_LAST            26
+
+#define MAX_REQ            1024
+
+typedef struct {
+  const char         *label;
+  int                tcp_port;
+  int                busy;
+  unsigned long long commands;
+  unsigned long long events;
+  unsigned long long errors;
+  unsigned long long lost;              // event queue was full
+} CHAN_STATS;
+
+// a response being built
+typedef struct {
+  char *s;
+  long n, size;
+} OUT;
+
+static int         nchans;
+static CHAN_STATS  *chans;
+static int         ncmd;
+static const char  **cmd_names;
+static HIST        *cmd_hist;
+static HIST        ev_hist[NUM_EVENTS];
+static int         listen_sd;
+
+#define LOAD(x)    __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define BUMP(x, n) __atomic_store_n(&(x), LOAD(x)+(n), __ATOMIC_RELAXED)
+
+static int bucket(unsigned long long v) {
+  int e;
+
+  if (v >= (1ULL<<MAX_BITS))
+    v = (1ULL<<MAX_BITS)-1;
+  if (v < SUB)
+    return v;
+  e = 63 - __builtin_clzll(v);
+  return (e-SUB_BITS+1)*SUB + ((v >> (e-SUB_BITS)) & (SUB-1));
+}
+
+// largest value that falls in bucket i
+
+static unsigned long long bucket_max(int i) {
+  int e, sub;
+
+  if (i < SUB)
+    return i;
+  e = i/SUB + SUB_BITS - 1;
+  sub = i%SUB;
+  return ((unsigned long long)(SUB+sub+1) << (e-SUB_BITS)) - 1;
+}
+
+void hist_add(HIST *h, unsigned long long us) {
+  BUMP(h->bucket[bucket(us)], 1);
+  BUMP(h->sum, us);
+  if (us > LOAD(h->max))
+    __atomic_store_n(&h->max, us, __ATOMIC_RELAXED);
+  BUMP(h->count, 1);
+}
+
+unsigned long long stats_now_us() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+void stats_init(int nchannels, const char **labels, const int *tcp_ports,
+		const char **names, int ncmds) {
+  int i;
+
+  nchans = nchannels;
+  chans = (CHAN_STATS*)calloc(nchans, sizeof(CHAN_STATS));
+  for(i=0; i<nchans; i++) {
+    chans[i].label = strdup(labels[i]);
+    chans[i].tcp_port = tcp_ports[i];
+  }
+  ncmd = ncmds;
+  cmd_names = (const char**)malloc(ncmd*sizeof(char*));
+  memcpy(cmd_names, names, ncmd*sizeof(char*));
+  cmd_hist = (HIST*)calloc(ncmd, sizeof(HIST));
+  listen_sd = -1;
+}
+
+void stats_command_start(int ch) {
+  __atomic_store_n(&chans[ch].busy, 1, __ATOMIC_RELAXED);
+}
+
+void stats_command_done(int ch, int cmd, unsigned long long us, int error) {
+  __atomic_store_n(&chans[ch].busy, 0, __ATOMIC_RELAXED);
+  BUMP(chans[ch].commands, 1);
+  if (error)
+    BUMP(chans[ch].errors, 1);
+  if ((cmd >= 0) && (cmd < ncmd))
+    hist_add(&cmd_hist[cmd], us);
+}
+
+void stats_event(int ch, int type, unsigned long long us) {
+  BUMP(chans[ch].events, 1);
+  if ((type >= 0) && (type < NUM_EVENTS))
+    hist_add(&ev_hist[type], us);
+}
+
+void stats_lost(int ch) {
+  BUMP(chans[ch].lost, 1);
+}
+
+/*--------------------------------------------------------------------------*\
+
+				  OUTPUT
+
+\*--------------------------------------------------------------------------*/
+
+static void out(OUT *o, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+static void out(OUT *o, const char *fmt, ...) {
+  va_list argptr;
+  int     n;
+
+  while(1) {
+    va_start(argptr, fmt);
+    n = vsnprintf(o->s+o->n, o->size-o->n, fmt, argptr);
+    va_end(argptr);
+    if (n < o->size-o->n)
+      break;
+    o->size *= 2;
+    o->s = (char*)realloc(o->s, o->size);
+  }
+  o->n += n;
+}
+
+// a consistent enough copy to report from, the writer may be part way
+// through an update
+
+static void hist_copy(HIST *to, HIST *from) {
+  int i;
+
+  to->count = LOAD(from->count);
+  to->sum = LOAD(from->sum);
+  to->max = LOAD(from->max);
+  for(i=0; i<BUCKETS; i++)
+    to->bucket[i] = LOAD(from->bucket[i]);
+}
+
+void hist_merge(HIST *to, HIST *from) {
+  int i;
+
+  to->count += from->count;
+  to->sum += from->sum;
+  if (from->max > to->max)
+    to->max = from->max;
+  for(i=0; i<BUCKETS; i++)
+    to->bucket[i] += from->bucket[i];
+}
+
+// the value p (0 to 1) of the way through, to within a bucket
+
+unsigned long long hist_percentile(HIST *h, double p) {
+  unsigned long long total = 0, want;
+  int                i;
+
+  for(i=0; i<BUCKETS; i++)
+    total += h->bucket[i];
+  if (total == 0)
+    return 0;
+  want = (unsigned long long)(p*total + 0.5);
+  if (want < 1)
+    want = 1;
+  for(i=0, total=0; i<BUCKETS; i++) {
+    total += h->bucket[i];
+    if (total >= want)
+      break;
+  }
+  return (bucket_max(i) < h->max) ? bucket_max(i) : h->max;
+}
+
+static void prom_hist(OUT *o, const char *metric, const char *label,
+		      const char *name, HIST *h) {
+  unsigned long long total = 0;
+  int                i, k;
+
+  for(i=0, k=LE_FIRST; k<=LE_LAST; k++) {
+    for(; (i<BUCKETS) && (bucket_max(i) < (1ULL<<k)); i++)
+      total += h->bucket[i];
+    out(o, "%s_bucket{%s=\"%s\",le=\"%g\"} %llu\n", metric, label, name,
+	(double)(1ULL<<k)/1E6, total);
+  }
+  out(o, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %llu\n", metric, label, name,
+      h->count);
+  out(o, "%s_sum{%s=\"%s\"} %g\n", metric, label, name, h->sum/1E6);
+  out(o, "%s_count{%s=\"%s\"} %llu\n", metric, label, name, h->count);
+}
+
+static void prometheus(OUT *o) {
+  HIST h;
+  int  i, busy;
+
+  for(i=0, busy=0; i<nchans; i++)
+    busy += LOAD(chans[i].busy);
+  out(o, "# HELP ctserver_channels_busy Channels running a command.\n"
+      "# TYPE ctserver_channels_busy gauge\n"
+      "ctserver_channels_busy %d\n", busy);
+
+  out(o, "# HELP ctserver_channel_busy 1 while a command is running.\n"
+      "# TYPE ctserver_channel_busy gauge\n");
+  for(i=0; i<nchans; i++)
+    out(o, "ctserver_channel_busy{channel=\"%s\"} %d\n", chans[i].label,
+	LOAD(chans[i].busy));
+  out(o, "# HELP ctserver_channel_commands_total Commands finished.\n"
+      "# TYPE ctserver_channel_commands_total counter\n");
+  for(i=0; i<nchans; i++)
+    out(o, "ctserver_channel_commands_total{channel=\"%s\"} %llu\n",
+	chans[i].label, LOAD(chans[i].commands));
+  out(o, "# HELP ctserver_channel_errors_total Commands that replied "
+      "ERROR.\n"
+      "# TYPE ctserver_channel_errors_total counter\n");
+  for(i=0; i<nchans; i++)
+    out(o, "ctserver_channel_errors_total{channel=\"%s\"} %llu\n",
+	chans[i].label, LOAD(chans[i].errors));
+  out(o, "# HELP ctserver_channel_events_total Hardware events handled.\n"
+      "# TYPE ctserver_channel_events_total counter\n");
+  for(i=0; i<nchans; i++)
+    out(o, "ctserver_channel_events_total{channel=\"%s\"} %llu\n",
+	chans[i].label, LOAD(chans[i].events));
+  out(o, "# HELP ctserver_channel_events_lost_total Hardware events lost "
+      "to a full queue.\n"
+      "# TYPE ctserver_channel_events_lost_total counter\n");
+  for(i=0; i<nchans; i++)
+    out(o, "ctserver_channel_events_lost_total{channel=\"%s\"} %llu\n",
+	chans[i].label, LOAD(chans[i].lost));
+
+  out(o, "# HELP ctserver_command_seconds Time from a command starting "
+      "to its reply.\n"
+      "# TYPE ctserver_command_seconds histogram\n");
+  for(i=0; i<ncmd; i++)
+    if (cmd_names[i]) {
+      hist_copy(&h, &cmd_hist[i]);
+      prom_hist(o, "ctserver_command_seconds", "command", cmd_names[i], &h);
+    }
+
+  out(o, "# HELP ctserver_event_seconds Time from the hardware event to "
+      "the end of its handling.\n"
+      "# TYPE ctserver_event_seconds histogram\n");
+  for(i=0; i<NUM_EVENTS; i++) {
+    hist_copy(&h, &ev_hist[i]);
+    prom_hist(o, "ctserver_event_seconds", "event", event_name(i), &h);
+  }
+}
+
+static void json_hist(OUT *o, const char *name, HIST *h, int last) {
+  out(o, "    \"%s\": {\"count\": %llu, \"sum_us\": %llu, \"p50_us\": %llu, "
+      "\"p90_us\": %llu, \"p99_us\": %llu, \"p999_us\": %llu, "
+      "\"max_us\": %llu}%s\n", name, h->count, h->sum,
+      hist_percentile(h, 0.5), hist_percentile(h, 0.9),
+      hist_percentile(h, 0.99), hist_percentile(h, 0.999), h->max, last ? "" : ",");
+}
+
+static void json(OUT *o) {
+  HIST h;
+  int  i, busy, last;
+
+  for(i=0, busy=0; i<nchans; i++)
+    busy += LOAD(chans[i].busy);
+  out(o, "{\n  \"channels_busy\": %d,\n  \"channels\": [\n", busy);
+  for(i=0; i<nchans; i++)
+    out(o, "    {\"channel\": \"%s\", \"tcp_port\": %d, \"busy\": %d, "
+	"\"commands\": %llu, \"errors\": %llu, \"events\": %llu, "
+	"\"events_lost\": %llu}%s\n", chans[i].label, chans[i].tcp_port,
+	LOAD(chans[i].busy), LOAD(chans[i].commands),
+	LOAD(chans[i].errors), LOAD(chans[i].events), LOAD(chans[i].lost),
+	(i == nchans-1) ? "" : ",");
+
+  out(o, "  ],\n  \"commands\": {\n");
+  for(last=ncmd-1; (last >= 0) && !cmd_names[last]; last--);
+  for(i=0; i<ncmd; i++)
+    if (cmd_names[i]) {
+      hist_copy(&h, &cmd_hist[i]);
+      json_hist(o, cmd_names[i], &h, i == last);
+    }
+
+  out(o, "  },\n  \"events\": {\n");
+  for(i=0; i<NUM_EVENTS; i++) {
+    hist_copy(&h, &ev_hist[i]);
+    json_hist(o, event_name(i), &h, i == NUM_EVENTS-1);
+  }
+  out(o, "  }\n}\n");
+}
+
+/*--------------------------------------------------------------------------*\
+
+				  SERVER
+
+\*--------------------------------------------------------------------------*/
+
+// answers one HTTP request, the client gets a second to send it and a
+// second for each part of the reply it takes.  A client that goes away
+// mid reply must not take ctserver with it, hence MSG_NOSIGNAL.
+
+static void serve(int sd) {
+  char           req[MAX_REQ], hdr[128];
+  const char     *type = "text/plain; version=0.0.4";
+  OUT            o;
+  struct timeval tv = {1, 0};
+  int            n, got = 0, hn;
+
+  setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  while(got < MAX_REQ-1) {
+    if ((n = read(sd, req+got, MAX_REQ-1-got)) <= 0)
+      break;
+    got += n;
+    req[got] = 0;
+    if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+      break;
+  }
+  req[got] = 0;
+
+  o.size = 16384;
+  o.s = (char*)malloc(o.size);
+  o.n = 0;
+  if (strncmp(req, "GET /metrics ", 13) == 0)
+    prometheus(&o);
+  else if (strncmp(req, "GET /json ", 10) == 0) {
+    json(&o);
+    type = "application/json";
+  }
+
+  if (o.n)
+    hn = sprintf(hdr, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+		 "Content-Length: %ld\r\n\r\n", type, o.n);
+  else
+    hn = sprintf(hdr, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+  if (send(sd, hdr, hn, MSG_NOSIGNAL) != hn)
+    o.n = 0;
+  for(n=0; n<o.n; ) {
+    hn = send(sd, o.s+n, o.n-n, MSG_NOSIGNAL);
+    if (hn <= 0)
+      break;
+    n += hn;
+  }
+  free(o.s);
+  close(sd);
+}
+
+static void *stats_thread(void *pv) {
+  int sd;
+
+  while(1) {
+    if ((sd = accept(listen_sd, NULL, NULL)) < 0)
+      continue;
+    serve(sd);
+  }
+
+  return NULL;
+}
+
+int stats_listen(int port) {
+  struct sockaddr_in addr;
+  pthread_t          thread;
+  int                on = 1;
+
+  if ((listen_sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    return -1;
+  setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if ((bind(listen_sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+      (listen(listen_sd, 5) < 0) ||
+      (pthread_create(&thread, NULL, stats_thread, NULL) != 0)) {
+    close(listen_sd);
+    listen_sd = -1;
+    return -1;
+  }
+  pthread_detach(thread);
+  mylog(LOG_INFO, "stats on port TCP %d", port);
+
+  return 0;
+}
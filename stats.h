@@ -0,0 +1,75 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: STATS.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Per channel counters and latency histograms, served to a local TCP
+    port as Prometheus text or JSON.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __STATS__
+#define __STATS__
+
+// a latency histogram in microseconds, log-linear like HdrHistogram
+#define HIST_SUB_BITS      4            // 16 buckets per power of 2
+#define HIST_MAX_BITS      40           // values up to 2^40 us, 12 days
+#define HIST_BUCKETS       ((HIST_MAX_BITS-HIST_SUB_BITS+1)<<HIST_SUB_BITS)
+
+typedef struct {
+  unsigned long long count;
+  unsigned long long sum;
+  unsigned long long max;
+  unsigned long long bucket[HIST_BUCKETS];
+} HIST;
+
+// single writer, readers in other threads see a nearly consistent view
+void hist_add(HIST *h, unsigned long long us);
+void hist_merge(HIST *to, HIST *from);
+unsigned long long hist_percentile(HIST *h, double p);
+
+// labels are "board:channel" strings, cmd_names are indexed by command
+// number with NULL for ones not to report.  Must be called before any
+// of the others.
+void stats_init(int nchannels, const char **labels, const int *tcp_ports,
+		const char **cmd_names, int ncmds);
+
+// starts a thread serving GET /metrics (Prometheus) and GET /json on
+// 127.0.0.1:port, returns -1 if the port can't be opened
+int  stats_listen(int port);
+
+// the rest are cheap enough for the call path.  Each counter must only
+// be updated from one thread, the reactor except for stats_lost().
+
+unsigned long long stats_now_us();
+void stats_command_start(int ch);
+void stats_command_done(int ch, int cmd, unsigned long long us, int error);
+void stats_event(int ch, int type, unsigned long long us);
+void stats_lost(int ch);
+
+#endif
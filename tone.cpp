@@ -0,0 +1,275 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TONE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Software DTMF and call progress tone detector.  A bank of Goertzel
+    filters is run over each 20 ms frame, four channels at a time in the
+    lanes of an SSE register.  DTMF is decided frame by frame, call
+    progress tones by their cadence.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "ctbackend.h"
+#include "tone.h"
+
+#define FS                 8000
+#define LANES              4            // channels per pass
+
+// frame energy of a pair of tones MIN_LEVEL peak, and of one tone
+#define MIN_LEVEL          250
+#define MIN_ENERGY         (TONE_FRAME*MIN_LEVEL*MIN_LEVEL)
+#define MIN_TONE_ENERGY    (TONE_FRAME*MIN_LEVEL*MIN_LEVEL/2)
+
+// DTMF, the share of frame energy in the row and column tones, the most
+// they may differ in level (8 dB), and how far they must stand above the
+// other tones in their group
+#define DTMF_SHARE         0.6
+#define TWIST              6.3
+#define PEAK               4.0
+
+// share of frame energy in the strongest call progress tone
+#define CP_SHARE           0.4
+
+// cadences, in frames
+#define GAP_FRAMES         11           // shorter offs are part of a tone
+#define BUSY_MIN           11
+#define BUSY_MAX           35
+#define RING_ON_MIN        15
+#define RING_ON_MAX        125
+#define RING_OFF           50
+#define DIAL_FRAMES        110          // longer than any ringback on
+
+// DTMF rows and columns, then call progress tones are in 350-620 Hz
+
+static const float freqs[TONE_BINS] = {
+  697, 770, 852, 941, 1209, 1336, 1477, 1633,
+  350, 375, 400, 425, 450, 480, 550, 620
+};
+
+static float coef[TONE_BINS];
+static int   coef_ready;
+
+void tone_init(TONE_DET *t) {
+  int i;
+
+  if (!coef_ready) {
+    for(i=0; i<TONE_BINS; i++)
+      coef[i] = 2*cos(2*M_PI*freqs[i]/FS);
+    coef_ready = 1;
+  }
+
+  memset(t, 0, sizeof(TONE_DET));
+  t->off_frames = RING_OFF+1;
+  t->tone = -1;
+}
+
+// Goertzel power of each bin, and the energy of each lane's frame
+
+static void goertzel(float x[][LANES], float p[][LANES], float e[LANES]) {
+  int i, j, b;
+
+#ifdef __SSE2__
+  __m128 c[4], s1[4], s2[4], s0, v, acc;
+
+  for(b=0; b<TONE_BINS; b+=4) {
+    for(j=0; j<4; j++) {
+      c[j] = _mm_set1_ps(coef[b+j]);
+      s1[j] = s2[j] = _mm_setzero_ps();
+    }
+    // four bins at once so the filters' recursions overlap
+    for(i=0; i<TONE_FRAME; i++) {
+      v = _mm_load_ps(x[i]);
+      for(j=0; j<4; j++) {
+	s0 = _mm_add_ps(v, _mm_sub_ps(_mm_mul_ps(c[j], s1[j]), s2[j]));
+	s2[j] = s1[j];
+	s1[j] = s0;
+      }
+    }
+    for(j=0; j<4; j++) {
+      v = _mm_add_ps(_mm_mul_ps(s1[j], s1[j]), _mm_mul_ps(s2[j], s2[j]));
+      v = _mm_sub_ps(v, _mm_mul_ps(c[j], _mm_mul_ps(s1[j], s2[j])));
+      _mm_store_ps(p[b+j], v);
+    }
+  }
+
+  acc = _mm_setzero_ps();
+  for(i=0; i<TONE_FRAME; i++) {
+    v = _mm_load_ps(x[i]);
+    acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+  }
+  _mm_store_ps(e, acc);
+#else
+  float s0, s1[LANES], s2[LANES];
+
+  for(b=0; b<TONE_BINS; b++) {
+    for(j=0; j<LANES; j++)
+      s1[j] = s2[j] = 0;
+    for(i=0; i<TONE_FRAME; i++)
+      for(j=0; j<LANES; j++) {
+	s0 = x[i][j] + coef[b]*s1[j] - s2[j];
+	s2[j] = s1[j];
+	s1[j] = s0;
+      }
+    for(j=0; j<LANES; j++)
+      p[b][j] = s1[j]*s1[j] + s2[j]*s2[j] - coef[b]*s1[j]*s2[j];
+  }
+
+  for(j=0; j<LANES; j++)
+    e[j] = 0;
+  for(i=0; i<TONE_FRAME; i++)
+    for(j=0; j<LANES; j++)
+      e[j] += x[i][j]*x[i][j];
+#endif
+}
+
+// A tone at a bin's frequency has power (A*N/2)^2 and energy A*A*N/2,
+// so 2p/(N*e) is the share of the frame's energy in that bin.
+
+static char dtmf_digit(const float p[], float e) {
+  static const char keys[] = "123A456B789C*0#D";
+  int               row = 0, col = 4, i;
+
+  if (e < MIN_ENERGY)
+    return 0;
+
+  for(i=1; i<4; i++)
+    if (p[i] > p[row])
+      row = i;
+  for(i=5; i<8; i++)
+    if (p[i] > p[col])
+      col = i;
+
+  if ((p[row] > TWIST*p[col]) || (p[col] > TWIST*p[row]))
+    return 0;
+  if (2*(p[row]+p[col]) < DTMF_SHARE*TONE_FRAME*e)
+    return 0;
+  for(i=0; i<8; i++)
+    if ((i != row) && (i != col) && (PEAK*p[i] > (i < 4 ? p[row] : p[col])))
+      return 0;
+
+  return keys[row*4 + col-4];
+}
+
+static int cp_tone(const float p[], float e) {
+  float max = 0;
+  int   i;
+
+  if (e < MIN_TONE_ENERGY)
+    return 0;
+  for(i=8; i<TONE_BINS; i++)
+    if (p[i] > max)
+      max = p[i];
+
+  return 2*max >= CP_SHARE*TONE_FRAME*e;
+}
+
+// one frame's bins for one detector
+
+static void decide(TONE_DET *t, const float p[], float e) {
+  char d = dtmf_digit(p, e);
+  int  on = !d && cp_tone(p, e);
+
+  // a digit must be in two frames in a row
+  t->dtmf = 0;
+  if (d && (d == t->cand) && (d != t->digit)) {
+    t->digit = d;
+    t->dtmf = d;
+  }
+  if (!d && !t->cand)
+    t->digit = 0;
+  t->cand = d;
+
+  t->tone = -1;
+  if (on) {
+    if (!t->on) {
+      if (t->off_frames < GAP_FRAMES) {
+	// a drop out, or the short break in a double ring
+	t->on_frames += t->off_frames;
+	t->gaps++;
+      }
+      else {
+	if ((t->last_on >= BUSY_MIN) && (t->last_on <= BUSY_MAX) &&
+	    (t->off_frames >= BUSY_MIN) && (t->off_frames <= BUSY_MAX)) {
+	  if (++t->busy_cycles == 2)
+	    t->tone = CT_TONE_BUSY;
+	}
+	else
+	  t->busy_cycles = 0;
+	t->on_frames = 0;
+	t->gaps = 0;
+      }
+    }
+    if (t->on_frames <= RING_ON_MAX)
+      t->on_frames++;
+    if ((t->on_frames == DIAL_FRAMES) && !t->gaps)
+      t->tone = CT_TONE_DIAL;
+  }
+  else {
+    if (t->on) {
+      t->last_on = t->on_frames;
+      t->off_frames = 0;
+    }
+    if (t->off_frames <= RING_OFF)
+      t->off_frames++;
+    if ((t->off_frames == RING_OFF) && (t->last_on >= RING_ON_MIN) &&
+	(t->last_on <= RING_ON_MAX)) {
+      t->tone = CT_TONE_RINGBACK;
+      t->busy_cycles = 0;
+    }
+  }
+  t->on = on;
+}
+
+void tone_frames(TONE_DET *t[], const short *x[], int n) {
+  float xt[TONE_FRAME][LANES] __attribute__ ((aligned (16)));
+  float p[TONE_BINS][LANES] __attribute__ ((aligned (16)));
+  float e[LANES] __attribute__ ((aligned (16)));
+  float q[TONE_BINS];
+  int   i, j, k, m;
+
+  for(i=0; i<n; i+=LANES) {
+    m = (n-i < LANES) ? n-i : LANES;
+    for(k=0; k<TONE_FRAME; k++)
+      for(j=0; j<LANES; j++)
+	xt[k][j] = (j < m) ? x[i+j][k] : 0;
+
+    goertzel(xt, p, e);
+
+    for(j=0; j<m; j++) {
+      for(k=0; k<TONE_BINS; k++)
+	q[k] = p[k][j];
+      decide(t[i+j], q, e[j]);
+    }
+  }
+}
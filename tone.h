@@ -0,0 +1,68 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TONE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Software DTMF and call progress tone detector, for audio the card
+    hasn't looked at.  Channels are processed a frame at a time, several
+    channels per pass.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __TONE__
+#define __TONE__
+
+#define TONE_FRAME         160          // samples, 20 ms
+#define TONE_BINS          16           // 8 DTMF, 8 call progress
+
+typedef struct {
+  // DTMF
+  char          cand;                   // digit in the last frame, 0 none
+  char          digit;                  // digit being heard, 0 none
+
+  // call progress cadence, in frames
+  int           on;                     // tone in the last frame
+  int           on_frames;              // length of this on period
+  int           off_frames;             // length of this off period
+  int           last_on;                // length of the last on period
+  int           gaps;                   // short drop outs in this period
+  int           busy_cycles;
+
+  // results for the last frame
+  char          dtmf;                   // digit that started, 0 for none
+  int           tone;                   // CT_TONE_* detected, -1 for none
+} TONE_DET;
+
+void tone_init(TONE_DET *t);
+
+// runs n detectors over a frame of TONE_FRAME samples each, x[i] is the
+// next frame for t[i].  A digit is reported in the second frame it is
+// heard in.
+void tone_frames(TONE_DET *t[], const short *x[], int n);
+
+#endif
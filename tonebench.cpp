@@ -0,0 +1,203 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TONEBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Benchmark for the software tone detector (tone.cpp).  Runs a number
+    of channels of synthetic audio, a quarter each of DTMF, dial tone,
+    busy and ringback, through tone_frames() in one batch per 20 ms
+    frame.  Prints what was detected on each kind of channel and how
+    many channels one core could keep up with.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "ctbackend.h"
+#include "tone.h"
+
+#define FS                 8000
+#define KINDS              4
+#define DIGITS             "0123456789*#ABCD"
+
+static const char *kind_names[KINDS] = {"dtmf", "dial", "busy", "ringback"};
+
+// cadence, ms of on then off, repeated, and the tones
+
+typedef struct {
+  float f1, f2;
+  int   cadence[4];
+} CP;
+
+static const CP cps[KINDS] = {
+  {0,   0,   {0, 0, 0, 0}},
+  {350, 440, {1000, 0, 0, 0}},           // continuous
+  {480, 620, {500, 500, 0, 0}},
+  {400, 450, {400, 200, 400, 2000}}      // Australian double ring
+};
+
+static short noise(unsigned int *seed) {
+  *seed = *seed*1103515245 + 12345;
+  return (short)((*seed >> 16) % 201) - 100;
+}
+
+// n samples of one kind of channel
+
+static void generate(int kind, short *x, long n) {
+  static const float row[] = {697, 770, 852, 941};
+  static const float col[] = {1209, 1336, 1477, 1633};
+  static const char  *keys = "123A456B789C*0#D";
+  const CP           *cp = &cps[kind];
+  unsigned int       seed = kind;
+  long               i, t, period;
+  int                k, j, on;
+  float              f1, f2;
+
+  for(period=0, j=0; j<4; j++)
+    period += cp->cadence[j];
+
+  for(i=0; i<n; i++) {
+    x[i] = noise(&seed);
+    if (kind == 0) {
+      // each digit 100 ms, then 100 ms of quiet
+      t = i % (FS/5);
+      if (t >= FS/10)
+	continue;
+      k = strchr(keys, DIGITS[(i/(FS/5)) % 16]) - keys;
+      f1 = row[k/4];
+      f2 = col[k%4];
+    }
+    else {
+      t = (i*1000/FS) % period;
+      for(on=1, j=0; t >= cp->cadence[j]; j++, on=!on)
+	t -= cp->cadence[j];
+      if (!on)
+	continue;
+      f1 = cp->f1;
+      f2 = cp->f2;
+    }
+    x[i] += (short)(2000*sin(2*M_PI*f1*i/FS) + 2000*sin(2*M_PI*f2*i/FS));
+  }
+}
+
+static double cpu_time() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1E9;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int          channels = 1024, seconds = 10;
+  TONE_DET     *dets, **t;
+  const short  **x;
+  short        *audio[KINDS];
+  long         n, f, frames;
+  int          i, k;
+  int          ndigits[KINDS], ntones[KINDS][4];
+  char         heard[64];
+  double       cpu;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-channels n] [-time s]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-channels")) && (i+1 < argc))
+    channels = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-time")) && (i+1 < argc))
+    seconds = atoi(argv[i+1]);
+
+  frames = (long)seconds*FS/TONE_FRAME;
+  n = frames*TONE_FRAME;
+  for(k=0; k<KINDS; k++) {
+    audio[k] = (short*)malloc(n*sizeof(short));
+    generate(k, audio[k], n);
+  }
+
+  dets = (TONE_DET*)malloc(channels*sizeof(TONE_DET));
+  t = (TONE_DET**)malloc(channels*sizeof(TONE_DET*));
+  x = (const short**)malloc(channels*sizeof(short*));
+  for(i=0; i<channels; i++) {
+    tone_init(&dets[i]);
+    t[i] = &dets[i];
+  }
+  memset(ndigits, 0, sizeof(ndigits));
+  memset(ntones, 0, sizeof(ntones));
+  heard[0] = 0;
+
+  cpu = cpu_time();
+  for(f=0; f<frames; f++) {
+    for(i=0; i<channels; i++)
+      x[i] = audio[i % KINDS] + f*TONE_FRAME;
+    tone_frames(t, x, channels);
+    for(i=0; i<channels; i++) {
+      k = i % KINDS;
+      if (dets[i].dtmf) {
+	ndigits[k]++;
+	if ((i == 0) && (strlen(heard) < sizeof(heard)-1))
+	  strncat(heard, &dets[i].dtmf, 1);
+      }
+      if (dets[i].tone != -1)
+	ntones[k][dets[i].tone]++;
+    }
+  }
+  cpu = cpu_time() - cpu;
+
+  printf("%d channels %d s of audio, channel 0 heard %s\n", channels,
+	 seconds, heard);
+  printf("  %-9s %7s %7s %7s %7s\n", "channels", "digits", "dial", "busy",
+	 "ringbk");
+  for(k=0; k<KINDS; k++)
+    printf("  %-9s %7d %7d %7d %7d\n", kind_names[k], ndigits[k],
+	   ntones[k][CT_TONE_DIAL], ntones[k][CT_TONE_BUSY],
+	   ntones[k][CT_TONE_RINGBACK]);
+  printf("%.3f s CPU, %.0f ns per channel frame, %.0f channels per core\n",
+	 cpu, cpu*1E9/((double)frames*channels),
+	 (double)channels*seconds/cpu);
+
+  for(k=0; k<KINDS; k++)
+    free(audio[k]);
+  free(dets);
+  free(t);
+  free(x);
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TRACE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Binary per channel trace.  The file is a header and a fixed number
+    of 64 byte records, written through a shared mapping so nothing is
+    lost if ctserver dies.  When it is full the oldest records are
+    overwritten.
+
+    Timer behaviour is not replayed.  Expired channel timers are
+    recorded as CT_TIMEREXP events and replayed as such, but replay
+    doesn't run the timing wheel, so it can't show that a timer would
+    have fired at the same time.  The client idle time out and campaign
+    pacing leave no event and are lost.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+#define TRACE_MAGIC        "CTTRACE1"
+
+static TRACE_HDR          *hdr;
+static TRACE_REC          *recs;
+static unsigned long      size;
+static unsigned long long t0;
+
+static unsigned long long now_us() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+int trace_open(const char *file_name, unsigned long nrecs, int nports) {
+  void *p;
+  int  fd;
+
+  if (nrecs == 0)
+    return -1;
+  fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return -1;
+  size = sizeof(TRACE_HDR) + nrecs*sizeof(TRACE_REC);
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    return -1;
+  }
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+
+  hdr = (TRACE_HDR*)p;
+  recs = (TRACE_REC*)(hdr+1);
+  memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+  hdr->rec_size = sizeof(TRACE_REC);
+  hdr->nports = nports;
+  hdr->nrecs = nrecs;
+  hdr->started = time(NULL);
+  hdr->head = 0;
+  t0 = now_us();
+
+  return 0;
+}
+
+void trace_add(int chan, int kind, int type, int data, const char *text,
+	       int n) {
+  TRACE_REC *r;
+
+  if (hdr == NULL)
+    return;
+
+  r = &recs[hdr->head % hdr->nrecs];
+  r->t = now_us() - t0;
+  r->chan = chan;
+  r->kind = kind;
+  r->type = type;
+  r->data = data;
+  if (n > TRACE_TEXT)
+    n = TRACE_TEXT;
+  r->n = n;
+  if (n)
+    memcpy(r->text, text, n);
+
+  // a reader of a live trace only looks at records below head
+  __atomic_store_n(&hdr->head, hdr->head+1, __ATOMIC_RELEASE);
+}
+
+void trace_close() {
+  if (hdr == NULL)
+    return;
+  munmap(hdr, size);
+  hdr = NULL;
+}
+
+int trace_map(const char *file_name, TRACE_MAP *m) {
+  struct stat st;
+  void        *p;
+  int         fd;
+
+  fd = open(file_name, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if ((fstat(fd, &st) != 0) ||
+      ((unsigned long)st.st_size < sizeof(TRACE_HDR))) {
+    close(fd);
+    return -1;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return -1;
+
+  m->hdr = (TRACE_HDR*)p;
+  m->recs = (TRACE_REC*)(m->hdr+1);
+  m->size = st.st_size;
+  if (memcmp(m->hdr->magic, TRACE_MAGIC, sizeof(m->hdr->magic)) ||
+      (m->hdr->rec_size != sizeof(TRACE_REC)) || (m->hdr->nrecs == 0) ||
+      (m->size < sizeof(TRACE_HDR) + m->hdr->nrecs*sizeof(TRACE_REC))) {
+    munmap(p, m->size);
+    return -1;
+  }
+
+  m->n = m->hdr->head;
+  m->first = 0;
+  if (m->n > m->hdr->nrecs) {
+    m->first = m->n % m->hdr->nrecs;
+    m->n = m->hdr->nrecs;
+  }
+
+  return 0;
+}
+
+TRACE_REC *trace_rec(TRACE_MAP *m, unsigned long long i) {
+  return &m->recs[(m->first + i) % m->hdr->nrecs];
+}
+
+void trace_unmap(TRACE_MAP *m) {
+  munmap(m->hdr, m->size);
+}
@@ -0,0 +1,91 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TRACE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Binary trace of what each channel saw: hardware events, client input
+    and the replies sent, in an mmap'd file used as a ring, so a call can
+    be replayed later (ctserver -replay).
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __TRACE__
+#define __TRACE__
+
+// kinds of record
+#define TRACE_EVENT        0            // type and data of a backend event
+#define TRACE_OPEN         1            // client attached
+#define TRACE_INPUT        2            // bytes from the client
+#define TRACE_CLOSE        3            // client went away
+#define TRACE_CID          4            // CID decoded, text is the number
+#define TRACE_REPLY        5            // sent to the client, to check
+
+#define TRACE_TEXT         40
+
+typedef struct {
+  unsigned long long t;                 // us since the trace started
+  unsigned short     chan;              // index of the channel
+  unsigned char      kind;
+  unsigned char      n;                 // bytes of text
+  int                type;
+  int                data;
+  char               text[TRACE_TEXT];
+} TRACE_REC;
+
+typedef struct {
+  char               magic[8];
+  unsigned int       rec_size;
+  unsigned int       nports;
+  unsigned long long nrecs;             // records the ring holds
+  unsigned long long started;           // time() tracing started
+  unsigned long long head;              // records ever written
+  char               pad[24];
+} TRACE_HDR;
+
+// a trace opened for reading, records are numbered from the oldest kept
+typedef struct {
+  TRACE_HDR          *hdr;
+  TRACE_REC          *recs;
+  unsigned long long first;
+  unsigned long long n;
+  unsigned long      size;
+} TRACE_MAP;
+
+// writing, trace_add must only be called from one thread (the reactor)
+// and does nothing unless trace_open succeeded.  Text longer than
+// TRACE_TEXT is cut short.
+int  trace_open(const char *file_name, unsigned long nrecs, int nports);
+void trace_add(int chan, int kind, int type, int data, const char *text,
+	       int n);
+void trace_close();
+
+int  trace_map(const char *file_name, TRACE_MAP *m);
+TRACE_REC *trace_rec(TRACE_MAP *m, unsigned long long i);
+void trace_unmap(TRACE_MAP *m);
+
+#endif
@@ -0,0 +1,492 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TRANSCODE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Audio transcoding and resampling, see transcode.h.
+
+    G.711 is done eight samples at a time in SSE2 registers.  The
+    segment shifts differ per sample, so they are done as multiplies by
+    a power of two built from the bits of the segment number; the
+    results match g711.cpp exactly.
+
+    The resampler is a polyphase FIR: for a ratio of L/M (in lowest
+    terms) a windowed sinc low pass at the lower of the two Nyquist
+    rates is designed for the signal upsampled by L, and split into L
+    phases of T taps.  Each output sample is then a T tap dot product
+    of the input against one phase.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "ctbackend.h"
+#include "g711.h"
+#include "wave.h"
+#include "transcode.h"
+
+#define FS                 8000
+#define TAPS               32           // per phase, per unit of decimation
+#define CUTOFF             0.45         // of the lower sample rate
+#define MAX_COEFFS         (1<<20)
+
+/*--------------------------------------------------------------------------*\
+
+				  G.711
+
+\*--------------------------------------------------------------------------*/
+
+#ifdef __SSE2__
+
+// 2^e for 16 bit lanes holding 0 <= e <= 7
+
+static inline __m128i pow2(__m128i e) {
+  const __m128i one = _mm_set1_epi16(1);
+  __m128i       p;
+
+  p = _mm_add_epi16(one, _mm_and_si128(e, one));
+  p = _mm_mullo_epi16(p, _mm_add_epi16(one, _mm_mullo_epi16(
+	_mm_and_si128(_mm_srli_epi16(e, 1), one), _mm_set1_epi16(3))));
+  p = _mm_mullo_epi16(p, _mm_add_epi16(one, _mm_mullo_epi16(
+	_mm_and_si128(_mm_srli_epi16(e, 2), one), _mm_set1_epi16(15))));
+  return p;
+}
+
+// 2^13 >> e for 16 bit lanes holding 0 <= e <= 7
+
+static inline __m128i pow2_down(__m128i e) {
+  const __m128i one = _mm_set1_epi16(1);
+  __m128i       p = _mm_set1_epi16(1<<13), m;
+
+  m = _mm_cmpeq_epi16(_mm_and_si128(e, one), one);
+  p = _mm_or_si128(_mm_and_si128(m, _mm_srli_epi16(p, 1)),
+		   _mm_andnot_si128(m, p));
+  m = _mm_cmpeq_epi16(_mm_and_si128(_mm_srli_epi16(e, 1), one), one);
+  p = _mm_or_si128(_mm_and_si128(m, _mm_srli_epi16(p, 2)),
+		   _mm_andnot_si128(m, p));
+  m = _mm_cmpeq_epi16(_mm_and_si128(_mm_srli_epi16(e, 2), one), one);
+  p = _mm_or_si128(_mm_and_si128(m, _mm_srli_epi16(p, 4)),
+		   _mm_andnot_si128(m, p));
+  return p;
+}
+
+// number of thresholds t, t*2 .. t*64 that x is at or above
+
+static inline __m128i segment(__m128i x, int t) {
+  __m128i e = _mm_setzero_si128();
+  int     i;
+
+  for(i=0; i<7; i++, t <<= 1)
+    e = _mm_sub_epi16(e, _mm_cmpgt_epi16(x, _mm_set1_epi16(t-1)));
+  return e;
+}
+
+static inline __m128i mulaw_dec8(__m128i u) {
+  __m128i s, e, x;
+
+  u = _mm_xor_si128(u, _mm_set1_epi16(0xff));
+  s = _mm_cmpeq_epi16(_mm_and_si128(u, _mm_set1_epi16(0x80)),
+		      _mm_set1_epi16(0x80));
+  e = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(7));
+  x = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0xf)), 3),
+		    _mm_set1_epi16(0x84));
+  x = _mm_sub_epi16(_mm_mullo_epi16(x, pow2(e)), _mm_set1_epi16(0x84));
+  return _mm_sub_epi16(_mm_xor_si128(x, s), s);
+}
+
+static inline __m128i alaw_dec8(__m128i a) {
+  __m128i s, e, m, x0, x1, z;
+
+  a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+  s = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)),
+		      _mm_setzero_si128());
+  e = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(7));
+  m = _mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0xf)), 4);
+  z = _mm_cmpeq_epi16(e, _mm_setzero_si128());
+  x0 = _mm_add_epi16(m, _mm_set1_epi16(8));
+  x1 = _mm_mullo_epi16(_mm_add_epi16(m, _mm_set1_epi16(0x108)),
+		       pow2(_mm_sub_epi16(e, _mm_set1_epi16(1))));
+  x1 = _mm_or_si128(_mm_and_si128(z, x0), _mm_andnot_si128(z, x1));
+  return _mm_sub_epi16(_mm_xor_si128(x1, s), s);
+}
+
+static inline __m128i mulaw_enc8(__m128i x) {
+  __m128i s, ax, e, m;
+
+  s = _mm_srai_epi16(x, 15);
+  ax = _mm_max_epi16(x, _mm_subs_epi16(_mm_setzero_si128(), x));
+  ax = _mm_add_epi16(_mm_min_epi16(ax, _mm_set1_epi16(32635)),
+		     _mm_set1_epi16(0x84));
+  e = segment(ax, 0x100);
+  m = _mm_and_si128(_mm_mulhi_epu16(ax, pow2_down(e)), _mm_set1_epi16(0xf));
+  x = _mm_or_si128(_mm_or_si128(_mm_and_si128(s, _mm_set1_epi16(0x80)),
+				_mm_slli_epi16(e, 4)), m);
+  return _mm_xor_si128(x, _mm_set1_epi16(0xff));
+}
+
+static inline __m128i alaw_enc8(__m128i x) {
+  __m128i s, ax, e, m;
+
+  s = _mm_srai_epi16(x, 15);
+  ax = _mm_xor_si128(x, s);
+  e = segment(ax, 0x100);
+  m = _mm_max_epi16(e, _mm_set1_epi16(1));
+  m = _mm_and_si128(_mm_mulhi_epu16(ax, pow2_down(m)), _mm_set1_epi16(0xf));
+  x = _mm_or_si128(_mm_or_si128(_mm_andnot_si128(s, _mm_set1_epi16(0x80)),
+				_mm_slli_epi16(e, 4)), m);
+  return _mm_xor_si128(x, _mm_set1_epi16(0x55));
+}
+
+#endif
+
+void tc_decode(short *out, const char *in, long n, int mode) {
+  long i = 0;
+
+  if (mode == CT_LINEAR) {
+    memcpy(out, in, n*sizeof(short));
+    return;
+  }
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  __m128i       b, lo, hi;
+
+  for(; i+16<=n; i+=16) {
+    b = _mm_loadu_si128((const __m128i*)(in+i));
+    lo = _mm_unpacklo_epi8(b, zero);
+    hi = _mm_unpackhi_epi8(b, zero);
+    if (mode == CT_MULAW) {
+      lo = mulaw_dec8(lo);
+      hi = mulaw_dec8(hi);
+    }
+    else {
+      lo = alaw_dec8(lo);
+      hi = alaw_dec8(hi);
+    }
+    _mm_storeu_si128((__m128i*)(out+i), lo);
+    _mm_storeu_si128((__m128i*)(out+i+8), hi);
+  }
+#endif
+
+  for(; i<n; i++)
+    out[i] = (mode == CT_MULAW) ? mulaw2linear(in[i]) : alaw2linear(in[i]);
+}
+
+void tc_encode(char *out, const short *in, long n, int mode) {
+  long i = 0;
+
+  if (mode == CT_LINEAR) {
+    memcpy(out, in, n*sizeof(short));
+    return;
+  }
+
+#ifdef __SSE2__
+  __m128i lo, hi;
+
+  for(; i+16<=n; i+=16) {
+    lo = _mm_loadu_si128((const __m128i*)(in+i));
+    hi = _mm_loadu_si128((const __m128i*)(in+i+8));
+    if (mode == CT_MULAW) {
+      lo = mulaw_enc8(lo);
+      hi = mulaw_enc8(hi);
+    }
+    else {
+      lo = alaw_enc8(lo);
+      hi = alaw_enc8(hi);
+    }
+    _mm_storeu_si128((__m128i*)(out+i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+
+  for(; i<n; i++)
+    out[i] = (mode == CT_MULAW) ? linear2mulaw(in[i]) : linear2alaw(in[i]);
+}
+
+/*--------------------------------------------------------------------------*\
+
+				Resampling
+
+\*--------------------------------------------------------------------------*/
+
+static int gcd(int a, int b) {
+  int t;
+
+  while(b) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// n taps, n a multiple of 16
+
+static float dot(const float *x, const float *h, int n) {
+  int   i;
+
+#ifdef __SSE2__
+  __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+  float  r[4];
+
+  for(i=0; i<n; i+=16) {
+    a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(h+i)));
+    a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(h+i+4)));
+    a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(x+i+8), _mm_loadu_ps(h+i+8)));
+    a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(x+i+12),
+				   _mm_loadu_ps(h+i+12)));
+  }
+  _mm_storeu_ps(r, _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3)));
+  return r[0] + r[1] + r[2] + r[3];
+#else
+  float y = 0;
+
+  for(i=0; i<n; i++)
+    y += x[i]*h[i];
+  return y;
+#endif
+}
+
+// the rates are limited so the filter stays a reasonable size
+
+int tc_resample_ok(int from, int to) {
+  int g;
+
+  if ((from <= 0) || (to <= 0))
+    return 0;
+  g = gcd(from, to);
+  return (long)(to/g)*TAPS*((from + to - 1)/to) <= MAX_COEFFS;
+}
+
+long tc_resample_len(long n, int from, int to) {
+  return (long)(((long long)n*to + from - 1)/from);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: tc_resample
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Resamples a whole buffer.  Output sample k is taken at upsampled
+	time k*M plus the filter delay D, which is a whole number of
+	upsampled samples so the output lines up exactly with the input.  The input is padded with T zeros either side so every dot
+	product is the same length.
+
+\*--------------------------------------------------------------------------*/
+
+long tc_resample(short *out, const short *in, long n, int from, int to) {
+  int       g, L, M, T, N, p, q;
+  long      k, nout, i;
+  long long t, D;
+  double    fc, x, w;
+  float     *h, *xp, y;
+
+  if (!tc_resample_ok(from, to))
+    return -1;
+  if (from == to) {
+    memcpy(out, in, n*sizeof(short));
+    return n;
+  }
+
+  g = gcd(from, to);
+  L = to/g;
+  M = from/g;
+  T = TAPS*((from + to - 1)/to);
+  N = L*T;
+
+  // prototype low pass at the upsampled rate, gain L, stored by phase
+  // with the taps reversed to run forward over the input
+  h = (float*)malloc(N*sizeof(float));
+  fc = CUTOFF*(from < to ? from : to)/((double)from*L);
+  D = (N-1)/2;
+  for(k=0; k<N; k++) {
+    x = k - D;
+    w = 0.42 - 0.5*cos(2*M_PI*(k+0.5)/N) + 0.08*cos(4*M_PI*(k+0.5)/N);
+    y = L*w*((x == 0) ? 2*fc : sin(2*M_PI*fc*x)/(M_PI*x));
+    p = k % L;
+    q = T-1 - k/L;
+    h[p*T + q] = y;
+  }
+
+  xp = (float*)calloc(n + 2*T, sizeof(float));
+  for(i=0; i<n; i++)
+    xp[T+i] = in[i];
+
+  nout = tc_resample_len(n, from, to);
+  for(k=0; k<nout; k++) {
+    t = (long long)k*M + D;
+    i = t/L;
+    p = t%L;
+    y = dot(xp + i + 1, h + p*T, T);
+    if (y > 32767)
+      y = 32767;
+    if (y < -32768)
+      y = -32768;
+    out[k] = (short)lrintf(y);
+  }
+
+  free(xp);
+  free(h);
+
+  return nout;
+}
+
+/*--------------------------------------------------------------------------*\
+
+				  Files
+
+\*--------------------------------------------------------------------------*/
+
+short *tc_read(const char *file_name, int rate, long *n) {
+  WAVE  *w;
+  char  *buf;
+  short *x, *y;
+  long  bytes, i;
+  int   mode, chans, from;
+
+  if (wave_open_read(&w, file_name) != CT_OK)
+    return NULL;
+  mode = wave_get_mode(w);
+  chans = wave_get_channels(w);
+  from = wave_get_rate(w);
+  bytes = wave_get_size(w);
+  buf = (char*)malloc(bytes ? bytes : 1);
+  bytes = wave_read(w, buf, bytes);
+  wave_close(w);
+
+  *n = bytes/wave_bytes_per_sample(mode);
+  x = (short*)malloc((*n ? *n : 1)*sizeof(short));
+  tc_decode(x, buf, *n, mode);
+  free(buf);
+
+  if (chans == 2) {
+    *n /= 2;
+    for(i=0; i<*n; i++)
+      x[i] = (x[2*i] + x[2*i+1])/2;
+  }
+
+  if (from != rate) {
+    y = (short*)malloc((tc_resample_len(*n, from, rate) + 1)*sizeof(short));
+    *n = tc_resample(y, x, *n, from, rate);
+    free(x);
+    x = y;
+    if (*n < 0) {
+      free(x);
+      return NULL;
+    }
+  }
+
+  return x;
+}
+
+char *tc_load(const char *file_name, int mode, long *bytes) {
+  WAVE  *w;
+  char  *buf;
+  short *x;
+  long  n;
+
+  if (wave_open_read(&w, file_name) != CT_OK)
+    return NULL;
+
+  // already how the card wants it
+  if ((wave_get_mode(w) == mode) && (wave_get_rate(w) == FS) &&
+      (wave_get_channels(w) == 1)) {
+    *bytes = wave_get_size(w);
+    buf = (char*)malloc(*bytes ? *bytes : 1);
+    *bytes = wave_read(w, buf, *bytes);
+    wave_close(w);
+    return buf;
+  }
+  wave_close(w);
+
+  if ((x = tc_read(file_name, FS, &n)) == NULL)
+    return NULL;
+  *bytes = n*wave_bytes_per_sample(mode);
+  buf = (char*)malloc(*bytes ? *bytes : 1);
+  tc_encode(buf, x, n, mode);
+  free(x);
+
+  return buf;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: tc_file
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Rewrites a file in another mode and rate.  The new file is written
+	alongside with the same extension, so it gets the same kind of
+	header, then renamed over the original.
+
+\*--------------------------------------------------------------------------*/
+
+int tc_file(const char *file_name, int mode, int rate) {
+  WAVE       *w;
+  short      *x;
+  char       *buf, *tmp;
+  const char *ext, *slash;
+  long       n, bytes;
+  int        ret;
+
+  if ((x = tc_read(file_name, rate, &n)) == NULL)
+    return CT_ERROR;
+  bytes = n*wave_bytes_per_sample(mode);
+  buf = (char*)malloc(bytes ? bytes : 1);
+  tc_encode(buf, x, n, mode);
+  free(x);
+
+  ext = strrchr(file_name, '.');
+  slash = strrchr(file_name, '/');
+  if ((ext == NULL) || (slash && (ext < slash)))
+    ext = file_name + strlen(file_name);
+  tmp = (char*)malloc(strlen(file_name) + 5);
+  sprintf(tmp, "%.*s.tc~%s", (int)(ext - file_name), file_name, ext);
+
+  ret = wave_open_write_rate(&w, tmp, mode, rate);
+  if (ret == CT_OK) {
+    if (wave_write(w, buf, bytes) != bytes)
+      ret = CT_ERROR;
+    wave_close(w);
+    if ((ret != CT_OK) || (rename(tmp, file_name) != 0)) {
+      unlink(tmp);
+      ret = CT_ERROR;
+    }
+  }
+
+  free(tmp);
+  free(buf);
+
+  return ret;
+}
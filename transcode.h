@@ -0,0 +1,64 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TRANSCODE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Converts audio between the CT_xxx modes and sample rates: G.711
+    encode/decode a vector at a time, and a polyphase resampler.  Also
+    whole file helpers for loading prompts and rewriting recordings.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __TRANSCODE__
+#define __TRANSCODE__
+
+// n samples between CT_xxx mode and linear, CT_LINEAR is a copy
+void  tc_decode(short *out, const char *in, long n, int mode);
+void  tc_encode(char *out, const short *in, long n, int mode);
+
+// non zero if tc_resample() can convert between the rates
+int   tc_resample_ok(int from, int to);
+
+// output samples tc_resample() will produce from n input samples
+long  tc_resample_len(long n, int from, int to);
+
+// resamples a whole buffer from one rate (Hz) to another, returns the
+// number of output samples or -1 if the rates aren't supported
+long  tc_resample(short *out, const short *in, long n, int from, int to);
+
+// reads a file as mono linear at rate Hz, caller frees, NULL on error
+short *tc_read(const char *file_name, int rate, long *n);
+
+// reads a file as 8 kHz mono in mode, *bytes is set to the size, caller
+// frees, NULL on error
+char  *tc_load(const char *file_name, int mode, long *bytes);
+
+// rewrites a file in place in the given mode and rate
+int   tc_file(const char *file_name, int mode, int rate);
+
+#endif
@@ -0,0 +1,173 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: TRANSCODEBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Benchmark for the transcoder (transcode.cpp).  Checks the vector
+    G.711 against the scalar code in g711.cpp for every input, then
+    times both, and the resampler at the usual rates, in samples per
+    second on one core.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "ctbackend.h"
+#include "g711.h"
+#include "transcode.h"
+
+#define FS                 8000
+
+static const int rates[][2] = {
+  {8000, 16000}, {16000, 8000}, {8000, 44100}, {44100, 8000}, {48000, 8000}
+};
+#define NRATES             (int)(sizeof(rates)/sizeof(rates[0]))
+
+static double cpu_time() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1E9;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+// every code and every linear sample, returns the number of mismatches
+
+static int check(int mode) {
+  short x[65536], y[65536];
+  char  c[65536], d[65536];
+  int   i, bad = 0;
+
+  for(i=0; i<65536; i++) {
+    x[i] = (short)(i - 32768);
+    c[i] = (char)i;
+  }
+  tc_encode(d, x, 65536, mode);
+  for(i=0; i<65536; i++)
+    if ((unsigned char)d[i] != ((mode == CT_MULAW) ? linear2mulaw(x[i]) :
+				linear2alaw(x[i])))
+      bad++;
+  tc_decode(y, c, 256, mode);
+  for(i=0; i<256; i++)
+    if (y[i] != ((mode == CT_MULAW) ? mulaw2linear(i) : alaw2linear(i)))
+      bad++;
+
+  return bad;
+}
+
+static void report(const char *what, double cpu, long n) {
+  printf("  %-22s %8.1f M samples/s\n", what, n/cpu/1E6);
+}
+
+int main(int argc, char *argv[]) {
+  int    seconds = 60, i, k, mode;
+  long   n, m;
+  short  *x, *y;
+  char   *c;
+  double cpu, f;
+  char   what[64];
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-time s]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-time")) && (i+1 < argc))
+    seconds = atoi(argv[i+1]);
+
+  for(mode=CT_ALAW; mode<=CT_MULAW; mode++)
+    if ((k = check(mode)) != 0) {
+      printf("%s: %d mismatches against g711.cpp\n",
+	     mode == CT_MULAW ? "mulaw" : "alaw", k);
+      exit(1);
+    }
+  printf("G.711 matches g711.cpp for every input\n");
+
+  // speech-ish test signal, a few tones at varying level
+  n = (long)seconds*48000;
+  x = (short*)malloc(n*sizeof(short));
+  y = (short*)malloc((tc_resample_len(n, 8000, 48000) + 1)*sizeof(short));
+  c = (char*)malloc(n);
+  for(i=0; i<n; i++) {
+    f = sin(2*M_PI*3*i/FS);
+    x[i] = (short)(8000*f*(sin(2*M_PI*300*i/FS) + 0.5*sin(2*M_PI*1100*i/FS) +
+			   0.25*sin(2*M_PI*2500*i/FS)));
+  }
+
+  printf("%d s of 48 kHz audio:\n", seconds);
+  for(mode=CT_ALAW; mode<=CT_MULAW; mode++) {
+    const char *name = (mode == CT_MULAW) ? "mulaw" : "alaw";
+
+    cpu = cpu_time();
+    tc_encode(c, x, n, mode);
+    sprintf(what, "%s encode", name);
+    report(what, cpu_time() - cpu, n);
+
+    cpu = cpu_time();
+    for(i=0; i<n; i++)
+      c[i] = (mode == CT_MULAW) ? linear2mulaw(x[i]) : linear2alaw(x[i]);
+    sprintf(what, "%s encode scalar", name);
+    report(what, cpu_time() - cpu, n);
+
+    cpu = cpu_time();
+    tc_decode(y, c, n, mode);
+    sprintf(what, "%s decode", name);
+    report(what, cpu_time() - cpu, n);
+
+    cpu = cpu_time();
+    g711_to_linear(y, c, n, mode);
+    sprintf(what, "%s decode scalar", name);
+    report(what, cpu_time() - cpu, n);
+  }
+
+  // counted in output samples, a second of audio in is from samples
+  for(k=0; k<NRATES; k++) {
+    m = n/48000*rates[k][0];
+    cpu = cpu_time();
+    m = tc_resample(y, x, m, rates[k][0], rates[k][1]);
+    sprintf(what, "resample %d->%d", rates[k][0], rates[k][1]);
+    report(what, cpu_time() - cpu, m);
+  }
+
+  free(x);
+  free(y);
+  free(c);
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: VAD.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Voice activity detector, see vad.h.  It is run on every frame of a
+    recording, so the measurements are vectorised like the tone detector
+    and the mixer.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "vad.h"
+
+// energy per sample, the floor is kept above rms 10, speech must be above
+// rms 100 and 9 dB over the floor, or 5 dB if it has 40 zero crossings a
+// frame (1 kHz) like a fricative
+#define MIN_FLOOR          100.0f
+#define MIN_SPEECH         10000.0f
+#define THRESH             8.0f
+#define THRESH_ZC          3.0f
+#define ZC_HIGH            40
+
+// the floor drops to quiet frames quickly, rises to louder noise over a
+// second or so, and creeps up 1 dB a second under speech so a step in
+// the line noise isn't taken for speech for ever.  It doesn't rise for
+// HANG frames after speech, the quiet between syllables isn't noise.
+#define FALL               0.5f
+#define RISE               0.05f
+#define CREEP              1.005f
+#define HANG               10
+
+// loud frames in a row before they are speech, so clicks aren't
+#define ONSET              2
+
+void vad_init(VAD *v) {
+  memset(v, 0, sizeof(VAD));
+  v->first = v->last = -1;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: vad_measure
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Energy per sample and the number of sign changes in a frame.  With
+	SSE2 eight samples are squared and summed in pairs at a time, and
+	compared with the eight after them for the zero crossings.
+
+\*--------------------------------------------------------------------------*/
+
+void vad_measure(const short *x, float *energy, int *zc) {
+  float e = 0;
+  int   i = 0, z = 0;
+
+#ifdef __SSE2__
+  __m128i lo = _mm_set1_epi16(-32767), a, b, zacc = _mm_setzero_si128();
+  __m128  eacc = _mm_setzero_ps();
+  int     t[4];
+  float   s[4];
+
+  // -32768 squared twice would overflow the pair sum
+  for(; i+8 <= VAD_FRAME; i+=8) {
+    a = _mm_max_epi16(_mm_loadu_si128((const __m128i*)(x+i)), lo);
+    eacc = _mm_add_ps(eacc, _mm_cvtepi32_ps(_mm_madd_epi16(a, a)));
+  }
+  _mm_storeu_ps(s, eacc);
+  e = s[0] + s[1] + s[2] + s[3];
+
+  // the sign of x[i] against x[i+1], -1 where they differ
+  for(i=0; i+9 <= VAD_FRAME; i+=8) {
+    a = _mm_loadu_si128((const __m128i*)(x+i));
+    b = _mm_loadu_si128((const __m128i*)(x+i+1));
+    zacc = _mm_sub_epi16(zacc, _mm_srai_epi16(_mm_xor_si128(a, b), 15));
+  }
+  zacc = _mm_madd_epi16(zacc, _mm_set1_epi16(1));
+  _mm_storeu_si128((__m128i*)t, zacc);
+  z = t[0] + t[1] + t[2] + t[3];
+#else
+  for(i=0; i<VAD_FRAME; i++)
+    e += (float)x[i]*x[i];
+  i = 0;
+#endif
+
+  for(; i+1<VAD_FRAME; i++)
+    z += (x[i] ^ x[i+1]) < 0;
+
+  *energy = e/VAD_FRAME;
+  *zc = z;
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: vad_frame
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Decides if a frame is speech and moves the noise floor.  The first
+	of the ONSET frames that started the speech is its first frame,
+	and gaps of up to HANG frames are counted as speech.
+
+\*--------------------------------------------------------------------------*/
+
+int vad_frame(VAD *v, const short *x) {
+  float e, thresh;
+  int   zc, loud;
+  long  f = v->frames++, gap;
+
+  vad_measure(x, &e, &zc);
+  if (v->floor == 0)
+    v->floor = (e > MIN_FLOOR) ? e : MIN_FLOOR;
+
+  thresh = (zc >= ZC_HIGH) ? THRESH_ZC : THRESH;
+  loud = (e >= MIN_SPEECH) && (e >= thresh*v->floor);
+
+  if (loud) {
+    v->floor *= CREEP;
+    if (++v->run < ONSET)
+      return 0;
+    if (v->run == ONSET) {
+      if (v->first == -1)
+	v->first = f - ONSET + 1;
+      gap = f - ONSET - v->last;
+      v->speech += ONSET + ((v->last != -1) && (gap <= HANG) ? gap : 0);
+    }
+    else
+      v->speech++;
+    v->last = f;
+    return 1;
+  }
+
+  v->run = 0;
+  if (e < v->floor)
+    v->floor += (e - v->floor)*FALL;
+  else if ((v->last == -1) || (f - v->last > HANG))
+    v->floor += (e - v->floor)*RISE;
+  if (v->floor < MIN_FLOOR)
+    v->floor = MIN_FLOOR;
+  return 0;
+}
+
+void vad_audio(VAD *v, const short *x, long n) {
+  long m;
+
+  if (v->nbuf) {
+    m = VAD_FRAME - v->nbuf;
+    if (m > n)
+      m = n;
+    memcpy(v->buf + v->nbuf, x, m*sizeof(short));
+    v->nbuf += m;
+    x += m;
+    n -= m;
+    if (v->nbuf < VAD_FRAME)
+      return;
+    vad_frame(v, v->buf);
+    v->nbuf = 0;
+  }
+
+  for(; n >= VAD_FRAME; x += VAD_FRAME, n -= VAD_FRAME)
+    vad_frame(v, x);
+
+  memcpy(v->buf, x, n*sizeof(short));
+  v->nbuf = n;
+}
+
+long vad_silence(VAD *v) {
+  return (v->last == -1) ? -1 : v->frames - 1 - v->last;
+}
@@ -0,0 +1,71 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: VAD.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Voice activity detector, for ending recordings once the caller stops
+    talking and trimming the silence either side of what they said.
+    Each 20 ms frame's energy is compared with a noise floor that follows
+    the line noise, frames with many zero crossings (s, f, sh) need less
+    energy to count as speech.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __VAD__
+#define __VAD__
+
+#define VAD_FRAME          160          // samples, 20 ms
+#define VAD_FRAME_MS       20
+
+typedef struct {
+  float         floor;                  // noise energy per sample, 0 unset
+  int           run;                    // loud frames in a row
+  short         buf[VAD_FRAME];         // part of a frame from vad_audio
+  int           nbuf;
+
+  // in frames, from the start
+  long          frames;                 // seen
+  long          speech;                 // of speech
+  long          first, last;            // speech frames, -1 for none
+} VAD;
+
+void vad_init(VAD *v);
+
+// one frame of VAD_FRAME linear samples, 1 if it is speech
+int  vad_frame(VAD *v, const short *x);
+
+// linear audio of any length, split into frames
+void vad_audio(VAD *v, const short *x, long n);
+
+// frames since the last speech, -1 if there hasn't been any
+long vad_silence(VAD *v);
+
+// energy per sample and zero crossings of one frame
+void vad_measure(const short *x, float *energy, int *zc);
+
+#endif
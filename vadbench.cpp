@@ -0,0 +1,158 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: VADBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Benchmark for the voice activity detector (vad.cpp).  Every channel
+    hears line noise at one of a few levels, with talking in two known
+    spans.  Each channel's first and last speech frames are checked
+    against the spans, and the CPU per channel frame is reported.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "vad.h"
+
+#define FS                 8000
+#define LEVELS             4
+
+// rms of the line noise, the quietest a ctserver sim channel, the
+// loudest a poor line 30 dB below the talking
+static const int noise_rms[LEVELS] = {18, 50, 120, 250};
+
+// talking, in ms
+static const long talk[2][2] = {{1500, 4000}, {5000, 7200}};
+
+static float noise(unsigned int *seed) {
+  *seed = *seed*1103515245 + 12345;
+  return ((int)((*seed >> 16) % 2001) - 1000)/1000.0*sqrt(3);
+}
+
+// a 125 Hz buzz rising and falling four times a second like syllables
+
+static float speech(long n) {
+  float y = 0;
+  int   k;
+
+  for(k=1; k<=8; k++)
+    y += sin(2*M_PI*125*k*n/FS)/k;
+  return 1500*(0.6 + 0.4*sin(2*M_PI*4*n/FS))*y;
+}
+
+static void generate(int level, short *x, long n) {
+  unsigned int seed = level;
+  long         i;
+  int          j;
+  float        y;
+
+  for(i=0; i<n; i++) {
+    y = noise_rms[level]*noise(&seed);
+    for(j=0; j<2; j++)
+      if ((i >= talk[j][0]*FS/1000) && (i < talk[j][1]*FS/1000))
+	y += speech(i);
+    x[i] = (short)y;
+  }
+}
+
+static double cpu_time() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1E9;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int    channels = 1024, seconds = 10, i, k;
+  VAD    *v;
+  short  *audio[LEVELS];
+  long   n, f, frames, want;
+  double cpu;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-channels n] [-time s]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-channels")) && (i+1 < argc))
+    channels = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-time")) && (i+1 < argc))
+    seconds = atoi(argv[i+1]);
+  if (seconds*1000 < talk[1][1]) {
+    fprintf(stderr, "-time must be at least %ld s\n", talk[1][1]/1000+1);
+    exit(1);
+  }
+
+  frames = (long)seconds*FS/VAD_FRAME;
+  n = frames*VAD_FRAME;
+  for(k=0; k<LEVELS; k++) {
+    audio[k] = (short*)malloc(n*sizeof(short));
+    generate(k, audio[k], n);
+  }
+
+  v = (VAD*)malloc(channels*sizeof(VAD));
+  for(i=0; i<channels; i++)
+    vad_init(&v[i]);
+
+  cpu = cpu_time();
+  for(f=0; f<frames; f++)
+    for(i=0; i<channels; i++)
+      vad_frame(&v[i], audio[i % LEVELS] + f*VAD_FRAME);
+  cpu = cpu_time() - cpu;
+
+  want = (talk[0][1] - talk[0][0] + talk[1][1] - talk[1][0])/VAD_FRAME_MS;
+  printf("%d channels %d s of audio, talking %ld-%ld and %ld-%ld ms, "
+	 "%ld frames\n", channels, seconds, talk[0][0], talk[0][1],
+	 talk[1][0], talk[1][1], want);
+  printf("  %-9s %7s %7s %7s\n", "noise", "first", "last", "speech");
+  for(k=0; k<LEVELS && k<channels; k++)
+    printf("  rms %-5d %7ld %7ld %7ld\n", noise_rms[k],
+	   v[k].first*VAD_FRAME_MS, (v[k].last+1)*VAD_FRAME_MS,
+	   v[k].speech);
+  printf("%.3f s CPU, %.0f ns per channel frame, %.0f channels per core\n",
+	 cpu, cpu*1E9/((double)frames*channels),
+	 (double)channels*seconds/cpu);
+
+  for(k=0; k<LEVELS; k++)
+    free(audio[k]);
+  free(v);
+
+  return 0;
+}
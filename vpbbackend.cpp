@@ -0,0 +1,453 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: VPBBACKEND.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Channel backend for Voicetronix cards, a thin layer over libvpb.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <vpbapi.h>
+#include "ctbackend.h"
+
+typedef struct WORKER WORKER;
+
+static WORKER *worker_start(int h, int record);
+static void   worker_stop(WORKER *w);
+
+class VpbBackend : public CTBackend {
+public:
+  VpbBackend();
+
+  int  num_boards();
+  int  num_channels(int board);
+  int  open(int board, int channel);
+  void close(int h);
+  int  sethook(int h, int hookstate);
+  int  get_event(CT_EVENT *e, unsigned int time_out);
+  int  play_buf_async(int h, const char *buf, long n, int mode);
+  int  play_terminate(int h);
+  int  record_file_async(int h, const char *file_name, int mode,
+			 unsigned int time_out);
+  int  record_terminate(int h);
+  int  record_stream_async(int h, int mode, unsigned int time_out,
+			   CT_AUDIO_CB cb, void *arg);
+  int  play_stream_async(int h, int mode, CT_FILL_CB cb, void *arg);
+  int  dial_async(int h, const char *dial_str);
+
+private:
+  WORKER          *worker(int h, int record);
+
+  pthread_mutex_t mutex;          // open may be called from several threads
+  WORKER          **players;      // each handle's play thread
+  WORKER          **recorders;    // and record thread
+  int             nworkers;
+};
+
+static int vpb_mode(int mode) {
+  switch(mode) {
+  case CT_ALAW:  return VPB_ALAW;
+  case CT_MULAW: return VPB_MULAW;
+  default:       return VPB_LINEAR;
+  }
+}
+
+static int ret(int r) {
+  return (r == VPB_OK) ? CT_OK : CT_ERROR;
+}
+
+VpbBackend::VpbBackend() {
+  vpb_seterrormode(VPB_ERROR_CODE);
+  pthread_mutex_init(&mutex, NULL);
+  players = NULL;
+  recorders = NULL;
+  nworkers = 0;
+}
+
+// libvpb only knows how many cards there are, and that they are all
+// the same
+
+int VpbBackend::num_boards() {
+  return vpb_get_num_cards();
+}
+
+int VpbBackend::num_channels(int board) {
+  return vpb_get_ports_per_card();
+}
+
+int VpbBackend::open(int board, int channel) {
+  WORKER *p, *r;
+  int    h = vpb_open(board, channel);
+
+  if ((h < 0) || ((p = worker_start(h, 0)) == NULL))
+    return -1;
+  if ((r = worker_start(h, 1)) == NULL) {
+    worker_stop(p);
+    return -1;
+  }
+
+  pthread_mutex_lock(&mutex);
+  if (h >= nworkers) {
+    players = (WORKER**)realloc(players, (h+1)*sizeof(WORKER*));
+    recorders = (WORKER**)realloc(recorders, (h+1)*sizeof(WORKER*));
+    memset(players+nworkers, 0, (h+1-nworkers)*sizeof(WORKER*));
+    memset(recorders+nworkers, 0, (h+1-nworkers)*sizeof(WORKER*));
+    nworkers = h+1;
+  }
+  players[h] = p;
+  recorders[h] = r;
+  pthread_mutex_unlock(&mutex);
+
+  return h;
+}
+
+void VpbBackend::close(int h) {
+  WORKER *p = NULL, *r = NULL;
+
+  pthread_mutex_lock(&mutex);
+  if (h < nworkers) {
+    p = players[h];
+    r = recorders[h];
+    players[h] = recorders[h] = NULL;
+  }
+  pthread_mutex_unlock(&mutex);
+
+  if (p)
+    worker_stop(p);
+  if (r)
+    worker_stop(r);
+  vpb_close(h);
+}
+
+int VpbBackend::sethook(int h, int hookstate) {
+  return ret(vpb_sethook_async(h, hookstate == CT_OFFHOOK ? VPB_OFFHOOK :
+			       VPB_ONHOOK));
+}
+
+// translates the VPB events ctserver uses, others are passed on with a
+// type of -1 so they are still logged
+
+int VpbBackend::get_event(CT_EVENT *e, unsigned int time_out) {
+  VPB_EVENT v;
+
+  if (vpb_get_event_sync(&v, time_out) != VPB_OK)
+    return CT_TIME_OUT;
+
+  e->handle = v.handle;
+  e->data = v.data;
+  switch(v.type) {
+  case VPB_RING:       e->type = CT_RING; break;
+  case VPB_PLAYEND:    e->type = CT_PLAYEND; break;
+  case VPB_RECORDEND:  e->type = CT_RECORDEND; break;
+  case VPB_DTMF:       e->type = CT_DTMF; break;
+  case VPB_DIALEND:    e->type = CT_DIALEND; break;
+  case VPB_TONEDETECT:
+    e->type = CT_TONEDETECT;
+    switch(v.data) {
+    case VPB_DIAL:     e->data = CT_TONE_DIAL; break;
+    case VPB_RINGBACK: e->data = CT_TONE_RINGBACK; break;
+    case VPB_BUSY:     e->data = CT_TONE_BUSY; break;
+    case VPB_GRUNT:    e->data = CT_TONE_GRUNT; break;
+    default:           e->data = -1; break;
+    }
+    break;
+  default:
+    e->type = -1;
+    e->data = v.type;
+    break;
+  }
+
+  return CT_OK;
+}
+
+// libvpb only plays and records buffers synchronously, so each channel
+// has two worker threads, started when it is opened.  The play worker
+// feeds the card the buffers queued for it and posts VPB_PLAYEND after
+// each, the event data being how far through the buffer we got.  Streamed
+// plays, whose audio comes from a callback as the card needs it, are
+// queued the same way.  The record worker reads streamed recordings into
+// their callbacks and posts VPB_RECORDEND.  As one thread does all of a
+// channel's plays, and another all of its recordings, each is finished
+// with the card before the next one starts, and a conference leg can play
+// and record at once.
+//
+// play_terminate and record_terminate end every job queued so far on
+// their worker, including one the thread has taken but not yet started on
+// the card, where vpb_play_terminate or vpb_record_terminate would be
+// lost.  The threads check between chunks.
+
+#define PLAY_CHUNK         1024
+#define PLAY_BLOCK         320
+#define RECORD_CHUNK       320
+
+typedef struct JOB {
+  const char       *buf;          // to play
+  unsigned long    n;             // bytes to play, or record, 0 for no limit
+  int              mode;
+  CT_FILL_CB       fill;          // streamed play if set, buf is unused
+  CT_AUDIO_CB      audio;         // streamed recording
+  void             *arg;
+  unsigned long    seq;
+  struct JOB       *next;
+} JOB;
+
+struct WORKER {
+  int              h;
+  int              record;        // the record worker, else the play worker
+  pthread_t        thread;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   cond;          // a job queued, or quit
+  JOB              *head, *tail;
+  int              quit;
+  unsigned long    queued;        // seq of the last job queued
+  unsigned long    stopped;       // jobs up to this seq are terminated
+};
+
+static int stopped(WORKER *w, JOB *j) {
+  return __atomic_load_n(&w->stopped, __ATOMIC_ACQUIRE) >= j->seq;
+}
+
+static void play(WORKER *w, JOB *j) {
+  VPB_EVENT     e;
+  char          buf[PLAY_BLOCK];
+  unsigned long i, m;
+
+  vpb_play_buf_start(w->h, vpb_mode(j->mode));
+  if (j->fill) {
+    for(i=0; !stopped(w, j); i+=PLAY_BLOCK) {
+      j->fill(j->arg, buf, PLAY_BLOCK);
+      if (vpb_play_buf_sync(w->h, buf, PLAY_BLOCK) != VPB_OK)
+	break;
+    }
+  }
+  else {
+    for(i=0; (i<j->n) && !stopped(w, j); i+=m) {
+      m = (j->n-i < PLAY_CHUNK) ? j->n-i : PLAY_CHUNK;
+      if (vpb_play_buf_sync(w->h, (char*)j->buf+i, m) != VPB_OK)
+	break;
+    }
+  }
+  vpb_play_buf_finish(w->h);
+
+  e.type = VPB_PLAYEND;
+  e.handle = w->h;
+  e.data = i;
+  vpb_put_event(&e);
+}
+
+// ends at the time out, or when record_terminate makes
+// vpb_record_buf_sync return early
+
+static void record(WORKER *w, JOB *j) {
+  VPB_EVENT     e;
+  char          buf[RECORD_CHUNK];
+  unsigned long i, m;
+
+  vpb_record_buf_start(w->h, vpb_mode(j->mode));
+  for(i=0; (!j->n || (i<j->n)) && !stopped(w, j); i+=m) {
+    m = RECORD_CHUNK;
+    if (j->n && (j->n-i < m))
+      m = j->n-i;
+    if (vpb_record_buf_sync(w->h, buf, m) != VPB_OK)
+      break;
+    j->audio(j->arg, buf, m);
+  }
+  vpb_record_buf_finish(w->h);
+
+  e.type = VPB_RECORDEND;
+  e.handle = w->h;
+  e.data = 0;
+  vpb_put_event(&e);
+}
+
+static void *worker_thread(void *pv) {
+  WORKER *w = (WORKER*)pv;
+  JOB    *j;
+
+  pthread_mutex_lock(&w->mutex);
+  for(;;) {
+    while(!w->head && !w->quit)
+      pthread_cond_wait(&w->cond, &w->mutex);
+    if (w->quit)
+      break;
+    j = w->head;
+    w->head = j->next;
+    if (w->head == NULL)
+      w->tail = NULL;
+    pthread_mutex_unlock(&w->mutex);
+
+    if (w->record)
+      record(w, j);
+    else
+      play(w, j);
+    free(j);
+
+    pthread_mutex_lock(&w->mutex);
+  }
+  pthread_mutex_unlock(&w->mutex);
+
+  return NULL;
+}
+
+static WORKER *worker_start(int h, int record) {
+  WORKER *w = (WORKER*)malloc(sizeof(WORKER));
+
+  memset(w, 0, sizeof(WORKER));
+  w->h = h;
+  w->record = record;
+  pthread_mutex_init(&w->mutex, NULL);
+  pthread_cond_init(&w->cond, NULL);
+  if (pthread_create(&w->thread, NULL, worker_thread, w) != 0) {
+    free(w);
+    return NULL;
+  }
+
+  return w;
+}
+
+// ends every job queued so far, and the one on the card
+
+static int worker_terminate(WORKER *w) {
+  pthread_mutex_lock(&w->mutex);
+  __atomic_store_n(&w->stopped, w->queued, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&w->mutex);
+
+  return w->record ? vpb_record_terminate(w->h) : vpb_play_terminate(w->h);
+}
+
+// ends the worker thread, jobs still queued are dropped
+
+static void worker_stop(WORKER *w) {
+  JOB *j;
+
+  pthread_mutex_lock(&w->mutex);
+  w->quit = 1;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->mutex);
+  worker_terminate(w);
+  pthread_join(w->thread, NULL);
+
+  while((j = w->head) != NULL) {
+    w->head = j->next;
+    free(j);
+  }
+  pthread_mutex_destroy(&w->mutex);
+  pthread_cond_destroy(&w->cond);
+  free(w);
+}
+
+static int worker_queue(WORKER *w, JOB *j) {
+  if (w == NULL) {
+    free(j);
+    return CT_ERROR;
+  }
+
+  j->next = NULL;
+  pthread_mutex_lock(&w->mutex);
+  j->seq = ++w->queued;
+  if (w->tail)
+    w->tail->next = j;
+  else
+    w->head = j;
+  w->tail = j;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->mutex);
+
+  return CT_OK;
+}
+
+WORKER *VpbBackend::worker(int h, int record) {
+  WORKER *w = NULL;
+
+  pthread_mutex_lock(&mutex);
+  if ((h >= 0) && (h < nworkers))
+    w = record ? recorders[h] : players[h];
+  pthread_mutex_unlock(&mutex);
+
+  return w;
+}
+
+int VpbBackend::play_buf_async(int h, const char *buf, long n, int mode) {
+  JOB *j = (JOB*)calloc(1, sizeof(JOB));
+
+  j->buf = buf;
+  j->n = n;
+  j->mode = mode;
+  return worker_queue(worker(h, 0), j);
+}
+
+int VpbBackend::play_terminate(int h) {
+  WORKER *w = worker(h, 0);
+
+  return ret(w ? worker_terminate(w) : vpb_play_terminate(h));
+}
+
+int VpbBackend::record_file_async(int h, const char *file_name, int mode,
+				  unsigned int time_out) {
+  VPB_RECORD r = {"", time_out};
+
+  vpb_record_set(h, &r);
+  return ret(vpb_record_file_async(h, (char*)file_name, vpb_mode(mode)));
+}
+
+int VpbBackend::record_terminate(int h) {
+  WORKER *w = worker(h, 1);
+
+  return ret(w ? worker_terminate(w) : vpb_record_terminate(h));
+}
+
+int VpbBackend::record_stream_async(int h, int mode, unsigned int time_out,
+				    CT_AUDIO_CB cb, void *arg) {
+  JOB *j = (JOB*)calloc(1, sizeof(JOB));
+
+  j->n = (unsigned long)time_out * 8 * (mode == CT_LINEAR ? 2 : 1);
+  j->mode = mode;
+  j->audio = cb;
+  j->arg = arg;
+  return worker_queue(worker(h, 1), j);
+}
+
+int VpbBackend::play_stream_async(int h, int mode, CT_FILL_CB cb, void *arg) {
+  JOB *j = (JOB*)calloc(1, sizeof(JOB));
+
+  j->mode = mode;
+  j->fill = cb;
+  j->arg = arg;
+  return worker_queue(worker(h, 0), j);
+}
+
+int VpbBackend::dial_async(int h, const char *dial_str) {
+  return ret(vpb_dial_async(h, (char*)dial_str));
+}
+
+CTBackend *vpb_backend_create() {
+  return new VpbBackend();
+}
@@ -0,0 +1,493 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WAVE.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Audio file reading and writing, see wave.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ctbackend.h"
+#include "wave.h"
+
+// file types
+#define WAVE_WAV           0
+#define WAVE_AU            1
+#define WAVE_VOX           2
+
+// Sun .au encodings
+#define AU_MULAW           1
+#define AU_LINEAR16        3
+#define AU_ALAW            27
+
+// .wav format tags
+#define WAV_PCM            1
+#define WAV_ALAW           6
+#define WAV_MULAW          7
+
+#define WAV_HEADER         44
+#define AU_HEADER          24
+
+// sample rates we'll read, Hz
+#define RATE_OK(r)         (((r) >= 4000) && ((r) <= 48000))
+
+struct WAVE {
+  FILE          *f;
+  int           type;             // WAVE_xxx
+  int           mode;             // CT_xxx
+  int           swap;             // linear samples are big endian
+  int           writing;
+  int           rate;             // Hz
+  int           channels;
+  unsigned long offset;           // where the sample data starts
+  unsigned long size;             // bytes of sample data
+  unsigned long pos;              // bytes read or written so far
+};
+
+static unsigned long get_le(unsigned char *p, int n) {
+  unsigned long v = 0;
+  while(n--)
+    v = (v << 8) | p[n];
+  return v;
+}
+
+static unsigned long get_be(unsigned char *p, int n) {
+  unsigned long v = 0;
+  int           i;
+  for(i=0; i<n; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static void put_le(unsigned char *p, unsigned long v, int n) {
+  int i;
+  for(i=0; i<n; i++, v >>= 8)
+    p[i] = v & 0xff;
+}
+
+static void put_be(unsigned char *p, unsigned long v, int n) {
+  while(n--) {
+    p[n] = v & 0xff;
+    v >>= 8;
+  }
+}
+
+static int vox_mode(const char *file_name) {
+  const char *ext = strrchr(file_name, '.');
+
+  if (ext == NULL)
+    return -1;
+  if (!strcmp(ext, ".ul"))
+    return CT_MULAW;
+  if (!strcmp(ext, ".al"))
+    return CT_ALAW;
+  if (!strcmp(ext, ".sw"))
+    return CT_LINEAR;
+  return -1;
+}
+
+static int is_au(const char *file_name) {
+  const char *ext = strrchr(file_name, '.');
+  return (ext != NULL) && !strcmp(ext, ".au");
+}
+
+int wave_bytes_per_sample(int mode) {
+  return (mode == CT_LINEAR) ? 2 : 1;
+}
+
+// walks the RIFF chunks, leaving the file at the start of the data chunk
+
+static int read_wav_header(WAVE *w) {
+  unsigned char hdr[12], chunk[8], fmt[16];
+  unsigned long len;
+  int           tag, got_fmt = 0;
+
+  if (fread(hdr, 1, 12, w->f) != 12)
+    return CT_ERROR;
+  if (memcmp(hdr, "RIFF", 4) || memcmp(hdr+8, "WAVE", 4))
+    return CT_ERROR;
+
+  while(fread(chunk, 1, 8, w->f) == 8) {
+    len = get_le(chunk+4, 4);
+
+    if (!memcmp(chunk, "fmt ", 4)) {
+      if ((len < 16) || (fread(fmt, 1, 16, w->f) != 16))
+	return CT_ERROR;
+      tag = get_le(fmt, 2);
+      w->channels = get_le(fmt+2, 2);
+      w->rate = get_le(fmt+4, 4);
+      if (!RATE_OK(w->rate) || (w->channels < 1) || (w->channels > 2))
+	return CT_ERROR;
+      if ((tag == WAV_PCM) && (get_le(fmt+14, 2) == 16))
+	w->mode = CT_LINEAR;
+      else if (tag == WAV_ALAW)
+	w->mode = CT_ALAW;
+      else if (tag == WAV_MULAW)
+	w->mode = CT_MULAW;
+      else
+	return CT_ERROR;
+      got_fmt = 1;
+      fseek(w->f, len - 16 + (len & 1), SEEK_CUR);
+    }
+    else if (!memcmp(chunk, "data", 4)) {
+      if (!got_fmt)
+	return CT_ERROR;
+      w->offset = ftell(w->f);
+      w->size = len;
+      return CT_OK;
+    }
+    else
+      fseek(w->f, len + (len & 1), SEEK_CUR);
+  }
+
+  return CT_ERROR;
+}
+
+static int read_au_header(WAVE *w) {
+  unsigned char hdr[AU_HEADER];
+  unsigned long offset, size, file_size;
+
+  if (fread(hdr, 1, AU_HEADER, w->f) != AU_HEADER)
+    return CT_ERROR;
+  if (memcmp(hdr, ".snd", 4))
+    return CT_ERROR;
+
+  offset = get_be(hdr+4, 4);
+  size = get_be(hdr+8, 4);
+  switch(get_be(hdr+12, 4)) {
+  case AU_MULAW:    w->mode = CT_MULAW; break;
+  case AU_ALAW:     w->mode = CT_ALAW; break;
+  case AU_LINEAR16: w->mode = CT_LINEAR; w->swap = 1; break;
+  default:          return CT_ERROR;
+  }
+  w->rate = get_be(hdr+16, 4);
+  w->channels = get_be(hdr+20, 4);
+  if (!RATE_OK(w->rate) || (w->channels < 1) || (w->channels > 2))
+    return CT_ERROR;
+
+  // size is optional in .au files
+  fseek(w->f, 0, SEEK_END);
+  file_size = ftell(w->f);
+  if ((offset > file_size) || (size == 0xffffffff) ||
+      (offset + size > file_size))
+    size = file_size - offset;
+  fseek(w->f, offset, SEEK_SET);
+  w->offset = offset;
+  w->size = size;
+
+  return CT_OK;
+}
+
+int wave_open_read(WAVE **w, const char *file_name) {
+  int mode = vox_mode(file_name);
+  int ret;
+
+  if (mode != -1)
+    return wave_open_vox_read(w, file_name, mode);
+
+  *w = (WAVE*)calloc(1, sizeof(WAVE));
+  (*w)->f = fopen(file_name, "rb");
+  if ((*w)->f == NULL) {
+    free(*w);
+    return CT_ERROR;
+  }
+
+  if (is_au(file_name)) {
+    (*w)->type = WAVE_AU;
+    ret = read_au_header(*w);
+  }
+  else {
+    (*w)->type = WAVE_WAV;
+    ret = read_wav_header(*w);
+  }
+
+  if (ret != CT_OK) {
+    fclose((*w)->f);
+    free(*w);
+  }
+  return ret;
+}
+
+int wave_open_vox_read(WAVE **w, const char *file_name, int mode) {
+  *w = (WAVE*)calloc(1, sizeof(WAVE));
+  (*w)->f = fopen(file_name, "rb");
+  if ((*w)->f == NULL) {
+    free(*w);
+    return CT_ERROR;
+  }
+
+  (*w)->type = WAVE_VOX;
+  (*w)->mode = mode;
+  (*w)->rate = 8000;
+  (*w)->channels = 1;
+  fseek((*w)->f, 0, SEEK_END);
+  (*w)->size = ftell((*w)->f);
+  fseek((*w)->f, 0, SEEK_SET);
+
+  return CT_OK;
+}
+
+// header is written with zero sizes and fixed up by wave_close
+
+int wave_open_write(WAVE **w, const char *file_name, int mode) {
+  return wave_open_write_rate(w, file_name, mode, 8000);
+}
+
+int wave_open_write_rate(WAVE **w, const char *file_name, int mode, int rate) {
+  unsigned char hdr[WAV_HEADER];
+  int           vmode = vox_mode(file_name);
+
+  *w = (WAVE*)calloc(1, sizeof(WAVE));
+  (*w)->f = fopen(file_name, "wb");
+  if ((*w)->f == NULL) {
+    free(*w);
+    return CT_ERROR;
+  }
+  (*w)->mode = mode;
+  (*w)->writing = 1;
+  (*w)->rate = rate;
+  (*w)->channels = 1;
+
+  memset(hdr, 0, sizeof(hdr));
+  if (vmode != -1) {
+    (*w)->type = WAVE_VOX;
+  }
+  else if (is_au(file_name)) {
+    (*w)->type = WAVE_AU;
+    memcpy(hdr, ".snd", 4);
+    put_be(hdr+4, AU_HEADER, 4);
+    put_be(hdr+8, 0xffffffff, 4);
+    put_be(hdr+12, mode == CT_MULAW ? AU_MULAW :
+	   mode == CT_ALAW ? AU_ALAW : AU_LINEAR16, 4);
+    put_be(hdr+16, rate, 4);
+    put_be(hdr+20, 1, 4);
+    (*w)->swap = (mode == CT_LINEAR);
+    (*w)->offset = AU_HEADER;
+    fwrite(hdr, 1, AU_HEADER, (*w)->f);
+  }
+  else {
+    int bps = wave_bytes_per_sample(mode);
+
+    (*w)->type = WAVE_WAV;
+    memcpy(hdr, "RIFF", 4);
+    memcpy(hdr+8, "WAVEfmt ", 8);
+    put_le(hdr+16, 16, 4);
+    put_le(hdr+20, mode == CT_MULAW ? WAV_MULAW :
+	   mode == CT_ALAW ? WAV_ALAW : WAV_PCM, 2);
+    put_le(hdr+22, 1, 2);
+    put_le(hdr+24, rate, 4);
+    put_le(hdr+28, rate*bps, 4);
+    put_le(hdr+32, bps, 2);
+    put_le(hdr+34, 8*bps, 2);
+    memcpy(hdr+36, "data", 4);
+    (*w)->offset = WAV_HEADER;
+    fwrite(hdr, 1, WAV_HEADER, (*w)->f);
+  }
+
+  return CT_OK;
+}
+
+static void swap16(char *buf, long n) {
+  char t;
+  long i;
+
+  for(i=0; i+1<n; i+=2) {
+    t = buf[i]; buf[i] = buf[i+1]; buf[i+1] = t;
+  }
+}
+
+long wave_read(WAVE *w, char *buf, long n) {
+  long ret;
+
+  if ((unsigned long)n > w->size - w->pos)
+    n = w->size - w->pos;
+  ret = fread(buf, 1, n, w->f);
+  w->pos += ret;
+  if (w->swap)
+    swap16(buf, ret);
+
+  return ret;
+}
+
+int wave_seek(WAVE *w, unsigned long pos) {
+  if (pos > w->size)
+    pos = w->size;
+  if (fseek(w->f, w->offset + pos, SEEK_SET) != 0)
+    return CT_ERROR;
+  w->pos = pos;
+
+  return CT_OK;
+}
+
+long wave_write(WAVE *w, const char *buf, long n) {
+  char tmp[1024];
+  long i, m, ret = 0;
+
+  if (!w->swap) {
+    ret = fwrite(buf, 1, n, w->f);
+  }
+  else {
+    for(i=0; i<n; i+=m) {
+      m = (n-i < (long)sizeof(tmp)) ? n-i : sizeof(tmp);
+      memcpy(tmp, buf+i, m);
+      swap16(tmp, m);
+      ret += fwrite(tmp, 1, m, w->f);
+    }
+  }
+  w->pos += ret;
+  w->size = w->pos;
+
+  return ret;
+}
+
+// sets the sizes in the header, the data chunk is assumed to be last
+
+static void fix_header(WAVE *w) {
+  unsigned char b[4];
+
+  if (w->type == WAVE_WAV) {
+    put_le(b, w->offset - 8 + w->size, 4);
+    fseek(w->f, 4, SEEK_SET);
+    fwrite(b, 1, 4, w->f);
+    put_le(b, w->size, 4);
+    fseek(w->f, w->offset - 4, SEEK_SET);
+    fwrite(b, 1, 4, w->f);
+  }
+  if (w->type == WAVE_AU) {
+    put_be(b, w->size, 4);
+    fseek(w->f, 8, SEEK_SET);
+    fwrite(b, 1, 4, w->f);
+  }
+}
+
+void wave_close(WAVE *w) {
+  if (w->writing)
+    fix_header(w);
+  fclose(w->f);
+  free(w);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: wave_trim
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	Removes the last lose samples of a file in place, by truncating it
+	and fixing up the header.  The cost doesn't depend on the length
+	of the file.  Files with anything after the sample data are left
+	alone.
+
+\*--------------------------------------------------------------------------*/
+
+int wave_trim(const char *file_name, long lose) {
+  return wave_cut(file_name, 0, lose);
+}
+
+/*--------------------------------------------------------------------------*\
+
+	FUNCTION....: wave_cut
+	AUTHOR......: agent
+	DATE CREATED: 17/10/26
+
+	As wave_trim(), and also removes the first skip samples by moving
+	the rest of the sample data down, so that costs as much as copying
+	what is kept.
+
+\*--------------------------------------------------------------------------*/
+
+int wave_cut(const char *file_name, long skip, long lose) {
+  WAVE          *w;
+  char          buf[4096];
+  unsigned long head, tail, keep, done;
+  long          end;
+  size_t        n;
+  int           bps, ret = CT_ERROR;
+
+  if (wave_open_read(&w, file_name) != CT_OK)
+    return CT_ERROR;
+
+  fseek(w->f, 0, SEEK_END);
+  end = ftell(w->f);
+  if ((unsigned long)end == w->offset + w->size) {
+    bps = wave_bytes_per_sample(w->mode);
+    head = skip*bps;
+    tail = lose*bps;
+    if (head > w->size)
+      head = w->size;
+    if (tail > w->size - head)
+      tail = w->size - head;
+    keep = w->size - head - tail;
+    fclose(w->f);
+    w->f = fopen(file_name, "r+b");
+
+    for(done=0; w->f && head && (done < keep); done += n) {
+      n = (keep - done < sizeof(buf)) ? keep - done : sizeof(buf);
+      fseek(w->f, w->offset + head + done, SEEK_SET);
+      if (fread(buf, 1, n, w->f) != n)
+	break;
+      fseek(w->f, w->offset + done, SEEK_SET);
+      if (fwrite(buf, 1, n, w->f) != n)
+	break;
+    }
+    if (head && (done < keep))
+      keep = done;
+
+    w->size = keep;
+    if (w->f && (fflush(w->f) == 0) &&
+	(truncate(file_name, w->offset + w->size) == 0)) {
+      fix_header(w);
+      ret = CT_OK;
+    }
+  }
+
+  if (w->f)
+    fclose(w->f);
+  free(w);
+  return ret;
+}
+
+int wave_get_mode(WAVE *w) {
+  return w->mode;
+}
+
+unsigned long wave_get_size(WAVE *w) {
+  return w->size;
+}
+
+int wave_get_rate(WAVE *w) {
+  return w->rate;
+}
+
+int wave_get_channels(WAVE *w) {
+  return w->channels;
+}
@@ -0,0 +1,74 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WAVE.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Reads and writes the audio files ctserver deals with: .wav (PCM, A-law,
+    mu-law), Sun .au and headerless "vox" files (.ul, .al, .sw).  Samples
+    are presented in one of the CT_xxx modes, with linear samples in host
+    byte order.  Files may be 4 to 48 kHz, mono or stereo (interleaved);
+    headerless files are 8 kHz mono.  See transcode.h for converting.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __WAVE__
+#define __WAVE__
+
+typedef struct WAVE WAVE;
+
+// open for reading, format taken from the header or the file extension
+int  wave_open_read(WAVE **w, const char *file_name);
+
+// open a headerless file of samples in the given CT_xxx mode
+int  wave_open_vox_read(WAVE **w, const char *file_name, int mode);
+
+// open for writing, .au and .ul/.al/.sw extensions are honoured,
+// anything else gets a .wav header
+int  wave_open_write(WAVE **w, const char *file_name, int mode);
+
+// as above at rate Hz rather than 8 kHz
+int  wave_open_write_rate(WAVE **w, const char *file_name, int mode, int rate);
+
+long wave_read(WAVE *w, char *buf, long n);
+int  wave_seek(WAVE *w, unsigned long pos);   // bytes into sample data
+long wave_write(WAVE *w, const char *buf, long n);
+void wave_close(WAVE *w);
+
+// drops the last lose samples from a file, in place
+int  wave_trim(const char *file_name, long lose);
+
+// drops the first skip and the last lose samples from a file, in place
+int  wave_cut(const char *file_name, long skip, long lose);
+
+int  wave_get_mode(WAVE *w);
+unsigned long wave_get_size(WAVE *w);     // bytes of sample data
+int  wave_bytes_per_sample(int mode);
+int  wave_get_rate(WAVE *w);              // Hz
+int  wave_get_channels(WAVE *w);
+
+#endif
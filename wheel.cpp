@@ -0,0 +1,208 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WHEEL.CPP
+    TYPE....: C++ module
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Hierarchical timing wheel, see wheel.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include "wheel.h"
+
+#define LEVELS             4
+#define BITS               8
+#define SLOTS              (1<<BITS)
+#define MASK               (SLOTS-1)
+#define WORDS              (SLOTS/64)
+#define SPAN               (1ULL << (BITS*LEVELS))
+
+static WHEEL_TIMER        *slots[LEVELS][SLOTS];
+static unsigned long long occ[LEVELS][WORDS];   // slots with timers
+static unsigned long long cur;                  // ms, run up to here
+static long               count;
+
+// a timer due in the current turn of a level goes in that level, so the
+// slot it is in comes round before, or just as, it is due
+
+static void timer_link(WHEEL_TIMER *t) {
+  unsigned long long delta = t->expires - cur;
+  int                level, s;
+
+  if (delta >= SPAN) {
+    t->expires = cur + SPAN - 1;
+    delta = SPAN - 1;
+  }
+  for(level=0; (level<LEVELS-1) && (delta >> (BITS*(level+1))); level++);
+  s = (t->expires >> (BITS*level)) & MASK;
+
+  t->next = slots[level][s];
+  if (t->next)
+    t->next->pprev = &t->next;
+  slots[level][s] = t;
+  t->pprev = &slots[level][s];
+  t->level = level;
+  t->slot = s;
+  occ[level][s >> 6] |= 1ULL << (s & 63);
+}
+
+static void timer_unlink(WHEEL_TIMER *t) {
+  *t->pprev = t->next;
+  if (t->next)
+    t->next->pprev = t->pprev;
+  if (slots[t->level][t->slot] == NULL)
+    occ[t->level][t->slot >> 6] &= ~(1ULL << (t->slot & 63));
+  t->pprev = NULL;
+}
+
+// how many slots on from 'from' the next occupied one is, 1 to SLOTS,
+// or 0 if the level is empty
+
+static int next_slot(int level, int from) {
+  const unsigned long long *o = occ[level];
+  unsigned long long       bits;
+  int                      i, w, s, start;
+
+  start = (from+1) & MASK;
+  w = start >> 6;
+  bits = o[w] & (~0ULL << (start & 63));
+  for(i=0; i<=WORDS; i++) {
+    if (bits) {
+      s = (w << 6) + __builtin_ctzll(bits);
+      s = (s - from) & MASK;
+      return s ? s : SLOTS;
+    }
+    w = (w+1) % WORDS;
+    bits = o[w];
+  }
+
+  return 0;
+}
+
+// the next ms at which a timer is due, or a level has timers to move
+// down
+
+static unsigned long long next_tick() {
+  unsigned long long t, best = ~0ULL;
+  int                level, shift, d;
+
+  for(level=0; level<LEVELS; level++) {
+    shift = BITS*level;
+    d = next_slot(level, (cur >> shift) & MASK);
+    if (d == 0)
+      continue;
+    t = ((cur >> shift) + d) << shift;
+    if (t < best)
+      best = t;
+  }
+
+  return best;
+}
+
+void wheel_init(unsigned long long now) {
+  cur = now;
+}
+
+void wheel_timer_init(WHEEL_TIMER *t, WHEEL_CB cb, void *arg) {
+  t->next = NULL;
+  t->pprev = NULL;
+  t->cb = cb;
+  t->arg = arg;
+}
+
+void wheel_add(WHEEL_TIMER *t, unsigned long ms) {
+  if (t->pprev)
+    timer_unlink(t);
+  else
+    count++;
+
+  // the slot for cur has already been run
+  t->expires = cur + (ms ? ms : 1);
+  timer_link(t);
+}
+
+void wheel_cancel(WHEEL_TIMER *t) {
+  if (t->pprev == NULL)
+    return;
+  timer_unlink(t);
+  count--;
+}
+
+int wheel_pending(WHEEL_TIMER *t) {
+  return t->pprev != NULL;
+}
+
+void wheel_run(unsigned long long now) {
+  WHEEL_TIMER        *t, *list;
+  unsigned long long tick;
+  int                level, shift, s;
+
+  while(count && ((tick = next_tick()) <= now)) {
+    cur = tick;
+
+    // higher levels first, they may move timers into a lower slot that
+    // comes round now as well
+    for(level=LEVELS-1; level>0; level--) {
+      shift = BITS*level;
+      if (tick & ((1ULL << shift) - 1))
+	continue;
+      s = (tick >> shift) & MASK;
+      list = slots[level][s];
+      slots[level][s] = NULL;
+      occ[level][s >> 6] &= ~(1ULL << (s & 63));
+      while((t = list) != NULL) {
+	list = t->next;
+	timer_link(t);
+      }
+    }
+
+    s = tick & MASK;
+    while((t = slots[0][s]) != NULL) {
+      timer_unlink(t);
+      count--;
+      t->cb(t->arg);
+    }
+  }
+
+  // nothing is due before now, so the slots still line up
+  if (now > cur)
+    cur = now;
+}
+
+long wheel_timeout(unsigned long long now) {
+  unsigned long long tick;
+
+  if (count == 0)
+    return -1;
+  tick = next_tick();
+  if (tick <= now)
+    return 0;
+  if (tick - now > 0x7fffffff)
+    return 0x7fffffff;
+  return tick - now;
+}
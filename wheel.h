@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WHEEL.H
+    TYPE....: C++ header
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Hierarchical timing wheel, one for the whole server, with millisecond
+    resolution.  Four wheels of 256 slots cover 49 days.  Timers are kept
+    in a doubly linked list per slot, so starting and stopping one is
+    O(1) however many are running, and a timer due in a later turn of a
+    wheel is moved down a level when that turn comes.  A bitmap of
+    occupied slots finds the next timer without visiting empty slots.
+
+    Only the reactor thread may use it.  The timer structures belong to
+    the caller, nothing is allocated.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#ifndef __WHEEL__
+#define __WHEEL__
+
+typedef void (*WHEEL_CB)(void *arg);
+
+typedef struct WHEEL_TIMER {
+  struct WHEEL_TIMER *next;
+  struct WHEEL_TIMER **pprev;           // NULL when not running
+  unsigned long long expires;           // ms
+  short              level, slot;
+  WHEEL_CB           cb;
+  void               *arg;
+} WHEEL_TIMER;
+
+// time starts at now, in ms
+void wheel_init(unsigned long long now);
+
+void wheel_timer_init(WHEEL_TIMER *t, WHEEL_CB cb, void *arg);
+
+// (re)starts t to call its cb ms from now, 0 is on the next run
+void wheel_add(WHEEL_TIMER *t, unsigned long ms);
+
+void wheel_cancel(WHEEL_TIMER *t);
+int  wheel_pending(WHEEL_TIMER *t);
+
+// calls back every timer due by now.  Callbacks may start and stop
+// timers, including their own.
+void wheel_run(unsigned long long now);
+
+// ms from now until wheel_run next has something to do, -1 if no timer
+// is running
+long wheel_timeout(unsigned long long now);
+
+#endif
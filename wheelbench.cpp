@@ -0,0 +1,162 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WHEELBENCH.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Benchmark for the timing wheel (wheel.cpp).  Keeps a number of timers
+    running with lengths from a few ms to minutes, as sleeps, collects,
+    ring windows and idle clients would, restarting each as it expires
+    and cancelling some early.  Time moves on the way the reactor's does,
+    to the next timer or sooner.  Every expiry is checked to come in the
+    run that covers its time, and the cost of each operation is reported.
+
+\*---------------------------------------------------------------------------*/
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wheel.h"
+
+typedef struct {
+  WHEEL_TIMER        t;
+  unsigned long long due;                // ms
+} BENCH_TIMER;
+
+static unsigned long long prev_now, now;
+static long               fired, bad;
+
+static double cpu_time() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1E9;
+}
+
+static int arg_exists(int argc, char *argv[], const char *arg) {
+  int i;
+
+  for(i=0; i<argc; i++)
+    if (strcmp(argv[i],arg) == 0)
+      return i;
+
+  return 0;
+}
+
+// mostly short timeouts, some long ones
+
+static unsigned long length() {
+  int r = rand() % 100;
+
+  if (r < 60)
+    return 1 + rand() % 1000;
+  if (r < 90)
+    return 1000 + rand() % 60000;
+  return 60000 + rand() % 3600000;
+}
+
+static void expired(void *arg) {
+  BENCH_TIMER *b = (BENCH_TIMER*)arg;
+
+  if ((b->due <= prev_now) || (b->due > now))
+    bad++;
+  fired++;
+}
+
+int main(int argc, char *argv[]) {
+  int                timers = 100000, i, k;
+  long               ops = 10000000, adds = 0, cancels = 0, w, o;
+  BENCH_TIMER        *b;
+  unsigned long      ms;
+  double             cpu_ops = 0, cpu_run = 0, t;
+
+  if (arg_exists(argc,argv,"-h") || arg_exists(argc,argv,"--help")) {
+    printf("usage: %s [-timers n] [-ops n]\n", argv[0]);
+    exit(0);
+  }
+  if ((i = arg_exists(argc,argv,"-timers")) && (i+1 < argc))
+    timers = atoi(argv[i+1]);
+  if ((i = arg_exists(argc,argv,"-ops")) && (i+1 < argc))
+    ops = atol(argv[i+1]);
+
+  srand(1);
+  now = prev_now = 1000;
+  wheel_init(now);
+  b = (BENCH_TIMER*)calloc(timers, sizeof(BENCH_TIMER));
+  for(i=0; i<timers; i++)
+    wheel_timer_init(&b[i].t, expired, &b[i]);
+
+  for(o=0; o<ops; ) {
+    // the handlers for this wake up start and stop a few timers
+    t = cpu_time();
+    for(k=0; k<16; k++, o++) {
+      i = rand() % timers;
+      if (wheel_pending(&b[i].t) && (rand() % 4 == 0)) {
+	wheel_cancel(&b[i].t);
+	cancels++;
+      }
+      else {
+	ms = length();
+	b[i].due = now + ms;
+	wheel_add(&b[i].t, ms);
+	adds++;
+      }
+    }
+    cpu_ops += cpu_time() - t;
+
+    // then the reactor waits for the next timer, or is woken sooner
+    w = wheel_timeout(now);
+    if ((w == -1) || (w > 1000))
+      w = 1000;
+    prev_now = now;
+    now += rand() % (w+1);
+
+    t = cpu_time();
+    wheel_run(now);
+    cpu_run += cpu_time() - t;
+  }
+
+  // and the rest expire
+  while((w = wheel_timeout(now)) != -1) {
+    prev_now = now;
+    now += w;
+    t = cpu_time();
+    wheel_run(now);
+    cpu_run += cpu_time() - t;
+  }
+
+  printf("%d timers, %ld starts, %ld stops, %ld expiries, %ld late or "
+	 "early\n", timers, adds, cancels, fired, bad);
+  printf("start/stop %.0f ns, expiry %.0f ns including the scans for "
+	 "the next timer\n", cpu_ops*1E9/(adds+cancels),
+	 cpu_run*1E9/(fired ? fired : 1));
+
+  free(b);
+
+  return bad != 0;
+}
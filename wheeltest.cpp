@@ -0,0 +1,221 @@
+/*---------------------------------------------------------------------------*\
+
+    FILE....: WHEELTEST.CPP
+    TYPE....: C++ program
+    AUTHOR..: agent
+    DATE....: 17/10/26
+
+    Tests for the timing wheel (wheel.cpp).  Timers are started,
+    restarted and cancelled, including from their own callbacks, with
+    lengths either side of each level's span, and time is moved on in
+    steps of a ms, in one jump, or the way the reactor does it with
+    wheel_timeout.  Each timer must fire once, in the run that reaches
+    its time and not before.  Exits 1 if any check fails, run by make
+    test.
+
+\*---------------------------------------------------------------------------*/
+
+
+/*--------------------------------------------------------------------------*\
+
+       ctserver - client/server library for Computer Telephony programming
+
+       Copyright (C) 2026 agent agent@local
+
+       This library is free software; you can redistribute it and/or
+       modify it under the terms of the GNU Lesser General Public
+       License as published by the Free Software Foundation; either
+       version 2.1 of the License, or (at your option) any later version.
+
+       This library is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+       Lesser General Public License for more details.
+
+       You should have received a copy of the GNU Lesser General Public
+       License along with this library; if not, write to the Free Software
+       Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307
+       USA.
+
+\*--------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "wheel.h"
+
+#define SPAN               (1ULL << 32)  // the most a timer can wait, ms
+
+typedef struct {
+  WHEEL_TIMER        t;
+  unsigned long long due;               // ms
+  unsigned long long at;                // the run it fired in
+  int                fired;
+  unsigned long      period;            // restarts itself if non zero
+  WHEEL_TIMER        *other;            // cancels this when it fires
+} TEST_TIMER;
+
+static unsigned long long now;
+static unsigned long long last_due;
+static int                checks, failed, in_order;
+
+static void check(int ok, const char *what, unsigned long long n) {
+  checks++;
+  if (!ok) {
+    printf("wheeltest: %s (%llu)\n", what, n);
+    failed++;
+  }
+}
+
+static void expired(void *arg) {
+  TEST_TIMER *x = (TEST_TIMER*)arg;
+
+  x->fired++;
+  x->at = now;
+  if (x->due < last_due)
+    in_order = 0;
+  last_due = x->due;
+  if (x->period) {
+    x->due += x->period;
+    wheel_add(&x->t, x->period);
+  }
+  if (x->other)
+    wheel_cancel(x->other);
+}
+
+static void start(TEST_TIMER *x, unsigned long ms) {
+  x->due = now + (ms ? ms : 1);
+  x->fired = 0;
+  x->period = 0;
+  x->other = NULL;
+  wheel_add(&x->t, ms);
+}
+
+static void run(unsigned long long to) {
+  now = to;
+  wheel_run(now);
+}
+
+// one timer of ms, stepping up to the ms before it is due, then to it
+
+static void one_timer(unsigned long ms) {
+  TEST_TIMER x;
+
+  wheel_timer_init(&x.t, expired, &x);
+  start(&x, ms);
+  check(wheel_pending(&x.t), "started timer not pending", ms);
+  if (x.due - 1 > now)
+    run(x.due - 1);
+  check(x.fired == 0, "timer fired early", ms);
+  run(x.due);
+  check(x.fired == 1, "timer didn't fire when due", ms);
+  check(!wheel_pending(&x.t), "fired timer still pending", ms);
+  run(x.due + 1000);
+  check(x.fired == 1, "timer fired twice", ms);
+}
+
+// the reactor sleeps for wheel_timeout, then runs the wheel
+
+static void reactor(unsigned long ms) {
+  TEST_TIMER x;
+  long       wait;
+  int        wakes = 0;
+
+  wheel_timer_init(&x.t, expired, &x);
+  start(&x, ms);
+  while(!x.fired && (wakes < 100)) {
+    wait = wheel_timeout(now);
+    check((wait >= 0) && (now + wait <= x.due), "wheel_timeout past due",
+	  ms);
+    run(now + wait);
+    wakes++;
+  }
+  check(x.fired && (x.at == x.due), "reactor saw timer late or not at all",
+	ms);
+}
+
+int main(int argc, char *argv[]) {
+  static const unsigned long lengths[] = {
+    0, 1, 2, 255, 256, 257, 1000, 65535, 65536, 65537, 3600000,
+    16777215, 16777216, 16777217, 86400000
+  };
+  TEST_TIMER    x[1000], y;
+  unsigned long ms;
+  int           i, n;
+
+  // a realistic CLOCK_MONOTONIC in ms, not on any slot boundary
+  now = 123456789123ULL;
+  wheel_init(now);
+  check(wheel_timeout(now) == -1, "empty wheel has a timeout", 0);
+
+  n = sizeof(lengths)/sizeof(lengths[0]);
+  for(i=0; i<n; i++)
+    one_timer(lengths[i]);
+  for(i=0; i<n; i++)
+    reactor(lengths[i]);
+
+  // lengths past the span wait for the span
+  wheel_timer_init(&y.t, expired, &y);
+  start(&y, (unsigned long)(4*SPAN));
+  y.due = now + SPAN - 1;
+  run(y.due - 1);
+  check(y.fired == 0, "long timer fired early", 4*SPAN);
+  run(y.due);
+  check(y.fired == 1, "long timer not clamped to the span", 4*SPAN);
+
+  // restarting moves the timer, and it fires once
+  start(&y, 500);
+  start(&y, 100);
+  run(now + 100);
+  check(y.fired == 1, "restarted timer didn't fire at its new time", 100);
+  run(now + 1000);
+  check(y.fired == 1, "restarted timer fired at its old time too", 500);
+
+  // cancelled timers don't fire, and leave the wheel empty
+  start(&y, 100);
+  wheel_cancel(&y.t);
+  wheel_cancel(&y.t);
+  check(wheel_timeout(now) == -1, "cancelled timer left a timeout", 0);
+  run(now + 1000);
+  check(y.fired == 0, "cancelled timer fired", 100);
+
+  // a timer restarting itself from its callback, caught up in one run
+  start(&y, 100);
+  y.period = 100;
+  run(now + 1000);
+  check(y.fired == 10, "periodic timer missed a period", y.fired);
+  wheel_cancel(&y.t);
+
+  // two due together that cancel each other, only one fires
+  wheel_timer_init(&x[0].t, expired, &x[0]);
+  wheel_timer_init(&x[1].t, expired, &x[1]);
+  start(&x[0], 300);
+  start(&x[1], 300);
+  x[0].other = &x[1].t;
+  x[1].other = &x[0].t;
+  run(now + 300);
+  check(x[0].fired + x[1].fired == 1, "timer fired after being cancelled",
+	x[0].fired + x[1].fired);
+
+  // many timers over every level, in one jump they fire in time order
+  srand(1);
+  for(i=0; i<1000; i++) {
+    ms = (i % 4 == 0) ? rand() % 300 : (i % 4 == 1) ? rand() % 70000 :
+      (i % 4 == 2) ? rand() % 20000000 : rand() % 1000000000;
+    wheel_timer_init(&x[i].t, expired, &x[i]);
+    start(&x[i], ms);
+  }
+  for(i=0; i<1000; i+=7)
+    wheel_cancel(&x[i].t);
+  last_due = 0;
+  in_order = 1;
+  run(now + 1000000000);
+  for(i=0; i<1000; i++)
+    check(x[i].fired == ((i % 7) ? 1 : 0), "timer lost or cancel ignored",
+	  i);
+  check(in_order, "timers fired out of order", 0);
+  check(wheel_timeout(now) == -1, "wheel not empty at the end", 0);
+
+  printf("wheeltest: %d checks, %d failed\n", checks, failed);
+
+  return failed ? 1 : 0;
+}